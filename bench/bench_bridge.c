@@ -0,0 +1,577 @@
+/**
+ * @file bench_bridge.c
+ * @brief Control Area Network - Ethernet - Gateway - Packet Ring Bridge
+ * Benchmark (Utility)
+ * @details Bridges FRAMES classic and CAN-FD frames of TYPE_NET and
+ *          TYPE_ETH in both directions of bridge.h, with the TPACKET_V3
+ *          rings and with one system call per frame, and reports frames/s,
+ *          the CPU time of bridge_run() per frame and the latency of single
+ *          frames. Every frame is checked to arrive once, in order and
+ *          unchanged, and the layouts of the frames on the wire are
+ *          checked byte by byte. The Ethernet side is the device pair in
+ *          CEGW_BENCH_ETH as DEV:PEER (e.g. the ends of a veth), or the
+ *          loopback device. The CAN side is a raw socket pair of the device
+ *          in CEGW_BENCH_CAN (e.g. a vcan), or a loopback UDP socket pair.
+ *          Needs CAP_NET_RAW. Run with "make bench".
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <linux/can/raw.h>
+#include <linux/if_packet.h>
+#include "bridge.h"
+#include "hist.h"
+#include "timing.h"
+
+#define FRAMES 100000 /**< frames per run */
+#define CHUNK 256 /**< frames injected before each bridge_run() */
+#define SAMPLES 200 /**< single frames of a latency run */
+#define CAN_ID 0x123 /**< can_id of every frame */
+/** Environment variable with the CAN device of the benchmark */
+#define BENCH_CAN_ENV "CEGW_BENCH_CAN"
+/** Environment variable with the Ethernet devices of the benchmark */
+#define BENCH_ETH_ENV "CEGW_BENCH_ETH"
+
+/** The Ethernet device of the bridge and the one of the test frames */
+static char eth_dev[IFNAMSIZ] = "lo", eth_peer[IFNAMSIZ] = "lo";
+
+/**
+ * @fn double cpu_now(void)
+ * @brief CPU time of the calling thread in seconds.
+ */
+static double cpu_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @fn void check(int ok, const char *what)
+ * @brief exits with what if ok is 0.
+ */
+static void check(int ok, const char *what)
+{
+	if (!ok) {
+		fprintf(stderr, "bench_bridge: %s\n", what);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @fn void udp_pair(int fd[2])
+ * @brief two UDP sockets on 127.0.0.1 connected to each other.
+ */
+static void udp_pair(int fd[2])
+{
+	struct sockaddr_in addr[2];
+	socklen_t len = sizeof(addr[0]);
+	int rcvbuf = FORWARD_RCVBUF;
+
+	for (int i = 0; i < 2; ++i) {
+		memset(&addr[i], 0, sizeof(addr[i]));
+		addr[i].sin_family = AF_INET;
+		addr[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		fd[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		check(fd[i] >= 0 &&
+		      bind(fd[i], (struct sockaddr *) &addr[i], len) == 0 &&
+		      getsockname(fd[i], (struct sockaddr *) &addr[i],
+		                  &len) == 0, "UDP socket failed");
+		setsockopt(fd[i], SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+		           sizeof(rcvbuf));
+	}
+	check(connect(fd[0], (struct sockaddr *) &addr[1], len) == 0 &&
+	      connect(fd[1], (struct sockaddr *) &addr[0], len) == 0,
+	      "UDP connect failed");
+}
+
+/**
+ * @fn void can_pair(const char *dev, uint32_t flags, int fd[2])
+ * @brief two raw sockets of the CAN device dev, which see the frames of
+ *        each other, or a UDP pair if dev is NULL.
+ */
+static void can_pair(const char *dev, uint32_t flags, int fd[2])
+{
+	struct sockaddr_can addr = { .can_family = AF_CAN };
+	int on = 1;
+
+	if (dev == NULL) {
+		udp_pair(fd);
+		return;
+	}
+
+	addr.can_ifindex = if_nametoindex(dev);
+	for (int i = 0; i < 2; ++i) {
+		fd[i] = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+		check(fd[i] >= 0 && addr.can_ifindex != 0 &&
+		      (!(flags & F_CAN_FD) ||
+		       setsockopt(fd[i], SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on,
+		                  sizeof(on)) == 0) &&
+		      bind(fd[i], (struct sockaddr *) &addr,
+		           sizeof(addr)) == 0, "CAN socket failed");
+	}
+}
+
+/**
+ * @fn int eth_socket(void)
+ * @brief a packet socket of eth_peer, which sends and receives every
+ *        frame but its own.
+ */
+static int eth_socket(void)
+{
+	struct sockaddr_ll sll = {
+		.sll_family = AF_PACKET,
+		.sll_protocol = htons(ETH_P_ALL),
+		.sll_ifindex = if_nametoindex(eth_peer),
+	};
+	int rcvbuf = FORWARD_RCVBUF;
+	int on = 1;
+	int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+	check(fd >= 0 && sll.sll_ifindex != 0 &&
+	      bind(fd, (struct sockaddr *) &sll, sizeof(sll)) == 0,
+	      "packet socket failed (CAP_NET_RAW?)");
+	setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &on, sizeof(on));
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	return fd;
+}
+
+/**
+ * @fn void fill(struct canfd_frame *cf, size_t mtu, uint32_t seq)
+ * @brief the frame number seq: CAN_ID, full length, seq in the data.
+ */
+static void fill(struct canfd_frame *cf, size_t mtu, uint32_t seq)
+{
+	memset(cf, 0, sizeof(*cf));
+	cf->can_id = CAN_ID;
+	cf->len = mtu == CAN_MTU ? CAN_MAX_DLEN : CANFD_MAX_DLEN;
+	if (mtu == CANFD_MTU)
+		cf->flags = CANFD_BRS;
+	memcpy(cf->data, &seq, sizeof(seq));
+	memset(cf->data + sizeof(seq), seq & 0xff, cf->len - sizeof(seq));
+}
+
+/**
+ * @fn int match(const struct canfd_frame *cf, size_t mtu, uint32_t seq)
+ * @brief 1 if cf is the frame number seq of fill().
+ */
+static int match(const struct canfd_frame *cf, size_t mtu, uint32_t seq)
+{
+	struct canfd_frame want;
+
+	fill(&want, mtu, seq);
+	return cf->can_id == want.can_id && cf->len == want.len &&
+	       cf->flags == want.flags &&
+	       !memcmp(cf->data, want.data, want.len);
+}
+
+/**
+ * @struct stream
+ * @brief Numbered frames, sent and checked by the inject and drain
+ *        functions.
+ */
+struct stream {
+	const struct bridge *b;	/**< the bridge, for the encapsulation */
+	uint8_t buf[CHUNK][ETH_FRAME_LEN]; /**< buffers */
+	struct iovec iov[CHUNK];	/**< one per frame */
+	struct mmsghdr msgs[CHUNK];	/**< one per frame */
+	size_t mtu;		/**< CAN_MTU or CANFD_MTU */
+	uint32_t sent;		/**< number of injected frames */
+	uint32_t received;	/**< number of drained frames */
+};
+
+/**
+ * @fn void stream_init(struct stream *s, const struct bridge *b)
+ * @brief prepares s for the frames of b.
+ */
+static void stream_init(struct stream *s, const struct bridge *b)
+{
+	memset(s, 0, sizeof(*s));
+	s->b = b;
+	s->mtu = b->flags & F_CAN_FD ? CANFD_MTU : CAN_MTU;
+	for (int i = 0; i < CHUNK; ++i) {
+		s->iov[i].iov_base = s->buf[i];
+		s->msgs[i].msg_hdr.msg_iov = &s->iov[i];
+		s->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+/**
+ * @fn void inject_can(struct stream *s, int fd, unsigned int n)
+ * @brief sends the next n frames to the CAN socket fd as far as it takes
+ *        them.
+ */
+static void inject_can(struct stream *s, int fd, unsigned int n)
+{
+	for (unsigned int i = 0; i < n; ++i) {
+		fill((struct canfd_frame *) s->buf[i], s->mtu, s->sent + i);
+		s->iov[i].iov_len = s->mtu;
+	}
+
+	int r = sendmmsg(fd, s->msgs, n, MSG_DONTWAIT);
+	if (r > 0)
+		s->sent += r;
+}
+
+/**
+ * @fn void inject_eth(struct stream *s, int fd, unsigned int n)
+ * @brief sends the next n frames encapsulated to the packet socket fd as
+ *        far as it takes them.
+ */
+static void inject_eth(struct stream *s, int fd, unsigned int n)
+{
+	size_t off = bridge_can_offset(s->b->type);
+
+	for (unsigned int i = 0; i < n; ++i) {
+		fill((struct canfd_frame *) (s->buf[i] + off), s->mtu,
+		     s->sent + i);
+		s->iov[i].iov_len = bridge_encap(s->b, s->buf[i], s->mtu);
+	}
+
+	int r = sendmmsg(fd, s->msgs, n, MSG_DONTWAIT);
+	if (r > 0)
+		s->sent += r;
+}
+
+/**
+ * @fn int drain_can(struct stream *s, int fd)
+ * @brief receives and checks the frames waiting at the CAN socket fd.
+ * @retval the number of frames
+ */
+static int drain_can(struct stream *s, int fd)
+{
+	int n, total = 0;
+
+	do {
+		for (int i = 0; i < CHUNK; ++i)
+			s->iov[i].iov_len = CANFD_MTU;
+
+		n = recvmmsg(fd, s->msgs, CHUNK, MSG_DONTWAIT, NULL);
+		for (int i = 0; i < n; ++i) {
+			check(s->msgs[i].msg_len == s->mtu &&
+			      match((struct canfd_frame *) s->buf[i], s->mtu,
+			            s->received), "bridged frame differs");
+			s->received++;
+		}
+		total += n > 0 ? n : 0;
+	} while (n == CHUNK);
+
+	return total;
+}
+
+/**
+ * @fn int drain_eth(struct stream *s, int fd)
+ * @brief receives and checks the frames of the type of the bridge waiting
+ *        at the packet socket fd, other traffic is skipped.
+ * @retval the number of frames
+ */
+static int drain_eth(struct stream *s, int fd)
+{
+	struct sockaddr_ll sll;
+	struct canfd_frame hdr;
+	struct iovec iov[2];
+	uint8_t cf[CANFD_MTU];
+	int total = 0;
+
+	for (;;) {
+		socklen_t sll_len = sizeof(sll);
+		ssize_t n = recvfrom(fd, s->buf[0], ETH_FRAME_LEN,
+		                     MSG_DONTWAIT, (struct sockaddr *) &sll,
+		                     &sll_len);
+		int len;
+
+		if (n < 0)
+			break;
+		if (sll.sll_pkttype == PACKET_OUTGOING)
+			continue;
+
+		len = bridge_decap(s->b, s->buf[0], n, ETH_FRAME_LEN, &hdr,
+		                   iov);
+		if (len == 0)
+			continue;
+
+		memcpy(cf, iov[0].iov_base, iov[0].iov_len);
+		memcpy(cf + iov[0].iov_len, iov[1].iov_base, iov[1].iov_len);
+		if (!(len == (int) s->mtu && match((struct canfd_frame *) cf, s->mtu, s->received))) { struct canfd_frame *c = (void *) cf; uint32_t q; memcpy(&q, c->data, 4); fprintf(stderr, "len %d n %zd id %x dl %d fl %x seq %u want %u type %d\n", len, n, c->can_id, c->len, c->flags, q, s->received, sll.sll_pkttype); }
+		check(len == (int) s->mtu &&
+		      match((struct canfd_frame *) cf, s->mtu, s->received),
+		      "bridged frame differs");
+		s->received++;
+		total++;
+	}
+
+	return total;
+}
+
+/**
+ * @fn void wait_in(const struct bridge *b, enum bridge_dir dir)
+ * @brief waits up to 5 ms for frames at the input of dir.
+ */
+static void wait_in(const struct bridge *b, enum bridge_dir dir)
+{
+	struct pollfd pfd = {
+		dir == BRIDGE_CAN_ETH ? b->can_fd : b->rx_fd, POLLIN, 0
+	};
+
+	poll(&pfd, 1, 5);
+}
+
+/** names of the types, the directions and the I/O of a bridge */
+static const char *type_name[] = { [TYPE_NET] = "net", [TYPE_ETH] = "eth" };
+static const char *dir_name[] = { "can->eth", "eth->can" };
+static const char *io_name[] = { "mmap", "copy" };
+
+/**
+ * @fn void run(const char *dev, enum bridge_dir dir, uint8_t type,
+ *              uint32_t flags, enum bridge_io io)
+ * @brief bridges FRAMES frames in dir and prints the rates.
+ */
+static void run(const char *dev, enum bridge_dir dir, uint8_t type,
+                uint32_t flags, enum bridge_io io)
+{
+	static struct stream s;
+	struct bridge b;
+	int can[2], eth;
+	double cpu = 0;
+
+	can_pair(dev, flags, can);
+	eth = eth_socket();
+	check(bridge_init(&b, can[0], eth_dev, type, flags, io,
+	                  BRIDGE_BLOCK_FRAMES) == 0, "bridge_init failed");
+	stream_init(&s, &b);
+
+	double start = timing_now() / 1e9;
+	for (int idle = 0; s.received < FRAMES && idle < 100; ) {
+		/* no more than the CAN and packet sockets buffer */
+		if (s.sent < FRAMES && s.sent - s.received < 4 * CHUNK) {
+			unsigned int n = FRAMES - s.sent < CHUNK ?
+			                 FRAMES - s.sent : CHUNK;
+
+			if (dir == BRIDGE_CAN_ETH)
+				inject_can(&s, can[1], n);
+			else
+				inject_eth(&s, eth, n);
+		}
+
+		double t = cpu_now();
+		int n = bridge_run(&b, dir);
+		cpu += cpu_now() - t;
+		check(n >= 0, "bridge_run failed");
+
+		n = dir == BRIDGE_CAN_ETH ? drain_eth(&s, eth)
+		                          : drain_can(&s, can[1]);
+		if (n > 0) {
+			idle = 0;
+		} else {
+			/* e.g. a block of the RX ring waits for its timeout */
+			wait_in(&b, dir);
+			idle++;
+		}
+	}
+	double sec = timing_now() / 1e9 - start;
+
+	const struct forward_stats *st = &b.stats[dir];
+	check(s.received == FRAMES && st->handled == FRAMES &&
+	      st->dropped == 0, "frames were lost");
+
+	printf("  %-8s %-3s %-7s %-4s %10.0f frames/s %7.0f ns/frame "
+	       "%6.1f frames/call\n", dir_name[dir], type_name[type],
+	       flags & F_CAN_FD ? "can-fd" : "classic", io_name[io],
+	       FRAMES / sec, cpu * 1e9 / FRAMES,
+	       (double) st->handled / st->batches);
+
+	bridge_close(&b);
+	close(can[1]);
+	close(eth);
+}
+
+/**
+ * @fn void run_latency(const char *dev, enum bridge_dir dir, uint8_t type,
+ *                      enum bridge_io io)
+ * @brief bridges SAMPLES single frames in dir, each after the previous one
+ *        arrived, and prints the percentiles of the latency.
+ */
+static void run_latency(const char *dev, enum bridge_dir dir, uint8_t type,
+                        enum bridge_io io)
+{
+	static struct stream s;
+	struct bridge b;
+	struct hist h;
+	int can[2], eth;
+
+	can_pair(dev, 0, can);
+	eth = eth_socket();
+	check(bridge_init(&b, can[0], eth_dev, type, 0, io,
+	                  BRIDGE_BLOCK_FRAMES) == 0, "bridge_init failed");
+	stream_init(&s, &b);
+	hist_init(&h);
+
+	for (int i = 0; i < SAMPLES; ++i) {
+		double start = timing_now() / 1e9, t = start;
+
+		if (dir == BRIDGE_CAN_ETH)
+			inject_can(&s, can[1], 1);
+		else
+			inject_eth(&s, eth, 1);
+
+		while (s.received < s.sent && t - start < 1) {
+			check(bridge_poll(&b, 1) >= 0, "bridge_poll failed");
+			if (dir == BRIDGE_CAN_ETH)
+				drain_eth(&s, eth);
+			else
+				drain_can(&s, can[1]);
+			t = timing_now() / 1e9;
+		}
+		check(s.received == s.sent, "frame was lost");
+		hist_record(&h, (t - start) * 1e9);
+	}
+
+	printf("  %-8s %-3s %-4s latency p50 %7.1f us p99 %7.1f us\n",
+	       dir_name[dir], type_name[type], io_name[io],
+	       hist_percentile(&h, 50) / 1e3, hist_percentile(&h, 99) / 1e3);
+
+	bridge_close(&b);
+	close(can[1]);
+	close(eth);
+}
+
+/**
+ * @fn void run_layout(void)
+ * @brief checks the frames on the wire of both types byte by byte and that
+ *        malformed ones are dropped and counted, other traffic ignored.
+ */
+static void run_layout(void)
+{
+	static const uint8_t net[] = {
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* lo */
+		0x00, 0x0c,				/* ETH_P_CAN */
+		0x00, 0x00, 0x01, 0x23, 0x08, 0x00, 0x00, 0x00,
+		0x07, 0x00, 0x00, 0x00, 0x07, 0x07, 0x07, 0x07,
+	};
+	static const uint8_t eth[] = {
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0x06, CANFD_BRS, 0x00, 0x00, 0x01, 0x23,
+		0x00, 0x40,				/* 64 bytes */
+		0x07, 0x00, 0x00, 0x00,
+	};
+	struct bridge b;
+	struct canfd_frame hdr;
+	struct iovec iov[2];
+	uint8_t frame[ETH_FRAME_LEN];
+	int can[2];
+
+	udp_pair(can);
+	check(bridge_init(&b, can[0], "lo", TYPE_NET, F_CAN_FD, BRIDGE_COPY,
+	                  1) == 0, "bridge_init failed");
+
+	fill((struct canfd_frame *) (frame + ETH_HLEN), CAN_MTU, 7);
+	check(bridge_encap(&b, frame, CAN_MTU) == sizeof(net) &&
+	      !memcmp(frame, net, sizeof(net)), "TYPE_NET layout differs");
+	check(bridge_decap(&b, frame, sizeof(net), sizeof(frame), &hdr,
+	                   iov) == CAN_MTU &&
+	      match(iov[0].iov_base, CAN_MTU, 7), "TYPE_NET decap failed");
+
+	b.type = TYPE_ETH;
+	fill((struct canfd_frame *) (frame + bridge_can_offset(TYPE_ETH)),
+	     CANFD_MTU, 7);
+	check(bridge_encap(&b, frame, CANFD_MTU) == ETH_HLEN + CANFD_MAX_DLEN
+	      && !memcmp(frame, eth, sizeof(eth)), "TYPE_ETH layout differs");
+	check(bridge_decap(&b, frame, ETH_HLEN + CANFD_MAX_DLEN,
+	                   sizeof(frame), &hdr, iov) == CANFD_MTU &&
+	      iov[0].iov_base == &hdr && iov[1].iov_base == frame + ETH_HLEN &&
+	      hdr.can_id == CAN_ID && hdr.flags == CANFD_BRS &&
+	      hdr.len == CANFD_MAX_DLEN, "TYPE_ETH decap failed");
+	/* a short frame at the end of a buffer is copied */
+	frame[13] = 8;
+	check(bridge_decap(&b, frame, ETH_HLEN + 8, ETH_HLEN + 8, &hdr,
+	                   iov) == CANFD_MTU && iov[0].iov_len == CANFD_MTU &&
+	      iov[1].iov_len == 0 && hdr.len == 8 &&
+	      !memcmp(hdr.data, frame + ETH_HLEN, 8),
+	      "TYPE_ETH decap at the end failed");
+
+	/* truncated, a length above 64, CAN-FD without F_CAN_FD; ARP */
+	frame[13] = CANFD_MAX_DLEN;
+	check(bridge_decap(&b, frame, ETH_HLEN + 8, sizeof(frame), &hdr,
+	                   iov) == -EINVAL, "truncated frame accepted");
+	frame[13] = 65;
+	check(bridge_decap(&b, frame, sizeof(frame), sizeof(frame), &hdr,
+	                   iov) == -EINVAL, "long frame accepted");
+	frame[13] = 8;
+	b.flags = 0;
+	check(bridge_decap(&b, frame, sizeof(frame), sizeof(frame), &hdr,
+	                   iov) == -EINVAL, "CAN-FD frame accepted");
+	frame[12] = ETH_P_ARP >> 8;
+	frame[13] = ETH_P_ARP & 0xff;
+	check(bridge_decap(&b, frame, sizeof(frame), sizeof(frame), &hdr,
+	                   iov) == 0, "ARP frame accepted");
+	b.type = TYPE_NET;
+	check(bridge_decap(&b, frame, sizeof(frame), sizeof(frame), &hdr,
+	                   iov) == 0, "ARP frame accepted");
+
+	bridge_close(&b);
+	close(can[1]);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dev = getenv(BENCH_CAN_ENV);
+	const char *eth = getenv(BENCH_ETH_ENV);
+	const uint8_t types[] = { TYPE_NET, TYPE_ETH };
+
+	if (eth != NULL) {
+		const char *colon = strchr(eth, ':');
+
+		snprintf(eth_dev, IFNAMSIZ, "%.*s",
+		         colon ? (int) (colon - eth) : (int) strlen(eth), eth);
+		snprintf(eth_peer, IFNAMSIZ, "%s", colon ? colon + 1 : eth);
+	}
+
+	run_layout();
+
+	printf("bench_bridge: %d frames, Ethernet side %s:%s, CAN side %s\n",
+	       FRAMES, eth_dev, eth_peer, dev ? dev : "loopback UDP");
+	for (int d = 0; d < BRIDGE_DIRS; ++d)
+		for (int t = 0; t < 2; ++t) {
+			run(dev, d, types[t], 0, BRIDGE_MMAP);
+			run(dev, d, types[t], F_CAN_FD, BRIDGE_MMAP);
+			run(dev, d, types[t], 0, BRIDGE_COPY);
+		}
+
+	for (int d = 0; d < BRIDGE_DIRS; ++d)
+		for (int io = 0; io < 2; ++io)
+			run_latency(dev, d, TYPE_ETH, io);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,293 @@
+/**
+ * @file bench_codec.c
+ * @brief Control Area Network - Ethernet - Gateway - Batch Codec Benchmark
+ * (Utility)
+ * @details Checks every version of codec.h the CPU supports against the
+ *          scalar reference, with random frames of every type including
+ *          rejected and corrupted ones, and the scalar one against
+ *          bridge_encap() and bridge_decap(). Then reports the frames per
+ *          ns each version encodes and decodes. Run with "make bench".
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bridge.h"
+#include "codec.h"
+#include "timing.h"
+
+#define FRAMES 4096 /**< frames per batch */
+#define ROUNDS 20 /**< random batches checked per version */
+#define MIN_TIME 0.2 /**< seconds each measurement runs at least */
+
+/**
+ * @fn void check(int ok, const char *what)
+ * @brief exits with what if ok is 0.
+ */
+static void check(int ok, const char *what)
+{
+	if (!ok) {
+		fprintf(stderr, "bench_codec: %s\n", what);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @fn uint32_t rnd(void)
+ * @brief a pseudo random number (xorshift), the same in every run.
+ */
+static uint32_t rnd(void)
+{
+	static uint32_t x = 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+/** the frames of a batch, CAN and encapsulated */
+static struct canfd_frame can[FRAMES], can_ref[FRAMES];
+static uint8_t mtu[FRAMES], mtu_ref[FRAMES];
+static uint16_t len[FRAMES], len_ref[FRAMES];
+static uint8_t *buf, *buf_ref;
+
+/** the types of the codec */
+static const uint8_t types[] = { TYPE_NET, TYPE_ETH, TYPE_UDP };
+
+/**
+ * @fn void random_can(uint32_t flags)
+ * @brief fills can with random frames, most of them valid for flags.
+ */
+static void random_can(uint32_t flags)
+{
+	for (int i = 0; i < FRAMES; ++i) {
+		struct canfd_frame *cf = &can[i];
+		uint32_t r = rnd();
+
+		for (size_t j = 0; j < sizeof(*cf); j += 4) {
+			uint32_t v = rnd();
+			memcpy((uint8_t *) cf + j, &v, 4);
+		}
+		mtu[i] = (flags & F_CAN_FD) && (r & 1) ? CANFD_MTU : CAN_MTU;
+		cf->len = rnd() % ((mtu[i] == CAN_MTU ? CAN_MAX_DLEN
+		                                      : CANFD_MAX_DLEN) + 1);
+		/* an invalid size or length now and then */
+		if (r % 16 == 1)
+			mtu[i] = r % 32 == 1 ? CANFD_MTU : r >> 8;
+		if (r % 16 == 2)
+			cf->len = r >> 8;
+	}
+}
+
+/**
+ * @fn void corrupt(const struct codec *c)
+ * @brief changes bytes or the length of some of the encapsulated frames.
+ */
+static void corrupt(const struct codec *c)
+{
+	for (int i = 0; i < FRAMES; ++i) {
+		uint8_t *frame = buf_ref + i * c->stride;
+		uint32_t r = rnd();
+
+		if (len_ref[i] == 0)
+			len_ref[i] = codec_frame_size(c->type, c->flags);
+		switch (r % 8) {
+		case 1:
+			frame[(r >> 8) % 16] ^= 1 << (r >> 16) % 8;
+			break;
+		case 2:
+			len_ref[i] = (r >> 8) % (c->stride + 1);
+			break;
+		case 3:
+			frame[6] = r >> 8;
+			frame[13] = r >> 16;
+			break;
+		}
+	}
+}
+
+/**
+ * @fn void check_bridge(const struct codec *c)
+ * @brief compares the encapsulated frames of the scalar codec in buf_ref
+ *        with bridge_encap() and bridge_decap().
+ */
+static void check_bridge(const struct codec *c)
+{
+	struct bridge b = { .type = c->type, .flags = c->flags };
+	uint8_t frame[ETH_FRAME_LEN];
+	struct canfd_frame hdr, cf;
+	struct iovec iov[2];
+
+	for (int i = 0; i < FRAMES; ++i) {
+		size_t off = bridge_can_offset(c->type);
+		size_t l;
+		int m;
+
+		memcpy(frame + off, &can[i], sizeof(can[i]));
+		l = bridge_encap(&b, frame, mtu[i]);
+		check(l == len_ref[i] && (l == 0 ||
+		      !memcmp(frame, buf_ref + i * c->stride, l)),
+		      "codec differs from bridge_encap()");
+		if (l == 0)
+			continue;
+
+		m = bridge_decap(&b, frame, l, sizeof(frame), &hdr, iov);
+		check(m == mtu[i], "bridge_decap() rejects a codec frame");
+		memcpy(&cf, iov[0].iov_base, iov[0].iov_len);
+		memcpy((uint8_t *) &cf + iov[0].iov_len, iov[1].iov_base,
+		       iov[1].iov_len);
+		check(cf.can_id == can[i].can_id && cf.len == can[i].len &&
+		      !memcmp(cf.data, can[i].data, cf.len),
+		      "bridge_decap() differs from the CAN frame");
+	}
+}
+
+/**
+ * @fn void run_check(uint8_t type, uint32_t flags)
+ * @brief checks every supported version against the scalar one.
+ */
+static void run_check(uint8_t type, uint32_t flags)
+{
+	struct codec ref, c;
+
+	check(codec_init(&ref, type, flags, NULL, CODEC_SCALAR) == 0,
+	      "codec_init failed");
+
+	for (int round = 0; round < ROUNDS; ++round) {
+		random_can(flags);
+		memset(buf_ref, 0xaa, FRAMES * ref.stride);
+		int n = codec_encode(&ref, can, mtu, FRAMES, buf_ref, len_ref);
+		check(n > FRAMES / 2, "too many frames rejected");
+		if (type != TYPE_UDP && round == 0)
+			check_bridge(&ref);
+
+		for (int impl = CODEC_SSSE3; impl < CODEC_IMPLS; ++impl) {
+			if (!codec_supported(impl))
+				continue;
+			check(codec_init(&c, type, flags, NULL, impl) == 0,
+			      "codec_init failed");
+			memset(buf, 0xaa, FRAMES * c.stride);
+			check(codec_encode(&c, can, mtu, FRAMES, buf, len) == n
+			      && !memcmp(len, len_ref, sizeof(len)) &&
+			      !memcmp(buf, buf_ref, FRAMES * c.stride),
+			      "encode differs from the scalar one");
+		}
+
+		/* the round trip gives the valid frames back */
+		memset(can_ref, 0x55, sizeof(can_ref));
+		check(codec_decode(&ref, buf_ref, len_ref, FRAMES, can_ref,
+		                   mtu_ref) == n, "decode rejects frames");
+		for (int i = 0; i < FRAMES; ++i)
+			check(mtu_ref[i] == (len_ref[i] ? mtu[i] : 0) &&
+			      (!mtu_ref[i] || (can_ref[i].can_id ==
+			                       can[i].can_id &&
+			                       can_ref[i].len == can[i].len &&
+			                       !memcmp(can_ref[i].data,
+			                               can[i].data,
+			                               can[i].len))),
+			      "decode differs from the encoded frame");
+
+		corrupt(&ref);
+		memset(can_ref, 0x55, sizeof(can_ref));
+		n = codec_decode(&ref, buf_ref, len_ref, FRAMES, can_ref,
+		                 mtu_ref);
+		for (int impl = CODEC_SSSE3; impl < CODEC_IMPLS; ++impl) {
+			if (!codec_supported(impl))
+				continue;
+			check(codec_init(&c, type, flags, NULL, impl) == 0,
+			      "codec_init failed");
+			memset(can, 0x55, sizeof(can));
+			check(codec_decode(&c, buf_ref, len_ref, FRAMES, can,
+			                   mtu) == n &&
+			      !memcmp(mtu, mtu_ref, sizeof(mtu)) &&
+			      !memcmp(can, can_ref, sizeof(can)),
+			      "decode differs from the scalar one");
+		}
+	}
+}
+
+/**
+ * @fn void run_bench(uint8_t type, uint32_t flags, enum codec_impl impl)
+ * @brief measures encode and decode of valid frames with impl.
+ */
+static void run_bench(uint8_t type, uint32_t flags, enum codec_impl impl)
+{
+	struct codec c;
+	double enc, dec, start;
+	long reps;
+
+	check(codec_init(&c, type, flags, NULL, impl) == 0,
+	      "codec_init failed");
+	random_can(flags);
+	for (int i = 0; i < FRAMES; ++i) {
+		mtu[i] = flags & F_CAN_FD ? CANFD_MTU : CAN_MTU;
+		can[i].len %= (flags & F_CAN_FD ? CANFD_MAX_DLEN
+		                                : CAN_MAX_DLEN) + 1;
+	}
+
+	start = timing_now() / 1e9;
+	for (reps = 0; timing_now() / 1e9 - start < MIN_TIME; ++reps)
+		check(codec_encode(&c, can, mtu, FRAMES, buf, len) == FRAMES,
+		      "encode rejects frames");
+	enc = (timing_now() / 1e9 - start) * 1e9 / (reps * FRAMES);
+
+	start = timing_now() / 1e9;
+	for (reps = 0; timing_now() / 1e9 - start < MIN_TIME; ++reps)
+		check(codec_decode(&c, buf, len, FRAMES, can_ref, mtu_ref) ==
+		      FRAMES, "decode rejects frames");
+	dec = (timing_now() / 1e9 - start) * 1e9 / (reps * FRAMES);
+
+	printf("  %-3s %-7s %-6s encode %6.3f frames/ns %6.2f ns/frame   "
+	       "decode %6.3f frames/ns %6.2f ns/frame\n",
+	       enum2str(type, type_array, TYPE_MAX),
+	       flags & F_CAN_FD ? "can-fd" : "classic", codec_impl_name(impl),
+	       1 / enc, enc, 1 / dec, dec);
+}
+
+int main(int argc, char *argv[])
+{
+	const uint32_t flags[] = { 0, F_CAN_FD };
+
+	buf = malloc(FRAMES * codec_frame_size(TYPE_NET, F_CAN_FD));
+	buf_ref = malloc(FRAMES * codec_frame_size(TYPE_NET, F_CAN_FD));
+	check(buf != NULL && buf_ref != NULL, "out of memory");
+
+	for (int t = 0; t < 3; ++t)
+		for (int f = 0; f < 2; ++f)
+			run_check(types[t], flags[f]);
+
+	printf("bench_codec: %d frames per batch\n", FRAMES);
+	for (int t = 0; t < 3; ++t)
+		for (int f = 0; f < 2; ++f)
+			for (int impl = CODEC_SCALAR; impl < CODEC_IMPLS;
+			     ++impl)
+				if (codec_supported(impl))
+					run_bench(types[t], flags[f], impl);
+
+	free(buf);
+	free(buf_ref);
+	return EXIT_SUCCESS;
+}
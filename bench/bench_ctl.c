@@ -0,0 +1,449 @@
+/**
+ * @file bench_ctl.c
+ * @brief Control Area Network - Ethernet - Gateway - Control Path Benchmark
+ * (Utility)
+ * @details Drives ce_gw_add(), ce_gw_del(), ce_gw_list(), ce_gw_echo() and
+ *          ce_gw_batch() in loops over several table sizes and batch windows
+ *          and reports the throughput and the p50/p99/p999 latency of every
+ *          request. Uses the kernel module if it is loaded, else the mock
+ *          (mock.c); CEGW_TRANSPORT overrides this. Run with "make bench".
+ *
+ *          usage: bench_ctl [-n SIZES] [-w WINDOWS] [-l LISTS] [-e ECHOS]
+ *                           [-s SRC] [-o FILE]
+ *
+ *          SIZES and WINDOWS are comma separated lists. With -o the results
+ *          are written to FILE ("-" for stdout) as one JSON object per line,
+ *          so that runs can be compared.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "netlink.h"
+#include "transport.h"
+#include "famcache.h"
+#include "format.h"
+#include "hist.h"
+#include "timing.h"
+
+#define SIZES "1000,10000" /**< default table sizes */
+#define WINDOWS "1,16,64" /**< default windows of ce_gw_batch() */
+#define LISTS 20 /**< default number of listings per table size */
+#define ECHOS 10000 /**< default number of echos */
+#define SRC "can0" /**< default src device of the routes */
+#define DEV "cegwbench" /**< gateway device added for the routes */
+#define MAX_VALUES 16 /**< maximum number of SIZES and WINDOWS */
+#define MAX_RESULTS 256 /**< maximum number of results */
+
+/**
+ * @struct result
+ * @brief The result of one loop.
+ */
+struct result {
+	const char *op;		/**< add, del, list, echo, batch-add, ... */
+	unsigned int size;	/**< table size */
+	unsigned int window;	/**< window of ce_gw_batch(), 1 otherwise */
+	uint64_t count;		/**< number of requests */
+	double seconds;		/**< time of all requests */
+	double rate;		/**< requests (rows for list) per second */
+	int latency;		/**< 1 if the percentiles are valid */
+	uint64_t p50, p99, p999, max; /**< latency in ns */
+	double mean;		/**< mean latency in ns */
+};
+
+static struct result results[MAX_RESULTS]; /**< results of all loops */
+static unsigned int n_results; /**< number of results */
+static struct hist hist; /**< latencies of the running loop */
+static int null_fd; /**< /dev/null, stdout of list and echo */
+static struct cegw_ctx *ctx; /**< context of all requests */
+
+/**
+ * @fn void check(int ok, const char *what)
+ * @brief exits with what if ok is 0.
+ */
+static void check(int ok, const char *what)
+{
+	if (!ok) {
+		fprintf(stderr, "bench_ctl: %s\n", what);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @fn unsigned int parse_list(char *str, unsigned int *values)
+ * @brief parses a comma separated list of at most MAX_VALUES numbers > 0.
+ * @returns the number of values
+ */
+static unsigned int parse_list(char *str, unsigned int *values)
+{
+	unsigned int n = 0;
+	char *save;
+
+	for (char *tok = strtok_r(str, ",", &save); tok != NULL;
+	     tok = strtok_r(NULL, ",", &save)) {
+		char *end;
+		unsigned long v = strtoul(tok, &end, 10);
+
+		check(*end == '\0' && v > 0 && n < MAX_VALUES,
+		      "invalid list of numbers");
+		values[n++] = v;
+	}
+
+	check(n > 0, "empty list of numbers");
+	return n;
+}
+
+/**
+ * @fn struct result *result_add(const char *op, unsigned int size,
+ *                               unsigned int window, uint64_t count,
+ *                               uint64_t ns, uint64_t rows)
+ * @brief stores the result of a loop of count requests in ns. The
+ *        percentiles are taken from hist if it is not empty.
+ */
+static struct result *result_add(const char *op, unsigned int size,
+                                 unsigned int window, uint64_t count,
+                                 uint64_t ns, uint64_t rows)
+{
+	check(n_results < MAX_RESULTS, "too many results");
+	struct result *r = &results[n_results++];
+
+	memset(r, 0, sizeof(*r));
+	r->op = op;
+	r->size = size;
+	r->window = window;
+	r->count = count;
+	r->seconds = ns / 1e9;
+	r->rate = r->seconds > 0 ? rows / r->seconds : 0;
+
+	if (hist.n > 0) {
+		r->latency = 1;
+		r->p50 = hist_percentile(&hist, 50);
+		r->p99 = hist_percentile(&hist, 99);
+		r->p999 = hist_percentile(&hist, 99.9);
+		r->max = hist.max;
+		r->mean = hist_mean(&hist);
+	}
+	hist_init(&hist);
+
+	return r;
+}
+
+/**
+ * @fn int stdout_mute(void)
+ * @brief redirects stdout to /dev/null.
+ * @returns the saved stdout for stdout_restore()
+ */
+static int stdout_mute(void)
+{
+	int saved = dup(STDOUT_FILENO);
+
+	fflush(stdout);
+	dup2(null_fd, STDOUT_FILENO);
+	return saved;
+}
+
+/**
+ * @fn void stdout_restore(int saved)
+ * @brief undoes stdout_mute().
+ */
+static void stdout_restore(int saved)
+{
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+}
+
+/**
+ * @fn size_t bench_routes(struct ce_gw_route_table *table)
+ * @brief lists the routes to DEV into table, all others are removed.
+ * @returns the number of routes to DEV
+ */
+static size_t bench_routes(struct ce_gw_route_table *table)
+{
+	size_t n = 0;
+
+	check(ce_gw_list_table(ctx, 0, table) == 0, "list failed");
+	for (size_t i = 0; i < table->len; ++i) {
+		if (strcmp(table->routes[i].dst, DEV) == 0)
+			table->routes[n++] = table->routes[i];
+	}
+	table->len = n;
+
+	return n;
+}
+
+/**
+ * @fn void bench_single(unsigned int size, char *src, unsigned int lists,
+ *                       struct ce_gw_route_table *table)
+ * @brief adds size routes, lists them lists times and deletes them again,
+ *        one request at a time.
+ */
+static void bench_single(unsigned int size, char *src, unsigned int lists,
+                         struct ce_gw_route_table *table)
+{
+	uint64_t start, t, total;
+
+	total = 0;
+	for (unsigned int i = 0; i < size; ++i) {
+		start = timing_now();
+		ce_gw_add(ctx, DEV, src, TYPE_NET, 0);
+		t = timing_now() - start;
+		hist_record(&hist, t);
+		total += t;
+	}
+	result_add("add", size, 1, size, total, size);
+	check(bench_routes(table) == size, "add failed");
+
+	total = 0;
+	int saved = stdout_mute();
+	for (unsigned int i = 0; i < lists; ++i) {
+		start = timing_now();
+		int err = ce_gw_list(ctx, 0, NULL, FORMAT_TEXT);
+		t = timing_now() - start;
+		if (err != 0)
+			break;
+		hist_record(&hist, t);
+		total += t;
+	}
+	stdout_restore(saved);
+	check(hist.n == lists, "list failed");
+	result_add("list", size, 1, lists, total, (uint64_t) size * lists);
+
+	total = 0;
+	for (size_t i = 0; i < table->len; ++i) {
+		start = timing_now();
+		ce_gw_del(ctx, table->routes[i].id, NULL);
+		t = timing_now() - start;
+		hist_record(&hist, t);
+		total += t;
+	}
+	result_add("del", size, 1, size, total, size);
+	check(bench_routes(table) == 0, "del failed");
+}
+
+/**
+ * @fn void bench_batch(unsigned int size, unsigned int window, char *src,
+ *                      struct ce_gw_op *ops,
+ *                      struct ce_gw_route_table *table)
+ * @brief adds and deletes size routes with ce_gw_batch(). Only the
+ *        throughput is measured, the requests overlap.
+ */
+static void bench_batch(unsigned int size, unsigned int window, char *src,
+                        struct ce_gw_op *ops, struct ce_gw_route_table *table)
+{
+	uint64_t start;
+
+	memset(ops, 0, size * sizeof(*ops));
+	for (unsigned int i = 0; i < size; ++i) {
+		ops[i].cmd = CE_GW_C_ADD;
+		ops[i].type = TYPE_NET;
+		ops[i].line = i + 1;
+		strncpy(ops[i].src, src, IFNAMSIZ - 1);
+		strcpy(ops[i].dst, DEV);
+	}
+
+	start = timing_now();
+	check(ce_gw_batch(ctx, ops, size, window) == 0, "batch add failed");
+	result_add("batch-add", size, window, size, timing_now() - start, size);
+	check(bench_routes(table) == size, "batch add failed");
+
+	memset(ops, 0, size * sizeof(*ops));
+	for (unsigned int i = 0; i < size; ++i) {
+		ops[i].cmd = CE_GW_C_DEL;
+		ops[i].id = table->routes[i].id;
+		ops[i].line = i + 1;
+	}
+
+	start = timing_now();
+	check(ce_gw_batch(ctx, ops, size, window) == 0, "batch del failed");
+	result_add("batch-del", size, window, size, timing_now() - start, size);
+	check(bench_routes(table) == 0, "batch del failed");
+}
+
+/**
+ * @fn void bench_echo(unsigned int echos)
+ * @brief sends echos echo requests one at a time.
+ */
+static void bench_echo(unsigned int echos)
+{
+	uint64_t start, t, total = 0;
+	int saved = stdout_mute();
+
+	for (unsigned int i = 0; i < echos; ++i) {
+		start = timing_now();
+		int err = ce_gw_echo(ctx, "bench_ctl");
+		t = timing_now() - start;
+		if (err != 0)
+			break;
+		hist_record(&hist, t);
+		total += t;
+	}
+
+	stdout_restore(saved);
+	check(hist.n == echos, "echo failed");
+	result_add("echo", 0, 1, echos, total, echos);
+}
+
+/**
+ * @fn void print_text(const char *name)
+ * @brief prints the results as table to stdout.
+ */
+static void print_text(const char *name)
+{
+	printf("bench_ctl: transport %s\n", name);
+	printf("  %-10s %7s %6s %12s %9s %9s %9s %9s\n", "OP", "SIZE",
+	       "WINDOW", "RATE/s", "P50 us", "P99 us", "P999 us", "MAX us");
+
+	for (unsigned int i = 0; i < n_results; ++i) {
+		const struct result *r = &results[i];
+
+		printf("  %-10s %7u %6u %12.0f", r->op, r->size, r->window,
+		       r->rate);
+		if (r->latency)
+			printf(" %9.1f %9.1f %9.1f %9.1f", r->p50 / 1e3,
+			       r->p99 / 1e3, r->p999 / 1e3, r->max / 1e3);
+		printf("\n");
+	}
+}
+
+/**
+ * @fn void print_json(FILE *file, const char *name)
+ * @brief writes the results as one JSON object per line to file. The
+ *        latencies of batches are null.
+ */
+static void print_json(FILE *file, const char *name)
+{
+	for (unsigned int i = 0; i < n_results; ++i) {
+		const struct result *r = &results[i];
+
+		fprintf(file, "{\"bench\":\"ctl\",\"transport\":\"%s\","
+		        "\"op\":\"%s\",\"size\":%u,\"window\":%u,"
+		        "\"count\":%llu,\"seconds\":%.6f,\"rate\":%.1f",
+		        name, r->op, r->size, r->window,
+		        (unsigned long long) r->count, r->seconds, r->rate);
+		if (r->latency)
+			fprintf(file, ",\"p50_ns\":%llu,\"p99_ns\":%llu,"
+			        "\"p999_ns\":%llu,\"max_ns\":%llu,"
+			        "\"mean_ns\":%.0f}\n",
+			        (unsigned long long) r->p50,
+			        (unsigned long long) r->p99,
+			        (unsigned long long) r->p999,
+			        (unsigned long long) r->max, r->mean);
+		else
+			fprintf(file, ",\"p50_ns\":null,\"p99_ns\":null,"
+			        "\"p999_ns\":null,\"max_ns\":null,"
+			        "\"mean_ns\":null}\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	char sizes_str[256] = SIZES, windows_str[256] = WINDOWS;
+	unsigned int sizes[MAX_VALUES], windows[MAX_VALUES];
+	unsigned int n_sizes, n_windows, max_size = 0;
+	unsigned int lists = LISTS, echos = ECHOS;
+	char *src = SRC;
+	const char *out = NULL;
+	struct ce_gw_route_table table = { 0 };
+	int c;
+
+	while ((c = getopt(argc, argv, "n:w:l:e:s:o:")) != -1) {
+		switch (c) {
+		case 'n':
+			snprintf(sizes_str, sizeof(sizes_str), "%s", optarg);
+			break;
+		case 'w':
+			snprintf(windows_str, sizeof(windows_str), "%s",
+			         optarg);
+			break;
+		case 'l':
+			lists = strtoul(optarg, NULL, 10);
+			break;
+		case 'e':
+			echos = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			src = optarg;
+			break;
+		case 'o':
+			out = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n SIZES] [-w WINDOWS] "
+			        "[-l LISTS] [-e ECHOS] [-s SRC] [-o FILE]\n",
+			        argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	n_sizes = parse_list(sizes_str, sizes);
+	n_windows = parse_list(windows_str, windows);
+	for (unsigned int i = 0; i < n_sizes; ++i) {
+		if (sizes[i] > max_size)
+			max_size = sizes[i];
+	}
+
+	struct ce_gw_op *ops = malloc(max_size * sizeof(*ops));
+	null_fd = open("/dev/null", O_WRONLY);
+	check(ops != NULL && null_fd >= 0, "allocation failed");
+
+	/* the module if it is loaded, else the mock */
+	if (getenv(TRANSPORT_ENV) == NULL &&
+	    access("/sys/module/" FAMCACHE_MODULE, F_OK) != 0)
+		setenv(TRANSPORT_ENV, mock_transport.name, 1);
+
+	ctx = cegw_ctx_alloc();
+	check(ctx != NULL, "init failed");
+	hist_init(&hist);
+
+	ce_gw_add(ctx, DEV, NULL, TYPE_NET, 0);
+
+	for (unsigned int i = 0; i < n_sizes; ++i) {
+		bench_single(sizes[i], src, lists, &table);
+		for (unsigned int j = 0; j < n_windows; ++j)
+			bench_batch(sizes[i], windows[j], src, ops, &table);
+	}
+	if (echos > 0)
+		bench_echo(echos);
+
+	ce_gw_del(ctx, 0, DEV);
+
+	print_text(cegw_ctx_transport(ctx));
+	if (out != NULL) {
+		FILE *file = strcmp(out, "-") ? fopen(out, "w") : stdout;
+		check(file != NULL, "can not open the output file");
+		print_json(file, cegw_ctx_transport(ctx));
+		if (file != stdout)
+			fclose(file);
+	}
+
+	cegw_ctx_free(ctx);
+	ce_gw_route_table_free(&table);
+	free(ops);
+	close(null_fd);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file bench_exporter.c
+ * @brief Control Area Network - Ethernet - Gateway - Exporter Benchmark
+ * (Utility)
+ * @details Renders the metrics of exporter.c for ROUTES routes of the mock
+ *          kernel (mock.c) and checks them against the route table. Many
+ *          scrapes within the interval must share one dump, with interval 0
+ *          every scrape dumps. A failed dump must report cegw_up 0. Prints
+ *          the time of a cached scrape and of a scrape with dump.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#define _GNU_SOURCE /* memmem() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "exporter.h"
+#include "format.h"
+#include "transport.h"
+#include "mock.h"
+#include "timing.h"
+
+#define ROUTES 10000 /**< number of routes of the mock */
+#define CACHED 1000 /**< scrapes served from one dump */
+#define DUMPED 20 /**< scrapes which dump */
+
+/**
+ * @fn void check(int ok, const char *what)
+ * @brief exits with what if ok is 0.
+ */
+static void check(int ok, const char *what)
+{
+	if (!ok) {
+		fprintf(stderr, "bench_exporter: %s\n", what);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @fn size_t count(const char *body, size_t len, const char *prefix)
+ * @brief counts the lines of body which start with prefix.
+ */
+static size_t count(const char *body, size_t len, const char *prefix)
+{
+	size_t n = 0, prefix_len = strlen(prefix);
+	const char *p = body, *end = body + len;
+
+	while (p < end) {
+		const char *nl = memchr(p, '\n', end - p);
+
+		if ((size_t) (end - p) >= prefix_len &&
+		    memcmp(p, prefix, prefix_len) == 0)
+			n++;
+		p = nl ? nl + 1 : end;
+	}
+
+	return n;
+}
+
+/**
+ * @fn int contains(const char *body, size_t len, const char *line)
+ * @brief 1 if line is a line of body.
+ */
+static int contains(const char *body, size_t len, const char *line)
+{
+	return memmem(body, len, line, strlen(line)) != NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct exporter e;
+	const char *body;
+	size_t len;
+	char line[256];
+
+	setenv(TRANSPORT_ENV, mock_transport.name, 1);
+	unsetenv(MOCK_ROUTES_ENV);
+	unsetenv(MOCK_FAIL_ENV);
+	struct cegw_ctx *ctx = cegw_ctx_alloc();
+	check(ctx != NULL, "init failed");
+	check(mock_reset(ROUTES) == 0, "mock_reset failed");
+
+	/* the first scrape dumps, the metrics match the table */
+	exporter_init(&e, ctx, 3600);
+	check(exporter_scrape(&e, &body, &len) == 0, "scrape failed");
+	check(e.dumps == 1 && e.table.len == ROUTES, "dump is incomplete");
+	check(count(body, len, "cegw_route_handled_total{") == ROUTES &&
+	      count(body, len, "cegw_route_dropped_total{") == ROUTES,
+	      "wrong number of route samples");
+	for (size_t i = 0; i < e.table.len; i += ROUTES / 10) {
+		const struct ce_gw_route *r = &e.table.routes[i];
+		size_t flags_len;
+		const char *flags = format_flags(r->flags, &flags_len);
+
+		snprintf(line, sizeof(line), "\ncegw_route_handled_total{"
+		         "id=\"%u\",src=\"%s\",dst=\"%s\",type=\"%s\","
+		         "flags=\"%.*s\"} %u\n", r->id, r->src, r->dst,
+		         enum2str(r->type, type_array, TYPE_MAX),
+		         (int) flags_len - 2, flags + 1, r->handled);
+		check(contains(body, len, line), "route sample differs");
+	}
+	check(contains(body, len, "\ncegw_up 1\n"), "cegw_up is not 1");
+
+	/* the scrapes within the interval share the dump */
+	double t = timing_now() / 1e9;
+	for (int i = 0; i < CACHED; ++i)
+		check(exporter_scrape(&e, &body, &len) == 0, "scrape failed");
+	double t_cached = (timing_now() / 1e9 - t) / CACHED;
+	check(e.dumps == 1, "cached scrape dumped");
+	check(count(body, len, "cegw_route_handled_total{") == ROUTES,
+	      "cached scrape lost routes");
+	snprintf(line, sizeof(line),
+	         "\ncegw_exporter_scrape_duration_seconds_count %d\n", CACHED);
+	check(contains(body, len, line), "scrapes are not counted");
+	exporter_free(&e);
+
+	/* interval 0 dumps for every scrape */
+	exporter_init(&e, ctx, 0);
+	t = timing_now() / 1e9;
+	for (int i = 0; i < DUMPED; ++i)
+		check(exporter_scrape(&e, &body, &len) == 0, "scrape failed");
+	double t_dumped = (timing_now() / 1e9 - t) / DUMPED;
+	check(e.dumps == DUMPED, "scrape did not dump");
+
+	/* a failed dump serves no routes and says so */
+	check(mock_fail("list:EIO") == 0, "mock_fail failed");
+	check(exporter_scrape(&e, &body, &len) == 0, "scrape failed");
+	check(mock_fail(NULL) == 0, "mock_fail failed");
+	check(contains(body, len, "\ncegw_up 0\n") &&
+	      contains(body, len, "\ncegw_exporter_dump_errors_total 1\n") &&
+	      count(body, len, "cegw_route_handled_total{") == 0,
+	      "failed dump not reported");
+	check(exporter_scrape(&e, &body, &len) == 0 &&
+	      contains(body, len, "\ncegw_up 1\n"), "no recovery");
+	exporter_free(&e);
+	cegw_ctx_free(ctx);
+
+	printf("bench_exporter: %d routes, %zu bytes\n", ROUTES, len);
+	printf("  cached scrape %10.3f ms\n", t_cached * 1e3);
+	printf("  dumped scrape %10.3f ms\n", t_dumped * 1e3);
+
+	return EXIT_SUCCESS;
+}
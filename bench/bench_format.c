@@ -0,0 +1,186 @@
+/**
+ * @file bench_format.c
+ * @brief Control Area Network - Ethernet - Gateway - Route Table Benchmark
+ * (Utility)
+ * @details Lists a synthetic dump of 100000 routes once with printf()
+ *          (ce_gw_route_print()) and once with the buffered formatter of
+ *          ce_gw_list() and compares the throughput. Both outputs are checked
+ *          to be identical. Run with "make bench".
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "netlink.h"
+#include "format.h"
+#include "timing.h"
+
+#define ROUTES 100000 /**< size of the synthetic dump */
+#define ROUNDS 5 /**< the best of ROUNDS runs is reported */
+
+/**
+ * @fn void make_routes(struct ce_gw_route *routes, size_t n)
+ * @brief fills routes with a mix of types, flags, names and counters.
+ */
+static void make_routes(struct ce_gw_route *routes, size_t n)
+{
+	srand(1);
+
+	for (size_t i = 0; i < n; ++i) {
+		struct ce_gw_route *r = &routes[i];
+
+		memset(r, 0, sizeof(*r));
+		r->id = i + 1;
+		r->type = 1 + i % TYPE_MAX;
+		r->flags = (i % 3 == 0) ? F_CAN_FD : 0;
+		r->handled = rand();
+		r->dropped = (i % 7 == 0) ? rand() % 1000 : 0;
+		snprintf(r->src, IFNAMSIZ, "can%zu", i % 16);
+		snprintf(r->dst, IFNAMSIZ, "%s%zu", (i & 1) ? "eth" : "veth",
+		         i % 1000);
+	}
+}
+
+/**
+ * @fn void list_printf(const struct ce_gw_route *routes, size_t n)
+ * @brief the old list path: printf() to stdout.
+ */
+static void list_printf(const struct ce_gw_route *routes, size_t n)
+{
+	ce_gw_route_print_header();
+	for (size_t i = 0; i < n; ++i)
+		ce_gw_route_print(&routes[i], NULL);
+	fflush(stdout);
+}
+
+/**
+ * @fn void list_format(const struct ce_gw_route *routes, size_t n)
+ * @brief the list path of ce_gw_list(): buffered formatter to stdout.
+ */
+static void list_format(const struct ce_gw_route *routes, size_t n)
+{
+	struct outbuf out;
+
+	if (outbuf_init(&out, STDOUT_FILENO, OUTBUF_SIZE) != 0)
+		exit(EXIT_FAILURE);
+
+	format_header(&out);
+	for (size_t i = 0; i < n; ++i)
+		format_route(&out, &routes[i]);
+	outbuf_free(&out);
+}
+
+/**
+ * @fn double run(void (*list)(const struct ce_gw_route *, size_t),
+ *                const struct ce_gw_route *routes, size_t n, int fd)
+ * @brief runs list with stdout redirected to fd.
+ * @returns the time of the fastest round in seconds.
+ */
+static double run(void (*list)(const struct ce_gw_route *, size_t),
+                  const struct ce_gw_route *routes, size_t n, int fd)
+{
+	double best = 1e9;
+	int saved = dup(STDOUT_FILENO);
+
+	fflush(stdout);
+	dup2(fd, STDOUT_FILENO);
+
+	for (int i = 0; i < ROUNDS; ++i) {
+		lseek(fd, 0, SEEK_SET);
+		double start = timing_now() / 1e9;
+		list(routes, n);
+		double t = timing_now() / 1e9 - start;
+		if (t < best)
+			best = t;
+	}
+
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+
+	return best;
+}
+
+/**
+ * @fn char *read_file(FILE *file, size_t *len)
+ * @brief reads the whole temporary file.
+ */
+static char *read_file(FILE *file, size_t *len)
+{
+	fseek(file, 0, SEEK_END);
+	*len = ftell(file);
+	rewind(file);
+
+	char *buf = malloc(*len + 1);
+	if (buf == NULL || fread(buf, 1, *len, file) != *len)
+		exit(EXIT_FAILURE);
+
+	return buf;
+}
+
+int main(int argc, char *argv[])
+{
+	struct ce_gw_route *routes = malloc(ROUTES * sizeof(*routes));
+	FILE *a = tmpfile(), *b = tmpfile();
+	int null_fd = open("/dev/null", O_WRONLY);
+	size_t a_len, b_len;
+
+	if (routes == NULL || a == NULL || b == NULL || null_fd < 0) {
+		perror("bench_format");
+		return EXIT_FAILURE;
+	}
+
+	make_routes(routes, ROUTES);
+	format_init();
+
+	/* both paths must produce the same table */
+	run(list_printf, routes, ROUTES, fileno(a));
+	run(list_format, routes, ROUTES, fileno(b));
+	char *a_buf = read_file(a, &a_len);
+	char *b_buf = read_file(b, &b_len);
+	if (a_len != b_len || memcmp(a_buf, b_buf, a_len) != 0) {
+		fprintf(stderr, "bench_format: outputs differ\n");
+		return EXIT_FAILURE;
+	}
+
+	double t_printf = run(list_printf, routes, ROUTES, null_fd);
+	double t_format = run(list_format, routes, ROUTES, null_fd);
+
+	printf("bench_format: %d routes, %zu bytes\n", ROUTES, a_len);
+	printf("  printf     %8.2f ms %12.0f rows/s\n", t_printf * 1e3,
+	       ROUTES / t_printf);
+	printf("  formatter  %8.2f ms %12.0f rows/s  (%.1fx)\n",
+	       t_format * 1e3, ROUTES / t_format, t_printf / t_format);
+
+	free(a_buf);
+	free(b_buf);
+	free(routes);
+	fclose(a);
+	fclose(b);
+	close(null_fd);
+	return EXIT_SUCCESS;
+}
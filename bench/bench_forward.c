@@ -0,0 +1,325 @@
+/**
+ * @file bench_forward.c
+ * @brief Control Area Network - Ethernet - Gateway - UDP Forwarding
+ * Benchmark (Utility)
+ * @details Forwards FRAMES classic and CAN-FD frames in both directions of
+ *          forward.h with one frame per system call and with batches, and
+ *          reports frames/s and the CPU time of forward_run() per frame.
+ *          Every frame is checked to arrive once, in order and unchanged.
+ *          The UDP side is a socket pair on the loopback device. The CAN
+ *          side is a raw socket pair of the device in CEGW_BENCH_CAN (e.g.
+ *          a vcan), or another loopback socket pair if it is not set. Run
+ *          with "make bench".
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <linux/can/raw.h>
+#include "forward.h"
+#include "timing.h"
+
+#define FRAMES 100000 /**< frames per run */
+#define CHUNK 256 /**< frames injected before each forward_run() */
+#define CAN_ID 0x123 /**< can_id of every frame */
+/** Environment variable with the CAN device of the benchmark */
+#define BENCH_CAN_ENV "CEGW_BENCH_CAN"
+
+/**
+ * @fn double cpu_now(void)
+ * @brief CPU time of the calling thread in seconds.
+ */
+static double cpu_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @fn void check(int ok, const char *what)
+ * @brief exits with what if ok is 0.
+ */
+static void check(int ok, const char *what)
+{
+	if (!ok) {
+		fprintf(stderr, "bench_forward: %s\n", what);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @fn void udp_pair(int fd[2])
+ * @brief two UDP sockets on 127.0.0.1 connected to each other.
+ */
+static void udp_pair(int fd[2])
+{
+	struct sockaddr_in addr[2];
+	socklen_t len = sizeof(addr[0]);
+	int rcvbuf = FORWARD_RCVBUF;
+
+	for (int i = 0; i < 2; ++i) {
+		memset(&addr[i], 0, sizeof(addr[i]));
+		addr[i].sin_family = AF_INET;
+		addr[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		fd[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		check(fd[i] >= 0 &&
+		      bind(fd[i], (struct sockaddr *) &addr[i], len) == 0 &&
+		      getsockname(fd[i], (struct sockaddr *) &addr[i],
+		                  &len) == 0, "UDP socket failed");
+		setsockopt(fd[i], SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+		           sizeof(rcvbuf));
+	}
+	check(connect(fd[0], (struct sockaddr *) &addr[1], len) == 0 &&
+	      connect(fd[1], (struct sockaddr *) &addr[0], len) == 0,
+	      "UDP connect failed");
+}
+
+/**
+ * @fn void can_pair(const char *dev, uint32_t flags, int fd[2])
+ * @brief two raw sockets of the CAN device dev, which see the frames of
+ *        each other, or a UDP pair if dev is NULL.
+ */
+static void can_pair(const char *dev, uint32_t flags, int fd[2])
+{
+	struct sockaddr_can addr = { .can_family = AF_CAN };
+	int on = 1;
+
+	if (dev == NULL) {
+		udp_pair(fd);
+		return;
+	}
+
+	addr.can_ifindex = if_nametoindex(dev);
+	for (int i = 0; i < 2; ++i) {
+		fd[i] = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+		check(fd[i] >= 0 && addr.can_ifindex != 0 &&
+		      (!(flags & F_CAN_FD) ||
+		       setsockopt(fd[i], SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on,
+		                  sizeof(on)) == 0) &&
+		      bind(fd[i], (struct sockaddr *) &addr,
+		           sizeof(addr)) == 0, "CAN socket failed");
+	}
+}
+
+/**
+ * @struct stream
+ * @brief Frames numbered in their data, sent and checked by inject() and
+ *        drain().
+ */
+struct stream {
+	struct canfd_frame frames[CHUNK];	/**< buffers */
+	struct iovec iov[CHUNK];		/**< one per frame */
+	struct mmsghdr msgs[CHUNK];		/**< one per frame */
+	size_t mtu;		/**< CAN_MTU or CANFD_MTU */
+	int wire;		/**< 1 if the can_id of the injected frames is in
+				 * network byte order, the forwarded ones have
+				 * the other */
+	uint32_t sent;		/**< number of injected frames */
+	uint32_t received;	/**< number of drained frames */
+};
+
+/**
+ * @fn void stream_init(struct stream *s, size_t mtu, int wire)
+ * @brief prepares s for frames of mtu bytes.
+ */
+static void stream_init(struct stream *s, size_t mtu, int wire)
+{
+	memset(s, 0, sizeof(*s));
+	s->mtu = mtu;
+	s->wire = wire;
+	for (int i = 0; i < CHUNK; ++i) {
+		s->iov[i].iov_base = &s->frames[i];
+		s->msgs[i].msg_hdr.msg_iov = &s->iov[i];
+		s->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+/**
+ * @fn void inject(struct stream *s, int fd, unsigned int n)
+ * @brief sends the next n frames to fd as far as it takes them.
+ */
+static void inject(struct stream *s, int fd, unsigned int n)
+{
+	for (unsigned int i = 0; i < n; ++i) {
+		struct canfd_frame *cf = &s->frames[i];
+		uint32_t seq = s->sent + i;
+
+		memset(cf, 0, sizeof(*cf));
+		cf->can_id = s->wire ? htonl(CAN_ID) : CAN_ID;
+		cf->len = s->mtu == CAN_MTU ? CAN_MAX_DLEN : CANFD_MAX_DLEN;
+		memcpy(cf->data, &seq, sizeof(seq));
+		memset(cf->data + sizeof(seq), seq & 0xff,
+		       cf->len - sizeof(seq));
+		s->iov[i].iov_len = s->mtu;
+	}
+
+	int r = sendmmsg(fd, s->msgs, n, MSG_DONTWAIT);
+	if (r > 0)
+		s->sent += r;
+}
+
+/**
+ * @fn void drain(struct stream *s, int fd)
+ * @brief receives and checks the frames waiting at fd.
+ */
+static void drain(struct stream *s, int fd)
+{
+	int n;
+
+	do {
+		for (int i = 0; i < CHUNK; ++i)
+			s->iov[i].iov_len = sizeof(struct canfd_frame);
+
+		n = recvmmsg(fd, s->msgs, CHUNK, MSG_DONTWAIT, NULL);
+		for (int i = 0; i < n; ++i) {
+			struct canfd_frame *cf = &s->frames[i];
+			uint32_t seq;
+
+			memcpy(&seq, cf->data, sizeof(seq));
+			check(s->msgs[i].msg_len == s->mtu &&
+			      cf->can_id == (s->wire ? CAN_ID : htonl(CAN_ID))
+			      && seq == s->received &&
+			      cf->data[cf->len - 1] == (seq & 0xff),
+			      "forwarded frame differs");
+			s->received++;
+		}
+	} while (n == CHUNK);
+}
+
+/**
+ * @fn void run(const char *dev, enum forward_dir dir, uint32_t flags,
+ *              unsigned int batch)
+ * @brief forwards FRAMES frames in dir and prints the rates.
+ */
+static void run(const char *dev, enum forward_dir dir, uint32_t flags,
+                unsigned int batch)
+{
+	static struct stream s;
+	struct forward f;
+	int can[2], udp[2];
+	double cpu = 0;
+
+	can_pair(dev, flags, can);
+	udp_pair(udp);
+	check(forward_init(&f, can[0], udp[0], flags, batch) == 0,
+	      "forward_init failed");
+
+	/* the frames enter at the peer of the input and leave at the peer
+	 * of the output, in network byte order on the UDP side */
+	int in = dir == FORWARD_CAN_UDP ? can[1] : udp[1];
+	int out = dir == FORWARD_CAN_UDP ? udp[1] : can[1];
+	stream_init(&s, flags & F_CAN_FD ? CANFD_MTU : CAN_MTU,
+	            dir == FORWARD_UDP_CAN);
+
+	double start = timing_now() / 1e9;
+	for (int idle = 0; s.received < FRAMES && idle < 1000; ) {
+		uint32_t received = s.received;
+
+		if (s.sent < FRAMES)
+			inject(&s, in, FRAMES - s.sent < CHUNK ?
+			       FRAMES - s.sent : CHUNK);
+
+		double t = cpu_now();
+		check(forward_run(&f, dir) >= 0, "forward_run failed");
+		cpu += cpu_now() - t;
+
+		drain(&s, out);
+		idle = s.received == received ? idle + 1 : 0;
+	}
+	double sec = timing_now() / 1e9 - start;
+
+	const struct forward_stats *st = &f.stats[dir];
+	check(s.received == FRAMES && st->handled == FRAMES &&
+	      st->dropped == 0, "frames were lost");
+
+	printf("  %-8s %-7s batch %-4u %10.0f frames/s %7.0f ns/frame "
+	       "%6.1f frames/call\n",
+	       dir == FORWARD_CAN_UDP ? "can->udp" : "udp->can",
+	       flags & F_CAN_FD ? "can-fd" : "classic", batch, FRAMES / sec,
+	       cpu * 1e9 / FRAMES, (double) st->handled / st->batches);
+
+	forward_close(&f);
+	close(can[1]);
+	close(udp[1]);
+}
+
+/**
+ * @fn void run_malformed(void)
+ * @brief checks that malformed datagrams are dropped and counted.
+ */
+static void run_malformed(void)
+{
+	struct canfd_frame cf = { .can_id = htonl(CAN_ID), .len = 9 };
+	struct forward f;
+	int can[2], udp[2];
+	char sink[CANFD_MTU];
+
+	udp_pair(can);
+	udp_pair(udp);
+	check(forward_init(&f, can[0], udp[0], 0, FORWARD_BATCH) == 0,
+	      "forward_init failed");
+
+	/* too short, CAN-FD without F_CAN_FD, a DLC above 8, too long */
+	check(send(udp[1], &cf, 10, 0) == 10 &&
+	      send(udp[1], &cf, CANFD_MTU, 0) == CANFD_MTU &&
+	      send(udp[1], &cf, CAN_MTU, 0) == CAN_MTU &&
+	      send(udp[1], sink, sizeof(sink), 0) == sizeof(sink),
+	      "send failed");
+	check(forward_run(&f, FORWARD_UDP_CAN) == 4, "forward_run failed");
+	check(f.stats[FORWARD_UDP_CAN].dropped == 4 &&
+	      f.stats[FORWARD_UDP_CAN].handled == 0 &&
+	      recv(can[1], sink, sizeof(sink), MSG_DONTWAIT) < 0,
+	      "malformed frame was forwarded");
+
+	forward_close(&f);
+	close(can[1]);
+	close(udp[1]);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dev = getenv(BENCH_CAN_ENV);
+	const unsigned int batches[] = { 1, FORWARD_BATCH };
+	const uint32_t flags[] = { 0, F_CAN_FD };
+
+	run_malformed();
+
+	printf("bench_forward: %d frames, CAN side %s\n", FRAMES,
+	       dev ? dev : "loopback UDP");
+	for (int d = 0; d < FORWARD_DIRS; ++d)
+		for (int fl = 0; fl < 2; ++fl)
+			for (int b = 0; b < 2; ++b)
+				run(dev, d, flags[fl], batches[b]);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,419 @@
+/**
+ * @file bench_mock.c
+ * @brief Control Area Network - Ethernet - Gateway - Control Path Benchmark
+ * (Utility)
+ * @details Runs the control path against the mock kernel (mock.c): adds
+ *          100000 routes with ce_gw_batch(), lists them with
+ *          ce_gw_list_table() and deletes them again, with and without
+ *          injected errors. The results are checked against the table of
+ *          the mock. A list with an add in the middle and a list with
+ *          overruns, which lose routes, must still list every route once. A snapshot of
+ *          10000 routes is saved and restored into an empty mock.
+ *          ASYNC_OPS adds, echoes and two lists are driven from one
+ *          thread with the async API, then echoes hit by an overrun must
+ *          all complete with an error. Run with "make bench".
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "netlink.h"
+#include "transport.h"
+#include "mock.h"
+#include "snapshot.h"
+#include "timing.h"
+
+#define ROUTES 100000 /**< number of routes added and listed */
+#define WINDOW 64 /**< window of ce_gw_batch() */
+#define FAIL_EVERY 1000 /**< every FAIL_EVERY-th add fails in the last run */
+#define OVERRUN_EVERY 7 /**< every OVERRUN_EVERY-th receive overruns */
+#define OVERRUNS 3 /**< number of overruns of the overrun test */
+#define SNAP_ROUTES 10000 /**< number of routes of the snapshot */
+#define SNAP_PATH "/tmp/bench_mock.snap" /**< file of the snapshot */
+#define ASYNC_OPS 1000 /**< outstanding adds and echoes of the async test */
+
+static struct cegw_ctx *ctx; /**< context of all requests */
+
+/**
+ * @fn void check(int ok, const char *what)
+ * @brief exits with what if ok is 0.
+ */
+static void check(int ok, const char *what)
+{
+	if (!ok) {
+		fprintf(stderr, "bench_mock: %s\n", what);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * @fn void make_adds(struct ce_gw_op *ops, size_t n)
+ * @brief fills ops with n adds of routes between can0-can3 and cegw.
+ */
+static void make_adds(struct ce_gw_op *ops, size_t n)
+{
+	memset(ops, 0, n * sizeof(*ops));
+
+	for (size_t i = 0; i < n; ++i) {
+		ops[i].cmd = CE_GW_C_ADD;
+		ops[i].type = TYPE_NET;
+		ops[i].line = i + 1;
+		snprintf(ops[i].src, IFNAMSIZ, "can%zu", i % MOCK_CAN_DEVS);
+		strcpy(ops[i].dst, "cegw");
+	}
+}
+
+/**
+ * @fn void make_dels(struct ce_gw_op *ops, const struct ce_gw_route_table
+ *                    *table)
+ * @brief fills ops with the deletion of every route of table.
+ */
+static void make_dels(struct ce_gw_op *ops,
+                      const struct ce_gw_route_table *table)
+{
+	memset(ops, 0, table->len * sizeof(*ops));
+
+	for (size_t i = 0; i < table->len; ++i) {
+		ops[i].cmd = CE_GW_C_DEL;
+		ops[i].id = table->routes[i].id;
+		ops[i].line = i + 1;
+	}
+}
+
+/**
+ * @fn size_t count_failed(const struct ce_gw_op *ops, size_t n, int err)
+ * @brief number of operations which failed with err.
+ */
+static size_t count_failed(const struct ce_gw_op *ops, size_t n, int err)
+{
+	size_t failed = 0;
+
+	for (size_t i = 0; i < n; ++i) {
+		if (ops[i].err == err)
+			failed++;
+	}
+
+	return failed;
+}
+
+/**
+ * @struct intr_list
+ * @brief Argument of list_with_add().
+ */
+struct intr_list {
+	struct cegw_ctx *writer;	/**< context of the add */
+	size_t add_at;			/**< number of routes before the add */
+	uint32_t *ids;			/**< the listed IDs */
+	size_t len;			/**< number of listed routes */
+	size_t size;			/**< size of ids */
+};
+
+/**
+ * @fn int list_with_add(const struct ce_gw_route *route, void *arg)
+ * @brief stores the ID of route and adds a route over another context in
+ *        the middle of the dump.
+ */
+static int list_with_add(const struct ce_gw_route *route, void *arg)
+{
+	struct intr_list *l = arg;
+
+	if (l->len == l->add_at)
+		check(ce_gw_add(l->writer, "cegw", "can0", TYPE_NET, 0) == 0,
+		      "add during the dump failed");
+
+	if (l->len < l->size)
+		l->ids[l->len] = route->id;
+	l->len++;
+
+	return 0;
+}
+
+/**
+ * @fn void check_ids(const struct intr_list *l, size_t n)
+ * @brief checks that l has n ascending IDs, i.e. none is missing or twice.
+ */
+static void check_ids(const struct intr_list *l, size_t n)
+{
+	check(l->len == n, "dump is incomplete");
+	for (size_t i = 1; i < l->len; ++i)
+		check(l->ids[i] > l->ids[i - 1], "route listed twice");
+}
+
+/**
+ * @fn double run_batch(struct ce_gw_op *ops, size_t n)
+ * @brief runs ops as one batch.
+ * @returns the time in seconds.
+ */
+static double run_batch(struct ce_gw_op *ops, size_t n)
+{
+	double start = timing_now() / 1e9;
+
+	check(ce_gw_batch(ctx, ops, n, WINDOW) == 0, "batch failed");
+	return timing_now() / 1e9 - start;
+}
+
+/**
+ * @fn double run_list(struct ce_gw_route_table *table)
+ * @brief lists all routes into table.
+ * @returns the time in seconds.
+ */
+static double run_list(struct ce_gw_route_table *table)
+{
+	double start = timing_now() / 1e9;
+
+	check(ce_gw_list_table(ctx, 0, table) == 0, "list failed");
+	return timing_now() / 1e9 - start;
+}
+
+/**
+ * @struct async_count
+ * @brief Argument of the async callbacks, counts the completions.
+ */
+struct async_count {
+	size_t done;	/**< completed requests */
+	size_t failed;	/**< completed with an error */
+	size_t echoes;	/**< echoes with the sent text */
+	size_t routes;	/**< routes passed to async_route() */
+	uint32_t last;	/**< handle of the last completed list */
+};
+
+/**
+ * @fn void async_done(uint32_t handle, int err, const char *echo,
+ *                     void *arg)
+ * @brief counts a completed request of the async test.
+ */
+static void async_done(uint32_t handle, int err, const char *echo, void *arg)
+{
+	struct async_count *c = arg;
+
+	c->done++;
+	if (err != 0)
+		c->failed++;
+	if (echo != NULL && strcmp(echo, "async") == 0)
+		c->echoes++;
+	if (echo == NULL)
+		c->last = handle;
+}
+
+/**
+ * @fn int async_route(const struct ce_gw_route *route, void *arg)
+ * @brief counts a listed route of the async test.
+ */
+static int async_route(const struct ce_gw_route *route, void *arg)
+{
+	struct async_count *c = arg;
+
+	c->routes++;
+	return 0;
+}
+
+/**
+ * @fn double run_async(void)
+ * @brief submits ASYNC_OPS adds and echoes and two lists at once on a new
+ *        context and processes the answers until all are complete.
+ * @returns the time in seconds.
+ */
+static double run_async(void)
+{
+	struct cegw_ctx *actx = cegw_ctx_alloc();
+	struct async_count c = { 0 };
+	uint32_t first, second;
+	double start = timing_now() / 1e9;
+
+	check(actx != NULL, "init failed");
+	check(ce_gw_async_fd(actx) == -1, "mock has a file descriptor");
+
+	for (int i = 0; i < ASYNC_OPS; ++i) {
+		check(ce_gw_async_add(actx, "cegw", "can0", TYPE_NET, 0,
+		                      async_done, &c, NULL) == 0 &&
+		      ce_gw_async_echo(actx, "async", async_done, &c,
+		                       NULL) == 0, "async submit failed");
+	}
+	check(ce_gw_async_list(actx, 0, NULL, async_route, async_done, &c,
+	                       &first) == 0 &&
+	      ce_gw_async_list(actx, 0, NULL, async_route, async_done, &c,
+	                       &second) == 0, "async list failed");
+	check(ce_gw_async_pending(actx) == 2 * ASYNC_OPS + 2,
+	      "async requests are not pending");
+
+	while (ce_gw_async_pending(actx) > 0)
+		check(ce_gw_async_process(actx) >= 0, "async process failed");
+
+	start = timing_now() / 1e9 - start;
+	check(c.done == 2 * ASYNC_OPS + 2 && c.failed == 0,
+	      "async requests failed");
+	check(c.echoes == ASYNC_OPS, "async echo differs");
+	check(c.routes == 2 * ASYNC_OPS && c.last == second,
+	      "async lists are incomplete or out of order");
+
+	/* an overrun completes the outstanding requests with an error */
+	memset(&c, 0, sizeof(c));
+	for (int i = 0; i < ASYNC_OPS; ++i) {
+		check(ce_gw_async_echo(actx, "async", async_done, &c,
+		                       NULL) == 0, "async submit failed");
+	}
+	check(mock_fail("recv:ENOBUFS:1:1") == 0, "mock_fail failed");
+	for (int i = 0; ce_gw_async_pending(actx) > 0; ++i) {
+		check(i < ASYNC_OPS, "async requests lost by an overrun");
+		check(ce_gw_async_process(actx) >= 0, "async process failed");
+	}
+	check(c.done == ASYNC_OPS && c.failed == ASYNC_OPS,
+	      "overrun not reported to the async requests");
+	mock_fail(NULL);
+
+	cegw_ctx_free(actx);
+	return start;
+}
+
+int main(int argc, char *argv[])
+{
+	struct ce_gw_op *ops = malloc(ROUTES * sizeof(*ops));
+	struct ce_gw_route_table table = { 0 };
+	char fail[64];
+
+	check(ops != NULL, "allocation failed");
+
+	setenv(TRANSPORT_ENV, mock_transport.name, 1);
+	unsetenv(MOCK_ROUTES_ENV);
+	unsetenv(MOCK_FAIL_ENV);
+	ctx = cegw_ctx_alloc();
+	check(ctx != NULL, "init failed");
+	check(ce_gw_add(ctx, "cegw", NULL, TYPE_NET, 0) == 0,
+	      "add dev failed");
+
+	/* add, list and delete everything */
+	make_adds(ops, ROUTES);
+	double t_add = run_batch(ops, ROUTES);
+	check(count_failed(ops, ROUTES, 0) == ROUTES, "add returned errors");
+
+	double t_list = run_list(&table);
+	check(table.len == ROUTES, "list is incomplete");
+	for (size_t i = 0; i < table.len; ++i) {
+		const struct ce_gw_route *r = &table.routes[i];
+		check(r->id == i + 1 && r->type == TYPE_NET &&
+		      strcmp(r->src, ops[i].src) == 0 &&
+		      strcmp(r->dst, "cegw") == 0, "listed route differs");
+	}
+
+	make_dels(ops, &table);
+	double t_del = run_batch(ops, table.len);
+	check(count_failed(ops, table.len, 0) == table.len,
+	      "del returned errors");
+	run_list(&table);
+	check(table.len == 0, "routes left after del");
+
+	/* the same with injected errors, which must hit exactly their ops */
+	snprintf(fail, sizeof(fail), "add:ENOSPC:%d", FAIL_EVERY);
+	check(mock_fail(fail) == 0, "mock_fail failed");
+	make_adds(ops, ROUTES);
+	run_batch(ops, ROUTES);
+	check(count_failed(ops, ROUTES, -ENOSPC) == ROUTES / FAIL_EVERY,
+	      "injected errors not reported");
+	run_list(&table);
+	check(table.len == ROUTES - ROUTES / FAIL_EVERY,
+	      "failed adds were listed");
+
+	mock_fail(NULL);
+
+	/* an add in the middle does not interrupt the list, which is no
+	 * dump, and the new route with the highest ID comes at its end */
+	struct intr_list l = { .add_at = table.len / 2, .size = table.len + 1 };
+	const struct ce_gw_dump_stats *stats = cegw_ctx_dump_stats(ctx);
+	uint64_t restarts = stats->restarts;
+
+	l.writer = cegw_ctx_alloc();
+	l.ids = malloc(l.size * sizeof(*l.ids));
+	check(l.writer != NULL && l.ids != NULL, "init failed");
+	check(ce_gw_list_foreach(ctx, 0, list_with_add, &l) == 0,
+	      "list with an add failed");
+	check(stats->restarts == restarts, "list restarted");
+	check_ids(&l, table.len + 1);
+
+	/* overruns lose routes, the list is resumed behind the last one */
+	snprintf(fail, sizeof(fail), "recv:ENOBUFS:%d:%d", OVERRUN_EVERY,
+	         OVERRUNS);
+	check(mock_fail(fail) == 0, "mock_fail failed");
+	l.len = 0;
+	l.add_at = SIZE_MAX;
+	check(ce_gw_list_foreach(ctx, 0, list_with_add, &l) == 0,
+	      "list with overruns failed");
+	check(stats->overruns > 0, "no overruns");
+	check(stats->restarts > restarts, "overrun not detected");
+	check_ids(&l, table.len + 1);
+	mock_fail(NULL);
+	cegw_ctx_free(l.writer);
+	free(l.ids);
+
+	check(ce_gw_del(ctx, 0, "cegw") == 0, "del dev failed");
+	run_list(&table);
+	check(table.len == 0, "routes of the device left");
+
+	/* a snapshot restores the devices and routes into an empty mock */
+	struct ce_gw_route_table saved = { 0 };
+
+	check(mock_reset(SNAP_ROUTES) == 0, "mock_reset failed");
+	run_list(&saved);
+	check(snapshot_save(ctx, SNAP_PATH) == 0, "save failed");
+	check(mock_reset(0) == 0, "mock_reset failed");
+	double t_restore = timing_now() / 1e9;
+	check(snapshot_restore(ctx, SNAP_PATH, CE_GW_SNAP_WINDOW) == 0,
+	      "restore failed");
+	t_restore = timing_now() / 1e9 - t_restore;
+	run_list(&table);
+	check(table.len == SNAP_ROUTES, "restore is incomplete");
+	for (size_t i = 0; i < table.len; ++i) {
+		const struct ce_gw_route *a = &saved.routes[i];
+		const struct ce_gw_route *b = &table.routes[i];
+		check(a->type == b->type && a->flags == b->flags &&
+		      strcmp(a->src, b->src) == 0 &&
+		      strcmp(a->dst, b->dst) == 0, "restored route differs");
+	}
+	unlink(SNAP_PATH);
+	ce_gw_route_table_free(&saved);
+
+	/* the async API drives all requests from one thread */
+	check(mock_reset(0) == 0, "mock_reset failed");
+	check(ce_gw_add(ctx, "cegw", NULL, TYPE_NET, 0) == 0,
+	      "add dev failed");
+	double t_async = run_async();
+
+	printf("bench_mock: %d routes, window %d\n", ROUTES, WINDOW);
+	printf("  add   %8.2f ms %12.0f ops/s\n", t_add * 1e3, ROUTES / t_add);
+	printf("  list  %8.2f ms %12.0f rows/s\n", t_list * 1e3,
+	       ROUTES / t_list);
+	printf("  del   %8.2f ms %12.0f ops/s\n", t_del * 1e3, ROUTES / t_del);
+	printf("  restore %6.2f ms %12.0f routes/s (%d routes)\n",
+	       t_restore * 1e3, SNAP_ROUTES / t_restore, SNAP_ROUTES);
+	printf("  async %8.2f ms %12.0f ops/s (%d adds, %d echoes, 2 lists)\n",
+	       t_async * 1e3, (2 * ASYNC_OPS + 2) / t_async, ASYNC_OPS,
+	       ASYNC_OPS);
+
+	cegw_ctx_free(ctx);
+	ce_gw_route_table_free(&table);
+	free(ops);
+	return EXIT_SUCCESS;
+}
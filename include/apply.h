@@ -0,0 +1,77 @@
+/**
+ * @file apply.h
+ * @brief Control Area Network - Ethernet - Gateway - Apply Header (Utility)
+ * @details Reconciles the routes of the kernel with a desired set of devices
+ *          and routes, see apply_file().
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_APPLY_H__
+#define __CAN_ETH_GW_UTILS_APPLY_H__
+
+#include <stdint.h>
+#include "netlink.h"
+
+/**
+ * @fn int apply_file(struct cegw_ctx *ctx, const char *path,
+ *                    unsigned int window, uint8_t type, uint32_t flags,
+ *                    int bidirectional, int dry_run)
+ * @brief Makes the routes of the kernel equal to the ones of a file with
+ *        as few adds and dels as possible.
+ * @details The file has the syntax of a batch file (see batch_parse_line()),
+ *          but only "add dev NAME" and "add route SRC DST" lines. The
+ *          current routes are dumped and matched with the desired ones by
+ *          the key (src, dst, type, flags) in a hash table, in time linear
+ *          in the number of routes. Matched routes are left alone and keep
+ *          their IDs and counters. The missing ones are added, the others
+ *          deleted, pipelined with ce_gw_batch(); the adds come first, so
+ *          a changed route is never missing.
+ *
+ *          The kernel can not list devices. A device is added unless a
+ *          current route uses it, and -EEXIST counts as success. Devices
+ *          are never deleted.
+ *
+ *          The plan (dry_run) or the summary is printed to stdout, failed
+ *          operations to stderr.
+ * @param ctx The context the dump and the batch are sent over.
+ * @param path The file name or "-" for stdin.
+ * @param window Maximum number of outstanding messages.
+ * @param type Default type of a line.
+ * @param flags Default flags of a line.
+ * @param bidirectional Default of the -b option of a line.
+ * @param dry_run If set, the plan is only printed.
+ * @retval 0 if everything was applied
+ * @retval >0 number of failed lines and operations
+ * @retval <0 if the file could not be read or the socket failed
+ * @ingroup files
+ */
+extern int apply_file(struct cegw_ctx *ctx, const char *path,
+                      unsigned int window, uint8_t type, uint32_t flags,
+                      int bidirectional, int dry_run);
+
+#endif
+
+/**@}*/
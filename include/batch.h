@@ -0,0 +1,133 @@
+/**
+ * @file batch.h
+ * @brief Control Area Network - Ethernet - Gateway - Batch Header (Utility)
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_BATCH_H__
+#define __CAN_ETH_GW_UTILS_BATCH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "netlink.h"
+
+/** Default number of outstanding messages of a batch */
+#define BATCH_WINDOW 64
+/** Maximum number of worker threads of a batch */
+#define BATCH_MAX_JOBS 64
+
+/**
+ * @struct ce_gw_op_list
+ * @brief A growing array of operations, e.g. parsed from a batch file.
+ */
+struct ce_gw_op_list {
+	struct ce_gw_op *ops;	/**< the operations */
+	size_t len;		/**< number of used entries */
+	size_t size;		/**< number of allocated entries */
+};
+
+/**
+ * @fn int batch_parse_line(char *line, unsigned int lineno, uint8_t type,
+ *                   uint32_t flags, int bidirectional,
+ *                   struct ce_gw_op_list *list)
+ * @brief Parses one line of a batch file and appends its operations to list.
+ * @details A line has the same syntax as the command line of cegwctl
+ *          without the program name, e.g. "-t eth add route can0 eth0".
+ *          Empty lines and lines beginning with '#' are ignored.
+ * @param line The line. It will be modified.
+ * @param lineno The number of the line, stored in ce_gw_op.line.
+ * @param type Default type if the line has no -t option.
+ * @param flags Default flags, the -f option of the line is added.
+ * @param bidirectional Default for the -b option.
+ * @param list The parsed operations are appended here.
+ * @retval 0 on success or if the line is empty
+ * @retval <0 if the line could not be parsed
+ * @ingroup files
+ */
+extern int batch_parse_line(char *line, unsigned int lineno, uint8_t type,
+                            uint32_t flags, int bidirectional,
+                            struct ce_gw_op_list *list);
+
+/**
+ * @fn int batch_parse_file(const char *prog, const char *path, uint8_t type,
+ *                          uint32_t flags, int bidirectional,
+ *                          struct ce_gw_op_list *list)
+ * @brief Parses every line of a batch file with batch_parse_line() and
+ *        appends the operations to list.
+ * @details Lines with a syntax error are reported to stderr and skipped.
+ * @param prog Prefix of the messages, e.g. "batch".
+ * @param path The file name or "-" for stdin.
+ * @retval >=0 number of lines with a syntax error
+ * @retval <0 -errno if the file could not be read or -ENOMEM
+ * @ingroup files
+ */
+extern int batch_parse_file(const char *prog, const char *path, uint8_t type,
+                            uint32_t flags, int bidirectional,
+                            struct ce_gw_op_list *list);
+
+/**
+ * @fn void batch_op_list_free(struct ce_gw_op_list *list)
+ * @brief frees the operations of list.
+ * @ingroup files
+ */
+extern void batch_op_list_free(struct ce_gw_op_list *list);
+
+/**
+ * @fn int batch_run_file(struct cegw_ctx *ctx, const char *path,
+ *                        unsigned int window, unsigned int jobs,
+ *                        uint8_t type, uint32_t flags, int bidirectional)
+ * @brief Executes all commands of a batch file. See batch_parse_line() for
+ *        the format and ce_gw_batch() for the execution.
+ * @details Every failed line is reported to stderr, the remaining lines are
+ *          executed anyway. At the end the number of operations and the
+ *          operations per second are printed to stdout, with more than one
+ *          job also those of every worker.
+ *
+ *          With jobs > 1 the route adds and dels are sharded over jobs
+ *          threads with an own context each. The device commands, the
+ *          route adds and the route dels between them are separate stages
+ *          that run one after the other, so a device is added before the
+ *          routes of later lines use it and a route before a later line
+ *          deletes it. Within a stage the order is not kept.
+ * @param ctx The context the batch is sent over, used by the first worker.
+ * @param path The file name or "-" for stdin.
+ * @param window Maximum number of outstanding messages of every worker.
+ * @param jobs Number of workers, 1 to BATCH_MAX_JOBS.
+ * @param type Default type of a line.
+ * @param flags Default flags of a line.
+ * @param bidirectional Default of the -b option of a line.
+ * @retval 0 if all lines were successful
+ * @retval >0 number of failed lines
+ * @retval <0 if the file could not be read or the socket failed
+ * @ingroup files
+ */
+extern int batch_run_file(struct cegw_ctx *ctx, const char *path,
+                          unsigned int window, unsigned int jobs,
+                          uint8_t type, uint32_t flags, int bidirectional);
+
+#endif
+
+/**@}*/
@@ -0,0 +1,280 @@
+/**
+ * @file bridge.h
+ * @brief Control Area Network - Ethernet - Gateway - Packet Ring Bridge
+ * Header (Utility)
+ * @details A userspace data path for TYPE_NET and TYPE_ETH routes between a
+ *          SocketCAN raw socket and an Ethernet device, for hosts without
+ *          the ce_gw module. The Ethernet side uses the PACKET_RX_RING and
+ *          PACKET_TX_RING of TPACKET_V3, the CAN side recvmmsg() and
+ *          sendmmsg(). A frame is received from CAN straight into its slot
+ *          of the TX ring and written to CAN straight from the RX ring, only
+ *          the headers are rewritten in place. The frames on the wire are
+ *          broadcasts (ff:ff:ff:ff:ff:ff):
+ *
+ *          TYPE_NET copies the complete frame into the payload, like
+ *          forward.h: ethertype ETH_P_CAN with a struct can_frame (16
+ *          bytes) or, with F_CAN_FD, ETH_P_CANFD with a struct canfd_frame
+ *          (72 bytes), the can_id in network byte order. The source is the
+ *          address of the device.
+ *
+ *          TYPE_ETH converts the CAN header into the Ethernet header and
+ *          carries only the data (8 or, with F_CAN_FD, 64 bytes): the
+ *          802.3 length field is the data length, the source address is
+ *          02:FL:ID:ID:ID:ID with the flags of a CAN-FD frame in FL and the
+ *          can_id in network byte order; 06 instead of 02 marks CAN-FD.
+ *
+ *          The frame sizes of the rings follow the MTU of a gateway device
+ *          of the type, see bridge_mtu(). Under light load a frame from the
+ *          Ethernet waits up to BRIDGE_BLOCK_TOV ms for its block to be
+ *          passed; BRIDGE_COPY does not, at a higher cost per frame.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_BRIDGE_H__
+#define __CAN_ETH_GW_UTILS_BRIDGE_H__
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <linux/can.h>
+#include <linux/if_ether.h>
+#include "netlink.h"
+#include "forward.h"
+
+/** Frames of an RX block and of the TX ring per batch */
+#define BRIDGE_BLOCK_FRAMES 64
+/** Number of blocks of the RX ring */
+#define BRIDGE_BLOCKS 64
+/** Number of batches in the TX ring */
+#define BRIDGE_TX_BATCHES 16
+/** ms until the kernel passes a block of the RX ring which is not full */
+#define BRIDGE_BLOCK_TOV 1
+/** First byte of the source address of a TYPE_ETH frame */
+#define BRIDGE_ETH_MARK 0x02
+/** Added to BRIDGE_ETH_MARK for CAN-FD */
+#define BRIDGE_ETH_FD 0x04
+
+/**
+ * @enum bridge_dir
+ * @brief The two routes of a bridge.
+ */
+enum bridge_dir {
+	BRIDGE_CAN_ETH,		/**< from the CAN device to the Ethernet */
+	BRIDGE_ETH_CAN,		/**< from the Ethernet to the CAN device */
+	BRIDGE_DIRS,		/**< number of directions */
+};
+
+/**
+ * @enum bridge_io
+ * @brief How a bridge moves the frames of the Ethernet device.
+ */
+enum bridge_io {
+	BRIDGE_MMAP,	/**< TPACKET_V3 rings, batched CAN I/O */
+	BRIDGE_COPY,	/**< one recv() and send() per frame, for comparison */
+};
+
+/**
+ * @struct bridge_ring
+ * @brief A mapped PACKET_RX_RING or PACKET_TX_RING.
+ */
+struct bridge_ring {
+	uint8_t *map;		/**< the mapping, NULL if unused */
+	size_t size;		/**< bytes of map */
+	size_t block;		/**< bytes of a block */
+	size_t frame;		/**< bytes of a frame, a frame never spans
+				 * two blocks */
+	unsigned int nr;	/**< number of blocks (RX) or frames (TX) */
+	unsigned int next;	/**< next block or frame to look at */
+};
+
+/**
+ * @struct bridge
+ * @brief A bridge between a CAN socket and an Ethernet device. See
+ *        bridge_open().
+ */
+struct bridge {
+	int can_fd;			/**< SocketCAN raw socket */
+	int rx_fd;			/**< packet socket receiving */
+	int tx_fd;			/**< packet socket sending, -1 for
+					 * BRIDGE_COPY, which sends on rx_fd */
+	uint8_t type;			/**< TYPE_NET or TYPE_ETH */
+	uint32_t flags;			/**< see F_CAN_FD */
+	enum bridge_io io;		/**< see enum bridge_io */
+	unsigned int batch;		/**< frames per CAN system call */
+	size_t frame;			/**< bytes of an Ethernet frame incl.
+					 * header, see bridge_frame_size() */
+	struct bridge_ring rx, tx;	/**< rings of BRIDGE_MMAP */
+	struct canfd_frame *hdrs;	/**< CAN headers of TYPE_ETH, batch */
+	struct iovec *iov;		/**< two per frame */
+	struct mmsghdr *msgs;		/**< one per frame */
+	uint8_t *buf;			/**< a frame of BRIDGE_COPY */
+	unsigned char mac[ETH_ALEN];	/**< address of the device */
+	struct forward_stats stats[BRIDGE_DIRS]; /**< see bridge_route() */
+	char can_name[IFNAMSIZ];	/**< the CAN device */
+	char eth_name[IFNAMSIZ];	/**< the Ethernet device */
+};
+
+/**
+ * @fn size_t bridge_mtu(uint8_t type, uint32_t flags)
+ * @brief The MTU of a gateway device: TYPE_NET 16 (72 with F_CAN_FD),
+ *        TYPE_ETH 8 (64), like the table of "add dev" in cegwctl(8).
+ * @retval 0 for the other types
+ * @ingroup net
+ */
+extern size_t bridge_mtu(uint8_t type, uint32_t flags);
+
+/**
+ * @fn size_t bridge_frame_size(uint8_t type, uint32_t flags)
+ * @brief Bytes of the largest Ethernet frame of type, the header and
+ *        bridge_mtu().
+ * @ingroup net
+ */
+extern size_t bridge_frame_size(uint8_t type, uint32_t flags);
+
+/**
+ * @fn size_t bridge_encap(const struct bridge *b, uint8_t *frame,
+ *                         size_t len)
+ * @brief Turns the CAN frame of len bytes at frame + bridge_can_offset()
+ *        into an Ethernet frame at frame, in place.
+ * @retval >0 the length of the Ethernet frame
+ * @retval 0 if the CAN frame is malformed
+ * @ingroup net
+ */
+extern size_t bridge_encap(const struct bridge *b, uint8_t *frame,
+                           size_t len);
+
+/**
+ * @fn size_t bridge_can_offset(uint8_t type)
+ * @brief Where bridge_encap() expects the CAN frame: behind the Ethernet
+ *        header for TYPE_NET, for TYPE_ETH so that the data is where the
+ *        payload goes and the CAN header is overwritten by the Ethernet
+ *        header.
+ * @ingroup net
+ */
+extern size_t bridge_can_offset(uint8_t type);
+
+/**
+ * @fn int bridge_decap(const struct bridge *b, uint8_t *frame, size_t len,
+ *                      size_t room, struct canfd_frame *hdr,
+ *                      struct iovec iov[2])
+ * @brief Points iov at the CAN frame of the Ethernet frame of len bytes at
+ *        frame. The can_id of TYPE_NET is converted in place, the header of
+ *        TYPE_ETH is built in hdr; its data stays in frame if room, the
+ *        bytes readable from frame on, holds a whole CAN frame, else it is
+ *        copied to hdr.
+ * @retval >0 the length of the CAN frame (CAN_MTU or CANFD_MTU)
+ * @retval 0 if the Ethernet frame is not of type, e.g. ARP on the device
+ * @retval -EINVAL if it is malformed or CAN-FD without F_CAN_FD
+ * @ingroup net
+ */
+extern int bridge_decap(const struct bridge *b, uint8_t *frame, size_t len,
+                        size_t room, struct canfd_frame *hdr,
+                        struct iovec iov[2]);
+
+/**
+ * @fn int bridge_init(struct bridge *b, int can_fd, const char *eth,
+ *                     uint8_t type, uint32_t flags, enum bridge_io io,
+ *                     unsigned int batch)
+ * @brief Opens the packet sockets and rings of the Ethernet device eth for
+ *        an open CAN socket. On success b owns can_fd, see bridge_close().
+ * @param can_fd A CAN_RAW socket, with CAN_RAW_FD_FRAMES if flags has
+ *        F_CAN_FD. Any datagram socket with one frame per datagram works.
+ * @param batch Frames per CAN system call, 1 to BRIDGE_BLOCK_FRAMES.
+ * @retval 0 on success
+ * @retval <0 -errno on failure, printed to stderr
+ * @ingroup net
+ */
+extern int bridge_init(struct bridge *b, int can_fd, const char *eth,
+                       uint8_t type, uint32_t flags, enum bridge_io io,
+                       unsigned int batch);
+
+/**
+ * @fn int bridge_open(struct bridge *b, const char *can, const char *eth,
+ *                     uint8_t type, uint32_t flags, enum bridge_io io,
+ *                     unsigned int batch)
+ * @brief Opens the raw socket of the CAN device can and calls
+ *        bridge_init().
+ * @retval 0 on success
+ * @retval <0 -errno on failure, printed to stderr
+ * @ingroup net
+ */
+extern int bridge_open(struct bridge *b, const char *can, const char *eth,
+                       uint8_t type, uint32_t flags, enum bridge_io io,
+                       unsigned int batch);
+
+/**
+ * @fn int bridge_run(struct bridge *b, enum bridge_dir dir)
+ * @brief Bridges the frames waiting for dir until there are no more or the
+ *        TX ring is full. Never blocks. Frames which are malformed, not of
+ *        the type or refused by the output are dropped.
+ * @retval >=0 the number of received frames
+ * @retval <0 -errno if receiving failed
+ * @ingroup net
+ */
+extern int bridge_run(struct bridge *b, enum bridge_dir dir);
+
+/**
+ * @fn int bridge_poll(struct bridge *b, int timeout)
+ * @brief Waits up to timeout ms (-1 forever) for frames and runs
+ *        bridge_run() for the ready directions.
+ * @retval >=0 the number of received frames
+ * @retval -EINTR if a signal arrived
+ * @retval <0 -errno on failure
+ * @ingroup net
+ */
+extern int bridge_poll(struct bridge *b, int timeout);
+
+/**
+ * @fn void bridge_route(const struct bridge *b, enum bridge_dir dir,
+ *                       struct ce_gw_route *route)
+ * @brief Describes dir as a route of the type of b with ID dir + 1 and its
+ *        counters, e.g. for ce_gw_route_print().
+ * @ingroup net
+ */
+extern void bridge_route(const struct bridge *b, enum bridge_dir dir,
+                         struct ce_gw_route *route);
+
+/**
+ * @fn void bridge_close(struct bridge *b)
+ * @brief Closes the sockets and unmaps the rings of b.
+ * @ingroup net
+ */
+extern void bridge_close(struct bridge *b);
+
+/**
+ * @fn int bridge_main(int argc, char *argv[])
+ * @brief Runs "bridge [-f] [-t TYPE] [-B BATCH] [-i INTERVAL] [--copy] CAN
+ *        ETH" with argv[0] being "bridge", until SIGINT.
+ * @details Prints the counters of both directions as routes every INTERVAL
+ *          seconds and at the end.
+ * @retval EXIT_SUCCESS after SIGINT
+ * @retval EXIT_FAILURE on failure
+ * @ingroup files
+ */
+extern int bridge_main(int argc, char *argv[]);
+
+#endif
+
+/**@}*/
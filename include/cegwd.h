@@ -0,0 +1,136 @@
+/**
+ * @file cegwd.h
+ * @brief Control Area Network - Ethernet - Gateway - Daemon Protocol (Utility)
+ * @details The requests and answers exchanged between cegwctl and cegwd over
+ *          the local AF_UNIX stream socket. Both sides run on the same host,
+ *          so the structs are sent in host byte order.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_CEGWD_H__
+#define __CAN_ETH_GW_UTILS_CEGWD_H__
+
+#include <stdint.h>
+#include "netlink.h"
+
+/** Default path of the daemon socket */
+#define CEGWD_SOCK_PATH "/run/cegwd.sock"
+/** Environment variable which overwrites CEGWD_SOCK_PATH */
+#define CEGWD_SOCK_ENV "CEGWD_SOCKET"
+
+/**
+ * @struct cegwd_req
+ * @brief A request to the daemon. Followed by len bytes of data.
+ * @details cmd is one of the CE_GW_C_* commands, the other fields have the
+ *          same meaning as the parameters of ce_gw_add(), ce_gw_del() and
+ *          ce_gw_list(). The data is the message of CE_GW_C_ECHO.
+ */
+struct cegwd_req {
+	uint8_t cmd;		/**< CE_GW_C_ADD, _DEL, _LIST or _ECHO */
+	uint8_t type;		/**< enum gw_type (add) */
+	uint16_t len;		/**< length of the following data */
+	uint32_t flags;		/**< flags (add) */
+	uint32_t id;		/**< route id (del, list) */
+	char src[IFNAMSIZ];	/**< src of a route (add) */
+	char dst[IFNAMSIZ];	/**< dst of a route or device name (add, del) */
+};
+
+/**
+ * @struct cegwd_rsp
+ * @brief The answer of the daemon. Followed by len bytes of data.
+ * @details The data is an array of struct ce_gw_route for CE_GW_C_LIST and
+ *          the \0 terminated answer of the kernel for CE_GW_C_ECHO.
+ */
+struct cegwd_rsp {
+	int32_t err;		/**< 0 on success, -errno on failure */
+	uint32_t len;		/**< length of the following data */
+};
+
+/**
+ * @fn int cegwd_connect(void)
+ * @brief Connects to a running cegwd.
+ * @details The path of the socket is taken from the environment variable
+ *          CEGWD_SOCKET or CEGWD_SOCK_PATH. Must be called before any other
+ *          cegwd_*() function.
+ * @retval 0 on success
+ * @retval <0 if no daemon is running
+ * @ingroup net
+ * @see cegwd_close()
+ */
+extern int cegwd_connect(void);
+
+/**
+ * @fn void cegwd_close(void)
+ * @brief closes the connection opened by cegwd_connect().
+ * @ingroup net
+ */
+extern void cegwd_close(void);
+
+/**
+ * @fn int cegwd_add(char *dst_name, char *src_name, uint8_t type,
+ *            uint32_t flags)
+ * @brief like ce_gw_add(), but executed by the daemon. An error of the kernel
+ *        is printed and not returned, as by the direct call.
+ * @retval 0 on success or after an error of the kernel
+ * @retval -EINVAL if a name does not fit into IFNAMSIZ
+ * @retval <0 -errno if the daemon could not be reached
+ * @ingroup net
+ */
+extern int cegwd_add(char *dst_name, char *src_name, uint8_t type,
+                     uint32_t flags);
+
+/**
+ * @fn int cegwd_del(uint32_t id, char *dev_name)
+ * @brief like ce_gw_del(), but executed by the daemon. An error of the kernel
+ *        is printed and not returned, as by the direct call.
+ * @retval 0 on success or after an error of the kernel
+ * @retval -EINVAL if a name does not fit into IFNAMSIZ
+ * @retval <0 -errno if the daemon could not be reached
+ * @ingroup net
+ */
+extern int cegwd_del(uint32_t id, char *dev_name);
+
+/**
+ * @fn int cegwd_list(uint32_t id, unsigned int format)
+ * @brief like ce_gw_list(), but answered from the route cache of the daemon.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ * @ingroup net
+ */
+extern int cegwd_list(uint32_t id, unsigned int format);
+
+/**
+ * @fn int cegwd_echo(char *message)
+ * @brief like ce_gw_echo(), but executed by the daemon.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ * @ingroup net
+ */
+extern int cegwd_echo(char *message);
+
+#endif
+
+/**@}*/
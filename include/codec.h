@@ -0,0 +1,169 @@
+/**
+ * @file codec.h
+ * @brief Control Area Network - Ethernet - Gateway - Batch Codec Header
+ * (Utility)
+ * @details Converts arrays of CAN frames into the frames of a gateway type
+ *          and back, for programs which receive or send many of them. The
+ *          layouts are the ones of the userspace data paths: TYPE_NET and
+ *          TYPE_ETH those of bridge.h (an Ethernet frame with header),
+ *          TYPE_UDP the one of forward.h (the payload of a datagram).
+ *
+ *          The encapsulated frames lie in one buffer, one every stride
+ *          bytes. A batch is converted in chunks of CODEC_CHUNK frames: the
+ *          CAN IDs and headers are first loaded into arrays of struct
+ *          codec (structure of arrays), byte swapped and checked there
+ *          several frames per instruction, then the frames are written.
+ *          Besides the scalar reference there are SSSE3 and AVX2 versions
+ *          of the first two steps. codec_init() selects AVX2 if the CPU
+ *          supports it, else the scalar one: SSSE3 has no gather and
+ *          stages the loads with scalar code, so it is not reliably faster
+ *          than the scalar version and only used when asked for.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_CODEC_H__
+#define __CAN_ETH_GW_UTILS_CODEC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/can.h>
+#include <linux/if_ether.h>
+#include "netlink.h"
+
+/** Frames converted per step, the size of the arrays of struct codec */
+#define CODEC_CHUNK 64
+
+/**
+ * @enum codec_impl
+ * @brief The versions of the conversion.
+ */
+enum codec_impl {
+	CODEC_AUTO,	/**< CODEC_AVX2 if supported, else CODEC_SCALAR */
+	CODEC_SCALAR,	/**< plain C, the reference */
+	CODEC_SSSE3,	/**< 4 frames per instruction, never selected by
+			 * CODEC_AUTO, not reliably faster than scalar */
+	CODEC_AVX2,	/**< 8 frames per instruction, gathered loads */
+	CODEC_IMPLS,	/**< number of versions */
+};
+
+/**
+ * @struct codec
+ * @brief The settings and the staging arrays of a conversion. See
+ *        codec_init().
+ */
+struct codec {
+	uint8_t type;			/**< TYPE_NET, TYPE_ETH or TYPE_UDP */
+	uint32_t flags;			/**< see F_CAN_FD */
+	size_t stride;			/**< bytes from one encapsulated frame
+					 * to the next */
+	enum codec_impl impl;		/**< the selected version */
+	uint8_t eth[2][ETH_HLEN];	/**< Ethernet header of TYPE_NET, of
+					 * classic and CAN-FD frames */
+	uint32_t id[CODEC_CHUNK];	/**< CAN IDs in the byte order of the
+					 * output */
+	uint32_t hdr[CODEC_CHUNK];	/**< data length | flags << 8 */
+	uint32_t mtu[CODEC_CHUNK];	/**< CAN_MTU, CANFD_MTU or 0 if the
+					 * frame is rejected */
+	uint32_t raw[CODEC_CHUNK];	/**< loaded bytes to check */
+};
+
+/**
+ * @fn size_t codec_frame_size(uint8_t type, uint32_t flags)
+ * @brief Returns the maximum bytes of an encapsulated frame of type, e.g.
+ *        86 for TYPE_NET with F_CAN_FD, the default stride.
+ * @retval 0 if type is not supported
+ * @ingroup net
+ */
+extern size_t codec_frame_size(uint8_t type, uint32_t flags);
+
+/**
+ * @fn int codec_supported(enum codec_impl impl)
+ * @brief Returns 1 if the CPU supports impl, else 0. CODEC_SCALAR and
+ *        CODEC_AUTO are always supported.
+ * @ingroup net
+ */
+extern int codec_supported(enum codec_impl impl);
+
+/**
+ * @fn const char *codec_impl_name(enum codec_impl impl)
+ * @brief Returns the name of impl, e.g. "avx2".
+ * @ingroup net
+ */
+extern const char *codec_impl_name(enum codec_impl impl);
+
+/**
+ * @fn int codec_init(struct codec *c, uint8_t type, uint32_t flags,
+ *                    const unsigned char *mac, enum codec_impl impl)
+ * @brief Prepares c for frames of type and flags, with the stride
+ *        codec_frame_size(). A larger stride may be set afterwards, e.g.
+ *        the frame size of a packet ring.
+ * @param mac Source address of TYPE_NET, NULL for 00:00:00:00:00:00
+ * @param impl The version, CODEC_AUTO for the fastest supported one
+ * @retval 0 on success
+ * @retval -EINVAL if type is not TYPE_NET, TYPE_ETH or TYPE_UDP
+ * @retval -EOPNOTSUPP if the CPU does not support impl
+ * @ingroup net
+ */
+extern int codec_init(struct codec *c, uint8_t type, uint32_t flags,
+                      const unsigned char *mac, enum codec_impl impl);
+
+/**
+ * @fn int codec_encode(struct codec *c, const struct canfd_frame *can,
+ *                      const uint8_t *mtu, unsigned int n, uint8_t *out,
+ *                      uint16_t *len)
+ * @brief Encapsulates the n CAN frames can into out, one every stride
+ *        bytes. A frame is rejected if mtu is not CAN_MTU or, with
+ *        F_CAN_FD, CANFD_MTU, or its length exceeds the data; its len is 0
+ *        and its place in out is not written.
+ * @param mtu Size of each frame, like read() from a CAN socket returns it
+ * @param len Set to the bytes of each encapsulated frame
+ * @retval the number of encapsulated frames
+ * @ingroup net
+ */
+extern int codec_encode(struct codec *c, const struct canfd_frame *can,
+                        const uint8_t *mtu, unsigned int n, uint8_t *out,
+                        uint16_t *len);
+
+/**
+ * @fn int codec_decode(struct codec *c, const uint8_t *in,
+ *                      const uint16_t *len, unsigned int n,
+ *                      struct canfd_frame *can, uint8_t *mtu)
+ * @brief Converts the n encapsulated frames in, one every stride bytes and
+ *        len bytes long, back into can. A frame is rejected if it is not of
+ *        the type, malformed or CAN-FD without F_CAN_FD; its mtu is 0 and
+ *        its CAN frame is not written. The data of a CAN frame behind its
+ *        length is copied from the encapsulated frame as it is.
+ * @param mtu Set to CAN_MTU or CANFD_MTU, the bytes to write to CAN
+ * @retval the number of converted frames
+ * @ingroup net
+ */
+extern int codec_decode(struct codec *c, const uint8_t *in,
+                        const uint16_t *len, unsigned int n,
+                        struct canfd_frame *can, uint8_t *mtu);
+
+#endif
+
+/**@}*/
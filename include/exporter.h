@@ -0,0 +1,118 @@
+/**
+ * @file exporter.h
+ * @brief Control Area Network - Ethernet - Gateway - Metrics Exporter Header
+ * (Utility)
+ * @details "cegwctl exporter": serves the counters of the routes to
+ *          Prometheus over HTTP. The routes are dumped at most once per
+ *          interval, however many scrapes arrive, and every response is
+ *          rendered into the same buffer.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_EXPORTER_H__
+#define __CAN_ETH_GW_UTILS_EXPORTER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "netlink.h"
+
+#define EXPORTER_LISTEN "127.0.0.1:9731" /**< default address to listen on */
+#define EXPORTER_INTERVAL 1.0 /**< default seconds between two dumps */
+#define EXPORTER_REQ_MAX 4096 /**< maximum size of a request header */
+
+/**
+ * @struct exporter
+ * @brief The route cache and the metrics of the exporter itself.
+ */
+struct exporter {
+	struct cegw_ctx *ctx;		/**< connection to the kernel module */
+	double interval;		/**< minimum seconds between dumps */
+	struct ce_gw_route_table table;	/**< routes of the last dump */
+	char *body;			/**< the rendered metrics */
+	size_t len;			/**< bytes in body */
+	size_t size;			/**< allocated size of body */
+	size_t routes_len;		/**< bytes of the route metrics in body */
+	int up;				/**< 1 if the last dump succeeded */
+	uint64_t dump_time;		/**< start of the last dump in ns */
+	uint64_t dumps;			/**< number of dumps */
+	uint64_t dump_errors;		/**< number of failed dumps */
+	uint64_t dump_ns;		/**< duration of the last dump */
+	uint64_t dump_ns_sum;		/**< duration of all dumps */
+	uint64_t scrapes;		/**< number of rendered scrapes */
+	uint64_t scrape_ns;		/**< duration of the last scrape */
+	uint64_t scrape_ns_sum;		/**< duration of all scrapes */
+};
+
+/**
+ * @fn void exporter_init(struct exporter *e, struct cegw_ctx *ctx,
+ *                        double interval)
+ * @brief Initialises e. Nothing is dumped before the first scrape.
+ * @param interval Minimum seconds between two dumps, 0 dumps for every
+ *        scrape.
+ * @ingroup trans
+ */
+extern void exporter_init(struct exporter *e, struct cegw_ctx *ctx,
+                          double interval);
+
+/**
+ * @fn int exporter_scrape(struct exporter *e, const char **body,
+ *                         size_t *len)
+ * @brief Renders the metrics in the Prometheus text format 0.0.4.
+ * @details The routes are dumped again if the last dump is interval seconds
+ *          old, else the route metrics of the last dump are reused. The
+ *          metrics of the exporter itself (dump and scrape durations) are
+ *          rendered every time, the scrape duration is the one of the
+ *          previous scrapes. The counters of the routes are 32 bit and wrap,
+ *          Prometheus treats that like a reset.
+ * @param body Returns the metrics. Valid until the next call.
+ * @param len Returns the length of body.
+ * @retval 0 on success, also if the dump failed (cegw_up is 0 then)
+ * @retval -ENOMEM if the buffer could not grow
+ * @ingroup trans
+ */
+extern int exporter_scrape(struct exporter *e, const char **body,
+                           size_t *len);
+
+/**
+ * @fn void exporter_free(struct exporter *e)
+ * @brief Frees the routes and the buffer of e, but not its context.
+ * @ingroup trans
+ */
+extern void exporter_free(struct exporter *e);
+
+/**
+ * @fn int exporter_main(int argc, char *argv[])
+ * @brief Runs "exporter [-l ADDR:PORT] [-i INTERVAL]" with argv[0] being
+ *        "exporter". Serves GET /metrics until SIGINT or SIGTERM.
+ * @retval EXIT_SUCCESS after a signal
+ * @retval EXIT_FAILURE on failure
+ * @ingroup files
+ */
+extern int exporter_main(int argc, char *argv[]);
+
+#endif
+
+/**@}*/
@@ -0,0 +1,68 @@
+/**
+ * @file famcache.h
+ * @brief Control Area Network - Ethernet - Gateway - Family Cache Header
+ * (Utility)
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_FAMCACHE_H__
+#define __CAN_ETH_GW_UTILS_FAMCACHE_H__
+
+/** Name of the kernel module in /sys/module and /proc/modules */
+#define FAMCACHE_MODULE "ce_gw"
+/** Cache file if /run is writable */
+#define FAMCACHE_PATH "/run/cegwctl.family"
+/** Environment variable which overwrites the path of the cache file */
+#define FAMCACHE_ENV "CEGW_FAMILY_CACHE"
+
+/**
+ * @fn int famcache_read(int *id, int *version)
+ * @brief Reads the generic netlink family ID and version of the last run.
+ * @details The values are only returned if the kernel module is still the
+ *          same instance as when they were written, i.e. it was not reloaded
+ *          in the meantime.
+ * @param id returns the family ID
+ * @param version returns the family version
+ * @retval 0 if the cached values are valid
+ * @retval <0 if there is no cache or the module changed
+ * @ingroup net
+ * @see famcache_write()
+ */
+extern int famcache_read(int *id, int *version);
+
+/**
+ * @fn void famcache_write(int id, int version)
+ * @brief Stores the resolved generic netlink family ID and version together
+ *        with the identity of the loaded kernel module.
+ * @details Failures are ignored, the cache is only an optimisation.
+ * @ingroup net
+ * @see famcache_read()
+ */
+extern void famcache_write(int id, int version);
+
+#endif
+
+/**@}*/
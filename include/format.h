@@ -0,0 +1,283 @@
+/**
+ * @file format.h
+ * @brief Control Area Network - Ethernet - Gateway - Output Format Header
+ * (Utility)
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_FORMAT_H__
+#define __CAN_ETH_GW_UTILS_FORMAT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "netlink.h"
+
+#define OUTBUF_SIZE (1 << 20) /**< Default size of an output buffer */
+#define ROW_MAX 1024 /**< Maximum length of one formatted row */
+
+/**
+ * @name Output formats of ce_gw_list()
+ * The low byte selects the format, the other bits are flags.
+ * @{
+ */
+#define FORMAT_TEXT 0 /**< table as printed by ce_gw_route_print() */
+#define FORMAT_JSON 1 /**< JSON array, one object per line */
+#define FORMAT_CSV 2 /**< comma separated values */
+#define FORMAT_BIN 3 /**< struct ce_gw_bin_header and ce_gw_bin_route */
+#define FORMAT_MASK 0xff /**< mask of the format */
+#define FORMAT_NO_HEADER 0x100 /**< do not print the column names */
+/** @} */
+
+/** Magic of struct ce_gw_bin_header */
+#define CE_GW_BIN_MAGIC "CEGW"
+/** Version of the binary format. Incremented on incompatible changes, new
+ * fields are appended to the record and increase record_size. */
+#define CE_GW_BIN_VERSION 1
+/** byte_order of struct ce_gw_bin_header as written by the host */
+#define CE_GW_BIN_BYTE_ORDER 0x01020304
+
+/**
+ * @struct ce_gw_bin_header
+ * @brief Start of the binary format (--format=bin). It is followed by
+ *        records of record_size bytes until the end of the stream, the number
+ *        of routes is (length - header_size) / record_size. All values are in
+ *        the byte order of the host which wrote them, see byte_order.
+ */
+struct ce_gw_bin_header {
+	char magic[4];		/**< CE_GW_BIN_MAGIC, not \0 terminated */
+	uint16_t version;	/**< CE_GW_BIN_VERSION */
+	uint16_t header_size;	/**< sizeof(struct ce_gw_bin_header) */
+	uint32_t byte_order;	/**< CE_GW_BIN_BYTE_ORDER */
+	uint16_t record_size;	/**< sizeof(struct ce_gw_bin_route) */
+	uint16_t reserved;	/**< 0 */
+};
+
+/**
+ * @struct ce_gw_bin_route
+ * @brief One route of the binary format. Fixed layout without implicit
+ *        padding, so it can be read or mmap()ed directly.
+ */
+struct ce_gw_bin_route {
+	uint32_t id;		/**< route id */
+	uint32_t flags;		/**< see F_CAN_FD */
+	uint32_t handled;	/**< number of handled frames */
+	uint32_t dropped;	/**< number of dropped frames */
+	uint8_t type;		/**< enum gw_type */
+	uint8_t reserved[3];	/**< 0 */
+	char src[IFNAMSIZ];	/**< name of the src device, \0 padded */
+	char dst[IFNAMSIZ];	/**< name of the dst device, \0 padded */
+};
+
+/**
+ * @struct outbuf
+ * @brief A large reusable output buffer, written with few big write() calls.
+ */
+struct outbuf {
+	int fd;		/**< destination */
+	char *buf;	/**< the buffer */
+	size_t len;	/**< used bytes */
+	size_t size;	/**< size of buf */
+	int err;	/**< first write error (-errno) or 0 */
+};
+
+/**
+ * @fn int outbuf_init(struct outbuf *out, int fd, size_t size)
+ * @brief Allocates the buffer.
+ * @param out The output buffer
+ * @param fd The file descriptor the buffer is flushed to.
+ * @param size Size of the buffer, at least ROW_MAX.
+ * @retval 0 on success
+ * @retval -ENOMEM on failure
+ * @ingroup trans
+ */
+extern int outbuf_init(struct outbuf *out, int fd, size_t size);
+
+/**
+ * @fn int outbuf_flush(struct outbuf *out)
+ * @brief Writes the content of the buffer to its file descriptor.
+ * @retval 0 on success
+ * @retval <0 -errno of the first failed write
+ * @ingroup trans
+ */
+extern int outbuf_flush(struct outbuf *out);
+
+/**
+ * @fn void outbuf_free(struct outbuf *out)
+ * @brief Flushes and frees the buffer.
+ * @ingroup trans
+ */
+extern void outbuf_free(struct outbuf *out);
+
+/**
+ * @fn char *outbuf_reserve(struct outbuf *out, size_t len)
+ * @brief Returns space for len bytes (at most ROW_MAX), flushes if needed.
+ *        The caller must call outbuf_commit() with the bytes used.
+ * @ingroup trans
+ */
+static inline char *outbuf_reserve(struct outbuf *out, size_t len)
+{
+	if (out->size - out->len < len)
+		outbuf_flush(out);
+
+	return out->buf + out->len;
+}
+
+/**
+ * @fn void outbuf_commit(struct outbuf *out, char *end)
+ * @brief Marks the bytes up to end as used. See outbuf_reserve().
+ * @ingroup trans
+ */
+static inline void outbuf_commit(struct outbuf *out, char *end)
+{
+	out->len = end - out->buf;
+}
+
+/**
+ * @fn void outbuf_put(struct outbuf *out, const char *str, size_t len)
+ * @brief Appends len bytes of str.
+ * @ingroup trans
+ */
+extern void outbuf_put(struct outbuf *out, const char *str, size_t len);
+
+/**
+ * @fn char *fmt_u32(char *p, uint32_t value)
+ * @brief Writes value as decimal number to p, without printf().
+ * @returns The end of the number.
+ * @ingroup trans
+ */
+extern char *fmt_u32(char *p, uint32_t value);
+
+/**
+ * @fn void format_init(void)
+ * @brief Precomputes the strings of all types and flag combinations from
+ *        type_array and flags_array. Called by the format functions on first
+ *        use, but can be called at startup.
+ * @ingroup trans
+ */
+extern void format_init(void);
+
+/**
+ * @fn const char *format_type(uint8_t type, size_t *len)
+ * @brief Returns the precomputed name of a type ("?" if unknown).
+ * @ingroup trans
+ */
+extern const char *format_type(uint8_t type, size_t *len);
+
+/**
+ * @fn const char *format_flags(uint32_t flags, size_t *len)
+ * @brief Returns the precomputed string of flags like flags2str(). Unknown
+ *        bits are ignored.
+ * @ingroup trans
+ */
+extern const char *format_flags(uint32_t flags, size_t *len);
+
+/**
+ * @fn void format_header(struct outbuf *out)
+ * @brief Appends the column names of the route table.
+ * @ingroup trans
+ */
+extern void format_header(struct outbuf *out);
+
+/**
+ * @fn void format_route(struct outbuf *out, const struct ce_gw_route *route)
+ * @brief Appends one route as line of the route table. The line is the same
+ *        as printed by ce_gw_route_print().
+ * @ingroup trans
+ */
+extern void format_route(struct outbuf *out, const struct ce_gw_route *route);
+
+/**
+ * @fn int str2format(const char *str)
+ * @brief Returns the format of its name ("text", "json", "csv", "bin").
+ * @retval -1 if str is no format
+ * @ingroup trans
+ */
+extern int str2format(const char *str);
+
+/**
+ * @struct format_stream
+ * @brief Writes routes in one of the formats as they are listed. Only one
+ *        buffer of OUTBUF_SIZE is used, however many routes there are.
+ */
+struct format_stream {
+	struct outbuf out;	/**< the output */
+	unsigned int format;	/**< FORMAT_* and flags */
+	size_t rows;		/**< number of routes written */
+};
+
+/**
+ * @fn int format_stream_begin(struct format_stream *fs, int fd,
+ *                             unsigned int format)
+ * @brief Initialises fs and writes the header of the format (column names,
+ *        '[' or struct ce_gw_bin_header).
+ * @param format FORMAT_* optionally ored with FORMAT_NO_HEADER. The header
+ *        of FORMAT_BIN is always written.
+ * @retval 0 on success
+ * @retval -ENOMEM on failure
+ * @ingroup trans
+ */
+extern int format_stream_begin(struct format_stream *fs, int fd,
+                               unsigned int format);
+
+/**
+ * @fn int format_stream_route(const struct ce_gw_route *route, void *arg)
+ * @brief Writes one route. A ce_gw_route_cb, arg is the struct
+ *        format_stream.
+ * @retval 0
+ * @ingroup trans
+ */
+extern int format_stream_route(const struct ce_gw_route *route, void *arg);
+
+/**
+ * @fn int format_stream_end(struct format_stream *fs)
+ * @brief Writes the end of the format, flushes and frees fs.
+ * @retval 0 on success
+ * @retval <0 -errno if writing failed
+ * @ingroup trans
+ */
+extern int format_stream_end(struct format_stream *fs);
+
+/**
+ * @fn size_t fmt_json_str(char *p, const char *str, size_t len)
+ * @brief Writes str as quoted JSON string to p, which needs space for
+ *        6 * len + 2 bytes.
+ * @returns The number of bytes written.
+ * @ingroup trans
+ */
+extern size_t fmt_json_str(char *p, const char *str, size_t len);
+
+/**
+ * @fn char *fmt_csv_str(char *p, const char *str, size_t len)
+ * @brief Writes str as CSV field to p, quoted if it contains ',', '"' or a
+ *        line break (RFC 4180). p needs space for 2 * len + 2 bytes.
+ * @returns The end of the field.
+ * @ingroup trans
+ */
+extern char *fmt_csv_str(char *p, const char *str, size_t len);
+
+#endif
+
+/**@}*/
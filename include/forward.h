@@ -0,0 +1,210 @@
+/**
+ * @file forward.h
+ * @brief Control Area Network - Ethernet - Gateway - UDP Forwarding Header
+ * (Utility)
+ * @details A userspace data path for TYPE_UDP routes, for hosts where the
+ *          ce_gw module cannot be loaded: CAN frames of a SocketCAN raw
+ *          socket are sent as UDP datagrams to a peer, and with a listen
+ *          address the datagrams of the peer are written back to the CAN
+ *          device. A datagram carries one frame in the layout of TYPE_NET,
+ *          struct can_frame (CAN_MTU) or with F_CAN_FD struct canfd_frame
+ *          (CANFD_MTU), with the can_id in network byte order. Frames are
+ *          moved in batches with recvmmsg() and sendmmsg() through a pool
+ *          allocated once, without a copy between receive and send.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_FORWARD_H__
+#define __CAN_ETH_GW_UTILS_FORWARD_H__
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include "netlink.h"
+
+/** Frames per recvmmsg() and sendmmsg() if -B is not given */
+#define FORWARD_BATCH 64
+/** Largest batch */
+#define FORWARD_BATCH_MAX 1024
+/** Receive buffer of both sockets, so a burst is not lost while the other
+ * direction is forwarded */
+#define FORWARD_RCVBUF (1 << 20)
+
+/**
+ * @enum forward_dir
+ * @brief The two routes of a forwarder.
+ */
+enum forward_dir {
+	FORWARD_CAN_UDP,	/**< from the CAN device to the peer */
+	FORWARD_UDP_CAN,	/**< from the peer to the CAN device */
+	FORWARD_DIRS,		/**< number of directions */
+};
+
+/**
+ * @struct forward_stats
+ * @brief Counters of one direction.
+ */
+struct forward_stats {
+	uint64_t handled;	/**< frames sent on, like CE_GW_A_HNDL */
+	uint64_t dropped;	/**< frames received but not sent on, like
+				 * CE_GW_A_DROP */
+	uint64_t batches;	/**< recvmmsg() calls which returned frames */
+};
+
+struct mmsghdr;
+
+/**
+ * @struct forward
+ * @brief A forwarder between a CAN socket and a UDP socket. See
+ *        forward_init() and forward_open().
+ */
+struct forward {
+	int can_fd;			/**< SocketCAN raw socket */
+	int udp_fd;			/**< UDP socket connected to the peer */
+	uint32_t flags;			/**< see F_CAN_FD */
+	unsigned int batch;		/**< size of the pool */
+	struct canfd_frame *frames;	/**< the pool, batch frames */
+	struct iovec *iov;		/**< one per frame, permuted by
+					 * forward_run() */
+	struct mmsghdr *msgs;		/**< one per frame */
+	struct forward_stats stats[FORWARD_DIRS]; /**< see forward_route() */
+	char can_name[IFNAMSIZ];	/**< source of FORWARD_CAN_UDP */
+	char udp_name[IFNAMSIZ];	/**< "udp:PORT" of the peer */
+};
+
+/**
+ * @fn int forward_init(struct forward *f, int can_fd, int udp_fd,
+ *                      uint32_t flags, unsigned int batch)
+ * @brief Sets up f for two open datagram sockets and allocates the pool.
+ *        On success f owns the sockets, see forward_close().
+ * @param can_fd A CAN_RAW socket, with CAN_RAW_FD_FRAMES if flags has
+ *        F_CAN_FD. Any datagram socket with one frame per datagram works,
+ *        e.g. a socketpair() in a test.
+ * @param udp_fd A datagram socket connected to the peer.
+ * @param batch Frames per system call, 1 to FORWARD_BATCH_MAX.
+ * @retval 0 on success
+ * @retval -EINVAL if batch is out of range
+ * @retval -ENOMEM if the pool could not be allocated
+ * @ingroup net
+ */
+extern int forward_init(struct forward *f, int can_fd, int udp_fd,
+                        uint32_t flags, unsigned int batch);
+
+/**
+ * @fn int forward_open(struct forward *f, const char *can, const char *peer,
+ *                      const char *listen, uint32_t flags,
+ *                      unsigned int batch)
+ * @brief Opens the raw socket of the CAN device can and a UDP socket
+ *        connected to peer, bound to listen, and calls forward_init().
+ * @param peer HOST:PORT, an IPv6 address in brackets, e.g. [::1]:20000.
+ * @param listen ADDR:PORT the datagrams of the peer arrive at. NULL for an
+ *        ephemeral port, then only FORWARD_CAN_UDP is of use.
+ * @retval 0 on success
+ * @retval <0 -errno on failure, printed to stderr
+ * @ingroup net
+ */
+extern int forward_open(struct forward *f, const char *can, const char *peer,
+                        const char *listen, uint32_t flags,
+                        unsigned int batch);
+
+/**
+ * @fn int forward_can_socket(const char *can, uint32_t flags)
+ * @brief Opens the raw socket of the CAN device can, with
+ *        CAN_RAW_FD_FRAMES if flags has F_CAN_FD.
+ * @retval >=0 the socket
+ * @retval <0 -errno after printing an error
+ * @ingroup net
+ */
+extern int forward_can_socket(const char *can, uint32_t flags);
+
+/**
+ * @fn void forward_send(int fd, struct mmsghdr *msgs, unsigned int n,
+ *                       struct forward_stats *st)
+ * @brief Sends the n frames of msgs with as few sendmmsg() as possible and
+ *        counts them as handled in st. A frame the socket refuses, e.g.
+ *        with ENOBUFS of a full CAN queue or ECONNREFUSED of a peer which
+ *        is not listening, is counted as dropped and the rest is sent.
+ * @ingroup net
+ */
+extern void forward_send(int fd, struct mmsghdr *msgs, unsigned int n,
+                         struct forward_stats *st);
+
+/**
+ * @fn int forward_run(struct forward *f, enum forward_dir dir)
+ * @brief Forwards the frames waiting on the input socket of dir, batch
+ *        frames per system call, until it is empty. Never blocks on
+ *        receive. Malformed frames (wrong size, DLC, or CAN-FD without
+ *        F_CAN_FD) and frames the output refuses are dropped.
+ * @retval >=0 the number of received frames
+ * @retval <0 -errno if receiving failed
+ * @ingroup net
+ */
+extern int forward_run(struct forward *f, enum forward_dir dir);
+
+/**
+ * @fn int forward_poll(struct forward *f, int both, int timeout)
+ * @brief Waits up to timeout ms (-1 forever) for frames and runs
+ *        forward_run() for the ready directions.
+ * @param both 0 for FORWARD_CAN_UDP only, else both directions.
+ * @retval >=0 the number of received frames
+ * @retval -EINTR if a signal arrived
+ * @retval <0 -errno on failure
+ * @ingroup net
+ */
+extern int forward_poll(struct forward *f, int both, int timeout);
+
+/**
+ * @fn void forward_route(const struct forward *f, enum forward_dir dir,
+ *                        struct ce_gw_route *route)
+ * @brief Describes dir as a TYPE_UDP route with ID dir + 1 and its counters,
+ *        e.g. for ce_gw_route_print().
+ * @ingroup net
+ */
+extern void forward_route(const struct forward *f, enum forward_dir dir,
+                          struct ce_gw_route *route);
+
+/**
+ * @fn void forward_close(struct forward *f)
+ * @brief Closes the sockets and frees the pool of f.
+ * @ingroup net
+ */
+extern void forward_close(struct forward *f);
+
+/**
+ * @fn int forward_main(int argc, char *argv[])
+ * @brief Runs "forward [-f] [-l ADDR:PORT] [-B BATCH] [-i INTERVAL] CAN
+ *        HOST:PORT" with argv[0] being "forward", until SIGINT.
+ * @details Prints the counters of both directions as routes every INTERVAL
+ *          seconds and at the end.
+ * @retval EXIT_SUCCESS after SIGINT
+ * @retval EXIT_FAILURE on failure
+ * @ingroup files
+ */
+extern int forward_main(int argc, char *argv[]);
+
+#endif
+
+/**@}*/
@@ -0,0 +1,115 @@
+/**
+ * @file hist.h
+ * @brief Control Area Network - Ethernet - Gateway - Latency Histogram Header
+ * (Utility)
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_HIST_H__
+#define __CAN_ETH_GW_UTILS_HIST_H__
+
+#include <stdint.h>
+
+/** Bits of the sub buckets. Every power of 2 is split into
+ * 2^(HIST_SUB_BITS - 1) buckets, i.e. a relative error below 1/32. */
+#define HIST_SUB_BITS 6
+/** Number of buckets for the whole range of uint64_t */
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 2) << (HIST_SUB_BITS - 1))
+
+/**
+ * @struct hist
+ * @brief A histogram of values, e.g. latencies in ns, with buckets of
+ *        logarithmic size like HdrHistogram. Recording is O(1) and the
+ *        memory is constant. Initialize it with hist_init().
+ */
+struct hist {
+	uint64_t counts[HIST_BUCKETS];	/**< number of values per bucket */
+	uint64_t n;			/**< number of values */
+	uint64_t min;			/**< smallest value */
+	uint64_t max;			/**< largest value */
+	double sum;			/**< sum of the values */
+	double sum2;			/**< sum of the squared values */
+};
+
+/**
+ * @fn void hist_init(struct hist *h)
+ * @brief Empties h.
+ * @ingroup trans
+ */
+extern void hist_init(struct hist *h);
+
+/**
+ * @fn void hist_record(struct hist *h, uint64_t value)
+ * @brief Adds value to h.
+ * @ingroup trans
+ */
+extern void hist_record(struct hist *h, uint64_t value);
+
+/**
+ * @fn void hist_merge(struct hist *h, const struct hist *from)
+ * @brief Adds all values of from to h.
+ * @ingroup trans
+ */
+extern void hist_merge(struct hist *h, const struct hist *from);
+
+/**
+ * @fn uint64_t hist_percentile(const struct hist *h, double p)
+ * @brief Returns the value below which p percent of the values are.
+ * @details The result is the upper end of the bucket of this value (at most
+ *          hist.max), so it is never too optimistic.
+ * @param p percentile, e.g. 99.9
+ * @retval 0 if h is empty
+ * @ingroup trans
+ */
+extern uint64_t hist_percentile(const struct hist *h, double p);
+
+/**
+ * @fn uint64_t hist_count_below(const struct hist *h, uint64_t value)
+ * @brief Returns the number of values below value. It is exact for powers
+ *        of 2 and values below 2^HIST_SUB_BITS, else it may miss values of
+ *        the bucket of value.
+ * @ingroup trans
+ */
+extern uint64_t hist_count_below(const struct hist *h, uint64_t value);
+
+/**
+ * @fn double hist_mean(const struct hist *h)
+ * @brief Returns the mean of the values, 0 if h is empty.
+ * @ingroup trans
+ */
+extern double hist_mean(const struct hist *h);
+
+/**
+ * @fn double hist_stddev(const struct hist *h)
+ * @brief Returns the standard deviation of the values (like mdev of ping),
+ *        0 if h is empty.
+ * @ingroup trans
+ */
+extern double hist_stddev(const struct hist *h);
+
+#endif
+
+/**@}*/
@@ -0,0 +1,121 @@
+/**
+ * @file ifcache.h
+ * @brief Control Area Network - Ethernet - Gateway - Interface Cache Header
+ * (Utility)
+ * @details Maps the names of the network devices to their interface indexes
+ *          and back. It is filled once per context by the transport (an
+ *          rtnetlink link dump for the kernel) and looked up in hash tables.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup net
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_IFCACHE_H__
+#define __CAN_ETH_GW_UTILS_IFCACHE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <net/if.h>
+
+/**
+ * @struct ifcache_entry
+ * @brief A network device.
+ */
+struct ifcache_entry {
+	int index;		/**< interface index, > 0 */
+	char name[IFNAMSIZ];	/**< name of the device */
+};
+
+/**
+ * @struct ifcache
+ * @brief The network devices with two open addressing hash tables, by name
+ *        and by index. Initialize it with zeros, fill it with ifcache_add()
+ *        and make it searchable with ifcache_build().
+ */
+struct ifcache {
+	struct ifcache_entry *entries;	/**< the devices */
+	size_t len;			/**< number of devices */
+	size_t size;			/**< allocated devices */
+	uint32_t *by_name;		/**< entry index + 1 by name hash, 0
+					 * for a free slot */
+	uint32_t *by_index;		/**< entry index + 1 by index hash */
+	size_t mask;			/**< number of slots - 1 */
+	int loaded;			/**< 1 after ifcache_build() */
+};
+
+/**
+ * @fn int ifcache_add(struct ifcache *c, int index, const char *name)
+ * @brief Adds a device. Call ifcache_build() after the last one.
+ * @retval 0 on success
+ * @retval -ENOMEM if the cache could not grow
+ * @ingroup net
+ */
+extern int ifcache_add(struct ifcache *c, int index, const char *name);
+
+/**
+ * @fn int ifcache_build(struct ifcache *c)
+ * @brief Builds the hash tables of the added devices. Without memory, the
+ *        cache stays empty, so every lookup misses.
+ * @retval 0 on success
+ * @retval -ENOMEM on failure
+ * @ingroup net
+ */
+extern int ifcache_build(struct ifcache *c);
+
+/**
+ * @fn int ifcache_index(const struct ifcache *c, const char *name)
+ * @brief Returns the interface index of the device name.
+ * @retval 0 if the device is not in the cache
+ * @ingroup net
+ */
+extern int ifcache_index(const struct ifcache *c, const char *name);
+
+/**
+ * @fn const char *ifcache_name(const struct ifcache *c, int index)
+ * @brief Returns the name of the device with the interface index.
+ * @retval NULL if the device is not in the cache
+ * @ingroup net
+ */
+extern const char *ifcache_name(const struct ifcache *c, int index);
+
+/**
+ * @fn void ifcache_free(struct ifcache *c)
+ * @brief Frees the memory of c and zeroes it.
+ * @ingroup net
+ */
+extern void ifcache_free(struct ifcache *c);
+
+/**
+ * @fn int ifcache_rtnl_load(struct ifcache *c)
+ * @brief Adds all network devices of the kernel with one RTM_GETLINK dump
+ *        over a NETLINK_ROUTE socket.
+ * @retval 0 on success
+ * @retval <0 libnl error code on failure
+ * @ingroup net
+ */
+extern int ifcache_rtnl_load(struct ifcache *c);
+
+#endif
+
+/**@}*/
@@ -0,0 +1,74 @@
+/**
+ * @file loadtest.h
+ * @brief Control Area Network - Ethernet - Gateway - Load Test Header
+ * (Utility)
+ * @details "cegwctl loadtest": injects numbered CAN frames at the source of
+ *          a route and captures them at its destination, with the kernel
+ *          timestamps of both ends.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_LOADTEST_H__
+#define __CAN_ETH_GW_UTILS_LOADTEST_H__
+
+/** Frames sent if -c is not given */
+#define LOADTEST_COUNT 1000
+/** Frames per second if -r is not given */
+#define LOADTEST_RATE 1000
+/** Seconds to wait for the last frames if -W is not given */
+#define LOADTEST_TIMEOUT 1.0
+/** CAN ID of the injected frames */
+#define LOADTEST_CAN_ID 0x7ee
+/** Frames per system call */
+#define LOADTEST_BATCH 64
+/** Bytes of a receive buffer, an Ethernet frame fits */
+#define LOADTEST_SLOT 1536
+
+/**
+ * @fn int loadtest_main(int argc, char *argv[])
+ * @brief Runs "loadtest [-c COUNT] [-r RATE] [-b BURST] [-f] [-s SIZE]
+ *        [-W TIMEOUT] ROUTE_ID" with argv[0] being "loadtest".
+ * @details Looks up src and dst of the route with CE_GW_C_LIST and sends
+ *          COUNT frames with CAN ID LOADTEST_CAN_ID to src, BURST frames
+ *          back to back RATE / BURST times a second. A CAN device is used
+ *          with a raw socket, any other device with a packet socket and
+ *          the layout of the route type of codec.h. Each frame carries its
+ *          number and a tag of the run in the first 8 data bytes. The
+ *          latency of a frame is the time from its SO_TIMESTAMPING
+ *          SOF_TIMESTAMPING_TX_SCHED timestamp at src (or the send() call
+ *          if the kernel gives none) to its receive timestamp at dst.
+ *          Prints the sent, received, lost, duplicated and reordered
+ *          frames, the rates, the latency percentiles and histogram, and
+ *          compares the deltas of the HNDL and DROP counters of the route.
+ * @retval EXIT_SUCCESS if every frame arrived
+ * @retval EXIT_FAILURE otherwise
+ * @ingroup files
+ */
+extern int loadtest_main(int argc, char *argv[]);
+
+#endif
+
+/**@}*/
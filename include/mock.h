@@ -0,0 +1,88 @@
+/**
+ * @file mock.h
+ * @brief Control Area Network - Ethernet - Gateway - Mock Kernel Header
+ * (Utility)
+ * @details A replacement of the ce_gw kernel module in this process. It is
+ *          selected with CEGW_TRANSPORT=mock (see transport.h) and answers
+ *          the CE_GW commands from a route and device table in memory.
+ *          The tables are shared by all sockets of the process and locked,
+ *          the answers are queued per socket, so contexts of several
+ *          threads may use the mock at the same time.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_MOCK_H__
+#define __CAN_ETH_GW_UTILS_MOCK_H__
+
+/** Environment variable with the number of routes the mock starts with */
+#define MOCK_ROUTES_ENV "CEGW_MOCK_ROUTES"
+/** Environment variable with the errors to inject, see mock_fail() */
+#define MOCK_FAIL_ENV "CEGW_MOCK_FAIL"
+
+/** Maximum size of one received buffer. Like a dump skb of the kernel, a
+ * large route list is split into many buffers of this size. */
+#define MOCK_RECV_SIZE 16384
+/** Number of CAN devices (can0, can1, ...) which always exist */
+#define MOCK_CAN_DEVS 4
+/** Number of gateway devices (cegw0, cegw1, ...) created by mock_reset() */
+#define MOCK_GW_DEVS 16
+
+/**
+ * @fn void mock_reset(unsigned int routes)
+ * @brief Replaces the tables of the mock: the CAN devices, and if routes is
+ *        not 0, MOCK_GW_DEVS gateway devices with routes routes between
+ *        them and the CAN devices. Pending answers are dropped.
+ * @details The first call of mock_transport.open() does this with
+ *          MOCK_ROUTES_ENV, later opens keep the tables.
+ * @retval 0 on success
+ * @retval -ENOMEM if the tables could not be allocated
+ * @ingroup net
+ */
+extern int mock_reset(unsigned int routes);
+
+/**
+ * @fn int mock_fail(const char *spec)
+ * @brief Sets the errors the mock injects. Replaces all earlier ones.
+ * @param spec Comma separated list of OP:ERRNO[:EVERY[:TIMES]], e.g.
+ *        "add:ENOSPC:100,recv:EIO:1000". Every EVERY-th (default every)
+ *        request OP fails with ERRNO, given by name or number, at most
+ *        TIMES times (default no limit). OP is one of echo, add, del,
+ *        list, family (the CE_GW requests and the request of the family
+ *        ID), send or recv (the transport itself). intr marks the next
+ *        buffer of a dump with NLM_F_DUMP and all after it
+ *        NLM_F_DUMP_INTR, as if the table had changed, its ERRNO is
+ *        ignored. A recv error does not stop a running list; recv ENOBUFS
+ *        loses the routes of its next buffer, like an overrun of the
+ *        unicasts of CE_GW_C_LIST. NULL or "" removes all errors.
+ * @retval 0 on success
+ * @retval -EINVAL if spec is malformed
+ * @ingroup net
+ */
+extern int mock_fail(const char *spec);
+
+#endif
+
+/**@}*/
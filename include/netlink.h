@@ -31,6 +31,9 @@
 #define __CAN_ETH_GW_UTILS_NETLINK_H__
 
 #include <stdint.h>
+#include <stddef.h>
+#include <signal.h>
+#include <net/if.h>
 
 /** This Flags are also defind in kernel in ce_gw_dev.h */
 #define F_CAN_FD 0x00000001
@@ -61,14 +64,236 @@ enum {
 	CE_GW_C_ADD,   /**< Add a gateway. Calls ce_gw_netlink_add(). */
 	CE_GW_C_DEL,   /**< Delate a gateway. Calls ce_gw_netlink_del(). */
 	CE_GW_C_LIST,  /**< list active gateways. Calls ce_gw_netlink_list(). */
+	CE_GW_C_EVENT, /**< Event, sent by the kernel to the multicast group
+	                * CE_GW_MCGRP_EVENTS. See ce_gw_monitor(). */
 	__CE_GW_C_MAX, /**< Maximum Number of Commands plus 1 */
 };
 #define CE_GW_C_MAX (__CE_GW_C_MAX - 1) /**< Maximum Number of Commands */
 
+/** Name of the multicast group of CE_GW_C_EVENT */
+#define CE_GW_MCGRP_EVENTS "events"
+
+/**
+ * @enum ce_gw_event_type
+ * @brief Kind of a CE_GW_C_EVENT (attribute CE_GW_A_EVENT).
+ */
+enum ce_gw_event_type {
+	CE_GW_E_UNSPEC,    /**< Only a Dummy to skip index 0. */
+	CE_GW_E_ROUTE_ADD, /**< a route was added */
+	CE_GW_E_ROUTE_DEL, /**< a route was deleted */
+	CE_GW_E_DEV_ADD,   /**< a gateway device was added */
+	CE_GW_E_DEV_DEL,   /**< a gateway device was deleted */
+	CE_GW_E_DROP,      /**< the drop threshold of a route was exceeded */
+	__CE_GW_E_MAX,     /**< Maximum Event Number plus 1 */
+};
+#define CE_GW_E_MAX (__CE_GW_E_MAX - 1) /**< Maximum Event Number */
+
+/**
+ * @struct flags
+ * @brief Textual name of a flag. See flags_array and flags2str().
+ */
+struct flags {
+	char *name;
+};
+
+/** Names of the flags, the index is the bit number. Ends with {0}. */
+extern const struct flags flags_array[];
+
+/**
+ * @struct enums
+ * @brief Textual name of an enum value. See type_array and enum2str().
+ */
+struct enums {
+	char *name;
+};
+
+/** Names of enum gw_type, the index is the value. Ends with {0}. */
+extern const struct enums type_array[];
+
+/** Names of enum ce_gw_event_type, the index is the value. Ends with {0}. */
+extern const struct enums event_array[];
+
+/** Maximum length of an echo answer including \0 */
+#define ECHO_MAX 1024
+
+/** Receive buffer (SO_RCVBUF) of the netlink socket in bytes, large enough
+ * for the dump of a big route table */
+#define CE_GW_RCVBUF (4 << 20)
+/** Environment variable with a receive buffer size instead of CE_GW_RCVBUF */
+#define CE_GW_RCVBUF_ENV "CEGW_RCVBUF"
+/** Size of the buffer of one receive. The kernel fills dump buffers of up to
+ * 32 KiB, a smaller buffer would truncate them. */
+#define CE_GW_MSG_BUFSIZE 32768
+/** Number of restarts in a row without a new route before
+ * ce_gw_list_foreach() gives up with -NLE_DUMP_INTR, and of overruns in a
+ * row without a message in between */
+#define CE_GW_DUMP_RETRIES 8
+
+/**
+ * @struct ce_gw_dump_stats
+ * @brief Counters of the CE_GW_C_LIST dumps of a context. See
+ *        cegw_ctx_dump_stats().
+ */
+struct ce_gw_dump_stats {
+	uint64_t dumps;		/**< listings, a restart counts once more */
+	uint64_t messages;	/**< netlink messages received by the dumps */
+	uint64_t bytes;		/**< bytes of these messages */
+	uint64_t restarts;	/**< restarts after an overrun or
+				 * NLM_F_DUMP_INTR */
+	uint64_t overruns;	/**< receive buffer overruns (ENOBUFS) */
+	int rcvbuf;		/**< receive buffer the kernel granted, as read
+				 * back by SO_RCVBUF, 0 without a socket */
+};
+
+/**
+ * @struct ce_gw_route
+ * @brief Informations of one active route as sent by CE_GW_C_LIST.
+ */
+struct ce_gw_route {
+	uint32_t id;		/**< route id */
+	uint32_t flags;		/**< see F_CAN_FD */
+	uint32_t handled;	/**< number of handled frames */
+	uint32_t dropped;	/**< number of dropped frames */
+	uint8_t type;		/**< enum gw_type */
+	char src[IFNAMSIZ];	/**< name of the src device */
+	char dst[IFNAMSIZ];	/**< name of the dst device */
+};
+
+/**
+ * @enum ce_gw_filter_field
+ * @brief The fields of a struct ce_gw_route_filter which are used.
+ */
+enum ce_gw_filter_field {
+	CE_GW_FILTER_SRC = 1 << 0,	/**< ce_gw_route_filter.src */
+	CE_GW_FILTER_DST = 1 << 1,	/**< ce_gw_route_filter.dst */
+	CE_GW_FILTER_TYPE = 1 << 2,	/**< ce_gw_route_filter.type */
+	CE_GW_FILTER_FLAGS = 1 << 3,	/**< ce_gw_route_filter.flags */
+};
+
+/**
+ * @struct ce_gw_route_filter
+ * @brief Selects routes of a listing. See ce_gw_lister_filter().
+ */
+struct ce_gw_route_filter {
+	unsigned int fields;	/**< ored enum ce_gw_filter_field, 0 for all
+				 * routes */
+	char src[IFNAMSIZ];	/**< name of the src device */
+	char dst[IFNAMSIZ];	/**< name of the dst device */
+	uint8_t type;		/**< enum gw_type */
+	uint32_t flags;		/**< all of these flags are set */
+};
+
+/**
+ * @fn int ce_gw_route_match(const struct ce_gw_route_filter *filter,
+ *                           const struct ce_gw_route *route)
+ * @brief Checks route against every used field of filter.
+ * @retval 1 if route is selected by filter or filter is NULL
+ * @retval 0 otherwise
+ * @ingroup trans
+ */
+extern int ce_gw_route_match(const struct ce_gw_route_filter *filter,
+                             const struct ce_gw_route *route);
+
+/**
+ * @typedef ce_gw_route_cb
+ * @brief Callback for every route. See ce_gw_list_foreach().
+ * @param route The route. Only valid during the call.
+ * @param arg The argument passed to ce_gw_list_foreach().
+ * @retval 0 to continue
+ * @retval !=0 to stop the listing. ce_gw_list_foreach() returns this value.
+ */
+typedef int (*ce_gw_route_cb)(const struct ce_gw_route *route, void *arg);
+
+/**
+ * @struct ce_gw_event
+ * @brief A CE_GW_C_EVENT of the multicast group. The fields of route which
+ *        are not part of the event are 0, the device of a device event is
+ *        route.dst.
+ */
+struct ce_gw_event {
+	uint8_t event;			/**< enum ce_gw_event_type */
+	uint64_t time;			/**< kernel time in ns, 0 if unknown */
+	struct ce_gw_route route;	/**< the route or device */
+};
+
+/**
+ * @typedef ce_gw_event_cb
+ * @brief Callback for every event. See ce_gw_monitor().
+ * @retval 0 to continue
+ * @retval !=0 to stop monitoring. ce_gw_monitor() returns this value.
+ */
+typedef int (*ce_gw_event_cb)(const struct ce_gw_event *event, void *arg);
+
+/** Environment variable with a NETLINK_USERSOCK group which ce_gw_monitor()
+ * joins instead of the CE_GW group. Used with a stand-in for the module. */
+#define CE_GW_EVENT_USERSOCK_ENV "CEGW_EVENT_USERSOCK"
+
+/**
+ * @struct ce_gw_op
+ * @brief A single add or del command of a batch. See ce_gw_batch().
+ */
+struct ce_gw_op {
+	uint8_t cmd;		/**< CE_GW_C_ADD or CE_GW_C_DEL */
+	uint8_t type;		/**< enum gw_type (only add) */
+	uint32_t flags;		/**< see F_CAN_FD (only add) */
+	uint32_t id;		/**< route id (only del route) */
+	char src[IFNAMSIZ];	/**< src name of a route. Empty for a device */
+	char dst[IFNAMSIZ];	/**< dst name of a route or the device name.
+				 * Empty for del route. */
+	unsigned int line;	/**< line in the batch file (for reports) */
+	int err;		/**< result: 0 on success, -errno on failure */
+};
+
 /**
- * @fn int ce_gw_add(char *src_name, char *dst_name, uint8_t type,
- *            uint32_t flags)
+ * @struct cegw_ctx
+ * @brief A connection to the kernel module: the socket, the family ID, the
+ *        callbacks and the request buffer. See cegw_ctx_alloc().
+ * @details Every request takes the context it is sent over. A context must
+ *          not be used by two threads at once, but every thread can have an
+ *          own context, so requests can run in parallel without locks.
+ */
+struct cegw_ctx;
+
+/**
+ * @fn struct cegw_ctx *cegw_ctx_alloc(void)
+ * @brief Creates a context: the netlink socket (or the transport of
+ *        TRANSPORT_ENV, see transport.h) is connected and the family ID is
+ *        resolved.
+ * @retval NULL on failure. The reason is printed to stderr.
+ * @ingroup net
+ * @see cegw_ctx_free()
+ */
+extern struct cegw_ctx *cegw_ctx_alloc(void);
+
+/**
+ * @fn void cegw_ctx_free(struct cegw_ctx *ctx)
+ * @brief Closes the socket and frees ctx. NULL is ignored.
+ * @ingroup net
+ */
+extern void cegw_ctx_free(struct cegw_ctx *ctx);
+
+/**
+ * @fn const char *cegw_ctx_transport(const struct cegw_ctx *ctx)
+ * @brief Returns the name of the transport of ctx, e.g. "netlink".
+ * @ingroup net
+ */
+extern const char *cegw_ctx_transport(const struct cegw_ctx *ctx);
+
+/**
+ * @fn const struct ce_gw_dump_stats *cegw_ctx_dump_stats(
+ *                                          const struct cegw_ctx *ctx)
+ * @brief Returns the counters of all listings of ctx so far, e.g. to size
+ *        the receive buffer with CE_GW_RCVBUF_ENV.
+ * @ingroup net
+ */
+extern const struct ce_gw_dump_stats *cegw_ctx_dump_stats(
+                                            const struct cegw_ctx *ctx);
+
+/**
+ * @fn int ce_gw_add(struct cegw_ctx *ctx, char *src_name, char *dst_name,
+ *                   uint8_t type, uint32_t flags)
  * @brief add a virtual ethernet device or a route
+ * @param ctx The context the request is sent over.
  * @param dst_name The textual name of the device wich will be the dst. OR the
  *                 name of the device, if you want to add a device.
  * @param src_name The textual name of the device wich will be the src. Must be
@@ -80,12 +305,13 @@ enum {
  * @ingroup net
  * @see related callbacks: nl_cb_general_errno()
  */
-extern int ce_gw_add(char *dst_name, char *src_name, uint8_t type,
-                     uint32_t flags);
+extern int ce_gw_add(struct cegw_ctx *ctx, char *dst_name,
+                     char *src_name, uint8_t type, uint32_t flags);
 
 /**
- * @fn int ce_gw_del(uint32_t id, char *dev_name)
+ * @fn int ce_gw_del(struct cegw_ctx *ctx, uint32_t id, char *dev_name)
  * @brief Deletes a device or a route in Kernel Module
+ * @param ctx The context the request is sent over.
  * @param id The id of the route you want to delete. param dev_name must be
  *        NULL when you want to delete a route.
  * @param dev_name The textual name of the virtual device you want to delete.
@@ -97,55 +323,494 @@ extern int ce_gw_add(char *dst_name, char *src_name, uint8_t type,
  * @ingroup net
  * @see related callbacks: nl_cb_general_errno()
  */
-extern int ce_gw_del(uint32_t id, char *dev_name);
+extern int ce_gw_del(struct cegw_ctx *ctx, uint32_t id, char *dev_name);
 
 /**
- * @fn int ce_gw_list(uint32_t id)
+ * @fn int ce_gw_batch(struct cegw_ctx *ctx, struct ce_gw_op *ops, size_t n,
+ *                     unsigned int window)
+ * @brief Sends many add and del commands pipelined over the socket of ctx.
+ * @details Up to window messages are sent before the first ACK is awaited.
+ *          ACKs and errors are matched back to their operation by the
+ *          sequence number. A failing operation does not stop the others,
+ *          its negative errno is stored in ce_gw_op.err.
+ * @param ops Array of operations. The results are written to ce_gw_op.err.
+ * @param n Number of operations in ops.
+ * @param window Maximum number of messages waiting for their ACK.
+ * @retval 0 if all messages could be sent and all answers received
+ *         (single operations may have failed anyway)
+ * @retval <0 if the socket failed. All unanswered operations get -EIO.
+ * @ingroup net
+ * @see related callbacks: nl_cb_batch_ack(), nl_cb_batch_errno(),
+ *                         nl_cb_batch_seq()
+ */
+extern int ce_gw_batch(struct cegw_ctx *ctx, struct ce_gw_op *ops, size_t n,
+                       unsigned int window);
+
+/**
+ * @fn int ce_gw_list(struct cegw_ctx *ctx, uint32_t id,
+ *                    const struct ce_gw_route_filter *filter,
+ *                    unsigned int format)
  * @brief Print informations of actual active routes to stdout
  * @param id set it to 0 if you want to list all routes. Else set it to the
  * route id you want to print
  *           of the route for wich you want the informations printed.
+ * @param filter Only the routes selected by filter are printed, NULL for
+ *        all. See ce_gw_lister_filter().
+ * @param format FORMAT_TEXT, FORMAT_JSON, FORMAT_CSV or FORMAT_BIN,
+ *        optionally ored with FORMAT_NO_HEADER. See format.h. The rows are
+ *        written as the dump arrives with few large write() calls.
  * @retval 0 on success
  * @retval <0 on failure
  * @ingroup net
  * @see related callbacks: nl_cb_list_entry(), nl_cb_list_finish(),
  *                   nl_cb_general_errno()
- * @todo perhaps return a list with the information, so that the caller
- * could parse the data himself (for example he will search for something
- * or want to pint out in an other method than the standart)
+ * @see ce_gw_list_foreach(), ce_gw_list_routes() and ce_gw_list_table() to
+ *      get the routes as struct ce_gw_route instead.
+ */
+extern int ce_gw_list(struct cegw_ctx *ctx, uint32_t id,
+                      const struct ce_gw_route_filter *filter,
+                      unsigned int format);
+
+/**
+ * @struct ce_gw_lister
+ * @brief A prepared list request, which can be run repeatedly without
+ *        building the message and callbacks again. See ce_gw_lister_alloc().
  */
-extern int ce_gw_list(uint32_t id);
+struct ce_gw_lister;
 
 /**
- * @fn int ce_gw_echo(char *message)
+ * @fn struct ce_gw_lister *ce_gw_lister_alloc(struct cegw_ctx *ctx,
+ *                                            uint32_t id)
+ * @brief Builds a CE_GW_C_LIST request and its callbacks once.
+ * @param ctx The context the request is sent over by every run. Must live
+ *        longer than the lister.
+ * @param id 0 for all routes, else the route id you want.
+ * @retval NULL on failure
+ * @ingroup net
+ * @see ce_gw_lister_run(), ce_gw_lister_free()
+ */
+extern struct ce_gw_lister *ce_gw_lister_alloc(struct cegw_ctx *ctx,
+                                              uint32_t id);
+
+/**
+ * @fn int ce_gw_lister_filter(struct ce_gw_lister *lister,
+ *                             const struct ce_gw_route_filter *filter)
+ * @brief Restricts the runs of lister to the routes selected by filter.
+ * @details The used fields are sent as CE_GW_A_SRC, CE_GW_A_DST,
+ *          CE_GW_A_TYPE and CE_GW_A_FLAGS of the request, so that a kernel
+ *          which supports them dumps only the selected routes. A kernel
+ *          which ignores them dumps all routes; the others are dropped in
+ *          the dump callback before route_cb is called. Call it once,
+ *          before the first run.
+ * @retval 0 on success
+ * @retval -NLE_NOMEM if the attributes do not fit into the message
+ * @ingroup net
+ */
+extern int ce_gw_lister_filter(struct ce_gw_lister *lister,
+                               const struct ce_gw_route_filter *filter);
+
+/**
+ * @fn int ce_gw_lister_run(struct ce_gw_lister *lister,
+ *                          ce_gw_route_cb route_cb, void *arg)
+ * @brief Sends the prepared request and calls route_cb for every route, like
+ *        ce_gw_list_foreach(). An interrupted dump is resumed the same way.
+ * @retval 0 on success
+ * @retval <0 libnl error code on failure
+ * @retval !=0 the return value of route_cb if it stopped the listing
+ * @ingroup net
+ */
+extern int ce_gw_lister_run(struct ce_gw_lister *lister,
+                            ce_gw_route_cb route_cb, void *arg);
+
+/**
+ * @fn void ce_gw_lister_free(struct ce_gw_lister *lister)
+ * @brief Frees a request of ce_gw_lister_alloc(). NULL is ignored.
+ * @ingroup net
+ */
+extern void ce_gw_lister_free(struct ce_gw_lister *lister);
+
+/**
+ * @fn int ce_gw_list_foreach(struct cegw_ctx *ctx, uint32_t id,
+ *                            ce_gw_route_cb route_cb, void *arg)
+ * @brief Calls route_cb for every active route
+ * @param id set it to 0 if you want all routes. Else set it to the route id
+ *           you want.
+ * @param route_cb called for every route
+ * @param arg passed to route_cb
+ * @details The routes are passed one by one as they are received, without
+ *          any allocation, so even very large tables need constant memory.
+ *
+ *          CE_GW_C_LIST is not a dump (NLM_F_DUMP), the module unicasts
+ *          every route. If the receive buffer overruns (ENOBUFS), these
+ *          messages are lost, so like after NLM_F_DUMP_INTR the rest of
+ *          the answer is dropped and the request is sent again, until
+ *          CE_GW_DUMP_RETRIES restarts in a row bring no new route.
+ *          route_cb only gets the routes behind the last ID it got, so no
+ *          route is passed twice. The counters are kept in
+ *          cegw_ctx_dump_stats().
+ * @retval 0 on success
+ * @retval -NLE_DUMP_INTR if the dump could not be completed, e.g. because
+ *         the kernel does not dump sorted by ID. Only a part of the routes
+ *         was passed to route_cb.
+ * @retval -NLE_NOMEM if the receive buffer kept overrunning. Only a part
+ *         of the routes was passed to route_cb.
+ * @retval <0 on failure
+ * @retval !=0 the value returned by route_cb to stop the listing
+ * @ingroup net
+ * @see related callbacks: nl_cb_list_entry(), nl_cb_list_finish(),
+ *                   nl_cb_general_errno()
+ */
+extern int ce_gw_list_foreach(struct cegw_ctx *ctx, uint32_t id,
+                              ce_gw_route_cb route_cb, void *arg);
+
+/**
+ * @fn int ce_gw_list_routes(struct cegw_ctx *ctx, uint32_t id,
+ *                           struct ce_gw_route *routes, size_t max,
+ *                           size_t *count)
+ * @brief Stores the active routes in a caller supplied array.
+ * @param id set it to 0 if you want all routes. Else set it to the route id
+ *           you want.
+ * @param routes The array for the routes.
+ * @param max Number of entries of routes.
+ * @param count Returns the number of active routes. If it is greater than
+ *        max, only the first max routes were stored.
+ * @retval 0 on success
+ * @retval <0 on failure
+ * @ingroup net
+ */
+extern int ce_gw_list_routes(struct cegw_ctx *ctx, uint32_t id,
+                             struct ce_gw_route *routes, size_t max,
+                             size_t *count);
+
+/**
+ * @struct ce_gw_route_table
+ * @brief A growing array of routes, which can be reused for many listings.
+ *        Initialize it with zeros, free it with ce_gw_route_table_free().
+ */
+struct ce_gw_route_table {
+	struct ce_gw_route *routes;	/**< the routes */
+	size_t len;			/**< number of routes */
+	size_t size;			/**< allocated routes */
+};
+
+/**
+ * @fn int ce_gw_list_table(struct cegw_ctx *ctx, uint32_t id,
+ *                          struct ce_gw_route_table *table)
+ * @brief Replaces the content of table with the active routes.
+ * @details The memory of table is reused and only grows if the table gets
+ *          larger than ever before.
+ * @param id set it to 0 if you want all routes. Else set it to the route id
+ *           you want.
+ * @param table The table. Must be zero initialized before the first use.
+ * @retval 0 on success
+ * @retval -ENOMEM if the table could not grow
+ * @retval <0 on failure
+ * @ingroup net
+ */
+extern int ce_gw_list_table(struct cegw_ctx *ctx, uint32_t id,
+                            struct ce_gw_route_table *table);
+
+/**
+ * @fn int ce_gw_route_table_store(const struct ce_gw_route *route, void *arg)
+ * @brief A ce_gw_route_cb which appends route to the struct
+ *        ce_gw_route_table arg, e.g. for ce_gw_async_list(). Set len to 0
+ *        before the listing.
+ * @retval 0 on success
+ * @retval -ENOMEM if the table could not grow. Stops the listing.
+ * @ingroup net
+ */
+extern int ce_gw_route_table_store(const struct ce_gw_route *route, void *arg);
+
+/**
+ * @fn void ce_gw_route_table_free(struct ce_gw_route_table *table)
+ * @brief frees the routes of table.
+ * @ingroup net
+ */
+extern void ce_gw_route_table_free(struct ce_gw_route_table *table);
+
+/**
+ * @fn void ce_gw_route_print_header(void)
+ * @brief Prints the column names of ce_gw_route_print() to stdout.
+ * @ingroup trans
+ */
+extern void ce_gw_route_print_header(void);
+
+/**
+ * @fn int ce_gw_route_print(const struct ce_gw_route *route, void *arg)
+ * @brief Prints one route as line of the route table to stdout.
+ * @param route The route
+ * @param arg unused. So it can be used as ce_gw_route_cb.
+ * @retval 0
+ * @ingroup trans
+ */
+extern int ce_gw_route_print(const struct ce_gw_route *route, void *arg);
+
+/**
+ * @fn int ce_gw_monitor(ce_gw_event_cb event_cb, void *arg)
+ * @brief Joins the multicast group CE_GW_MCGRP_EVENTS and calls event_cb for
+ *        every event as it arrives.
+ * @details The group is resolved through the generic netlink controller like
+ *          the family in cegw_ctx_alloc(). The function uses an own
+ *          non-blocking socket and does not need a context. If
+ *          CE_GW_EVENT_USERSOCK_ENV is set, the NETLINK_USERSOCK group of
+ *          this number is joined instead (see tools/event_standin.c).
+ * @param event_cb called for every event
+ * @param arg passed to event_cb
+ * @retval !=0 the return value of event_cb if it stopped monitoring
+ * @retval <0 on failure
+ * @ingroup net
+ * @see related callbacks: nl_cb_event()
+ */
+extern int ce_gw_monitor(ce_gw_event_cb event_cb, void *arg);
+
+/**
+ * @fn int ce_gw_event_print(const struct ce_gw_event *event, void *arg)
+ * @brief Prints an event with the local time of its arrival as one line to
+ *        stdout.
+ * @param arg unused. So it can be used as ce_gw_event_cb.
+ * @retval 0
+ * @ingroup trans
+ */
+extern int ce_gw_event_print(const struct ce_gw_event *event, void *arg);
+
+struct nl_msg;
+
+/**
+ * @fn struct nl_msg *ce_gw_event_msg(const struct ce_gw_event *event,
+ *                                    int family_id)
+ * @brief Builds the CE_GW_C_EVENT message of event like the kernel sends it.
+ *        For stand-ins of the kernel module.
+ * @retval NULL on failure
+ * @ingroup net
+ */
+extern struct nl_msg *ce_gw_event_msg(const struct ce_gw_event *event,
+                                      int family_id);
+
+/**
+ * @fn int ce_gw_echo_reply(struct cegw_ctx *ctx, char *message, char *reply,
+ *                          size_t size)
+ * @brief send a message and copy the message received from Kernel to reply.
+ * (for testing)
+ * @param message A String message you want to send.
+ * @param reply Buffer for the answer. Will be \0 terminated.
+ * @param size Size of reply.
+ * @ingroup net
+ * @retval 0 on success
+ * @retval <0 on failure
+ */
+extern int ce_gw_echo_reply(struct cegw_ctx *ctx, char *message, char *reply,
+                            size_t size);
+
+/**
+ * @fn int ce_gw_echo(struct cegw_ctx *ctx, char *message)
  * @brief send a message and return the received message from Kernel.
  * (for testing)
  * @param message A String message you want to send.
  * @ingroup net
  * @retval The message you get from the Kernel. NULL on failure.
  */
-extern int ce_gw_echo(char *message);
+extern int ce_gw_echo(struct cegw_ctx *ctx, char *message);
+
+/** Smallest CE_GW_A_DATA of ce_gw_ping(), room for sequence and time */
+#define CE_GW_PING_MIN 32
+/** Largest CE_GW_A_DATA of ce_gw_ping() */
+#define CE_GW_PING_MAX 8192
+
+/**
+ * @struct ce_gw_ping_opts
+ * @brief Parameters of ce_gw_ping().
+ */
+struct ce_gw_ping_opts {
+	unsigned int count;	/**< number of echoes, 0 until stop is set */
+	double interval;	/**< seconds from one echo to the next */
+	size_t size;		/**< bytes of CE_GW_A_DATA incl. the \0,
+				 * CE_GW_PING_MIN to CE_GW_PING_MAX */
+	unsigned int window;	/**< maximum number of outstanding echoes */
+	double timeout;		/**< seconds until an echo counts as lost */
+	volatile sig_atomic_t *stop; /**< ends the ping once it is != 0, e.g.
+				      * set by a signal handler. May be NULL */
+};
+
+/**
+ * @typedef ce_gw_ping_cb
+ * @brief Callback for every answered or lost echo. See ce_gw_ping().
+ * @param seq Sequence number of the echo, starting with 1.
+ * @param err 0 for a reply, the -errno of the module for an error or
+ *        -ETIMEDOUT if no answer came within ce_gw_ping_opts.timeout.
+ * @param rtt Round trip time in ns of a reply, else 0.
+ * @param arg The argument passed to ce_gw_ping().
+ */
+typedef void (*ce_gw_ping_cb)(uint32_t seq, int err, uint64_t rtt,
+                              void *arg);
+
+/**
+ * @fn int ce_gw_ping(struct cegw_ctx *ctx,
+ *                    const struct ce_gw_ping_opts *opts, ce_gw_ping_cb cb,
+ *                    void *arg)
+ * @brief Measures the round trip time through the module with repeated
+ *        CE_GW_C_ECHO requests.
+ * @details Every CE_GW_A_DATA carries the sequence number and the send time
+ *          as text, padded to opts->size, so a reply is matched and timed
+ *          by its content alone. A new echo is sent every opts->interval
+ *          seconds while less than opts->window are outstanding; with an
+ *          interval of 0 and a large window the module is flooded.
+ * @retval >=0 the number of sent echoes
+ * @retval <0 libnl error code if the socket failed
+ * @ingroup net
+ */
+extern int ce_gw_ping(struct cegw_ctx *ctx, const struct ce_gw_ping_opts *opts,
+                      ce_gw_ping_cb cb, void *arg);
+
+/**
+ * @typedef ce_gw_async_cb
+ * @brief Completion callback of a request of the async API. Called from
+ *        ce_gw_async_process() once per request. It may submit new requests
+ *        but must not call ce_gw_async_process().
+ * @param handle The handle returned by the submit.
+ * @param err 0 on success, the -errno of the module, -EINTR if a list was
+ *        interrupted too often (see CE_GW_DUMP_RETRIES), -ENOBUFS if the
+ *        socket overran while the request was outstanding, so its answer
+ *        may be lost (the request may have been executed anyway), -EIO if
+ *        a queued list could not be sent, or the value != 0 the route
+ *        callback of a list stopped it with.
+ * @param echo The reply of an echo, valid during the call. Else NULL.
+ * @param arg The argument passed to the submit.
+ */
+typedef void (*ce_gw_async_cb)(uint32_t handle, int err, const char *echo,
+                               void *arg);
+
+/**
+ * @fn int ce_gw_async_fd(struct cegw_ctx *ctx)
+ * @brief Prepares ctx for the async API and returns the file descriptor to
+ *        poll for answers (POLLIN), e.g. with epoll next to other I/O.
+ * @details The async API makes the socket non-blocking: the submit
+ *          functions send a request and return at once, and
+ *          ce_gw_async_process() reads what is there and calls the
+ *          completion callbacks. Hundreds of requests may be outstanding.
+ *          A context used with it must not be used for the blocking calls
+ *          (ce_gw_add(), ce_gw_list(), ...) anymore; use a second one.
+ *          Outstanding requests are dropped by cegw_ctx_free() without a
+ *          callback. The family ID is not resolved again for an async
+ *          request, it fails with -ENOENT if the module was reloaded.
+ *          The interface indexes are read once here; devices added later,
+ *          and all devices after an add failed with -ENODEV, are addressed
+ *          by name, so no submit waits for a link dump.
+ * @retval >=0 the file descriptor
+ * @retval -1 if the transport has none, e.g. the mock, which answers while
+ *         sending. Call ce_gw_async_process() after submitting.
+ * @retval <0 libnl error code on failure
+ * @ingroup net
+ */
+extern int ce_gw_async_fd(struct cegw_ctx *ctx);
+
+/**
+ * @fn int ce_gw_async_add(struct cegw_ctx *ctx, char *dst_name,
+ *                         char *src_name, uint8_t type, uint32_t flags,
+ *                         ce_gw_async_cb cb, void *arg, uint32_t *handle)
+ * @brief Submits ce_gw_add(). Completes with the ACK of the module.
+ * @param cb Called on completion with arg.
+ * @param handle Set to the handle of the request. May be NULL.
+ * @retval 0 on success, cb will be called
+ * @retval <0 libnl error code on failure, cb will not be called
+ * @ingroup net
+ */
+extern int ce_gw_async_add(struct cegw_ctx *ctx, char *dst_name,
+                           char *src_name, uint8_t type, uint32_t flags,
+                           ce_gw_async_cb cb, void *arg, uint32_t *handle);
 
 /**
- * @fn int nl_sk_fam_init(void)
- * @brief creakte socket and family and connect
- * @details     It creates the netlink socket and connect, as well as the
- *              netlink family. This function must called once before any other
- *              netlink operation.
- * @see nl_sk_fam_exit()
+ * @fn int ce_gw_async_del(struct cegw_ctx *ctx, uint32_t id, char *dev_name,
+ *                         ce_gw_async_cb cb, void *arg, uint32_t *handle)
+ * @brief Submits ce_gw_del(). Completes with the ACK of the module. See
+ *        ce_gw_async_add().
  * @ingroup net
- * @retval 0 on success, negative value on failure
  */
-extern int nl_sk_fam_init(void);
+extern int ce_gw_async_del(struct cegw_ctx *ctx, uint32_t id, char *dev_name,
+                           ce_gw_async_cb cb, void *arg, uint32_t *handle);
 
 /**
- * @fn void nl_sk_fam_exit(void)
- * @brief freeing the alloccated memory.
- * @detail The Function free the memory allocated by nl_sk_fam_init().
+ * @fn int ce_gw_async_echo(struct cegw_ctx *ctx, char *message,
+ *                          ce_gw_async_cb cb, void *arg, uint32_t *handle)
+ * @brief Submits ce_gw_echo_reply(). Completes with the reply, which is
+ *        passed to cb. See ce_gw_async_add().
  * @ingroup net
- * @see nl_sk_fam_init()
  */
-extern void nl_sk_fam_exit(void);
+extern int ce_gw_async_echo(struct cegw_ctx *ctx, char *message,
+                            ce_gw_async_cb cb, void *arg, uint32_t *handle);
+
+/**
+ * @fn int ce_gw_async_list(struct cegw_ctx *ctx, uint32_t id,
+ *                          const struct ce_gw_route_filter *filter,
+ *                          ce_gw_route_cb route_cb, ce_gw_async_cb cb,
+ *                          void *arg, uint32_t *handle)
+ * @brief Submits ce_gw_list_foreach() with a filter like
+ *        ce_gw_lister_filter(). route_cb is called with arg for every route
+ *        as it arrives, cb at the end of the dump.
+ * @details A socket runs one dump at a time. Further lists are queued and
+ *          sent when the one before is complete. A list interrupted by
+ *          NLM_F_DUMP_INTR or an overrun is resumed like by
+ *          ce_gw_lister_run().
+ * @param filter May be NULL.
+ * @ingroup net
+ */
+extern int ce_gw_async_list(struct cegw_ctx *ctx, uint32_t id,
+                            const struct ce_gw_route_filter *filter,
+                            ce_gw_route_cb route_cb, ce_gw_async_cb cb,
+                            void *arg, uint32_t *handle);
+
+/**
+ * @fn int ce_gw_async_process(struct cegw_ctx *ctx)
+ * @brief Reads all answers which are there without blocking and calls the
+ *        callbacks of the requests they complete.
+ * @retval >=0 the number of completed requests
+ * @retval <0 libnl error code if the socket failed
+ * @ingroup net
+ */
+extern int ce_gw_async_process(struct cegw_ctx *ctx);
+
+/**
+ * @fn unsigned int ce_gw_async_pending(const struct cegw_ctx *ctx)
+ * @brief Returns the number of submitted requests which are not completed,
+ *        including the queued lists.
+ * @ingroup net
+ */
+extern unsigned int ce_gw_async_pending(const struct cegw_ctx *ctx);
+
+/**
+ * @fn char *flags2str(uint32_t bits, const struct flags *flags, char *str,
+ *                     size_t size)
+ * @brief Convert Flags in ist textual represenation, e.g. "<CAN-FD>".
+ * @ingroup trans
+ */
+extern char *flags2str(uint32_t bits, const struct flags *flags, char *str,
+                       size_t size);
+
+/**
+ * @fn const char *enum2str(int value, const struct enums *enums, int max)
+ * @brief Returns the textual representation of an enum value or NULL.
+ * @ingroup trans
+ */
+extern const char *enum2str(int value, const struct enums *enums, int max);
+
+/**
+ * @fn int str2type(const char *str)
+ * @brief Returns the enum gw_type for its textual representation
+ * @param str Name of the type, e.g. "net". The case is ignored.
+ * @retval -1 if str is no known type
+ * @ingroup trans
+ */
+extern int str2type(const char *str);
+
+/**
+ * @fn int str2flags(const char *str, uint32_t *bits)
+ * @brief Parses a comma separated list of flag names of flags_array, e.g.
+ *        "can-fd", or a number into bits.
+ * @param str The flags. The case of the names is ignored.
+ * @retval 0 on success
+ * @retval -1 if str has an unknown flag
+ * @ingroup trans
+ */
+extern int str2flags(const char *str, uint32_t *bits);
 
 #endif
 
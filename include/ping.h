@@ -0,0 +1,58 @@
+/**
+ * @file ping.h
+ * @brief Control Area Network - Ethernet - Gateway - Ping Header (Utility)
+ * @details The ping command of cegwctl, a round trip probe of the control
+ *          channel built on ce_gw_ping().
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_PING_H__
+#define __CAN_ETH_GW_UTILS_PING_H__
+
+/** Data bytes of an echo if -s is not given, like ping(8) */
+#define PING_SIZE 56
+/** Outstanding echoes of --flood if -w is not given */
+#define PING_FLOOD_WINDOW 64
+/** Seconds until an echo is lost if -W is not given */
+#define PING_TIMEOUT 1.0
+
+/**
+ * @fn int ping_main(int argc, char *argv[])
+ * @brief Runs "ping [-c COUNT] [-i INTERVAL] [-s SIZE] [-W TIMEOUT]
+ *        [-w WINDOW] [--flood]" with argv[0] being "ping".
+ * @details Prints every reply like ping(8), or nothing in flood mode, and
+ *          at the end (COUNT echoes or SIGINT) the number of sent and
+ *          received echoes, min/avg/max/mdev and percentiles of the round
+ *          trip time and the rate.
+ * @retval EXIT_SUCCESS if every echo was answered
+ * @retval EXIT_FAILURE otherwise
+ * @ingroup files
+ */
+extern int ping_main(int argc, char *argv[]);
+
+#endif
+
+/**@}*/
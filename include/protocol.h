@@ -0,0 +1,80 @@
+/**
+ * @file protocol.h
+ * @brief Control Area Network - Ethernet - Gateway - Generic Netlink Protocol
+ * (Utility)
+ * @details The family, attributes and policy of CE_GW, shared by the
+ *          requests in netlink.c and the mock kernel in mock.c.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_PROTOCOL_H__
+#define __CAN_ETH_GW_UTILS_PROTOCOL_H__
+
+#include <netlink/attr.h>
+
+/**
+ * Netlink Family Settings
+ */
+#define GE_FAMILY_NAME "CE_GW"
+#define GE_FAMILY_VERSION 2
+/** First family version which knows CE_GW_A_SRC_IF and CE_GW_A_DST_IF */
+#define CE_GW_IFINDEX_VERSION 2
+#define USER_HDR_SIZE 0 /**< user header size */
+#define NO_FLAG 0
+#define IFACE_VERSION 0
+
+/**
+ * @enum
+ * @brief Data which can be send and received.
+ * @details Set int values as Identifiers for userspace application.
+ */
+enum {
+	CE_GW_A_UNSPEC, /**< Only a Dummy to skip index 0. */
+	CE_GW_A_DATA,	/**< NLA_STRING */
+	CE_GW_A_SRC,	/**< NLA_STRING */
+	CE_GW_A_DST,	/**< NLA_STRING */
+	CE_GW_A_ID,	/**< NLA_U32 */
+	CE_GW_A_FLAGS,	/**< NLA_U32 */
+	CE_GW_A_TYPE,	/**< NLA_U8 */
+	CE_GW_A_HNDL,	/**< NLA_U32 Handled Frames */
+	CE_GW_A_DROP,	/**< NLA_U32 Dropped Frames */
+	CE_GW_A_EVENT,	/**< NLA_U8 enum ce_gw_event_type */
+	CE_GW_A_TIME,	/**< NLA_U64 Kernel Time of an Event in ns */
+	CE_GW_A_SRC_IF,	/**< NLA_U32 Interface Index of CE_GW_A_SRC */
+	CE_GW_A_DST_IF,	/**< NLA_U32 Interface Index of CE_GW_A_DST */
+	__CE_GW_A_MAX,	/**< Maximum Number of Attribute plus 1 */
+};
+#define CE_GW_A_MAX (__CE_GW_A_MAX - 1) /**< Maximum Number of Attribute */
+
+
+/**
+ * @brief Netlink Policy - Defines the Type for the Netlink Attributes
+ */
+extern struct nla_policy ce_gw_genl_policy[CE_GW_A_MAX + 1];
+
+#endif
+
+/**@}*/
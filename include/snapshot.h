@@ -0,0 +1,123 @@
+/**
+ * @file snapshot.h
+ * @brief Control Area Network - Ethernet - Gateway - Snapshot Header
+ * (Utility)
+ * @details A binary snapshot of the devices and routes, written by
+ *          snapshot_save() and replayed by snapshot_restore() after a reboot
+ *          or module reload.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_SNAPSHOT_H__
+#define __CAN_ETH_GW_UTILS_SNAPSHOT_H__
+
+#include <stdint.h>
+#include "netlink.h"
+
+/** Magic of struct ce_gw_snap_header */
+#define CE_GW_SNAP_MAGIC "CGSN"
+/** Version of the snapshot format. Incremented on incompatible changes, new
+ * fields are appended to the record and increase record_size. */
+#define CE_GW_SNAP_VERSION 1
+/** Default window of snapshot_restore(). The ACKs of one window must fit
+ * into the receive buffer (CE_GW_RCVBUF). */
+#define CE_GW_SNAP_WINDOW 1024
+
+/**
+ * @struct ce_gw_snap_header
+ * @brief Start of a snapshot. It is followed by n_devs device records and
+ *        n_routes route records of record_size bytes each. All values are
+ *        in the byte order of the host which wrote them, see byte_order.
+ */
+struct ce_gw_snap_header {
+	char magic[4];		/**< CE_GW_SNAP_MAGIC, not \0 terminated */
+	uint16_t version;	/**< CE_GW_SNAP_VERSION */
+	uint16_t header_size;	/**< sizeof(struct ce_gw_snap_header) */
+	uint32_t byte_order;	/**< CE_GW_BIN_BYTE_ORDER */
+	uint16_t record_size;	/**< sizeof(struct ce_gw_snap_record) */
+	uint16_t reserved;	/**< 0 */
+	uint32_t n_devs;	/**< number of device records */
+	uint32_t n_routes;	/**< number of route records */
+	uint32_t crc;		/**< CRC-32 of the header (with crc 0) and
+				 * the records */
+	uint32_t reserved2;	/**< 0 */
+};
+
+/**
+ * @struct ce_gw_snap_record
+ * @brief A device (empty src, the name in dst) or a route of a snapshot.
+ *        Fixed layout without implicit padding, so the records can be used
+ *        directly from the mmap()ed file.
+ */
+struct ce_gw_snap_record {
+	uint32_t flags;		/**< see F_CAN_FD */
+	uint8_t type;		/**< enum gw_type */
+	uint8_t reserved[3];	/**< 0 */
+	char src[IFNAMSIZ];	/**< name of the src device, \0 padded */
+	char dst[IFNAMSIZ];	/**< name of the dst device, \0 padded */
+};
+
+/**
+ * @fn int snapshot_save(struct cegw_ctx *ctx, const char *path)
+ * @brief Writes the devices and routes of the kernel to a snapshot file.
+ * @details The routes are dumped once. The kernel can not list devices, so
+ *          every device a route uses is saved, except the CAN devices
+ *          (ARPHRD_CAN in /sys/class/net), with the type and flags of the
+ *          first route that uses it, which gives it the same MTU. The file
+ *          is written to PATH.tmp and renamed, so PATH is always complete.
+ * @param ctx The context the dump is sent over.
+ * @param path The file name.
+ * @retval 0 on success
+ * @retval <0 -errno or libnl error code on failure
+ * @ingroup files
+ */
+extern int snapshot_save(struct cegw_ctx *ctx, const char *path);
+
+/**
+ * @fn int snapshot_restore(struct cegw_ctx *ctx, const char *path,
+ *                          unsigned int window)
+ * @brief Adds the devices and routes of a snapshot file.
+ * @details The file is mmap()ed and checked (magic, version, byte order,
+ *          size and CRC) before anything is sent. Then the devices and the
+ *          routes are sent pipelined with ce_gw_batch(), the devices first
+ *          on the same socket, so they exist before their routes. A device
+ *          which exists already is not an error. The number of operations
+ *          and the time are printed to stdout, failed operations to stderr.
+ * @param ctx The context the adds are sent over.
+ * @param path The file name.
+ * @param window Maximum number of outstanding messages, e.g.
+ *        CE_GW_SNAP_WINDOW.
+ * @retval 0 if everything was restored
+ * @retval >0 number of failed operations
+ * @retval <0 if the file is invalid or the socket failed
+ * @ingroup files
+ */
+extern int snapshot_restore(struct cegw_ctx *ctx, const char *path,
+                            unsigned int window);
+
+#endif
+
+/**@}*/
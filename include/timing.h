@@ -0,0 +1,157 @@
+/**
+ * @file timing.h
+ * @brief Control Area Network - Ethernet - Gateway - Timing Header (Utility)
+ * @details Time of the phases of the netlink requests, enabled by --timing.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_TIMING_H__
+#define __CAN_ETH_GW_UTILS_TIMING_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @enum timing_cmd
+ * @brief The requests whose phases are timed.
+ */
+enum timing_cmd {
+	TIMING_C_ECHO,		/**< CE_GW_C_ECHO */
+	TIMING_C_ADD,		/**< CE_GW_C_ADD */
+	TIMING_C_DEL,		/**< CE_GW_C_DEL */
+	TIMING_C_LIST,		/**< CE_GW_C_LIST */
+	TIMING_C_FAMILY,	/**< CTRL_CMD_GETFAMILY, see fam_resolve() */
+	TIMING_C_BATCH,		/**< the ACKs of ce_gw_batch(), which are
+				 * received together */
+	__TIMING_C_MAX,		/**< Maximum Command Number plus 1 */
+};
+
+/**
+ * @enum timing_phase
+ * @brief The phases of a request.
+ */
+enum timing_phase {
+	TIMING_P_ALLOC,		/**< nlmsg_alloc() */
+	TIMING_P_ENCODE,	/**< genlmsg_put() and the attributes */
+	TIMING_P_VALIDATE,	/**< genlmsg_validate() */
+	TIMING_P_SEND,		/**< nl_send_auto() */
+	TIMING_P_WAIT,		/**< nl_wait_for_ack() */
+	TIMING_P_RECV,		/**< nl_recvmsgs(), including the callbacks */
+	TIMING_P_CALLBACK,	/**< our callbacks within nl_recvmsgs() */
+	__TIMING_P_MAX,		/**< Maximum Phase Number plus 1 */
+};
+
+/** != 0 if the phases are timed, see timing_init() */
+extern int timing_enabled;
+
+/** Takes a time stamp into stamp, if timing is enabled. */
+#define TIMING_STAMP(stamp) do { \
+		if (timing_enabled) \
+			(stamp) = timing_now(); \
+	} while (0)
+
+/** Opens the record of a request of cmd, see timing_begin(), and takes a
+ * time stamp into stamp, if timing is enabled. */
+#define TIMING_BEGIN(cmd, stamp) do { \
+		if (timing_enabled) { \
+			timing_begin(cmd); \
+			(stamp) = timing_now(); \
+		} \
+	} while (0)
+
+/** Records the time since stamp as phase of cmd and takes a new time stamp,
+ * if timing is enabled. */
+#define TIMING_PHASE(cmd, phase, stamp) do { \
+		if (timing_enabled) \
+			timing_phase(cmd, phase, &(stamp)); \
+	} while (0)
+
+/** Closes the record of the request of cmd, see timing_end(), if timing is
+ * enabled. */
+#define TIMING_END(cmd, seq, err) do { \
+		if (timing_enabled) \
+			timing_end(cmd, seq, err); \
+	} while (0)
+
+/**
+ * @fn int timing_init(const char *trace_path)
+ * @brief Enables timing. The summary is printed to stderr at exit.
+ * @param trace_path If not NULL, a line for every request is written to
+ *        this file, see timing_end().
+ * @retval 0 on success
+ * @retval <0 -errno if the trace file could not be opened
+ * @ingroup trans
+ */
+extern int timing_init(const char *trace_path);
+
+/**
+ * @fn uint64_t timing_now(void)
+ * @brief Returns the monotonic time in ns.
+ * @ingroup trans
+ */
+extern uint64_t timing_now(void);
+
+/**
+ * @fn void timing_begin(enum timing_cmd cmd)
+ * @brief Opens the record of a request of cmd, unless one is open already,
+ *        e.g. because the message was built before. Use TIMING_BEGIN().
+ * @details The open records belong to the calling thread, the summary and
+ *          the trace file are shared by all threads.
+ * @ingroup trans
+ */
+extern void timing_begin(enum timing_cmd cmd);
+
+/**
+ * @fn void timing_phase(enum timing_cmd cmd, enum timing_phase phase,
+ *                       uint64_t *stamp)
+ * @brief Adds the time since *stamp to phase of cmd and to the open record
+ *        of cmd, and sets *stamp to now. Use TIMING_PHASE().
+ * @ingroup trans
+ */
+extern void timing_phase(enum timing_cmd cmd, enum timing_phase phase,
+                         uint64_t *stamp);
+
+/**
+ * @fn void timing_end(enum timing_cmd cmd, uint32_t seq, int err)
+ * @brief Closes the open record of cmd and writes it to the trace file.
+ *        Use TIMING_END().
+ * @param seq sequence number of the request
+ * @param err result of the request
+ * @ingroup trans
+ */
+extern void timing_end(enum timing_cmd cmd, uint32_t seq, int err);
+
+/**
+ * @fn void timing_summary(FILE *file)
+ * @brief Prints count, total, min, mean and max of every phase of every
+ *        command that occurred.
+ * @ingroup trans
+ */
+extern void timing_summary(FILE *file);
+
+#endif
+
+/**@}*/
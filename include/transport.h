@@ -0,0 +1,108 @@
+/**
+ * @file transport.h
+ * @brief Control Area Network - Ethernet - Gateway - Transport Header
+ * (Utility)
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_TRANSPORT_H__
+#define __CAN_ETH_GW_UTILS_TRANSPORT_H__
+
+#include <netlink/netlink.h>
+#include <netlink/handlers.h>
+
+struct ifcache;
+
+/** Environment variable which selects the transport ("netlink", "mock") */
+#define TRANSPORT_ENV "CEGW_TRANSPORT"
+
+/**
+ * @struct ce_gw_transport
+ * @brief Carries the messages of a libnl socket, either to the kernel or to
+ *        a replacement of it.
+ * @details The messages are built and parsed with libnl in both cases. A
+ *          transport which does not use the kernel overrides send and
+ *          receive of the callbacks (see nl_cb_overwrite_send()), so the
+ *          sequence numbers, ACKs, errors and multipart messages are handled
+ *          by libnl exactly as with the kernel.
+ */
+struct ce_gw_transport {
+	const char *name;	/**< name for TRANSPORT_ENV */
+	int cache_family;	/**< the family ID may be cached (famcache.h) */
+
+	/**
+	 * @brief connects sk. Replaces genl_connect().
+	 * @retval 0 on success
+	 * @retval <0 libnl error code on failure
+	 */
+	int (*open)(struct nl_sock *sk);
+
+	/** @brief disconnects sk. Replaces nl_close(). */
+	void (*close)(struct nl_sock *sk);
+
+	/** @brief prepares a callback set which is used with sk, e.g.
+	 *         installs the send and receive overrides. May be NULL. */
+	void (*setup_cb)(struct nl_cb *cb);
+
+	/**
+	 * @brief adds the network devices to c (ifcache_add()), on the first
+	 *        lookup of a context and again after a miss or a stale
+	 *        index. May be NULL, then only names are sent.
+	 * @retval 0 on success
+	 * @retval <0 on failure
+	 */
+	int (*links)(struct ifcache *c);
+};
+
+/** The generic netlink socket to the ce_gw kernel module */
+extern const struct ce_gw_transport netlink_transport;
+/** The mock kernel in this process (mock.c) */
+extern const struct ce_gw_transport mock_transport;
+
+/**
+ * @fn const struct ce_gw_transport *transport_select(const char *name)
+ * @brief Returns the transport of a name, used by cegw_ctx_alloc().
+ * @param name "netlink" or "mock". NULL selects TRANSPORT_ENV or, if it is
+ *        not set, "netlink".
+ * @retval NULL if there is no transport of this name
+ * @ingroup net
+ */
+extern const struct ce_gw_transport *transport_select(const char *name);
+
+/**
+ * @fn struct nl_cb *transport_cb_alloc(const struct ce_gw_transport *t,
+ *                                      enum nl_cb_kind kind)
+ * @brief Like nl_cb_alloc(), but prepared for the transport t. Every
+ *        callback set passed to nl_recvmsgs() must be allocated with it.
+ * @retval NULL on failure
+ * @ingroup net
+ */
+extern struct nl_cb *transport_cb_alloc(const struct ce_gw_transport *t,
+                                        enum nl_cb_kind kind);
+
+#endif
+
+/**@}*/
@@ -0,0 +1,91 @@
+/**
+ * @file watch.h
+ * @brief Control Area Network - Ethernet - Gateway - Route Statistics Header
+ * (Utility)
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ * @{
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#ifndef __CAN_ETH_GW_UTILS_WATCH_H__
+#define __CAN_ETH_GW_UTILS_WATCH_H__
+
+#include <stdint.h>
+#include "netlink.h"
+
+#define WATCH_INTERVAL 1.0 /**< Default interval of --watch in seconds */
+
+/**
+ * @struct route_stat
+ * @brief The statistics of one route between two samples.
+ */
+struct route_stat {
+	struct ce_gw_route route;	/**< last sample (32 bit counters) */
+	uint64_t handled;		/**< handled frames (64 bit) */
+	uint64_t dropped;		/**< dropped frames (64 bit) */
+	double handled_rate;		/**< frames/s of the last interval */
+	double dropped_rate;		/**< drops/s of the last interval */
+};
+
+/**
+ * @struct stat_table
+ * @brief Hash table of struct route_stat with the route id as key.
+ */
+struct stat_table {
+	struct route_stat *stats;	/**< open addressing, id 0 is empty */
+	size_t len;			/**< number of routes */
+	size_t size;			/**< size of stats, a power of 2 */
+};
+
+/**
+ * @fn int ce_gw_watch(struct cegw_ctx *ctx, uint32_t id,
+ *                     const struct ce_gw_route_filter *filter,
+ *                     double interval, int once, unsigned int format)
+ * @brief Lists the routes every interval and prints frames/s, drops/s and
+ *        the drop ratio of each route, sorted by frames/s like top(1).
+ * @details The request is built once and sent again for every sample. The
+ *          32 bit counters of the kernel are extended to 64 bit, a wrap
+ *          between two samples is detected by the unsigned difference.
+ * @param ctx The context the requests are sent over.
+ * @param id 0 for all routes, else the route id you want.
+ * @param filter Only the routes selected by filter are watched, NULL for
+ *        all. See ce_gw_lister_filter().
+ * @param interval Seconds between two samples.
+ * @param once If set, two samples are taken, the result is printed once and
+ *             the function returns (--delta). Otherwise it runs until it is
+ *             interrupted (--watch).
+ * @param format FORMAT_TEXT for a table, FORMAT_JSON or FORMAT_CSV for one
+ *        record per route and sample, optionally ored with
+ *        FORMAT_NO_HEADER. FORMAT_BIN is not supported.
+ * @retval 0 on success
+ * @retval <0 on failure, -EINVAL for FORMAT_BIN
+ * @ingroup net
+ */
+extern int ce_gw_watch(struct cegw_ctx *ctx, uint32_t id,
+                       const struct ce_gw_route_filter *filter,
+                       double interval, int once, unsigned int format);
+
+#endif
+
+/**@}*/
@@ -0,0 +1,332 @@
+/**
+ * @file apply.c
+ * @brief Control Area Network - Ethernet - Gateway - Apply (Utility)
+ * @details Diffs a desired set of devices and routes with the routes of the
+ *          kernel and sends only the needed adds and dels.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "netlink.h"
+#include "batch.h"
+#include "apply.h"
+
+/**
+ * @struct apply_key
+ * @brief An entry of the hash table of apply_file(): a route key with the
+ *        number of desired and matched routes, or a device name.
+ */
+struct apply_key {
+	const struct ce_gw_op *op;	/**< first desired op with this key, NULL
+					 * for a free slot */
+	uint32_t hash;			/**< hash of the key */
+	unsigned int want;		/**< number of desired routes */
+	unsigned int have;		/**< current routes matched so far */
+};
+
+/**
+ * @struct apply_table
+ * @brief Open addressing hash table of struct apply_key.
+ */
+struct apply_table {
+	struct apply_key *keys;	/**< the slots */
+	size_t mask;		/**< number of slots - 1, a power of 2 */
+};
+
+/**
+ * @fn uint32_t hash_str(uint32_t hash, const char *str)
+ * @brief Continues the FNV-1a hash with str including its \0.
+ * @ingroup files
+ */
+static uint32_t hash_str(uint32_t hash, const char *str)
+{
+	do {
+		hash = (hash ^ (uint8_t) *str) * 16777619u;
+	} while (*str++ != '\0');
+
+	return hash;
+}
+
+/**
+ * @fn uint32_t key_hash(const char *src, const char *dst, uint8_t type,
+ *                       uint32_t flags)
+ * @brief Hash of a route key. A device has the name as dst and no src.
+ * @ingroup files
+ */
+static uint32_t key_hash(const char *src, const char *dst, uint8_t type,
+                         uint32_t flags)
+{
+	uint32_t hash = hash_str(hash_str(2166136261u, src), dst);
+
+	hash = (hash ^ type) * 16777619u;
+	for (int i = 0; i < 4; ++i)
+		hash = (hash ^ ((flags >> (i * 8)) & 0xff)) * 16777619u;
+
+	return hash;
+}
+
+/**
+ * @fn int table_init(struct apply_table *table, size_t n)
+ * @brief Allocates a table for n keys, at most half of the slots are used.
+ * @retval 0 on success
+ * @retval -ENOMEM on failure
+ * @ingroup files
+ */
+static int table_init(struct apply_table *table, size_t n)
+{
+	size_t size = 16;
+
+	while (size < n * 2)
+		size *= 2;
+
+	table->keys = calloc(size, sizeof(*table->keys));
+	table->mask = size - 1;
+
+	return table->keys ? 0 : -ENOMEM;
+}
+
+/**
+ * @fn struct apply_key *table_find(struct apply_table *table, const char *src,
+ *                                  const char *dst, uint8_t type,
+ *                                  uint32_t flags, int dev)
+ * @brief Returns the slot of a route key or, for dev, of a device name.
+ *        Devices only match devices, their type and flags are ignored.
+ * @returns the slot with the key or the free slot for it
+ * @ingroup files
+ */
+static struct apply_key *table_find(struct apply_table *table,
+                                    const char *src, const char *dst,
+                                    uint8_t type, uint32_t flags, int dev)
+{
+	uint32_t hash = dev ? key_hash("", dst, 0, 0)
+	                : key_hash(src, dst, type, flags);
+	size_t i = hash & table->mask;
+
+	for (;; i = (i + 1) & table->mask) {
+		struct apply_key *key = &table->keys[i];
+		const struct ce_gw_op *op = key->op;
+
+		if (op == NULL) {
+			key->hash = hash;
+			return key;
+		}
+
+		if (key->hash != hash || strcmp(op->dst, dst) != 0 ||
+		    (op->src[0] == '\0') != dev)
+			continue;
+		if (dev || (strcmp(op->src, src) == 0 && op->type == type &&
+		            op->flags == flags))
+			return key;
+	}
+}
+
+/**
+ * @fn int op_list_push(struct ce_gw_op_list *plan, const struct ce_gw_op *op)
+ * @brief Appends a copy of op to plan.
+ * @retval 0 on success
+ * @retval -ENOMEM on failure
+ * @ingroup files
+ */
+static int op_list_push(struct ce_gw_op_list *plan, const struct ce_gw_op *op)
+{
+	if (plan->len == plan->size) {
+		size_t size = plan->size ? plan->size * 2 : 256;
+		struct ce_gw_op *ops = realloc(plan->ops, size * sizeof(*ops));
+		if (ops == NULL)
+			return -ENOMEM;
+
+		plan->ops = ops;
+		plan->size = size;
+	}
+
+	plan->ops[plan->len++] = *op;
+	return 0;
+}
+
+/**
+ * @fn void op_print(FILE *file, const struct ce_gw_op *op,
+ *                    const struct ce_gw_route_table *cur)
+ * @brief Prints op in the syntax of a batch line, dels with their route.
+ * @details A del only carries the ID (a DST would delete a device), its line
+ *          is the index + 1 of the route in cur.
+ * @ingroup files
+ */
+static void op_print(FILE *file, const struct ce_gw_op *op,
+                     const struct ce_gw_route_table *cur)
+{
+	const char *type = enum2str(op->type, type_array, TYPE_MAX);
+	char flags[256];
+
+	if (op->cmd == CE_GW_C_DEL) {
+		const struct ce_gw_route *r = &cur->routes[op->line - 1];
+
+		type = enum2str(r->type, type_array, TYPE_MAX);
+		flags2str(r->flags, flags_array, flags, sizeof(flags));
+		fprintf(file, "del route %u # %s %s %s %s\n", op->id, r->src,
+		        r->dst, type ? type : "?", flags);
+	} else if (op->src[0] == '\0')
+		fprintf(file, "add dev %s\n", op->dst);
+	else
+		fprintf(file, "-t %s%s add route %s %s\n", type ? type : "?",
+		        op->flags & F_CAN_FD ? " -f" : "", op->src, op->dst);
+}
+
+int apply_file(struct cegw_ctx *ctx, const char *path, unsigned int window,
+               uint8_t type, uint32_t flags, int bidirectional, int dry_run)
+{
+	struct ce_gw_op_list want = { NULL, 0, 0 };
+	struct ce_gw_op_list plan = { NULL, 0, 0 };
+	struct ce_gw_op_list del_ops = { NULL, 0, 0 };
+	struct ce_gw_route_table cur = { NULL, 0, 0 };
+	struct apply_table table = { NULL, 0 };
+	size_t adds = 0, dels = 0, unchanged = 0;
+	int failed;
+	int err;
+
+	failed = batch_parse_file("apply", path, type, flags, bidirectional,
+	                          &want);
+	if (failed < 0)
+		return failed;
+
+	for (size_t i = 0; i < want.len; ++i) {
+		struct ce_gw_op *op = &want.ops[i];
+
+		if (op->cmd != CE_GW_C_ADD || strchr(op->dst, '%') != NULL) {
+			fprintf(stderr, "apply: line %u: Only add route and "
+			        "add dev NAME are allowed\n", op->line);
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+	err = table_init(&table, want.len);
+	if (err == 0)
+		err = ce_gw_list_table(ctx, 0, &cur);
+	if (err != 0) {
+		fprintf(stderr, "apply: Can not get the current routes: %d\n",
+		        err);
+		goto out;
+	}
+
+	/* the desired routes and devices */
+	for (size_t i = 0; i < want.len; ++i) {
+		struct ce_gw_op *op = &want.ops[i];
+		struct apply_key *key = table_find(&table, op->src, op->dst,
+		                                   op->type, op->flags,
+		                                   op->src[0] == '\0');
+		if (key->op == NULL)
+			key->op = op;
+		key->want++;
+	}
+
+	/* a current route is kept if it is still wanted, its devices exist */
+	for (size_t i = 0; i < cur.len; ++i) {
+		struct ce_gw_route *r = &cur.routes[i];
+		struct apply_key *key = table_find(&table, r->src, r->dst,
+		                                   r->type, r->flags, 0);
+
+		if (key->op != NULL && key->have < key->want) {
+			key->have++;
+			unchanged++;
+		} else {
+			struct ce_gw_op op = {
+				.cmd = CE_GW_C_DEL, .id = r->id, .line = i + 1,
+			};
+			if (op_list_push(&del_ops, &op) != 0)
+				goto nomem;
+			dels++;
+		}
+
+		for (int d = 0; d < 2; ++d) {
+			key = table_find(&table, "", d ? r->dst : r->src, 0, 0,
+			                 1);
+			if (key->op != NULL)
+				key->have = key->want;
+		}
+	}
+
+	/* adds in the order of the file, before the dels */
+	for (size_t i = 0; i < want.len; ++i) {
+		struct ce_gw_op *op = &want.ops[i];
+		struct apply_key *key = table_find(&table, op->src, op->dst,
+		                                   op->type, op->flags,
+		                                   op->src[0] == '\0');
+
+		if (key->have > 0) {
+			key->have--;
+			continue;
+		}
+		if (op_list_push(&plan, op) != 0)
+			goto nomem;
+		if (op->src[0] == '\0')
+			key->have = key->want; /* a device once */
+		adds++;
+	}
+	for (size_t i = 0; i < del_ops.len; ++i) {
+		if (op_list_push(&plan, &del_ops.ops[i]) != 0)
+			goto nomem;
+	}
+
+	if (dry_run) {
+		for (size_t i = 0; i < plan.len; ++i)
+			op_print(stdout, &plan.ops[i], &cur);
+	} else {
+		err = ce_gw_batch(ctx, plan.ops, plan.len, window);
+	}
+
+	for (size_t i = 0; !dry_run && i < plan.len; ++i) {
+		struct ce_gw_op *op = &plan.ops[i];
+
+		if (op->err == 0 || (op->err == -EEXIST && op->src[0] == '\0'))
+			continue;
+
+		fprintf(stderr, "apply: %s failed: %s: ", op->cmd == CE_GW_C_ADD
+		        ? "add" : "del", strerror(-op->err));
+		op_print(stderr, op, &cur);
+		failed++;
+	}
+
+	printf("apply: %zu unchanged, %zu adds, %zu dels%s\n", unchanged,
+	       adds, dels, dry_run ? " (dry run)" : "");
+
+	if (err == 0)
+		err = failed;
+
+out:
+	ce_gw_route_table_free(&cur);
+	batch_op_list_free(&plan);
+	batch_op_list_free(&del_ops);
+	batch_op_list_free(&want);
+	free(table.keys);
+	return err;
+
+nomem:
+	fprintf(stderr, "apply: Out of memory\n");
+	err = -ENOMEM;
+	goto out;
+}
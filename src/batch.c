@@ -0,0 +1,491 @@
+/**
+ * @file batch.c
+ * @brief Control Area Network - Ethernet - Gateway - Batch (Utility)
+ * @details Reads many commands from a file and sends them pipelined with
+ *          ce_gw_batch(), optionally sharded over several threads with an
+ *          own context each.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include "netlink.h"
+#include "batch.h"
+
+#define BATCH_MAX_ARGS 16 /**< maximum number of words in one line */
+
+/**
+ * @enum batch_stage
+ * @brief The kinds of operations that run in separate stages of a parallel
+ *        batch, see batch_run_stages().
+ */
+enum batch_stage {
+	BATCH_STAGE_DEV,	/**< add or del dev, run by one worker */
+	BATCH_STAGE_ADD,	/**< add route, sharded */
+	BATCH_STAGE_DEL,	/**< del route, sharded */
+};
+
+/**
+ * @struct batch_worker
+ * @brief A thread of a parallel batch with its own context.
+ */
+struct batch_worker {
+	pthread_t thread;
+	int started;		/**< != 0 if thread runs the current stage */
+	struct cegw_ctx *ctx;	/**< the context of the worker */
+	unsigned int window;	/**< window of ce_gw_batch() */
+	struct ce_gw_op *ops;	/**< the operations of the current stage */
+	size_t n;		/**< number of operations in ops */
+	size_t done;		/**< operations of all stages so far */
+	double sec;		/**< time spent in ce_gw_batch() */
+	int err;		/**< the last error of ce_gw_batch() */
+};
+
+/**
+ * @fn struct ce_gw_op *op_list_new(struct ce_gw_op_list *list)
+ * @brief Appends a zeroed operation to list.
+ * @retval NULL if the allocation failed
+ * @ingroup files
+ */
+static struct ce_gw_op *op_list_new(struct ce_gw_op_list *list)
+{
+	if (list->len == list->size) {
+		size_t size = list->size ? list->size * 2 : 256;
+		struct ce_gw_op *ops = realloc(list->ops, size * sizeof(*ops));
+		if (ops == NULL)
+			return NULL;
+
+		list->ops = ops;
+		list->size = size;
+	}
+
+	struct ce_gw_op *op = &list->ops[list->len++];
+	memset(op, 0, sizeof(*op));
+	return op;
+}
+
+/**
+ * @fn int copy_name(char *dst, const char *src)
+ * @brief Copies the interface name src to dst (IFNAMSIZ bytes)
+ * @retval -EINVAL if the name is too long
+ * @ingroup files
+ */
+static int copy_name(char *dst, const char *src)
+{
+	if (strlen(src) >= IFNAMSIZ)
+		return -EINVAL;
+
+	strcpy(dst, src);
+	return 0;
+}
+
+int batch_parse_line(char *line, unsigned int lineno, uint8_t type,
+                     uint32_t flags, int bidirectional,
+                     struct ce_gw_op_list *list)
+{
+	char *argv[BATCH_MAX_ARGS];
+	int argc = 0;
+	char *save = NULL;
+	char *word;
+	struct ce_gw_op *op;
+	size_t start = list->len;
+
+	/* split into words */
+	for (word = strtok_r(line, " \t\r\n", &save); word != NULL;
+	     word = strtok_r(NULL, " \t\r\n", &save)) {
+		if (word[0] == '#')
+			break;
+		if (argc == BATCH_MAX_ARGS)
+			return -EINVAL;
+		argv[argc++] = word;
+	}
+
+	int i = 0;
+
+	/* options */
+	for (; i < argc && argv[i][0] == '-'; ++i) {
+		const char *opt = argv[i];
+		const char *arg = NULL;
+
+		if (!strcmp(opt, "-b") || !strcmp(opt, "--bidirectional")) {
+			bidirectional = 1;
+		} else if (!strcmp(opt, "-f") || !strcmp(opt, "--can-fd")) {
+			flags |= F_CAN_FD;
+		} else if (!strncmp(opt, "--type=", 7)) {
+			arg = opt + 7;
+		} else if ((!strcmp(opt, "-t") || !strcmp(opt, "--type")) &&
+		           i + 1 < argc) {
+			arg = argv[++i];
+		} else {
+			return -EINVAL;
+		}
+
+		if (arg != NULL) {
+			int t = str2type(arg);
+			if (t < 0)
+				return -EINVAL;
+			type = t;
+		}
+	}
+
+	argc -= i;
+	char **args = &argv[i];
+
+	if (argc == 0) /* empty line or comment */
+		return 0;
+
+	if (argc < 2)
+		return -EINVAL;
+
+	/* add route SRC DST */
+	if (!strcmp(args[0], "add") && !strcmp(args[1], "route") &&
+	    argc == 4) {
+
+		for (int dir = 0; dir <= bidirectional; ++dir) {
+			op = op_list_new(list);
+			if (op == NULL)
+				return -ENOMEM;
+
+			op->cmd = CE_GW_C_ADD;
+			op->type = type;
+			op->flags = flags;
+			op->line = lineno;
+			if (copy_name(op->src, args[dir ? 3 : 2]) != 0 ||
+			    copy_name(op->dst, args[dir ? 2 : 3]) != 0)
+				goto invalid;
+		}
+
+		/* add dev [NAME] */
+	} else if (!strcmp(args[0], "add") && !strcmp(args[1], "dev") &&
+	           argc <= 3) {
+
+		op = op_list_new(list);
+		if (op == NULL)
+			return -ENOMEM;
+
+		op->cmd = CE_GW_C_ADD;
+		op->type = type;
+		op->flags = flags;
+		op->line = lineno;
+		if (copy_name(op->dst, argc == 3 ? args[2] : "cegw%d") != 0)
+			goto invalid;
+
+		/* del route ID */
+	} else if (!strcmp(args[0], "del") && !strcmp(args[1], "route") &&
+	           argc == 3) {
+
+		char *end;
+		errno = 0;
+		uintmax_t num = strtoumax(args[2], &end, 0);
+		if (errno != 0 || *end != '\0' || num == 0 ||
+		    num > UINT32_MAX)
+			return -EINVAL;
+
+		op = op_list_new(list);
+		if (op == NULL)
+			return -ENOMEM;
+
+		op->cmd = CE_GW_C_DEL;
+		op->id = (uint32_t) num;
+		op->line = lineno;
+
+		/* del dev NAME */
+	} else if (!strcmp(args[0], "del") && !strcmp(args[1], "dev") &&
+	           argc == 3) {
+
+		op = op_list_new(list);
+		if (op == NULL)
+			return -ENOMEM;
+
+		op->cmd = CE_GW_C_DEL;
+		op->line = lineno;
+		if (copy_name(op->dst, args[2]) != 0)
+			goto invalid;
+
+	} else {
+		return -EINVAL;
+	}
+
+	return 0;
+
+invalid:
+	/* drop the operations of this line */
+	list->len = start;
+	return -EINVAL;
+}
+
+/**
+ * @fn double elapsed(const struct timespec *start)
+ * @brief Returns the seconds since start.
+ * @ingroup files
+ */
+static double elapsed(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) +
+	       (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * @fn enum batch_stage op_stage(const struct ce_gw_op *op)
+ * @brief Returns the stage op belongs to.
+ * @ingroup files
+ */
+static enum batch_stage op_stage(const struct ce_gw_op *op)
+{
+	if (op->src[0] == '\0' && op->id == 0)
+		return BATCH_STAGE_DEV;
+
+	return op->cmd == CE_GW_C_ADD ? BATCH_STAGE_ADD : BATCH_STAGE_DEL;
+}
+
+/**
+ * @fn void *batch_work(void *arg)
+ * @brief Runs the operations of the current stage of a batch_worker.
+ * @ingroup files
+ */
+static void *batch_work(void *arg)
+{
+	struct batch_worker *w = arg;
+	struct timespec start;
+	int err;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	err = ce_gw_batch(w->ctx, w->ops, w->n, w->window);
+	w->sec += elapsed(&start);
+	w->done += w->n;
+	if (err != 0)
+		w->err = err;
+
+	return NULL;
+}
+
+/**
+ * @fn int batch_run_stages(struct batch_worker *workers, unsigned int jobs,
+ *                          struct ce_gw_op *ops, size_t n)
+ * @brief Runs ops over the contexts of jobs workers.
+ * @details The operations are cut into stages of consecutive device adds
+ *          and dels, route adds and route dels. A stage starts when the
+ *          previous one is acknowledged completely, so a device exists
+ *          before the routes of the following lines use it and a route is
+ *          added before a later line deletes it. Device stages are run by
+ *          the first worker in file order, route stages are cut into jobs
+ *          contiguous shards. With one worker all ops are one stage, like
+ *          ce_gw_batch().
+ * @retval 0 if all workers could send all operations
+ * @retval <0 the error of a failed ce_gw_batch()
+ * @ingroup files
+ */
+static int batch_run_stages(struct batch_worker *workers, unsigned int jobs,
+                            struct ce_gw_op *ops, size_t n)
+{
+	size_t end;
+	int err = 0;
+
+	for (size_t start = 0; start < n; start = end) {
+		enum batch_stage stage = op_stage(&ops[start]);
+		unsigned int used = stage == BATCH_STAGE_DEV ? 1 : jobs;
+
+		end = start + 1;
+		while (end < n && (jobs == 1 || op_stage(&ops[end]) == stage))
+			end++;
+
+		if (used > end - start)
+			used = end - start;
+		size_t count = end - start;
+		size_t first = start;
+
+		/* near-equal shards, the first count % used get one more op */
+		for (unsigned int i = 0; i < used; ++i) {
+			workers[i].ops = &ops[first];
+			workers[i].n = count / used + (i < count % used);
+			first += workers[i].n;
+		}
+
+		/* the first shard is run by this thread */
+		for (unsigned int i = 1; i < used; ++i) {
+			workers[i].started = pthread_create(&workers[i].thread,
+			                                    NULL, batch_work,
+			                                    &workers[i]) == 0;
+			if (!workers[i].started)
+				batch_work(&workers[i]);
+		}
+		batch_work(&workers[0]);
+		for (unsigned int i = 1; i < used; ++i) {
+			if (workers[i].started)
+				pthread_join(workers[i].thread, NULL);
+		}
+
+		for (unsigned int i = 0; i < used; ++i) {
+			if (workers[i].err != 0)
+				err = workers[i].err;
+		}
+	}
+
+	return err;
+}
+
+void batch_op_list_free(struct ce_gw_op_list *list)
+{
+	free(list->ops);
+	list->ops = NULL;
+	list->len = 0;
+	list->size = 0;
+}
+
+int batch_parse_file(const char *prog, const char *path, uint8_t type,
+                     uint32_t flags, int bidirectional,
+                     struct ce_gw_op_list *list)
+{
+	FILE *file;
+	char *line = NULL;
+	size_t line_size = 0;
+	unsigned int lineno = 0;
+	int failed = 0;
+	int err;
+
+	if (!strcmp(path, "-")) {
+		file = stdin;
+	} else {
+		file = fopen(path, "r");
+		if (file == NULL) {
+			err = -errno;
+			fprintf(stderr, "%s: Can not open %s: %s\n", prog,
+			        path, strerror(errno));
+			return err;
+		}
+	}
+
+	while (getline(&line, &line_size, file) != -1) {
+		lineno++;
+
+		err = batch_parse_line(line, lineno, type, flags,
+		                       bidirectional, list);
+		if (err == -ENOMEM) {
+			fprintf(stderr, "%s: Out of memory in line %u\n",
+			        prog, lineno);
+			failed = -ENOMEM;
+			break;
+		} else if (err != 0) {
+			fprintf(stderr, "%s: line %u: Syntax error\n",
+			        prog, lineno);
+			failed++;
+		}
+	}
+
+	free(line);
+	if (file != stdin)
+		fclose(file);
+
+	return failed;
+}
+
+int batch_run_file(struct cegw_ctx *ctx, const char *path,
+                   unsigned int window, unsigned int jobs, uint8_t type,
+                   uint32_t flags, int bidirectional)
+{
+	struct ce_gw_op_list list = { NULL, 0, 0 };
+	struct batch_worker *workers;
+	unsigned int failed = 0;
+	struct timespec start;
+	int err;
+
+	workers = calloc(jobs, sizeof(*workers));
+	if (workers == NULL)
+		return -ENOMEM;
+
+	for (unsigned int i = 0; i < jobs; ++i) {
+		workers[i].window = window;
+		workers[i].ctx = i == 0 ? ctx : cegw_ctx_alloc();
+		if (workers[i].ctx == NULL) {
+			fprintf(stderr, "batch: Can not open the socket of "
+			        "worker %u\n", i);
+			err = -EIO;
+			goto out_workers;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	/* parse the whole file */
+	err = batch_parse_file("batch", path, type, flags, bidirectional,
+	                       &list);
+	if (err < 0)
+		goto out;
+	failed = err;
+
+	/* send */
+	err = batch_run_stages(workers, jobs, list.ops, list.len);
+
+	/* report the failed lines, a line is counted only once */
+	unsigned int last_line = 0;
+	for (size_t i = 0; i < list.len; ++i) {
+		struct ce_gw_op *op = &list.ops[i];
+		if (op->err == 0)
+			continue;
+
+		fprintf(stderr, "batch: line %u: %s %s failed: %s\n", op->line,
+		        op->cmd == CE_GW_C_ADD ? "add" : "del",
+		        op->src[0] || op->id ? "route" : "dev",
+		        strerror(-op->err));
+		if (op->line != last_line)
+			failed++;
+		last_line = op->line;
+	}
+
+	double sec = elapsed(&start);
+
+	for (unsigned int i = 0; jobs > 1 && i < jobs; ++i) {
+		struct batch_worker *w = &workers[i];
+
+		printf("batch: worker %u: %zu operations in %.3f s "
+		       "(%.0f ops/s)\n", i, w->done, w->sec,
+		       w->sec > 0 ? w->done / w->sec : 0.0);
+	}
+
+	printf("batch: %zu operations in %.3f s (%.0f ops/s), "
+	       "%u lines failed\n", list.len, sec,
+	       sec > 0 ? list.len / sec : 0.0, failed);
+
+	if (err == 0)
+		err = failed;
+
+out:
+	batch_op_list_free(&list);
+
+out_workers:
+	for (unsigned int i = 1; i < jobs; ++i)
+		cegw_ctx_free(workers[i].ctx);
+	free(workers);
+
+	return err;
+}
@@ -0,0 +1,706 @@
+/**
+ * @file bridge.c
+ * @brief Control Area Network - Ethernet - Gateway - Packet Ring Bridge
+ * (Utility)
+ * @details The userspace TYPE_NET and TYPE_ETH data path. See bridge.h.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include "bridge.h"
+
+/** Bytes of the CAN header in front of the data */
+#define CAN_HDR offsetof(struct canfd_frame, data)
+/** Receive buffer of BRIDGE_COPY, other traffic of the device included */
+#define BRIDGE_COPY_BUF 2048
+/** Where the data of a TX ring frame starts, see tpacket_snd() */
+#define TX_DATA TPACKET_ALIGN(sizeof(struct tpacket3_hdr))
+
+size_t bridge_mtu(uint8_t type, uint32_t flags)
+{
+	int fd = (flags & F_CAN_FD) != 0;
+
+	switch (type) {
+	case TYPE_ETH:
+		return fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+	case TYPE_NET:
+		return fd ? CANFD_MTU : CAN_MTU;
+	default:
+		return 0;
+	}
+}
+
+size_t bridge_frame_size(uint8_t type, uint32_t flags)
+{
+	return ETH_HLEN + bridge_mtu(type, flags);
+}
+
+size_t bridge_can_offset(uint8_t type)
+{
+	return type == TYPE_ETH ? ETH_HLEN - CAN_HDR : ETH_HLEN;
+}
+
+size_t bridge_encap(const struct bridge *b, uint8_t *frame, size_t len)
+{
+	struct ethhdr *eth = (struct ethhdr *) frame;
+	struct canfd_frame *cf = (struct canfd_frame *)
+	                         (frame + bridge_can_offset(b->type));
+	int fd = len == CANFD_MTU;
+
+	if (!(len == CAN_MTU || (fd && (b->flags & F_CAN_FD))) ||
+	    cf->len > (fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN))
+		return 0;
+
+	if (b->type == TYPE_NET) {
+		cf->can_id = htonl(cf->can_id);
+		memset(eth->h_dest, 0xff, ETH_ALEN);
+		memcpy(eth->h_source, b->mac, ETH_ALEN);
+		eth->h_proto = htons(fd ? ETH_P_CANFD : ETH_P_CAN);
+		return ETH_HLEN + len;
+	}
+
+	/* the CAN header lies under the Ethernet source and length */
+	uint32_t id = htonl(cf->can_id);
+	uint8_t dlen = cf->len;
+	uint8_t flags = fd ? cf->flags : 0;
+
+	memset(eth->h_dest, 0xff, ETH_ALEN);
+	eth->h_source[0] = BRIDGE_ETH_MARK | (fd ? BRIDGE_ETH_FD : 0);
+	eth->h_source[1] = flags;
+	memcpy(eth->h_source + 2, &id, sizeof(id));
+	eth->h_proto = htons(dlen);
+
+	return ETH_HLEN + dlen;
+}
+
+int bridge_decap(const struct bridge *b, uint8_t *frame, size_t len,
+                 size_t room, struct canfd_frame *hdr, struct iovec iov[2])
+{
+	struct ethhdr *eth = (struct ethhdr *) frame;
+	uint16_t proto;
+	size_t mtu;
+
+	if (len < ETH_HLEN)
+		return 0;
+	proto = ntohs(eth->h_proto);
+
+	if (b->type == TYPE_NET) {
+		struct canfd_frame *cf = (struct canfd_frame *)
+		                         (frame + ETH_HLEN);
+
+		if (proto != ETH_P_CAN && proto != ETH_P_CANFD)
+			return 0;
+		if (proto == ETH_P_CANFD && !(b->flags & F_CAN_FD))
+			return -EINVAL;
+
+		mtu = proto == ETH_P_CAN ? CAN_MTU : CANFD_MTU;
+		if (len < ETH_HLEN + mtu ||
+		    cf->len > (mtu == CAN_MTU ? CAN_MAX_DLEN : CANFD_MAX_DLEN))
+			return -EINVAL;
+
+		cf->can_id = ntohl(cf->can_id);
+		iov[0].iov_base = cf;
+		iov[0].iov_len = mtu;
+		iov[1].iov_len = 0;
+		return mtu;
+	}
+
+	/* an 802.3 length and our mark, else it is other traffic */
+	uint8_t mark = eth->h_source[0];
+	if (proto >= ETH_P_802_3_MIN ||
+	    (mark & ~BRIDGE_ETH_FD) != BRIDGE_ETH_MARK)
+		return 0;
+
+	int fd = (mark & BRIDGE_ETH_FD) != 0;
+	if ((fd && !(b->flags & F_CAN_FD)) ||
+	    proto > (fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN) ||
+	    len < ETH_HLEN + proto)
+		return -EINVAL;
+
+	uint32_t id;
+	memcpy(&id, eth->h_source + 2, sizeof(id));
+	hdr->can_id = ntohl(id);
+	hdr->len = proto;
+	hdr->flags = fd ? eth->h_source[1] : 0;
+	hdr->__res0 = 0;
+	hdr->__res1 = 0;
+
+	mtu = fd ? CANFD_MTU : CAN_MTU;
+	if (room >= ETH_HLEN + mtu - CAN_HDR) {
+		iov[0].iov_base = hdr;
+		iov[0].iov_len = CAN_HDR;
+		iov[1].iov_base = frame + ETH_HLEN;
+		iov[1].iov_len = mtu - CAN_HDR;
+	} else {
+		/* the end of the ring, the bytes behind the frame are not
+		 * mapped */
+		memcpy(hdr->data, frame + ETH_HLEN, proto);
+		iov[0].iov_base = hdr;
+		iov[0].iov_len = mtu;
+		iov[1].iov_len = 0;
+	}
+
+	return mtu;
+}
+
+/**
+ * @fn size_t page_align(size_t size)
+ * @brief size rounded up to whole pages.
+ */
+static size_t page_align(size_t size)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+
+	return (size + page - 1) / page * page;
+}
+
+/**
+ * @fn int bridge_ring(int fd, int opt, struct bridge_ring *ring,
+ *                     size_t slot, unsigned int blocks)
+ * @brief Sets up and maps the ring opt (PACKET_RX_RING or PACKET_TX_RING)
+ *        of fd: blocks blocks of BRIDGE_BLOCK_FRAMES frames of slot bytes.
+ *        ring->nr counts the blocks of RX and the frames of TX.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int bridge_ring(int fd, int opt, struct bridge_ring *ring,
+                       size_t slot, unsigned int blocks)
+{
+	struct tpacket_req3 req;
+	int version = TPACKET_V3;
+
+	memset(&req, 0, sizeof(req));
+	req.tp_frame_size = TPACKET_ALIGN(slot);
+	req.tp_block_size = page_align(req.tp_frame_size *
+	                               BRIDGE_BLOCK_FRAMES);
+	req.tp_block_nr = blocks;
+	req.tp_frame_nr = req.tp_block_size / req.tp_frame_size * blocks;
+	if (opt == PACKET_RX_RING)
+		req.tp_retire_blk_tov = BRIDGE_BLOCK_TOV;
+
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version,
+	               sizeof(version)) != 0 ||
+	    setsockopt(fd, SOL_PACKET, opt, &req, sizeof(req)) != 0)
+		return -errno;
+
+	ring->size = (size_t) req.tp_block_size * req.tp_block_nr;
+	ring->map = mmap(NULL, ring->size, PROT_READ | PROT_WRITE,
+	                 MAP_SHARED | MAP_LOCKED, fd, 0);
+	if (ring->map == MAP_FAILED)
+		ring->map = mmap(NULL, ring->size, PROT_READ | PROT_WRITE,
+		                 MAP_SHARED, fd, 0);
+	if (ring->map == MAP_FAILED) {
+		ring->map = NULL;
+		return -errno;
+	}
+
+	ring->block = req.tp_block_size;
+	ring->frame = req.tp_frame_size;
+	ring->nr = opt == PACKET_RX_RING ? req.tp_block_nr : req.tp_frame_nr;
+	ring->next = 0;
+	return 0;
+}
+
+/**
+ * @fn int bridge_packet_socket(void)
+ * @brief Opens a packet socket which receives nothing until it is bound,
+ *        see bridge_bind().
+ * @retval >=0 the socket
+ * @retval <0 -errno on failure
+ */
+static int bridge_packet_socket(void)
+{
+	int on = 1;
+	int fd = socket(AF_PACKET, SOCK_RAW, 0);
+
+	if (fd < 0)
+		return -errno;
+
+	/* the own frames are not bridged back, needs Linux 4.20 */
+	setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &on, sizeof(on));
+	setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &on, sizeof(on));
+
+	return fd;
+}
+
+/**
+ * @fn int bridge_bind(int fd, int ifindex, int proto)
+ * @brief Binds the packet socket fd to the device ifindex and proto.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int bridge_bind(int fd, int ifindex, int proto)
+{
+	struct sockaddr_ll sll;
+
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(proto);
+	sll.sll_ifindex = ifindex;
+
+	return bind(fd, (struct sockaddr *) &sll, sizeof(sll)) == 0 ? 0
+	       : -errno;
+}
+
+int bridge_init(struct bridge *b, int can_fd, const char *eth, uint8_t type,
+                uint32_t flags, enum bridge_io io, unsigned int batch)
+{
+	struct ifreq ifr;
+	int ifindex;
+	int err;
+
+	if ((type != TYPE_NET && type != TYPE_ETH) || batch == 0 ||
+	    batch > BRIDGE_BLOCK_FRAMES)
+		return -EINVAL;
+
+	memset(b, 0, sizeof(*b));
+	b->can_fd = -1;
+	b->rx_fd = -1;
+	b->tx_fd = -1;
+	b->type = type;
+	b->flags = flags;
+	b->io = io;
+	b->batch = batch;
+	b->frame = bridge_frame_size(type, flags);
+	snprintf(b->eth_name, IFNAMSIZ, "%s", eth);
+	strcpy(b->can_name, "can");
+
+	ifindex = if_nametoindex(eth);
+	if (ifindex == 0) {
+		err = -ENODEV;
+		goto failure;
+	}
+
+	b->hdrs = calloc(batch, sizeof(*b->hdrs));
+	b->iov = calloc(2 * batch, sizeof(*b->iov));
+	b->msgs = calloc(batch, sizeof(*b->msgs));
+	b->buf = malloc(BRIDGE_COPY_BUF);
+	if (b->hdrs == NULL || b->iov == NULL || b->msgs == NULL ||
+	    b->buf == NULL) {
+		err = -ENOMEM;
+		goto failure;
+	}
+	for (unsigned int i = 0; i < batch; ++i) {
+		b->msgs[i].msg_hdr.msg_iov = &b->iov[2 * i];
+		b->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	b->rx_fd = bridge_packet_socket();
+	if (b->rx_fd < 0) {
+		err = b->rx_fd;
+		goto failure;
+	}
+
+	if (io == BRIDGE_COPY) {
+		int rcvbuf = FORWARD_RCVBUF;
+
+		setsockopt(b->rx_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+		           sizeof(rcvbuf));
+	} else {
+		/* a received frame lies behind the tpacket3_hdr and the
+		 * sockaddr_ll, its network header aligned to 16 bytes */
+		err = bridge_ring(b->rx_fd, PACKET_RX_RING, &b->rx,
+		                  TPACKET3_HDRLEN + 16 + b->frame,
+		                  BRIDGE_BLOCKS);
+		if (err != 0)
+			goto failure;
+
+		b->tx_fd = bridge_packet_socket();
+		if (b->tx_fd < 0) {
+			err = b->tx_fd;
+			goto failure;
+		}
+		err = bridge_ring(b->tx_fd, PACKET_TX_RING, &b->tx,
+		                  TX_DATA + b->frame, BRIDGE_TX_BATCHES);
+		if (err == 0)
+			err = bridge_bind(b->tx_fd, ifindex, 0);
+		if (err != 0)
+			goto failure;
+	}
+
+	err = bridge_bind(b->rx_fd, ifindex, ETH_P_ALL);
+	if (err != 0)
+		goto failure;
+
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, IFNAMSIZ, "%s", eth);
+	if (ioctl(b->rx_fd, SIOCGIFHWADDR, &ifr) == 0)
+		memcpy(b->mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+
+	b->can_fd = can_fd;
+	return 0;
+
+failure:
+	fprintf(stderr, "bridge: Error: %s: %s\n", eth, strerror(-err));
+	bridge_close(b);
+	return err;
+}
+
+int bridge_open(struct bridge *b, const char *can, const char *eth,
+                uint8_t type, uint32_t flags, enum bridge_io io,
+                unsigned int batch)
+{
+	int rcvbuf = FORWARD_RCVBUF;
+	int can_fd, err;
+
+	can_fd = forward_can_socket(can, flags);
+	if (can_fd < 0)
+		return can_fd;
+	setsockopt(can_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	err = bridge_init(b, can_fd, eth, type, flags, io, batch);
+	if (err != 0) {
+		close(can_fd);
+		return err;
+	}
+
+	snprintf(b->can_name, IFNAMSIZ, "%s", can);
+	return 0;
+}
+
+/**
+ * @fn struct tpacket3_hdr *tx_frame(const struct bridge *b,
+ *                                   unsigned int i)
+ * @brief The frame i of the TX ring.
+ */
+static struct tpacket3_hdr *tx_frame(const struct bridge *b, unsigned int i)
+{
+	unsigned int per_block = b->tx.block / b->tx.frame;
+
+	return (struct tpacket3_hdr *) (b->tx.map +
+	                                i / per_block * b->tx.block +
+	                                i % per_block * b->tx.frame);
+}
+
+/**
+ * @fn int bridge_can_eth_mmap(struct bridge *b)
+ * @brief BRIDGE_CAN_ETH of BRIDGE_MMAP: the CAN frames are received into
+ *        the free frames of the TX ring, encapsulated in place and sent by
+ *        one send() per batch.
+ */
+static int bridge_can_eth_mmap(struct bridge *b)
+{
+	struct forward_stats *st = &b->stats[BRIDGE_CAN_ETH];
+	size_t can_off = TX_DATA + bridge_can_offset(b->type);
+	int total = 0;
+
+	for (;;) {
+		unsigned int k, j = 0;
+		int n;
+
+		/* the free frames from the next on, the kernel sends the
+		 * ring in order */
+		for (k = 0; k < b->batch; ++k) {
+			unsigned int i = (b->tx.next + k) % b->tx.nr;
+			struct tpacket3_hdr *h = tx_frame(b, i);
+
+			if (h->tp_status == TP_STATUS_WRONG_FORMAT) {
+				st->handled--;
+				st->dropped++;
+				h->tp_status = TP_STATUS_AVAILABLE;
+			}
+			if (h->tp_status != TP_STATUS_AVAILABLE)
+				break;
+
+			b->iov[2 * k].iov_base = (uint8_t *) h + can_off;
+			b->iov[2 * k].iov_len = CANFD_MTU;
+			b->msgs[k].msg_hdr.msg_iovlen = 1;
+		}
+		if (k == 0)
+			break;
+
+		n = recvmmsg(b->can_fd, b->msgs, k, MSG_DONTWAIT, NULL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -errno;
+		}
+		st->batches++;
+		total += n;
+
+		for (int i = 0; i < n; ++i) {
+			struct tpacket3_hdr *h = tx_frame(b, (b->tx.next + j) %
+			                                  b->tx.nr);
+			uint8_t *frame = (uint8_t *) h + TX_DATA;
+			size_t can_len = b->msgs[i].msg_len;
+			size_t len;
+
+			/* closes the gap of a dropped frame, the only copy */
+			if ((unsigned int) i != j)
+				memcpy((uint8_t *) h + can_off,
+				       b->iov[2 * i].iov_base, can_len);
+
+			len = b->msgs[i].msg_hdr.msg_flags & MSG_TRUNC ? 0
+			      : bridge_encap(b, frame, can_len);
+			if (len == 0) {
+				st->dropped++;
+				continue;
+			}
+
+			h->tp_len = len;
+			h->tp_next_offset = 0;
+			__sync_synchronize();
+			h->tp_status = TP_STATUS_SEND_REQUEST;
+			j++;
+		}
+
+		b->tx.next = (b->tx.next + j) % b->tx.nr;
+		st->handled += j;
+		if (j > 0 && send(b->tx_fd, NULL, 0, MSG_DONTWAIT) < 0 &&
+		    errno != EAGAIN && errno != ENOBUFS)
+			return -errno;
+
+		if ((unsigned int) n < k)
+			break;
+	}
+
+	return total;
+}
+
+/**
+ * @fn int bridge_eth_can_mmap(struct bridge *b)
+ * @brief BRIDGE_ETH_CAN of BRIDGE_MMAP: the frames of every block the
+ *        kernel passed are decapsulated in place and written to CAN from
+ *        the ring before the block is given back.
+ */
+static int bridge_eth_can_mmap(struct bridge *b)
+{
+	struct forward_stats *st = &b->stats[BRIDGE_ETH_CAN];
+	int total = 0;
+
+	for (;;) {
+		struct tpacket_block_desc *bd = (struct tpacket_block_desc *)
+		                                (b->rx.map +
+		                                 b->rx.next * b->rx.block);
+		uint8_t *end = (uint8_t *) bd + b->rx.block;
+		unsigned int k = 0;
+
+		if (!(bd->hdr.bh1.block_status & TP_STATUS_USER))
+			break;
+		__sync_synchronize();
+
+		uint8_t *p = (uint8_t *) bd + bd->hdr.bh1.offset_to_first_pkt;
+		for (uint32_t i = 0; i < bd->hdr.bh1.num_pkts; ++i) {
+			struct tpacket3_hdr *h = (struct tpacket3_hdr *) p;
+			struct sockaddr_ll *sll = (struct sockaddr_ll *)
+			                          (p + TX_DATA);
+			uint8_t *frame = p + h->tp_mac;
+			int len;
+
+			p += h->tp_next_offset;
+			if (sll->sll_pkttype == PACKET_OUTGOING)
+				continue;
+
+			len = bridge_decap(b, frame, h->tp_snaplen,
+			                   end - frame, &b->hdrs[k],
+			                   &b->iov[2 * k]);
+			if (len == 0)
+				continue;
+			total++;
+			if (len < 0) {
+				st->dropped++;
+				continue;
+			}
+
+			b->msgs[k].msg_hdr.msg_iovlen = 2;
+			if (++k == b->batch) {
+				forward_send(b->can_fd, b->msgs, k, st);
+				st->batches++;
+				k = 0;
+			}
+		}
+
+		/* the iovecs point into the block until it is sent */
+		if (k > 0) {
+			forward_send(b->can_fd, b->msgs, k, st);
+			st->batches++;
+		}
+
+		__sync_synchronize();
+		bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		b->rx.next = (b->rx.next + 1) % b->rx.nr;
+	}
+
+	return total;
+}
+
+/**
+ * @fn int bridge_can_eth_copy(struct bridge *b)
+ * @brief BRIDGE_CAN_ETH of BRIDGE_COPY: one recv() and send() per frame.
+ */
+static int bridge_can_eth_copy(struct bridge *b)
+{
+	struct forward_stats *st = &b->stats[BRIDGE_CAN_ETH];
+	size_t can_off = bridge_can_offset(b->type);
+	int total = 0;
+
+	for (;;) {
+		ssize_t n = recv(b->can_fd, b->buf + can_off, CANFD_MTU,
+		                 MSG_DONTWAIT);
+		size_t len;
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -errno;
+		}
+		st->batches++;
+		total++;
+
+		len = bridge_encap(b, b->buf, n);
+		if (len > 0 && send(b->rx_fd, b->buf, len, 0) == (ssize_t) len)
+			st->handled++;
+		else
+			st->dropped++;
+	}
+
+	return total;
+}
+
+/**
+ * @fn int bridge_eth_can_copy(struct bridge *b)
+ * @brief BRIDGE_ETH_CAN of BRIDGE_COPY: one recvfrom() and writev() per
+ *        frame.
+ */
+static int bridge_eth_can_copy(struct bridge *b)
+{
+	struct forward_stats *st = &b->stats[BRIDGE_ETH_CAN];
+	int total = 0;
+
+	for (;;) {
+		struct sockaddr_ll sll;
+		socklen_t sll_len = sizeof(sll);
+		ssize_t n = recvfrom(b->rx_fd, b->buf, BRIDGE_COPY_BUF,
+		                     MSG_DONTWAIT, (struct sockaddr *) &sll,
+		                     &sll_len);
+		int len;
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -errno;
+		}
+		if (sll.sll_pkttype == PACKET_OUTGOING)
+			continue;
+
+		len = bridge_decap(b, b->buf, n, BRIDGE_COPY_BUF, b->hdrs,
+		                   b->iov);
+		if (len == 0)
+			continue;
+		st->batches++;
+		total++;
+
+		if (len > 0 && writev(b->can_fd, b->iov, 2) == len)
+			st->handled++;
+		else
+			st->dropped++;
+	}
+
+	return total;
+}
+
+int bridge_run(struct bridge *b, enum bridge_dir dir)
+{
+	if (b->io == BRIDGE_MMAP)
+		return dir == BRIDGE_CAN_ETH ? bridge_can_eth_mmap(b)
+		                             : bridge_eth_can_mmap(b);
+
+	return dir == BRIDGE_CAN_ETH ? bridge_can_eth_copy(b)
+	                             : bridge_eth_can_copy(b);
+}
+
+int bridge_poll(struct bridge *b, int timeout)
+{
+	struct pollfd pfd[BRIDGE_DIRS] = {
+		{ b->can_fd, POLLIN, 0 },
+		{ b->rx_fd, POLLIN, 0 },
+	};
+	int total = 0;
+
+	if (poll(pfd, BRIDGE_DIRS, timeout) < 0)
+		return -errno;
+
+	for (int dir = 0; dir < BRIDGE_DIRS; ++dir) {
+		if (!(pfd[dir].revents & (POLLIN | POLLERR)))
+			continue;
+
+		int n = bridge_run(b, dir);
+		if (n < 0)
+			return n;
+		total += n;
+	}
+
+	return total;
+}
+
+void bridge_route(const struct bridge *b, enum bridge_dir dir,
+                  struct ce_gw_route *route)
+{
+	memset(route, 0, sizeof(*route));
+	route->id = dir + 1;
+	route->flags = b->flags;
+	route->type = b->type;
+	route->handled = b->stats[dir].handled;
+	route->dropped = b->stats[dir].dropped;
+	strcpy(route->src, dir == BRIDGE_CAN_ETH ? b->can_name : b->eth_name);
+	strcpy(route->dst, dir == BRIDGE_CAN_ETH ? b->eth_name : b->can_name);
+}
+
+void bridge_close(struct bridge *b)
+{
+	if (b->rx.map != NULL)
+		munmap(b->rx.map, b->rx.size);
+	if (b->tx.map != NULL)
+		munmap(b->tx.map, b->tx.size);
+	if (b->can_fd >= 0)
+		close(b->can_fd);
+	if (b->rx_fd >= 0)
+		close(b->rx_fd);
+	if (b->tx_fd >= 0)
+		close(b->tx_fd);
+	free(b->hdrs);
+	free(b->iov);
+	free(b->msgs);
+	free(b->buf);
+	memset(b, 0, sizeof(*b));
+	b->can_fd = b->rx_fd = b->tx_fd = -1;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file bridge_main.c
+ * @brief Control Area Network - Ethernet - Gateway - Packet Ring Bridge
+ * (Utility)
+ * @details "cegwctl bridge", the frontend of the userspace TYPE_NET and
+ *          TYPE_ETH data path. See bridge.h.
+ * @author agent (agent@local)
+ * @date October, 2026
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bridge.h"
+#include "timing.h"
+
+/** set by SIGINT, ends bridge_main() */
+static volatile sig_atomic_t bridge_stop;
+
+/**
+ * @fn void bridge_sigint(int sig)
+ * @brief Handler of SIGINT.
+ */
+static void bridge_sigint(int sig)
+{
+	bridge_stop = 1;
+}
+
+/**
+ * @fn void bridge_print(const struct bridge *b)
+ * @brief Prints the directions of b as routes.
+ */
+static void bridge_print(const struct bridge *b)
+{
+	struct ce_gw_route route;
+
+	ce_gw_route_print_header();
+	for (int dir = 0; dir < BRIDGE_DIRS; ++dir) {
+		bridge_route(b, dir, &route);
+		ce_gw_route_print(&route, NULL);
+	}
+	fflush(stdout);
+}
+
+int bridge_main(int argc, char *argv[])
+{
+	const char *prog = "cegwctl bridge";
+	enum bridge_io io = BRIDGE_MMAP;
+	unsigned int batch = BRIDGE_BLOCK_FRAMES;
+	uint8_t type = TYPE_NET;
+	uint32_t flags = 0;
+	double interval = 0;
+	struct bridge b;
+	char *end;
+	int c, err;
+
+	static struct option long_options[] = {
+		{"can-fd",   no_argument,       0, 'f'},
+		{"type",     required_argument, 0, 't'},
+		{"batch",    required_argument, 0, 'B'},
+		{"interval", required_argument, 0, 'i'},
+		{"copy",     no_argument,       0, 'c'},
+		{0, 0, 0, 0},
+	};
+
+	optind = 1;
+	while ((c = getopt_long(argc, argv, "ft:B:i:", long_options,
+	                        NULL)) != -1) {
+		switch (c) {
+		case 'f':
+			flags |= F_CAN_FD;
+			break;
+
+		case 't':
+			err = str2type(optarg);
+			if (err != TYPE_NET && err != TYPE_ETH) {
+				fprintf(stderr, "%s: Error: type must be net "
+				        "or eth\n", prog);
+				return EXIT_FAILURE;
+			}
+			type = err;
+			break;
+
+		case 'B':
+			batch = strtoul(optarg, &end, 0);
+			if (end == optarg || *end != '\0' || batch == 0 ||
+			    batch > BRIDGE_BLOCK_FRAMES) {
+				fprintf(stderr, "%s: Error: batch must be "
+				        "between 1 and %d\n", prog,
+				        BRIDGE_BLOCK_FRAMES);
+				return EXIT_FAILURE;
+			}
+			break;
+
+		case 'i':
+			interval = strtod(optarg, &end);
+			if (end == optarg || *end != '\0' || interval < 0) {
+				fprintf(stderr, "%s: Error: interval must be "
+				        "a number of seconds\n", prog);
+				return EXIT_FAILURE;
+			}
+			break;
+
+		case 'c':
+			io = BRIDGE_COPY;
+			break;
+
+		default:
+			/* getopt_long already printed an error message. */
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind + 2 != argc) {
+		fprintf(stderr, "%s: Error: expected CAN ETH\n", prog);
+		return EXIT_FAILURE;
+	}
+
+	err = bridge_open(&b, argv[optind], argv[optind + 1], type, flags, io,
+	                  batch);
+	if (err != 0)
+		return EXIT_FAILURE;
+
+	struct sigaction sa, old;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = bridge_sigint;
+	sigaction(SIGINT, &sa, &old);
+
+	printf("BRIDGE %s <-> %s, type %s%s, %s, batch %u\n", b.can_name,
+	       b.eth_name, enum2str(type, type_array, TYPE_MAX),
+	       flags & F_CAN_FD ? " (CAN-FD)" : "",
+	       io == BRIDGE_MMAP ? "TPACKET_V3 rings" : "copy", batch);
+	fflush(stdout);
+
+	uint64_t step = interval * 1e9;
+	uint64_t next = timing_now() + step;
+	while (!bridge_stop) {
+		int timeout = -1;
+
+		if (interval > 0) {
+			uint64_t now = timing_now();
+			timeout = next > now ? (next - now) / 1000000 + 1 : 0;
+		}
+
+		err = bridge_poll(&b, timeout);
+		if (err < 0 && err != -EINTR) {
+			fprintf(stderr, "%s: Error: %s\n", prog,
+			        strerror(-err));
+			break;
+		}
+
+		if (interval > 0 && timing_now() >= next) {
+			bridge_print(&b);
+			next += step;
+		}
+	}
+
+	sigaction(SIGINT, &old, NULL);
+	printf("\n");
+	bridge_print(&b);
+	bridge_close(&b);
+
+	return bridge_stop ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,825 @@
+/**
+ * @file cegwd.c
+ * @brief Control Area Network - Ethernet - Gateway - Daemon (Utility)
+ * @details Keeps the netlink socket and family open and executes the
+ *          requests of many cegwctl clients, received over an AF_UNIX socket,
+ *          in one event loop. The kernel is asked with the async API, whose
+ *          socket is polled in the same loop, so a client waiting for the
+ *          module does not stop the others. The route table is cached
+ *          between the requests, so CE_GW_C_LIST is answered without asking
+ *          the kernel.
+ *          See cegwd.h for the protocol.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ * @ingroup files
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#define _GNU_SOURCE /* accept4() */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netlink/errno.h>
+#include "netlink.h"
+#include "cegwd.h"
+
+#define MAX_EVENTS 64 /**< epoll events handled per loop */
+
+/**
+ * @struct client
+ * @brief A connected cegwctl.
+ */
+struct client {
+	int fd;					/**< socket */
+	char in[sizeof(struct cegwd_req) + ECHO_MAX]; /**< received bytes */
+	size_t in_len;				/**< bytes in in */
+	char *out;				/**< bytes to send */
+	size_t out_len;				/**< bytes in out */
+	size_t out_size;			/**< allocated size of out */
+	size_t out_off;				/**< bytes of out sent */
+	int busy;		/**< 1 while a request waits for the kernel */
+	int closed;		/**< the connection is gone, free the client
+				 * when the kernel answers */
+	uint32_t list_id;	/**< route id of the list waiting for the cache */
+	struct client *wait_next; /**< next client waiting for the cache */
+};
+
+/**
+ * @struct route_cache
+ * @brief The last route table read from the kernel.
+ */
+struct route_cache {
+	struct ce_gw_route_table table;	/**< the routes */
+	int valid;			/**< 0 if it must be read again */
+	struct timespec time;		/**< time of the last read */
+	struct ce_gw_route_table next;	/**< the routes of the running read */
+	int reading;			/**< 1 while a list is outstanding */
+	struct timespec next_time;	/**< time the running read was sent */
+	unsigned int gen;		/**< completed adds and dels */
+	unsigned int next_gen;		/**< gen when the running read was sent */
+	struct client *waiting;		/**< clients waiting for the read */
+};
+
+int epoll_fd;
+struct cegw_ctx *ctx; /**< connection to the kernel module */
+struct route_cache cache;
+double cache_ttl = 1.0; /**< seconds, <=0 means until the next add/del */
+volatile sig_atomic_t running = 1;
+
+/**
+ * @fn void stop_handler(int sig)
+ * @brief stops the event loop on SIGINT and SIGTERM.
+ */
+static void stop_handler(int sig)
+{
+	running = 0;
+}
+
+/**
+ * @fn int cache_fresh(void)
+ * @brief checks if the cache is valid and not older than cache_ttl.
+ * @retval 1 if the cache can be used
+ * @retval 0 if it must be read again
+ */
+static int cache_fresh(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (cache.valid && cache_ttl > 0) {
+		double age = (now.tv_sec - cache.time.tv_sec) +
+		             (now.tv_nsec - cache.time.tv_nsec) / 1e9;
+		if (age > cache_ttl)
+			cache.valid = 0;
+	}
+
+	return cache.valid;
+}
+
+/**
+ * @fn size_t cache_lookup(uint32_t id, const struct ce_gw_route **routes)
+ * @brief finds the answer to a list of id in the cache.
+ * @param id 0 for all routes
+ * @param routes set to the first route of the answer
+ * @returns the number of routes in the answer
+ */
+static size_t cache_lookup(uint32_t id, const struct ce_gw_route **routes)
+{
+	*routes = cache.table.routes;
+	if (id == 0)
+		return cache.table.len;
+
+	for (size_t i = 0; i < cache.table.len; ++i) {
+		if (cache.table.routes[i].id == id) {
+			*routes = &cache.table.routes[i];
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void route_done(uint32_t handle, int err, const char *echo, void *arg);
+static void echo_done(uint32_t handle, int err, const char *echo, void *arg);
+static void cache_done(uint32_t handle, int err, const char *echo, void *arg);
+
+/**
+ * @fn int cache_read(void)
+ * @brief sends a list to the kernel unless one is outstanding. cache_done()
+ *        answers the waiting clients.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int cache_read(void)
+{
+	int err;
+
+	if (cache.reading)
+		return 0;
+
+	cache.next.len = 0;
+	err = ce_gw_async_list(ctx, 0, NULL, ce_gw_route_table_store,
+	                       cache_done, &cache.next, NULL);
+	if (err != 0)
+		return err == -NLE_NOMEM ? -ENOMEM : -EIO;
+
+	cache.reading = 1;
+	cache.next_gen = cache.gen;
+	clock_gettime(CLOCK_MONOTONIC, &cache.next_time);
+	return 0;
+}
+
+/**
+ * @fn int client_reply(struct client *cl, int err, const void *data,
+ *                uint32_t len)
+ * @brief appends an answer to the output buffer of cl.
+ * @retval 0 on success
+ * @retval -ENOMEM on failure
+ */
+static int client_reply(struct client *cl, int err, const void *data,
+                        uint32_t len)
+{
+	struct cegwd_rsp rsp = { err, len };
+	size_t need = cl->out_len + sizeof(rsp) + len;
+
+	if (need > cl->out_size) {
+		size_t size = cl->out_size ? cl->out_size : 4096;
+		while (size < need)
+			size *= 2;
+
+		char *out = realloc(cl->out, size);
+		if (out == NULL)
+			return -ENOMEM;
+
+		cl->out = out;
+		cl->out_size = size;
+	}
+
+	memcpy(cl->out + cl->out_len, &rsp, sizeof(rsp));
+	cl->out_len += sizeof(rsp);
+	if (len > 0)
+		memcpy(cl->out + cl->out_len, data, len);
+	cl->out_len += len;
+
+	return 0;
+}
+
+/**
+ * @fn int submit_err(int err)
+ * @brief converts the libnl error of a failed submit for the client.
+ */
+static int submit_err(int err)
+{
+	if (err == -NLE_INVAL)
+		return -EINVAL;
+	return err == -NLE_NOMEM ? -ENOMEM : -EIO;
+}
+
+/**
+ * @fn int handle_request(struct client *cl, struct cegwd_req *req,
+ *                 char *data)
+ * @brief executes one request and appends the answer to the client, or
+ *        sends it to the kernel and marks the client busy until the answer
+ *        is there.
+ * @retval 0 on success (the request itself might have failed)
+ * @retval <0 if the answer could not be created
+ */
+static int handle_request(struct client *cl, struct cegwd_req *req,
+                          char *data)
+{
+	const struct ce_gw_route *routes;
+	char *src, *dst;
+	size_t n;
+	int err;
+
+	/* a name without NUL would be another device than the client meant */
+	if (memchr(req->src, '\0', IFNAMSIZ) == NULL ||
+	    memchr(req->dst, '\0', IFNAMSIZ) == NULL)
+		return client_reply(cl, -EINVAL, NULL, 0);
+
+	src = req->src[0] ? req->src : NULL;
+	dst = req->dst[0] ? req->dst : NULL;
+
+	switch (req->cmd) {
+	case CE_GW_C_ADD:
+		if (dst == NULL)
+			return client_reply(cl, -EINVAL, NULL, 0);
+
+		err = ce_gw_async_add(ctx, dst, src, req->type, req->flags,
+		                      route_done, cl, NULL);
+		break;
+
+	case CE_GW_C_DEL:
+		if (req->id != 0 && dst != NULL)
+			return client_reply(cl, -EINVAL, NULL, 0);
+
+		err = ce_gw_async_del(ctx, req->id, dst, route_done, cl, NULL);
+		break;
+
+	case CE_GW_C_LIST:
+		if (cache_fresh()) {
+			n = cache_lookup(req->id, &routes);
+			return client_reply(cl, 0, routes, n * sizeof(*routes));
+		}
+
+		err = cache_read();
+		if (err != 0)
+			return client_reply(cl, err, NULL, 0);
+
+		cl->list_id = req->id;
+		cl->wait_next = cache.waiting;
+		cache.waiting = cl;
+		cl->busy = 1;
+		return 0;
+
+	case CE_GW_C_ECHO:
+		if (req->len == 0)
+			return client_reply(cl, -EINVAL, NULL, 0);
+		data[req->len - 1] = '\0';
+
+		err = ce_gw_async_echo(ctx, data, echo_done, cl, NULL);
+		break;
+
+	default:
+		return client_reply(cl, -EOPNOTSUPP, NULL, 0);
+	}
+
+	if (err != 0)
+		return client_reply(cl, submit_err(err), NULL, 0);
+
+	cl->busy = 1;
+	return 0;
+}
+
+/**
+ * @fn void client_close(struct client *cl)
+ * @brief closes the connection and frees the client. A busy client is freed
+ *        by client_resume() when the kernel answers.
+ */
+static void client_close(struct client *cl)
+{
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, cl->fd, NULL);
+	close(cl->fd);
+
+	if (cl->busy) {
+		cl->closed = 1;
+		return;
+	}
+
+	free(cl->out);
+	free(cl);
+}
+
+/**
+ * @fn int client_flush(struct client *cl)
+ * @brief sends as much of the output buffer as possible and waits for
+ *        EPOLLOUT if something is left. A busy client is not read from.
+ * @retval 0 on success
+ * @retval <0 if the connection failed
+ */
+static int client_flush(struct client *cl)
+{
+	while (cl->out_off < cl->out_len) {
+		ssize_t n = send(cl->fd, cl->out + cl->out_off,
+		                 cl->out_len - cl->out_off, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n < 0)
+			return -errno;
+
+		cl->out_off += n;
+	}
+
+	struct epoll_event ev = { .data.ptr = cl };
+	if (cl->out_off == cl->out_len) {
+		cl->out_off = 0;
+		cl->out_len = 0;
+	} else {
+		ev.events = EPOLLOUT;
+	}
+	if (!cl->busy)
+		ev.events |= EPOLLIN;
+
+	return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, cl->fd, &ev) ? -errno : 0;
+}
+
+/**
+ * @fn int client_handle(struct client *cl)
+ * @brief handles the complete requests in the input buffer until one waits
+ *        for the kernel.
+ * @retval 0 on success
+ * @retval <0 if the connection must be closed
+ */
+static int client_handle(struct client *cl)
+{
+	size_t off = 0;
+	int err = 0;
+
+	while (!cl->busy && cl->in_len - off >= sizeof(struct cegwd_req)) {
+		struct cegwd_req req;
+		memcpy(&req, cl->in + off, sizeof(req));
+
+		if (req.len > ECHO_MAX) {
+			err = -EMSGSIZE;
+			break;
+		}
+		if (cl->in_len - off < sizeof(req) + req.len)
+			break;
+
+		if (handle_request(cl, &req, cl->in + off + sizeof(req)) != 0) {
+			err = -ENOMEM;
+			break;
+		}
+
+		off += sizeof(req) + req.len;
+	}
+
+	memmove(cl->in, cl->in + off, cl->in_len - off);
+	cl->in_len -= off;
+	return err;
+}
+
+/**
+ * @fn int client_read(struct client *cl)
+ * @brief reads from the client and handles all complete requests.
+ * @retval 0 on success
+ * @retval <0 if the connection was closed or failed
+ */
+static int client_read(struct client *cl)
+{
+	while (!cl->busy) {
+		ssize_t n = recv(cl->fd, cl->in + cl->in_len,
+		                 sizeof(cl->in) - cl->in_len, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n < 0)
+			return -errno;
+		if (n == 0)
+			return -ECONNRESET;
+
+		cl->in_len += n;
+
+		int err = client_handle(cl);
+		if (err != 0)
+			return err;
+	}
+
+	return client_flush(cl);
+}
+
+/**
+ * @fn void client_resume(struct client *cl)
+ * @brief continues a client after the kernel answered its request: sends
+ *        the answer and handles the requests received meanwhile.
+ */
+static void client_resume(struct client *cl)
+{
+	cl->busy = 0;
+
+	if (cl->closed) {
+		free(cl->out);
+		free(cl);
+		return;
+	}
+
+	if (client_handle(cl) != 0 || client_flush(cl) != 0)
+		client_close(cl);
+}
+
+/**
+ * @fn void client_complete(struct client *cl, int err, const void *data,
+ *                   uint32_t len)
+ * @brief answers the request a client waits for and resumes it.
+ */
+static void client_complete(struct client *cl, int err, const void *data,
+                            uint32_t len)
+{
+	if (!cl->closed && client_reply(cl, err, data, len) != 0)
+		client_close(cl);
+
+	client_resume(cl);
+}
+
+/**
+ * @fn void route_done(uint32_t handle, int err, const char *echo, void *arg)
+ * @brief completes an add or del.
+ * @ingroup cb
+ */
+static void route_done(uint32_t handle, int err, const char *echo, void *arg)
+{
+	cache.valid = 0;
+	cache.gen++;
+
+	client_complete(arg, err, NULL, 0);
+}
+
+/**
+ * @fn void echo_done(uint32_t handle, int err, const char *echo, void *arg)
+ * @brief completes an echo.
+ * @ingroup cb
+ */
+static void echo_done(uint32_t handle, int err, const char *echo, void *arg)
+{
+	if (err != 0)
+		client_complete(arg, err, NULL, 0);
+	else
+		client_complete(arg, 0, echo, strlen(echo) + 1);
+}
+
+/**
+ * @fn void cache_done(uint32_t handle, int err, const char *echo, void *arg)
+ * @brief completes the list of cache_read() and answers the waiting clients.
+ *        The routes are kept until the next add or del, but one which
+ *        completed while the list was outstanding makes them stale at once.
+ * @ingroup cb
+ */
+static void cache_done(uint32_t handle, int err, const char *echo, void *arg)
+{
+	struct client *cl = cache.waiting;
+
+	cache.reading = 0;
+	cache.waiting = NULL;
+
+	if (err == 0) {
+		struct ce_gw_route_table table = cache.table;
+		cache.table = cache.next;
+		cache.next = table;
+		cache.valid = cache.gen == cache.next_gen;
+		cache.time = cache.next_time;
+	} else if (err != -ENOMEM) {
+		err = -EIO;
+	}
+
+	while (cl != NULL) {
+		struct client *next = cl->wait_next;
+		const struct ce_gw_route *routes = NULL;
+		size_t n = 0;
+
+		if (err == 0)
+			n = cache_lookup(cl->list_id, &routes);
+		client_complete(cl, err, routes, n * sizeof(*routes));
+		cl = next;
+	}
+}
+
+/**
+ * @fn int kernel_process(void)
+ * @brief reads the answers of the kernel and completes the requests. The
+ *        clients resumed by them may submit requests which complete at
+ *        once, as with the mock, so it repeats until nothing completes.
+ * @retval 0 on success
+ * @retval <0 libnl error code if the socket failed
+ */
+static int kernel_process(void)
+{
+	int n;
+
+	do {
+		n = ce_gw_async_process(ctx);
+	} while (n > 0);
+
+	return n;
+}
+
+/**
+ * @fn int client_allowed(int fd)
+ * @brief checks with SO_PEERCRED that the client is root or runs as the
+ *        user of the daemon, who may change the routes anyway.
+ * @retval 1 if the client may send requests
+ * @retval 0 otherwise
+ */
+static int client_allowed(int fd)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return 0;
+
+	return cred.uid == 0 || cred.uid == geteuid();
+}
+
+/**
+ * @fn void accept_clients(int listen_fd)
+ * @brief accepts all waiting connections.
+ */
+static void accept_clients(int listen_fd)
+{
+	for (;;) {
+		int fd = accept4(listen_fd, NULL, NULL,
+		                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK &&
+			    errno != EINTR)
+				perror("accept");
+			return;
+		}
+
+		if (!client_allowed(fd)) {
+			close(fd);
+			continue;
+		}
+
+		struct client *cl = calloc(1, sizeof(*cl));
+		if (cl == NULL) {
+			close(fd);
+			continue;
+		}
+		cl->fd = fd;
+
+		struct epoll_event ev = { .events = EPOLLIN, .data.ptr = cl };
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+			close(fd);
+			free(cl);
+		}
+	}
+}
+
+/**
+ * @fn int stale_socket(const char *path, const struct sockaddr_un *addr)
+ * @brief checks if path is the socket of a previous run, which may be
+ *        removed.
+ * @retval 1 if path is a socket no daemon answers on
+ * @retval 0 if path does not exist
+ * @retval -1 if a daemon answers or path is something else
+ */
+static int stale_socket(const char *path, const struct sockaddr_un *addr)
+{
+	struct stat st;
+	int fd, err;
+
+	if (lstat(path, &st) != 0) {
+		if (errno == ENOENT)
+			return 0;
+		goto fail;
+	}
+	if (!S_ISSOCK(st.st_mode)) {
+		fprintf(stderr, "cegwd: %s is not a socket\n", path);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		goto fail;
+
+	err = connect(fd, (const struct sockaddr *) addr, sizeof(*addr));
+	err = err == 0 ? 0 : errno;
+	close(fd);
+	if (err == 0) {
+		fprintf(stderr, "cegwd: Already running on %s\n", path);
+		return -1;
+	}
+	if (err == ECONNREFUSED)
+		return 1;
+
+	errno = err;
+fail:
+	fprintf(stderr, "cegwd: Can not check %s: %s\n", path,
+	        strerror(errno));
+	return -1;
+}
+
+/**
+ * @fn int listen_socket(const char *path)
+ * @brief creates the non-blocking listening socket at path, which only its
+ *        user may connect to.
+ * @retval the socket
+ * @retval <0 on failure
+ */
+static int listen_socket(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "cegwd: Socket path too long: %s\n", path);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	int stale = stale_socket(path, &addr);
+	if (stale < 0) {
+		close(fd);
+		return -1;
+	}
+	if (stale)
+		unlink(path);
+
+	/* no moment in which others may connect */
+	mode_t mask = umask(0077);
+	int err = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+	umask(mask);
+
+	if (err != 0 || chmod(path, 0600) != 0 ||
+	    listen(fd, SOMAXCONN) != 0) {
+		fprintf(stderr, "cegwd: Can not listen on %s: %s\n", path,
+		        strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = getenv(CEGWD_SOCK_ENV);
+	int c;
+
+	if (path == NULL)
+		path = CEGWD_SOCK_PATH;
+
+	while (1) {
+		static struct option long_options[] = {
+			{"socket",    required_argument, 0, 's'},
+			{"cache-ttl", required_argument, 0, 'c'},
+			{0, 0, 0, 0},
+		};
+		int option_index = 0;
+
+		c = getopt_long (argc, argv, "s:c:",
+		                 long_options, &option_index);
+
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 's':
+			path = optarg;
+			break;
+
+		case 'c':
+			cache_ttl = strtod(optarg, NULL);
+			break;
+
+		case '?':
+			fprintf(stderr, "Usage: %s [-s SOCKET] "
+			        "[-c CACHE_TTL_SECONDS]\n", argv[0]);
+			return EXIT_FAILURE;
+
+		default:
+			abort();
+		}
+	}
+
+	ctx = cegw_ctx_alloc();
+	if (ctx == NULL) {
+		fprintf(stderr, "cegwd: Error during initialisation of Socket "
+		        "or Netlink Family\n");
+		return EXIT_FAILURE;
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	int listen_fd = listen_socket(path);
+	if (listen_fd < 0) {
+		cegw_ctx_free(ctx);
+		return EXIT_FAILURE;
+	}
+
+	/* -1 for the mock, which answers while sending */
+	int kernel_fd = ce_gw_async_fd(ctx);
+	if (kernel_fd < -1) {
+		fprintf(stderr, "cegwd: Can not prepare the Netlink Socket: "
+		        "%s\n", nl_geterror(kernel_fd));
+		close(listen_fd);
+		unlink(path);
+		cegw_ctx_free(ctx);
+		return EXIT_FAILURE;
+	}
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+	struct epoll_event kev = { .events = EPOLLIN, .data.ptr = ctx };
+	if (epoll_fd < 0 ||
+	    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) != 0 ||
+	    (kernel_fd >= 0 &&
+	     epoll_ctl(epoll_fd, EPOLL_CTL_ADD, kernel_fd, &kev) != 0)) {
+		perror("epoll");
+		close(listen_fd);
+		unlink(path);
+		cegw_ctx_free(ctx);
+		return EXIT_FAILURE;
+	}
+
+	/* event loop */
+	while (running) {
+		struct epoll_event events[MAX_EVENTS];
+		int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			perror("epoll_wait");
+			break;
+		}
+
+		int kernel = kernel_fd < 0;
+		for (int i = 0; i < n; ++i) {
+			struct client *cl = events[i].data.ptr;
+			int err = 0;
+
+			if (cl == NULL) {
+				accept_clients(listen_fd);
+				continue;
+			}
+			if (events[i].data.ptr == ctx) {
+				kernel = 1;
+				continue;
+			}
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
+				err = -ECONNRESET;
+			if (err == 0 && (events[i].events & EPOLLOUT))
+				err = client_flush(cl);
+			if (err == 0 && (events[i].events & EPOLLIN))
+				err = client_read(cl);
+
+			if (err != 0)
+				client_close(cl);
+		}
+
+		/* after the events, which might point to clients it frees */
+		if (kernel && kernel_process() < 0) {
+			fprintf(stderr, "cegwd: Netlink Socket failed\n");
+			break;
+		}
+	}
+
+	close(epoll_fd);
+	close(listen_fd);
+	unlink(path);
+	ce_gw_route_table_free(&cache.table);
+	ce_gw_route_table_free(&cache.next);
+	cegw_ctx_free(ctx);
+
+	return EXIT_SUCCESS;
+}
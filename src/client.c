@@ -0,0 +1,282 @@
+/**
+ * @file client.c
+ * @brief Control Area Network - Ethernet - Gateway - Daemon Client (Utility)
+ * @details Forwards the commands of cegwctl to a running cegwd.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "netlink.h"
+#include "cegwd.h"
+#include "format.h"
+
+int cegwd_fd = -1; /**< Socket to the daemon */
+
+int cegwd_connect(void)
+{
+	struct sockaddr_un addr;
+	const char *path = getenv(CEGWD_SOCK_ENV);
+
+	if (path == NULL)
+		path = CEGWD_SOCK_PATH;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+
+	cegwd_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (cegwd_fd < 0)
+		return -errno;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if (connect(cegwd_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		int err = -errno;
+		close(cegwd_fd);
+		cegwd_fd = -1;
+		return err;
+	}
+
+	return 0;
+}
+
+void cegwd_close(void)
+{
+	if (cegwd_fd >= 0)
+		close(cegwd_fd);
+	cegwd_fd = -1;
+}
+
+/**
+ * @fn int full_io(int write_flag, void *buf, size_t len)
+ * @brief Reads or writes exactly len bytes from/to the daemon socket.
+ * @retval 0 on success
+ * @retval <0 -errno on failure, -ECONNRESET if the daemon closed the socket
+ * @ingroup net
+ */
+static int full_io(int write_flag, void *buf, size_t len)
+{
+	char *p = buf;
+
+	while (len > 0) {
+		ssize_t n = write_flag ? send(cegwd_fd, p, len, MSG_NOSIGNAL)
+		            : recv(cegwd_fd, p, len, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return -errno;
+		if (n == 0)
+			return -ECONNRESET;
+
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/**
+ * @fn int cegwd_request(struct cegwd_req *req, const void *data,
+ *                void **answer, uint32_t *answer_len, int *answer_err)
+ * @brief Sends a request to the daemon and waits for the answer.
+ * @param req The request. req->len must be the length of data.
+ * @param data The data of the request or NULL.
+ * @param answer Returns the data of the answer, must be freed by the caller.
+ *        NULL if the answer has no data.
+ * @param answer_len Returns the length of answer.
+ * @param answer_err Returns the error of the answer, -errno of the request
+ *        the daemon executed or 0.
+ * @retval 0 on success
+ * @retval <0 -errno if the daemon could not be asked
+ * @ingroup net
+ */
+static int cegwd_request(struct cegwd_req *req, const void *data,
+                         void **answer, uint32_t *answer_len,
+                         int *answer_err)
+{
+	struct cegwd_rsp rsp;
+	int err;
+
+	*answer = NULL;
+	*answer_len = 0;
+	*answer_err = 0;
+
+	err = full_io(1, req, sizeof(*req));
+	if (err == 0 && req->len > 0)
+		err = full_io(1, (void *) data, req->len);
+	if (err == 0)
+		err = full_io(0, &rsp, sizeof(rsp));
+	if (err != 0) {
+		fprintf(stderr, "daemon: Connection failed: %s\n",
+		        strerror(-err));
+		return err;
+	}
+
+	if (rsp.len > 0) {
+		*answer = malloc(rsp.len);
+		if (*answer == NULL)
+			return -ENOMEM;
+
+		err = full_io(0, *answer, rsp.len);
+		if (err != 0) {
+			free(*answer);
+			*answer = NULL;
+			return err;
+		}
+		*answer_len = rsp.len;
+	}
+
+	*answer_err = rsp.err;
+	return 0;
+}
+
+/**
+ * @fn int cegwd_modify(struct cegwd_req *req)
+ * @brief Sends an add or del request to the daemon. Like ce_gw_add() and
+ *        ce_gw_del(), an error of the kernel is printed but not returned.
+ * @retval 0 on success or after an error of the kernel
+ * @retval <0 -errno if the daemon could not be asked
+ * @ingroup net
+ */
+static int cegwd_modify(struct cegwd_req *req)
+{
+	void *answer;
+	uint32_t len;
+	int answer_err;
+	int err;
+
+	err = cegwd_request(req, NULL, &answer, &len, &answer_err);
+	free(answer);
+	if (err == 0 && answer_err != 0)
+		fprintf(stderr, "NETLINK returned Error: %s\n",
+		        strerror(-answer_err));
+
+	return err;
+}
+
+int cegwd_add(char *dst_name, char *src_name, uint8_t type, uint32_t flags)
+{
+	struct cegwd_req req;
+
+	if (strlen(dst_name) >= IFNAMSIZ ||
+	    (src_name != NULL && strlen(src_name) >= IFNAMSIZ))
+		return -EINVAL;
+
+	memset(&req, 0, sizeof(req));
+	req.cmd = CE_GW_C_ADD;
+	req.type = type;
+	req.flags = flags;
+	if (src_name != NULL)
+		strcpy(req.src, src_name);
+	strcpy(req.dst, dst_name);
+
+	return cegwd_modify(&req);
+}
+
+int cegwd_del(uint32_t id, char *dev_name)
+{
+	struct cegwd_req req;
+
+	if (dev_name != NULL && strlen(dev_name) >= IFNAMSIZ)
+		return -EINVAL;
+
+	memset(&req, 0, sizeof(req));
+	req.cmd = CE_GW_C_DEL;
+	req.id = id;
+	if (dev_name != NULL)
+		strcpy(req.dst, dev_name);
+
+	return cegwd_modify(&req);
+}
+
+int cegwd_list(uint32_t id, unsigned int format)
+{
+	struct cegwd_req req;
+	struct ce_gw_route *routes;
+	struct format_stream fs;
+	uint32_t len;
+	int answer_err;
+	int err;
+
+	memset(&req, 0, sizeof(req));
+	req.cmd = CE_GW_C_LIST;
+	req.id = id;
+
+	err = cegwd_request(&req, NULL, (void **) &routes, &len, &answer_err);
+	if (err == 0)
+		err = answer_err;
+	if (err != 0) {
+		free(routes);
+		return err;
+	}
+
+	fflush(stdout);
+	if (format_stream_begin(&fs, STDOUT_FILENO, format) != 0) {
+		free(routes);
+		return -ENOMEM;
+	}
+
+	for (uint32_t i = 0; i < len / sizeof(*routes); ++i)
+		format_stream_route(&routes[i], &fs);
+
+	free(routes);
+	return format_stream_end(&fs);
+}
+
+int cegwd_echo(char *message)
+{
+	struct cegwd_req req;
+	char *reply;
+	uint32_t len;
+	int answer_err;
+	int err;
+	size_t msg_len = strlen(message) + 1;
+
+	if (msg_len > ECHO_MAX)
+		return -EMSGSIZE;
+
+	memset(&req, 0, sizeof(req));
+	req.cmd = CE_GW_C_ECHO;
+	req.len = msg_len;
+
+	err = cegwd_request(&req, message, (void **) &reply, &len,
+	                    &answer_err);
+	if (err == 0)
+		err = answer_err;
+	if (err == 0 && len > 0) {
+		reply[len - 1] = '\0';
+		printf("kernel says: %s\n", reply);
+	}
+
+	free(reply);
+	return err;
+}
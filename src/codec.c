@@ -0,0 +1,691 @@
+/**
+ * @file codec.c
+ * @brief Control Area Network - Ethernet - Gateway - Batch Codec (Utility)
+ * @details See codec.h.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "bridge.h"
+#include "codec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CODEC_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * @struct codec_offsets
+ * @brief Where the loaded bytes of a frame start: the CAN ID, the word with
+ *        the data length (and the TYPE_ETH mark) and the Ethernet type.
+ */
+struct codec_offsets {
+	unsigned int id, word, proto;
+};
+
+/** offsets of the encapsulated frames, the index is the type */
+static const struct codec_offsets decode_off[] = {
+	[TYPE_ETH] = { ETH_ALEN + 2, ETH_ALEN - 2, 2 * ETH_ALEN },
+	[TYPE_NET] = { ETH_HLEN, ETH_HLEN + 4, 2 * ETH_ALEN },
+	[TYPE_UDP] = { 0, 4, 0 },
+};
+
+size_t codec_frame_size(uint8_t type, uint32_t flags)
+{
+	switch (type) {
+	case TYPE_ETH:
+	case TYPE_NET:
+		return bridge_frame_size(type, flags);
+	case TYPE_UDP:
+		return flags & F_CAN_FD ? CANFD_MTU : CAN_MTU;
+	default:
+		return 0;
+	}
+}
+
+int codec_supported(enum codec_impl impl)
+{
+	switch (impl) {
+	case CODEC_AUTO:
+	case CODEC_SCALAR:
+		return 1;
+#ifdef CODEC_X86
+	case CODEC_SSSE3:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("ssse3");
+	case CODEC_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return 0;
+	}
+}
+
+const char *codec_impl_name(enum codec_impl impl)
+{
+	static const char *names[] = {
+		[CODEC_AUTO] = "auto",
+		[CODEC_SCALAR] = "scalar",
+		[CODEC_SSSE3] = "ssse3",
+		[CODEC_AVX2] = "avx2",
+	};
+
+	return impl < CODEC_IMPLS ? names[impl] : "unknown";
+}
+
+int codec_init(struct codec *c, uint8_t type, uint32_t flags,
+               const unsigned char *mac, enum codec_impl impl)
+{
+	if (type != TYPE_NET && type != TYPE_ETH && type != TYPE_UDP)
+		return -EINVAL;
+	if (impl >= CODEC_IMPLS || !codec_supported(impl))
+		return -EOPNOTSUPP;
+
+	/* SSSE3 stages the loads with scalar code, in bench_codec it is
+	 * often slower than the scalar version */
+	if (impl == CODEC_AUTO)
+		impl = codec_supported(CODEC_AVX2) ? CODEC_AVX2 : CODEC_SCALAR;
+
+	memset(c, 0, sizeof(*c));
+	c->type = type;
+	c->flags = flags;
+	c->stride = codec_frame_size(type, flags);
+	c->impl = impl;
+
+	for (int fd = 0; fd < 2; ++fd) {
+		struct ethhdr *eth = (struct ethhdr *) c->eth[fd];
+
+		memset(eth->h_dest, 0xff, ETH_ALEN);
+		if (mac != NULL)
+			memcpy(eth->h_source, mac, ETH_ALEN);
+		eth->h_proto = htons(fd ? ETH_P_CANFD : ETH_P_CAN);
+	}
+
+	return 0;
+}
+
+/**
+ * @fn uint32_t max_dlen(uint32_t mtu)
+ * @brief the maximum data length of a frame of mtu.
+ */
+static inline uint32_t max_dlen(uint32_t mtu)
+{
+	return mtu == CAN_MTU ? CAN_MAX_DLEN : CANFD_MAX_DLEN;
+}
+
+/**
+ * @fn void decode_one(struct codec *c, const uint8_t *src,
+ *                     unsigned int len, unsigned int i)
+ * @brief Checks the encapsulated frame src of len bytes and stages it as
+ *        frame i of the chunk. The scalar reference of the vector versions.
+ */
+static inline void decode_one(struct codec *c, const uint8_t *src,
+                              unsigned int len, unsigned int i)
+{
+	int fd = (c->flags & F_CAN_FD) != 0;
+	uint32_t proto = src[12] << 8 | src[13];
+	uint32_t mtu = 0;
+
+	switch (c->type) {
+	case TYPE_ETH:
+		if (src[6] == BRIDGE_ETH_MARK)
+			mtu = CAN_MTU;
+		else if (src[6] == (BRIDGE_ETH_MARK | BRIDGE_ETH_FD) && fd)
+			mtu = CANFD_MTU;
+		if (proto > max_dlen(mtu) || len < ETH_HLEN + proto)
+			mtu = 0;
+
+		c->id[i] = (uint32_t) src[8] << 24 | src[9] << 16 |
+		           src[10] << 8 | src[11];
+		c->hdr[i] = proto | (mtu == CANFD_MTU ? src[7] : 0) << 8;
+		c->mtu[i] = mtu;
+		return;
+
+	case TYPE_NET:
+		if (proto == ETH_P_CAN)
+			mtu = CAN_MTU;
+		else if (proto == ETH_P_CANFD && fd)
+			mtu = CANFD_MTU;
+		if (len < ETH_HLEN + mtu)
+			mtu = 0;
+		src += ETH_HLEN;
+		break;
+
+	default:
+		if (len == CAN_MTU)
+			mtu = CAN_MTU;
+		else if (len == CANFD_MTU && fd)
+			mtu = CANFD_MTU;
+		break;
+	}
+
+	if (src[4] > max_dlen(mtu))
+		mtu = 0;
+	c->id[i] = (uint32_t) src[0] << 24 | src[1] << 16 | src[2] << 8 |
+	           src[3];
+	c->hdr[i] = src[4] | src[5] << 8;
+	c->mtu[i] = mtu;
+}
+
+/**
+ * @fn void encode_one(struct codec *c, const struct canfd_frame *cf,
+ *                     uint8_t mtu, unsigned int i)
+ * @brief Checks the CAN frame cf of mtu bytes and stages it as frame i of
+ *        the chunk. The scalar reference of the vector versions.
+ */
+static inline void encode_one(struct codec *c, const struct canfd_frame *cf,
+                              uint8_t mtu, unsigned int i)
+{
+	uint32_t m = 0;
+
+	if (mtu == CAN_MTU)
+		m = CAN_MTU;
+	else if (mtu == CANFD_MTU && (c->flags & F_CAN_FD))
+		m = CANFD_MTU;
+	if (cf->len > max_dlen(m))
+		m = 0;
+
+	c->id[i] = htonl(cf->can_id);
+	c->hdr[i] = cf->len | (m == CANFD_MTU ? cf->flags : 0) << 8;
+	c->mtu[i] = m;
+}
+
+#ifdef CODEC_X86
+
+/**
+ * @fn void decode_ssse3(struct codec *c, const uint8_t *in,
+ *                       const uint16_t *len, unsigned int n)
+ * @brief Stages n encapsulated frames like decode_one(), 4 at a time.
+ */
+__attribute__((target("ssse3")))
+static void decode_ssse3(struct codec *c, const uint8_t *in,
+                         const uint16_t *len, unsigned int n)
+{
+	const struct codec_offsets *off = &decode_off[c->type];
+	const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+	                                    11, 10, 9, 8, 15, 14, 13, 12);
+	const __m128i fdall = _mm_set1_epi32(c->flags & F_CAN_FD ? -1 : 0);
+	const __m128i ff = _mm_set1_epi32(0xff);
+	unsigned int i;
+
+	/* the loads, the SSE has no gather */
+	for (i = 0; i < n; ++i) {
+		const uint8_t *src = in + i * c->stride;
+
+		memcpy(&c->id[i], src + off->id, 4);
+		memcpy(&c->hdr[i], src + off->word, 4);
+		memcpy(&c->raw[i], src + off->proto, 4);
+	}
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i id = _mm_loadu_si128((const __m128i *) &c->id[i]);
+		__m128i w = _mm_loadu_si128((const __m128i *) &c->hdr[i]);
+		__m128i p = _mm_loadu_si128((const __m128i *) &c->raw[i]);
+		__m128i l = _mm_unpacklo_epi16(
+		        _mm_loadl_epi64((const __m128i *) &len[i]),
+		        _mm_setzero_si128());
+		__m128i proto = _mm_or_si128(
+		        _mm_slli_epi32(_mm_and_si128(p, ff), 8),
+		        _mm_and_si128(_mm_srli_epi32(p, 8), ff));
+		__m128i cl, fd, mtu, max, bad, hdr;
+
+		switch (c->type) {
+		case TYPE_ETH: {
+			__m128i mark = _mm_and_si128(_mm_srli_epi32(w, 16), ff);
+
+			cl = _mm_cmpeq_epi32(mark,
+			                     _mm_set1_epi32(BRIDGE_ETH_MARK));
+			fd = _mm_and_si128(fdall, _mm_cmpeq_epi32(mark,
+			        _mm_set1_epi32(BRIDGE_ETH_MARK |
+			                       BRIDGE_ETH_FD)));
+			max = _mm_or_si128(
+			        _mm_and_si128(cl, _mm_set1_epi32(CAN_MAX_DLEN)),
+			        _mm_andnot_si128(cl,
+			                _mm_set1_epi32(CANFD_MAX_DLEN)));
+			bad = _mm_or_si128(_mm_cmpgt_epi32(proto, max),
+			        _mm_cmpgt_epi32(_mm_add_epi32(proto,
+			                _mm_set1_epi32(ETH_HLEN)), l));
+			hdr = _mm_or_si128(proto, _mm_and_si128(fd,
+			        _mm_slli_epi32(_mm_srli_epi32(w, 24), 8)));
+			break;
+		}
+		case TYPE_NET:
+			cl = _mm_cmpeq_epi32(proto, _mm_set1_epi32(ETH_P_CAN));
+			fd = _mm_and_si128(fdall, _mm_cmpeq_epi32(proto,
+			        _mm_set1_epi32(ETH_P_CANFD)));
+			break;
+		default:
+			cl = _mm_cmpeq_epi32(l, _mm_set1_epi32(CAN_MTU));
+			fd = _mm_and_si128(fdall, _mm_cmpeq_epi32(l,
+			        _mm_set1_epi32(CANFD_MTU)));
+			break;
+		}
+
+		mtu = _mm_or_si128(_mm_and_si128(cl, _mm_set1_epi32(CAN_MTU)),
+		                   _mm_and_si128(fd, _mm_set1_epi32(CANFD_MTU)));
+		if (c->type != TYPE_ETH) {
+			max = _mm_or_si128(
+			        _mm_and_si128(cl, _mm_set1_epi32(CAN_MAX_DLEN)),
+			        _mm_andnot_si128(cl,
+			                _mm_set1_epi32(CANFD_MAX_DLEN)));
+			bad = _mm_cmpgt_epi32(_mm_and_si128(w, ff), max);
+			if (c->type == TYPE_NET)
+				bad = _mm_or_si128(bad, _mm_cmpgt_epi32(
+				        _mm_add_epi32(mtu,
+				                _mm_set1_epi32(ETH_HLEN)), l));
+			hdr = _mm_and_si128(w, _mm_set1_epi32(0xffff));
+		}
+
+		_mm_storeu_si128((__m128i *) &c->id[i],
+		                 _mm_shuffle_epi8(id, bswap));
+		_mm_storeu_si128((__m128i *) &c->hdr[i], hdr);
+		_mm_storeu_si128((__m128i *) &c->mtu[i],
+		                 _mm_andnot_si128(bad, mtu));
+	}
+
+	for (; i < n; ++i)
+		decode_one(c, in + i * c->stride, len[i], i);
+}
+
+/**
+ * @fn void encode_ssse3(struct codec *c, const struct canfd_frame *can,
+ *                       const uint8_t *mtu, unsigned int n)
+ * @brief Stages n CAN frames like encode_one(), 4 at a time.
+ */
+__attribute__((target("ssse3")))
+static void encode_ssse3(struct codec *c, const struct canfd_frame *can,
+                         const uint8_t *mtu, unsigned int n)
+{
+	const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+	                                    11, 10, 9, 8, 15, 14, 13, 12);
+	const __m128i fdall = _mm_set1_epi32(c->flags & F_CAN_FD ? -1 : 0);
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int i;
+
+	for (i = 0; i < n; ++i) {
+		memcpy(&c->id[i], &can[i], 4);
+		memcpy(&c->hdr[i], (const uint8_t *) &can[i] + 4, 4);
+	}
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i id = _mm_loadu_si128((const __m128i *) &c->id[i]);
+		__m128i w = _mm_loadu_si128((const __m128i *) &c->hdr[i]);
+		__m128i m;
+		uint32_t m4;
+
+		memcpy(&m4, &mtu[i], 4);
+		m = _mm_unpacklo_epi16(_mm_unpacklo_epi8(
+		        _mm_cvtsi32_si128(m4), zero), zero);
+
+		__m128i dlen = _mm_and_si128(w, _mm_set1_epi32(0xff));
+		__m128i cl = _mm_cmpeq_epi32(m, _mm_set1_epi32(CAN_MTU));
+		__m128i fd = _mm_and_si128(fdall, _mm_cmpeq_epi32(m,
+		        _mm_set1_epi32(CANFD_MTU)));
+		__m128i max = _mm_or_si128(
+		        _mm_and_si128(cl, _mm_set1_epi32(CAN_MAX_DLEN)),
+		        _mm_andnot_si128(cl, _mm_set1_epi32(CANFD_MAX_DLEN)));
+		__m128i out = _mm_or_si128(
+		        _mm_and_si128(cl, _mm_set1_epi32(CAN_MTU)),
+		        _mm_and_si128(fd, _mm_set1_epi32(CANFD_MTU)));
+
+		_mm_storeu_si128((__m128i *) &c->id[i],
+		                 _mm_shuffle_epi8(id, bswap));
+		_mm_storeu_si128((__m128i *) &c->hdr[i], _mm_or_si128(dlen,
+		        _mm_and_si128(fd, _mm_and_si128(w,
+		                _mm_set1_epi32(0xff00)))));
+		_mm_storeu_si128((__m128i *) &c->mtu[i], _mm_andnot_si128(
+		        _mm_cmpgt_epi32(dlen, max), out));
+	}
+
+	for (; i < n; ++i)
+		encode_one(c, &can[i], mtu[i], i);
+}
+
+/**
+ * @fn void decode_avx2(struct codec *c, const uint8_t *in,
+ *                      const uint16_t *len, unsigned int n)
+ * @brief Stages n encapsulated frames like decode_one(), 8 at a time with
+ *        gathered loads.
+ */
+__attribute__((target("avx2")))
+static void decode_avx2(struct codec *c, const uint8_t *in,
+                        const uint16_t *len, unsigned int n)
+{
+	const struct codec_offsets *off = &decode_off[c->type];
+	const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+	                                       11, 10, 9, 8, 15, 14, 13, 12,
+	                                       3, 2, 1, 0, 7, 6, 5, 4,
+	                                       11, 10, 9, 8, 15, 14, 13, 12);
+	const __m256i fdall = _mm256_set1_epi32(c->flags & F_CAN_FD ? -1 : 0);
+	const __m256i ff = _mm256_set1_epi32(0xff);
+	const __m256i idx = _mm256_mullo_epi32(
+	        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+	        _mm256_set1_epi32(c->stride));
+	unsigned int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		const uint8_t *base = in + i * c->stride;
+		__m256i id = _mm256_i32gather_epi32(
+		        (const int *) (base + off->id), idx, 1);
+		__m256i w = _mm256_i32gather_epi32(
+		        (const int *) (base + off->word), idx, 1);
+		__m256i l = _mm256_cvtepu16_epi32(
+		        _mm_loadu_si128((const __m128i *) &len[i]));
+		__m256i cl, fd, mtu, max, bad, hdr, proto = l;
+
+		if (c->type != TYPE_UDP) {
+			__m256i p = _mm256_i32gather_epi32(
+			        (const int *) (base + off->proto), idx, 1);
+
+			proto = _mm256_or_si256(
+			        _mm256_slli_epi32(_mm256_and_si256(p, ff), 8),
+			        _mm256_and_si256(_mm256_srli_epi32(p, 8), ff));
+		}
+
+		switch (c->type) {
+		case TYPE_ETH: {
+			__m256i mark = _mm256_and_si256(
+			        _mm256_srli_epi32(w, 16), ff);
+
+			cl = _mm256_cmpeq_epi32(mark,
+			        _mm256_set1_epi32(BRIDGE_ETH_MARK));
+			fd = _mm256_and_si256(fdall, _mm256_cmpeq_epi32(mark,
+			        _mm256_set1_epi32(BRIDGE_ETH_MARK |
+			                          BRIDGE_ETH_FD)));
+			break;
+		}
+		case TYPE_NET:
+			cl = _mm256_cmpeq_epi32(proto,
+			                        _mm256_set1_epi32(ETH_P_CAN));
+			fd = _mm256_and_si256(fdall, _mm256_cmpeq_epi32(proto,
+			        _mm256_set1_epi32(ETH_P_CANFD)));
+			break;
+		default:
+			cl = _mm256_cmpeq_epi32(l, _mm256_set1_epi32(CAN_MTU));
+			fd = _mm256_and_si256(fdall, _mm256_cmpeq_epi32(l,
+			        _mm256_set1_epi32(CANFD_MTU)));
+			break;
+		}
+
+		mtu = _mm256_or_si256(
+		        _mm256_and_si256(cl, _mm256_set1_epi32(CAN_MTU)),
+		        _mm256_and_si256(fd, _mm256_set1_epi32(CANFD_MTU)));
+		max = _mm256_or_si256(
+		        _mm256_and_si256(cl, _mm256_set1_epi32(CAN_MAX_DLEN)),
+		        _mm256_andnot_si256(cl,
+		                _mm256_set1_epi32(CANFD_MAX_DLEN)));
+
+		if (c->type == TYPE_ETH) {
+			bad = _mm256_or_si256(_mm256_cmpgt_epi32(proto, max),
+			        _mm256_cmpgt_epi32(_mm256_add_epi32(proto,
+			                _mm256_set1_epi32(ETH_HLEN)), l));
+			hdr = _mm256_or_si256(proto, _mm256_and_si256(fd,
+			        _mm256_slli_epi32(_mm256_srli_epi32(w, 24), 8)));
+		} else {
+			bad = _mm256_cmpgt_epi32(_mm256_and_si256(w, ff), max);
+			if (c->type == TYPE_NET)
+				bad = _mm256_or_si256(bad, _mm256_cmpgt_epi32(
+				        _mm256_add_epi32(mtu,
+				                _mm256_set1_epi32(ETH_HLEN)), l));
+			hdr = _mm256_and_si256(w, _mm256_set1_epi32(0xffff));
+		}
+
+		_mm256_storeu_si256((__m256i *) &c->id[i],
+		                    _mm256_shuffle_epi8(id, bswap));
+		_mm256_storeu_si256((__m256i *) &c->hdr[i], hdr);
+		_mm256_storeu_si256((__m256i *) &c->mtu[i],
+		                    _mm256_andnot_si256(bad, mtu));
+	}
+
+	for (; i < n; ++i)
+		decode_one(c, in + i * c->stride, len[i], i);
+}
+
+/**
+ * @fn void encode_avx2(struct codec *c, const struct canfd_frame *can,
+ *                      const uint8_t *mtu, unsigned int n)
+ * @brief Stages n CAN frames like encode_one(), 8 at a time with gathered
+ *        loads.
+ */
+__attribute__((target("avx2")))
+static void encode_avx2(struct codec *c, const struct canfd_frame *can,
+                        const uint8_t *mtu, unsigned int n)
+{
+	const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+	                                       11, 10, 9, 8, 15, 14, 13, 12,
+	                                       3, 2, 1, 0, 7, 6, 5, 4,
+	                                       11, 10, 9, 8, 15, 14, 13, 12);
+	const __m256i fdall = _mm256_set1_epi32(c->flags & F_CAN_FD ? -1 : 0);
+	const __m256i idx = _mm256_mullo_epi32(
+	        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+	        _mm256_set1_epi32(sizeof(*can)));
+	unsigned int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		const int *base = (const int *) &can[i];
+		__m256i id = _mm256_i32gather_epi32(base, idx, 1);
+		__m256i w = _mm256_i32gather_epi32(base + 1, idx, 1);
+		__m256i m = _mm256_cvtepu8_epi32(
+		        _mm_loadl_epi64((const __m128i *) &mtu[i]));
+		__m256i dlen = _mm256_and_si256(w, _mm256_set1_epi32(0xff));
+		__m256i cl = _mm256_cmpeq_epi32(m, _mm256_set1_epi32(CAN_MTU));
+		__m256i fd = _mm256_and_si256(fdall, _mm256_cmpeq_epi32(m,
+		        _mm256_set1_epi32(CANFD_MTU)));
+		__m256i max = _mm256_or_si256(
+		        _mm256_and_si256(cl, _mm256_set1_epi32(CAN_MAX_DLEN)),
+		        _mm256_andnot_si256(cl,
+		                _mm256_set1_epi32(CANFD_MAX_DLEN)));
+		__m256i out = _mm256_or_si256(
+		        _mm256_and_si256(cl, _mm256_set1_epi32(CAN_MTU)),
+		        _mm256_and_si256(fd, _mm256_set1_epi32(CANFD_MTU)));
+
+		_mm256_storeu_si256((__m256i *) &c->id[i],
+		                    _mm256_shuffle_epi8(id, bswap));
+		_mm256_storeu_si256((__m256i *) &c->hdr[i],
+		        _mm256_or_si256(dlen, _mm256_and_si256(fd,
+		                _mm256_and_si256(w,
+		                        _mm256_set1_epi32(0xff00)))));
+		_mm256_storeu_si256((__m256i *) &c->mtu[i],
+		        _mm256_andnot_si256(_mm256_cmpgt_epi32(dlen, max),
+		                            out));
+	}
+
+	for (; i < n; ++i)
+		encode_one(c, &can[i], mtu[i], i);
+}
+
+#endif /* CODEC_X86 */
+
+/**
+ * @fn int decode_write(struct codec *c, const uint8_t *in, unsigned int n,
+ *                      struct canfd_frame *can, uint8_t *mtu)
+ * @brief Writes the n staged frames of the chunk in to can.
+ * @retval the number of written frames
+ */
+static int decode_write(struct codec *c, const uint8_t *in, unsigned int n,
+                        struct canfd_frame *can, uint8_t *mtu)
+{
+	int count = 0;
+
+	for (unsigned int i = 0; i < n; ++i) {
+		const uint8_t *src = in + i * c->stride;
+		struct canfd_frame *cf = &can[i];
+
+		mtu[i] = c->mtu[i];
+		if (mtu[i] == 0)
+			continue;
+		count++;
+
+		if (c->type == TYPE_ETH) {
+			/* constant sizes, the compiler copies them inline */
+			if (mtu[i] == CAN_MTU)
+				memcpy(cf->data, src + ETH_HLEN, CAN_MAX_DLEN);
+			else
+				memcpy(cf->data, src + ETH_HLEN,
+				       CANFD_MAX_DLEN);
+			cf->len = c->hdr[i];
+			cf->flags = c->hdr[i] >> 8;
+			cf->__res0 = 0;
+			cf->__res1 = 0;
+		} else {
+			if (c->type == TYPE_NET)
+				src += ETH_HLEN;
+			if (mtu[i] == CAN_MTU)
+				memcpy(cf, src, CAN_MTU);
+			else
+				memcpy(cf, src, CANFD_MTU);
+		}
+		cf->can_id = c->id[i];
+	}
+
+	return count;
+}
+
+/**
+ * @fn int encode_write(struct codec *c, const struct canfd_frame *can,
+ *                      unsigned int n, uint8_t *out, uint16_t *len)
+ * @brief Writes the n staged frames of the chunk can to out.
+ * @retval the number of written frames
+ */
+static int encode_write(struct codec *c, const struct canfd_frame *can,
+                        unsigned int n, uint8_t *out, uint16_t *len)
+{
+	int count = 0;
+
+	for (unsigned int i = 0; i < n; ++i) {
+		uint8_t *dst = out + i * c->stride;
+		uint32_t m = c->mtu[i];
+
+		if (m == 0) {
+			len[i] = 0;
+			continue;
+		}
+		count++;
+
+		switch (c->type) {
+		case TYPE_ETH:
+			memset(dst, 0xff, ETH_ALEN);
+			dst[6] = BRIDGE_ETH_MARK |
+			         (m == CANFD_MTU ? BRIDGE_ETH_FD : 0);
+			dst[7] = c->hdr[i] >> 8;
+			memcpy(dst + 8, &c->id[i], 4);
+			dst[12] = 0;
+			dst[13] = c->hdr[i];
+			if (m == CAN_MTU)
+				memcpy(dst + ETH_HLEN, can[i].data,
+				       CAN_MAX_DLEN);
+			else
+				memcpy(dst + ETH_HLEN, can[i].data,
+				       CANFD_MAX_DLEN);
+			len[i] = ETH_HLEN + (c->hdr[i] & 0xff);
+			continue;
+
+		case TYPE_NET:
+			memcpy(dst, c->eth[m == CANFD_MTU], ETH_HLEN);
+			dst += ETH_HLEN;
+			len[i] = ETH_HLEN + m;
+			break;
+
+		default:
+			len[i] = m;
+			break;
+		}
+
+		if (m == CAN_MTU)
+			memcpy(dst, &can[i], CAN_MTU);
+		else
+			memcpy(dst, &can[i], CANFD_MTU);
+		memcpy(dst, &c->id[i], 4);
+	}
+
+	return count;
+}
+
+int codec_decode(struct codec *c, const uint8_t *in, const uint16_t *len,
+                 unsigned int n, struct canfd_frame *can, uint8_t *mtu)
+{
+	int count = 0;
+
+	for (unsigned int done = 0; done < n; done += CODEC_CHUNK) {
+		unsigned int k = n - done < CODEC_CHUNK ? n - done
+		                                        : CODEC_CHUNK;
+		const uint8_t *chunk = in + done * c->stride;
+
+		switch (c->impl) {
+#ifdef CODEC_X86
+		case CODEC_AVX2:
+			decode_avx2(c, chunk, len + done, k);
+			break;
+		case CODEC_SSSE3:
+			decode_ssse3(c, chunk, len + done, k);
+			break;
+#endif
+		default:
+			for (unsigned int i = 0; i < k; ++i)
+				decode_one(c, chunk + i * c->stride,
+				           len[done + i], i);
+			break;
+		}
+
+		count += decode_write(c, chunk, k, can + done, mtu + done);
+	}
+
+	return count;
+}
+
+int codec_encode(struct codec *c, const struct canfd_frame *can,
+                 const uint8_t *mtu, unsigned int n, uint8_t *out,
+                 uint16_t *len)
+{
+	int count = 0;
+
+	for (unsigned int done = 0; done < n; done += CODEC_CHUNK) {
+		unsigned int k = n - done < CODEC_CHUNK ? n - done
+		                                        : CODEC_CHUNK;
+
+		switch (c->impl) {
+#ifdef CODEC_X86
+		case CODEC_AVX2:
+			encode_avx2(c, can + done, mtu + done, k);
+			break;
+		case CODEC_SSSE3:
+			encode_ssse3(c, can + done, mtu + done, k);
+			break;
+#endif
+		default:
+			for (unsigned int i = 0; i < k; ++i)
+				encode_one(c, &can[done + i], mtu[done + i],
+				           i);
+			break;
+		}
+
+		count += encode_write(c, can + done, k,
+		                      out + done * c->stride, len + done);
+	}
+
+	return count;
+}
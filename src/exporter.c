@@ -0,0 +1,295 @@
+/**
+ * @file exporter.c
+ * @brief Control Area Network - Ethernet - Gateway - Metrics Exporter
+ * (Utility)
+ * @details The metrics of the exporter. See exporter.h.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "exporter.h"
+#include "format.h"
+#include "timing.h"
+
+void exporter_init(struct exporter *e, struct cegw_ctx *ctx, double interval)
+{
+	memset(e, 0, sizeof(*e));
+	e->ctx = ctx;
+	e->interval = interval;
+}
+
+void exporter_free(struct exporter *e)
+{
+	ce_gw_route_table_free(&e->table);
+	free(e->body);
+	e->body = NULL;
+	e->len = 0;
+	e->size = 0;
+}
+
+/**
+ * @fn char *exp_reserve(struct exporter *e, size_t len)
+ * @brief Returns space for len bytes at the end of the body, which only
+ *        grows if it gets larger than ever before.
+ * @retval NULL if the body could not grow
+ */
+static char *exp_reserve(struct exporter *e, size_t len)
+{
+	if (e->size - e->len < len) {
+		size_t size = e->size ? e->size : 65536;
+		char *body;
+
+		while (size - e->len < len)
+			size *= 2;
+		body = realloc(e->body, size);
+		if (body == NULL)
+			return NULL;
+		e->body = body;
+		e->size = size;
+	}
+
+	return e->body + e->len;
+}
+
+/**
+ * @fn char *exp_label(char *p, const char *str, size_t len)
+ * @brief Writes str as quoted label value to p, which needs space for
+ *        2 * len + 2 bytes.
+ * @returns The end of the value.
+ */
+static char *exp_label(char *p, const char *str, size_t len)
+{
+	*p++ = '"';
+	for (size_t i = 0; i < len; ++i) {
+		if (str[i] == '\\' || str[i] == '"') {
+			*p++ = '\\';
+			*p++ = str[i];
+		} else if (str[i] == '\n') {
+			*p++ = '\\';
+			*p++ = 'n';
+		} else {
+			*p++ = str[i];
+		}
+	}
+	*p++ = '"';
+
+	return p;
+}
+
+/**
+ * @fn int exp_routes(struct exporter *e, const char *name, const char *help,
+ *                    size_t offset)
+ * @brief Appends the metric family name with one sample per route, the
+ *        value is the uint32_t at offset of struct ce_gw_route.
+ * @retval 0 on success
+ * @retval -ENOMEM if the body could not grow
+ */
+static int exp_routes(struct exporter *e, const char *name, const char *help,
+                      size_t offset)
+{
+	size_t name_len = strlen(name);
+	int n;
+
+	char *p = exp_reserve(e, ROW_MAX);
+	if (p == NULL)
+		return -ENOMEM;
+	n = snprintf(p, ROW_MAX, "# HELP %s %s\n# TYPE %s counter\n", name,
+	             help, name);
+	e->len += n;
+
+	for (size_t i = 0; i < e->table.len; ++i) {
+		const struct ce_gw_route *r = &e->table.routes[i];
+		const char *type_str, *flags_str;
+		size_t type_len, flags_len;
+		uint32_t value;
+
+		type_str = format_type(r->type, &type_len);
+		flags_str = format_flags(r->flags, &flags_len);
+		if (flags_len >= 2 && flags_str[0] == '<') {
+			/* the names without the <> of flags2str() */
+			flags_str++;
+			flags_len -= 2;
+		}
+		memcpy(&value, (const char *) r + offset, sizeof(value));
+
+		/* the names are at most IFNAMSIZ - 1, escaped twice as long */
+		p = exp_reserve(e, ROW_MAX);
+		if (p == NULL)
+			return -ENOMEM;
+		p = (char *) memcpy(p, name, name_len) + name_len;
+		p = (char *) memcpy(p, "{id=\"", 5) + 5;
+		p = fmt_u32(p, r->id);
+		p = (char *) memcpy(p, "\",src=", 6) + 6;
+		p = exp_label(p, r->src, strnlen(r->src, IFNAMSIZ - 1));
+		p = (char *) memcpy(p, ",dst=", 5) + 5;
+		p = exp_label(p, r->dst, strnlen(r->dst, IFNAMSIZ - 1));
+		p = (char *) memcpy(p, ",type=", 6) + 6;
+		p = exp_label(p, type_str, type_len);
+		p = (char *) memcpy(p, ",flags=", 7) + 7;
+		p = exp_label(p, flags_str, flags_len);
+		p = (char *) memcpy(p, "} ", 2) + 2;
+		p = fmt_u32(p, value);
+		*p++ = '\n';
+		e->len = p - e->body;
+	}
+
+	return 0;
+}
+
+/**
+ * @fn int exp_dump(struct exporter *e, uint64_t now)
+ * @brief Dumps the routes and renders their metrics at the start of the
+ *        body. If the dump fails no routes are rendered.
+ * @retval 0 on success, also if the dump failed
+ * @retval -ENOMEM if the body could not grow
+ */
+static int exp_dump(struct exporter *e, uint64_t now)
+{
+	int err;
+
+	e->dump_time = now;
+	err = ce_gw_list_table(e->ctx, 0, &e->table);
+	e->dump_ns = timing_now() - now;
+	e->dump_ns_sum += e->dump_ns;
+	e->dumps++;
+	e->up = err == 0;
+	if (err != 0) {
+		e->dump_errors++;
+		e->table.len = 0;
+	}
+
+	e->len = 0;
+	err = exp_routes(e, "cegw_route_handled_total",
+	                 "Frames handled by the route.",
+	                 offsetof(struct ce_gw_route, handled));
+	if (err == 0)
+		err = exp_routes(e, "cegw_route_dropped_total",
+		                 "Frames dropped by the route.",
+		                 offsetof(struct ce_gw_route, dropped));
+	e->routes_len = err == 0 ? e->len : 0;
+
+	return err;
+}
+
+/**
+ * @fn int exp_printf(struct exporter *e, const char *fmt, ...)
+ * @brief Appends a formatted string of at most ROW_MAX bytes to the body.
+ * @retval 0 on success
+ * @retval -ENOMEM if the body could not grow
+ */
+static int exp_printf(struct exporter *e, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+static int exp_printf(struct exporter *e, const char *fmt, ...)
+{
+	char *p = exp_reserve(e, ROW_MAX);
+	va_list ap;
+	int n;
+
+	if (p == NULL)
+		return -ENOMEM;
+	va_start(ap, fmt);
+	n = vsnprintf(p, ROW_MAX, fmt, ap);
+	va_end(ap);
+	e->len += n < ROW_MAX ? n : ROW_MAX - 1;
+
+	return 0;
+}
+
+int exporter_scrape(struct exporter *e, const char **body, size_t *len)
+{
+	uint64_t start = timing_now();
+	int err = 0;
+
+	/* the route metrics are rendered once per dump, only the metrics of
+	 * the exporter behind them every time */
+	if (e->dumps == 0 || e->routes_len == 0 ||
+	    start - e->dump_time >= e->interval * 1e9)
+		err = exp_dump(e, start);
+	e->len = e->routes_len;
+
+	if (err == 0)
+		err = exp_printf(e,
+			"# HELP cegw_up 1 if the last dump of the routes "
+			"succeeded.\n"
+			"# TYPE cegw_up gauge\n"
+			"cegw_up %d\n"
+			"# HELP cegw_routes Routes of the last dump.\n"
+			"# TYPE cegw_routes gauge\n"
+			"cegw_routes %zu\n"
+			"# HELP cegw_exporter_dump_age_seconds Age of the "
+			"served routes.\n"
+			"# TYPE cegw_exporter_dump_age_seconds gauge\n"
+			"cegw_exporter_dump_age_seconds %.9f\n",
+			e->up, e->table.len, (start - e->dump_time) / 1e9);
+	if (err == 0)
+		err = exp_printf(e,
+			"# HELP cegw_exporter_dump_errors_total Failed dumps "
+			"of the routes.\n"
+			"# TYPE cegw_exporter_dump_errors_total counter\n"
+			"cegw_exporter_dump_errors_total %" PRIu64 "\n"
+			"# HELP cegw_exporter_dump_duration_seconds Time of "
+			"the CE_GW_C_LIST dumps.\n"
+			"# TYPE cegw_exporter_dump_duration_seconds summary\n"
+			"cegw_exporter_dump_duration_seconds_sum %.9f\n"
+			"cegw_exporter_dump_duration_seconds_count %" PRIu64
+			"\n"
+			"# HELP cegw_exporter_last_dump_duration_seconds Time "
+			"of the last dump.\n"
+			"# TYPE cegw_exporter_last_dump_duration_seconds "
+			"gauge\n"
+			"cegw_exporter_last_dump_duration_seconds %.9f\n",
+			e->dump_errors, e->dump_ns_sum / 1e9, e->dumps,
+			e->dump_ns / 1e9);
+	if (err == 0)
+		err = exp_printf(e,
+			"# HELP cegw_exporter_scrape_duration_seconds Time "
+			"to render the previous scrapes.\n"
+			"# TYPE cegw_exporter_scrape_duration_seconds "
+			"summary\n"
+			"cegw_exporter_scrape_duration_seconds_sum %.9f\n"
+			"cegw_exporter_scrape_duration_seconds_count %" PRIu64
+			"\n"
+			"# HELP cegw_exporter_last_scrape_duration_seconds "
+			"Time to render the previous scrape.\n"
+			"# TYPE cegw_exporter_last_scrape_duration_seconds "
+			"gauge\n"
+			"cegw_exporter_last_scrape_duration_seconds %.9f\n",
+			e->scrape_ns_sum / 1e9, e->scrapes,
+			e->scrape_ns / 1e9);
+	if (err != 0)
+		return err;
+
+	e->scrape_ns = timing_now() - start;
+	e->scrape_ns_sum += e->scrape_ns;
+	e->scrapes++;
+
+	*body = e->body;
+	*len = e->len;
+	return 0;
+}
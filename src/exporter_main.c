@@ -0,0 +1,549 @@
+/**
+ * @file exporter_main.c
+ * @brief Control Area Network - Ethernet - Gateway - Metrics Exporter
+ * (Utility)
+ * @details "cegwctl exporter", the HTTP server of the metrics exporter. See
+ *          exporter.h.
+ * @author agent (agent@local)
+ * @date October, 2026
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#define _GNU_SOURCE /* accept4(), strcasestr() */
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "exporter.h"
+
+#define EXPORTER_EVENTS 64 /**< epoll events handled per loop */
+
+/** set by SIGINT and SIGTERM, ends exporter_main() */
+static volatile sig_atomic_t exporter_stop;
+
+/**
+ * @fn void exporter_signal(int sig)
+ * @brief Handler of SIGINT and SIGTERM.
+ */
+static void exporter_signal(int sig)
+{
+	exporter_stop = 1;
+}
+
+/**
+ * @struct exp_client
+ * @brief A connected HTTP client.
+ */
+struct exp_client {
+	int fd;				/**< socket */
+	char in[EXPORTER_REQ_MAX];	/**< received bytes */
+	size_t in_len;			/**< bytes in in */
+	char *out;			/**< bytes the socket did not take */
+	size_t out_len;			/**< bytes in out */
+	size_t out_size;		/**< allocated size of out */
+	size_t out_off;			/**< bytes of out sent */
+	int close;			/**< close after out is sent */
+};
+
+/**
+ * @struct exp_server
+ * @brief The state of exporter_main().
+ */
+struct exp_server {
+	struct exporter e;	/**< the metrics */
+	int epoll_fd;		/**< the listening socket and the clients */
+	int listen_fd;		/**< the listening socket */
+};
+
+/**
+ * @fn int exp_queue(struct exp_client *cl, const struct iovec *iov,
+ *                   int n, size_t skip)
+ * @brief Appends iov to the output of cl, without the first skip bytes.
+ * @retval 0 on success
+ * @retval -ENOMEM on failure
+ */
+static int exp_queue(struct exp_client *cl, const struct iovec *iov, int n,
+                     size_t skip)
+{
+	for (int i = 0; i < n; ++i) {
+		size_t len = iov[i].iov_len;
+		const char *base = iov[i].iov_base;
+
+		if (skip >= len) {
+			skip -= len;
+			continue;
+		}
+		base += skip;
+		len -= skip;
+		skip = 0;
+
+		if (cl->out_size - cl->out_len < len) {
+			size_t size = cl->out_size ? cl->out_size : 4096;
+			char *out;
+
+			while (size - cl->out_len < len)
+				size *= 2;
+			out = realloc(cl->out, size);
+			if (out == NULL)
+				return -ENOMEM;
+			cl->out = out;
+			cl->out_size = size;
+		}
+		memcpy(cl->out + cl->out_len, base, len);
+		cl->out_len += len;
+	}
+
+	return 0;
+}
+
+/**
+ * @fn int exp_respond(struct exp_client *cl, const char *status,
+ *                     const char *headers, const char *body, size_t len,
+ *                     int head)
+ * @brief Sends a response. Usually the socket takes it at once, straight
+ *        from the rendered body; only what it does not take is copied to
+ *        the output of cl.
+ * @param headers The Content-Type and other header lines, CRLF separated
+ * @param head 1 for HEAD, which gets no body
+ * @retval 0 on success
+ * @retval <0 if the connection failed
+ */
+static int exp_respond(struct exp_client *cl, const char *status,
+                       const char *headers, const char *body, size_t len,
+                       int head)
+{
+	char hdr[256];
+	struct iovec iov[2];
+	ssize_t n = 0;
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = snprintf(hdr, sizeof(hdr),
+	                          "HTTP/1.1 %s\r\n"
+	                          "Content-Type: %s\r\n"
+	                          "Content-Length: %zu\r\n"
+	                          "%s\r\n", status, headers, len,
+	                          cl->close ? "Connection: close\r\n" : "");
+	iov[1].iov_base = (char *) body;
+	iov[1].iov_len = head ? 0 : len;
+
+	/* an earlier response is still waiting, keep the order */
+	if (cl->out_len == 0) {
+		struct msghdr mh = { .msg_iov = iov, .msg_iovlen = 2 };
+
+		do {
+			n = sendmsg(cl->fd, &mh, MSG_NOSIGNAL);
+		} while (n < 0 && errno == EINTR);
+		if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+			return -errno;
+		if (n < 0)
+			n = 0;
+	}
+
+	return exp_queue(cl, iov, 2, n);
+}
+
+/**
+ * @fn int exp_request(struct exp_server *s, struct exp_client *cl,
+ *                     char *req)
+ * @brief Answers the request header req, which ends with an empty line.
+ * @retval 0 on success
+ * @retval <0 if the connection failed
+ */
+static int exp_request(struct exp_server *s, struct exp_client *cl,
+                       char *req)
+{
+	static const char text[] = "text/plain; charset=utf-8";
+	char *method = req, *target, *version, *end;
+
+	/* METHOD SP TARGET SP VERSION CRLF */
+	end = strpbrk(req, "\r\n");
+	*end = '\0';
+	target = strchr(method, ' ');
+	version = target ? strchr(target + 1, ' ') : NULL;
+	if (version == NULL || strncmp(version + 1, "HTTP/1.", 7) != 0) {
+		cl->close = 1;
+		return exp_respond(cl, "400 Bad Request", text,
+		                   "Bad Request\n", 12, 0);
+	}
+	*target++ = '\0';
+	*version++ = '\0';
+
+	/* HTTP/1.1 keeps the connection, HTTP/1.0 closes it by default */
+	char *headers = end + 1;
+	if (strcasestr(headers, "\nConnection: close") ||
+	    (strcmp(version, "HTTP/1.0") == 0 &&
+	     !strcasestr(headers, "\nConnection: keep-alive")))
+		cl->close = 1;
+
+	int head = strcmp(method, "HEAD") == 0;
+	if (!head && strcmp(method, "GET") != 0)
+		return exp_respond(cl, "405 Method Not Allowed",
+		                   "text/plain; charset=utf-8\r\n"
+		                   "Allow: GET, HEAD",
+		                   "Method Not Allowed\n", 19, 0);
+
+	size_t path_len = strcspn(target, "?");
+	if (path_len != 8 || strncmp(target, "/metrics", 8) != 0)
+		return exp_respond(cl, "404 Not Found", text,
+		                   "Not Found, see /metrics\n", 24, head);
+
+	const char *body;
+	size_t len;
+	if (exporter_scrape(&s->e, &body, &len) != 0)
+		return exp_respond(cl, "500 Internal Server Error", text,
+		                   "Out of memory\n", 14, head);
+
+	return exp_respond(cl, "200 OK", "text/plain; version=0.0.4; "
+	                   "charset=utf-8", body, len, head);
+}
+
+/**
+ * @fn void exp_close(struct exp_server *s, struct exp_client *cl)
+ * @brief Closes the connection and frees the client.
+ */
+static void exp_close(struct exp_server *s, struct exp_client *cl)
+{
+	epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, cl->fd, NULL);
+	close(cl->fd);
+	free(cl->out);
+	free(cl);
+}
+
+/**
+ * @fn int exp_flush(struct exp_server *s, struct exp_client *cl)
+ * @brief Sends as much of the output as possible and waits for EPOLLOUT if
+ *        something is left.
+ * @retval 0 on success
+ * @retval <0 if the connection failed or is to be closed
+ */
+static int exp_flush(struct exp_server *s, struct exp_client *cl)
+{
+	while (cl->out_off < cl->out_len) {
+		ssize_t n = send(cl->fd, cl->out + cl->out_off,
+		                 cl->out_len - cl->out_off, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n < 0)
+			return -errno;
+
+		cl->out_off += n;
+	}
+
+	struct epoll_event ev = { .data.ptr = cl };
+	if (cl->out_off == cl->out_len) {
+		if (cl->close)
+			return -ESHUTDOWN;
+		cl->out_off = 0;
+		cl->out_len = 0;
+		ev.events = EPOLLIN;
+	} else {
+		/* no more requests until the responses are sent */
+		ev.events = EPOLLOUT;
+	}
+
+	return epoll_ctl(s->epoll_fd, EPOLL_CTL_MOD, cl->fd, &ev) ? -errno : 0;
+}
+
+/**
+ * @fn int exp_read(struct exp_server *s, struct exp_client *cl)
+ * @brief Reads from the client and answers all complete requests.
+ * @retval 0 on success
+ * @retval <0 if the connection was closed or failed
+ */
+static int exp_read(struct exp_server *s, struct exp_client *cl)
+{
+	while (!cl->close) {
+		ssize_t n = recv(cl->fd, cl->in + cl->in_len,
+		                 sizeof(cl->in) - 1 - cl->in_len, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n < 0)
+			return -errno;
+		if (n == 0)
+			return -ECONNRESET;
+
+		cl->in_len += n;
+		cl->in[cl->in_len] = '\0';
+
+		/* answer the complete requests, a GET has no body */
+		size_t off = 0;
+		while (!cl->close) {
+			char *req = cl->in + off;
+			char *end = strstr(req, "\r\n\r\n");
+			size_t len = 4;
+
+			if (end == NULL) {
+				end = strstr(req, "\n\n");
+				len = 2;
+			}
+			if (end == NULL)
+				break;
+			end[len - 1] = '\0';
+
+			int err = exp_request(s, cl, req);
+			if (err != 0)
+				return err;
+			off = end + len - cl->in;
+		}
+
+		memmove(cl->in, cl->in + off, cl->in_len - off + 1);
+		cl->in_len -= off;
+		if (cl->in_len == sizeof(cl->in) - 1) {
+			static const char text[] = "text/plain; charset=utf-8";
+
+			cl->close = 1;
+			int err = exp_respond(cl, "431 Request Header Fields "
+			                      "Too Large", text, "Too Large\n",
+			                      10, 0);
+			if (err != 0)
+				return err;
+		}
+	}
+
+	return exp_flush(s, cl);
+}
+
+/**
+ * @fn void exp_accept(struct exp_server *s)
+ * @brief Accepts all waiting connections.
+ */
+static void exp_accept(struct exp_server *s)
+{
+	for (;;) {
+		int fd = accept4(s->listen_fd, NULL, NULL,
+		                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK &&
+			    errno != EINTR)
+				perror("cegwctl exporter: Error: accept");
+			return;
+		}
+
+		struct exp_client *cl = calloc(1, sizeof(*cl));
+		if (cl == NULL) {
+			close(fd);
+			continue;
+		}
+		cl->fd = fd;
+
+		struct epoll_event ev = { .events = EPOLLIN, .data.ptr = cl };
+		if (epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+			close(fd);
+			free(cl);
+		}
+	}
+}
+
+/**
+ * @fn int exp_listen(const char *str)
+ * @brief Creates the non-blocking listening socket at ADDR:PORT or
+ *        [ADDR]:PORT str.
+ * @retval >=0 the socket
+ * @retval <0 -errno after printing an error
+ */
+static int exp_listen(const char *str)
+{
+	const char *port = strrchr(str, ':');
+	struct addrinfo hints, *res;
+	char host[256];
+	size_t n;
+	int fd, err, on = 1;
+
+	if (port == NULL || port[1] == '\0' ||
+	    (size_t) (port - str) >= sizeof(host)) {
+		fprintf(stderr, "cegwctl exporter: Error: %s is not "
+		        "ADDR:PORT\n", str);
+		return -EINVAL;
+	}
+
+	n = port - str;
+	memcpy(host, str, n);
+	host[n] = '\0';
+	if (n >= 2 && host[0] == '[' && host[n - 1] == ']') {
+		memmove(host, host + 1, n - 2);
+		host[n - 2] = '\0';
+	}
+
+	/* an empty ADDR listens on all addresses */
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_NUMERICSERV | AI_PASSIVE;
+	err = getaddrinfo(host[0] ? host : NULL, port + 1, &hints, &res);
+	if (err != 0) {
+		fprintf(stderr, "cegwctl exporter: Error: %s: %s\n", str,
+		        gai_strerror(err));
+		return -EINVAL;
+	}
+
+	fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK |
+	            SOCK_CLOEXEC, 0);
+	if (fd >= 0)
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (fd < 0 || bind(fd, res->ai_addr, res->ai_addrlen) != 0 ||
+	    listen(fd, SOMAXCONN) != 0) {
+		err = -errno;
+		fprintf(stderr, "cegwctl exporter: Error: can not listen on "
+		        "%s: %s\n", str, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		fd = err;
+	}
+
+	freeaddrinfo(res);
+	return fd;
+}
+
+int exporter_main(int argc, char *argv[])
+{
+	const char *listen_str = EXPORTER_LISTEN;
+	double interval = EXPORTER_INTERVAL;
+	struct exp_server s;
+	int ret = EXIT_FAILURE;
+	char *end;
+	int c;
+
+	static struct option long_options[] = {
+		{"listen",   required_argument, 0, 'l'},
+		{"interval", required_argument, 0, 'i'},
+		{0, 0, 0, 0},
+	};
+
+	optind = 1;
+	while ((c = getopt_long(argc, argv, "l:i:", long_options,
+	                        NULL)) != -1) {
+		switch (c) {
+		case 'l':
+			listen_str = optarg;
+			break;
+
+		case 'i':
+			interval = strtod(optarg, &end);
+			if (end == optarg || *end != '\0' || interval < 0 ||
+			    interval > 86400) {
+				fprintf(stderr, "cegwctl exporter: Error: "
+				        "interval must be between 0 and "
+				        "86400\n");
+				return EXIT_FAILURE;
+			}
+			break;
+
+		default:
+			/* getopt_long already printed an error message. */
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind < argc) {
+		fprintf(stderr, "cegwctl exporter: Error: unexpected argument "
+		        "%s\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	struct cegw_ctx *ctx = cegw_ctx_alloc();
+	if (ctx == NULL) {
+		fprintf(stderr, "Error during initialisation of Socket or "
+		        "Netlink Family\n");
+		return EXIT_FAILURE;
+	}
+	exporter_init(&s.e, ctx, interval);
+
+	s.listen_fd = exp_listen(listen_str);
+	s.epoll_fd = -1;
+	if (s.listen_fd < 0)
+		goto out;
+
+	s.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+	if (s.epoll_fd < 0 ||
+	    epoll_ctl(s.epoll_fd, EPOLL_CTL_ADD, s.listen_fd, &ev) != 0) {
+		perror("cegwctl exporter: Error: epoll");
+		goto out;
+	}
+
+	struct sigaction sa, old_int, old_term;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = exporter_signal;
+	sigaction(SIGINT, &sa, &old_int);
+	sigaction(SIGTERM, &sa, &old_term);
+
+	printf("serving http://%s/metrics, routes dumped at most every %g "
+	       "s\n", listen_str, interval);
+	fflush(stdout);
+
+	ret = EXIT_SUCCESS;
+	while (!exporter_stop) {
+		struct epoll_event events[EXPORTER_EVENTS];
+		int n = epoll_wait(s.epoll_fd, events, EXPORTER_EVENTS, -1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			perror("cegwctl exporter: Error: epoll_wait");
+			ret = EXIT_FAILURE;
+			break;
+		}
+
+		for (int i = 0; i < n; ++i) {
+			struct exp_client *cl = events[i].data.ptr;
+			int err = 0;
+
+			if (cl == NULL) {
+				exp_accept(&s);
+				continue;
+			}
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP))
+				err = -ECONNRESET;
+			if (err == 0 && (events[i].events & EPOLLOUT))
+				err = exp_flush(&s, cl);
+			if (err == 0 && (events[i].events & EPOLLIN))
+				err = exp_read(&s, cl);
+
+			if (err != 0)
+				exp_close(&s, cl);
+		}
+	}
+
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+
+out:
+	/* the clients still connected are closed by the exit */
+	if (s.epoll_fd >= 0)
+		close(s.epoll_fd);
+	if (s.listen_fd >= 0)
+		close(s.listen_fd);
+	exporter_free(&s.e);
+	cegw_ctx_free(ctx);
+	return ret;
+}
@@ -0,0 +1,166 @@
+/**
+ * @file famcache.c
+ * @brief Control Area Network - Ethernet - Gateway - Family Cache (Utility)
+ * @details Caches the generic netlink family ID of CE_GW in a runtime file,
+ *          so that short-lived calls of cegwctl save the round trip to the
+ *          generic netlink controller.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "famcache.h"
+
+#define IDENT_SIZE 256 /**< maximum length of the module identity */
+
+/**
+ * @fn const char *famcache_path(char *buf, size_t size)
+ * @brief Returns the path of the cache file.
+ * @details FAMCACHE_ENV if set, FAMCACHE_PATH if /run is writable, else the
+ *          file in XDG_RUNTIME_DIR.
+ * @retval NULL if there is no usable place.
+ * @ingroup net
+ */
+static const char *famcache_path(char *buf, size_t size)
+{
+	const char *path = getenv(FAMCACHE_ENV);
+	if (path != NULL)
+		return path[0] ? path : NULL; /* empty disables the cache */
+
+	if (access("/run", W_OK) == 0)
+		return FAMCACHE_PATH;
+
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	if (dir == NULL)
+		return NULL;
+
+	if (snprintf(buf, size, "%s/cegwctl.family", dir) >= (int) size)
+		return NULL;
+
+	return buf;
+}
+
+/**
+ * @fn int module_ident(char *ident, size_t size)
+ * @brief Returns a string which changes whenever the module is reloaded.
+ * @details It consists of the creation time of /sys/module/ce_gw, which is
+ *          the load time of the module, and the size and address of the
+ *          module from /proc/modules (the address is only visible for root).
+ * @retval 0 on success
+ * @retval <0 if the module is not loaded
+ * @ingroup net
+ */
+static int module_ident(char *ident, size_t size)
+{
+	struct stat st;
+	char line[IDENT_SIZE];
+	char name[64];
+	unsigned long mod_size = 0;
+	char addr[32] = "-";
+
+	if (stat("/sys/module/" FAMCACHE_MODULE, &st) != 0)
+		return -errno;
+
+	FILE *file = fopen("/proc/modules", "r");
+	if (file != NULL) {
+		while (fgets(line, sizeof(line), file) != NULL) {
+			/* NAME SIZE REFS DEPS STATE ADDRESS */
+			if (sscanf(line, "%63s %lu %*s %*s %*s %31s", name,
+			           &mod_size, addr) >= 2 &&
+			    strcmp(name, FAMCACHE_MODULE) == 0)
+				break;
+			mod_size = 0;
+			strcpy(addr, "-");
+		}
+		fclose(file);
+	}
+
+	snprintf(ident, size, "%lld.%09ld,%lu,%s",
+	         (long long) st.st_ctim.tv_sec, st.st_ctim.tv_nsec,
+	         mod_size, addr);
+	return 0;
+}
+
+int famcache_read(int *id, int *version)
+{
+	char buf[IDENT_SIZE];
+	char ident[IDENT_SIZE];
+	char cached[IDENT_SIZE];
+	const char *path = famcache_path(buf, sizeof(buf));
+
+	if (path == NULL || module_ident(ident, sizeof(ident)) != 0)
+		return -ENOENT;
+
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+		return -errno;
+
+	/* format: ID VERSION IDENT */
+	int n = fscanf(file, "%d %d %255s", id, version, cached);
+	fclose(file);
+
+	if (n != 3 || *id <= 0 || strcmp(ident, cached) != 0)
+		return -ESTALE;
+
+	return 0;
+}
+
+void famcache_write(int id, int version)
+{
+	char buf[IDENT_SIZE];
+	char ident[IDENT_SIZE];
+	char tmp[IDENT_SIZE + 8];
+	const char *path = famcache_path(buf, sizeof(buf));
+
+	if (path == NULL || module_ident(ident, sizeof(ident)) != 0)
+		return;
+
+	/* write a temporary file and rename it, so a concurrent
+	 * famcache_read() never sees a half written file. The name is unique
+	 * per writer, threads of one process resolve at the same time too */
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >=
+	    (int) sizeof(tmp))
+		return;
+
+	int fd = mkstemp(tmp);
+	if (fd < 0)
+		return;
+
+	/* readable by all users like a file of fopen(), not 0600 */
+	fchmod(fd, 0644);
+	FILE *file = fdopen(fd, "w");
+	if (file == NULL) {
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+
+	fprintf(file, "%d %d %s\n", id, version, ident);
+	if (fclose(file) != 0 || rename(tmp, path) != 0)
+		unlink(tmp);
+}
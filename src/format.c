@@ -0,0 +1,538 @@
+/**
+ * @file format.c
+ * @brief Control Area Network - Ethernet - Gateway - Output Format (Utility)
+ * @details Renders the route table into a large output buffer, which is
+ *          written with few write() calls. The strings of types and flags are
+ *          computed once, the numbers are formatted without printf().
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "format.h"
+
+#define FLAGS_BITS 8 /**< number of flags with precomputed combinations */
+#define FLAGS_STR_SIZE 256 /**< size of one precomputed flags string */
+
+/**
+ * @struct fmt_str
+ * @brief A precomputed string with its length.
+ */
+struct fmt_str {
+	const char *str;	/**< the string */
+	size_t len;		/**< strlen(str) */
+};
+
+static int format_ready = 0; /**< 1 after format_init() */
+static struct fmt_str type_strs[256]; /**< indexed by type */
+static struct fmt_str flags_strs[1 << FLAGS_BITS]; /**< indexed by flags */
+static struct fmt_str flags_json[1 << FLAGS_BITS]; /**< as JSON array */
+static uint32_t flags_mask; /**< bits of the known flags */
+/** storage of the flags strings */
+static char flags_buf[1 << FLAGS_BITS][FLAGS_STR_SIZE];
+/** storage of the flags JSON arrays */
+static char flags_json_buf[1 << FLAGS_BITS][FLAGS_STR_SIZE];
+
+/* the binary records are read by other programs, the layout must not
+ * change by accident */
+_Static_assert(sizeof(struct ce_gw_bin_header) == 16,
+               "layout of struct ce_gw_bin_header changed");
+_Static_assert(sizeof(struct ce_gw_bin_route) == 20 + 2 * IFNAMSIZ,
+               "layout of struct ce_gw_bin_route changed");
+
+/** names of the formats, the index is FORMAT_* */
+static const struct enums format_array[] = {
+	{ "text"	}, /**< FORMAT_TEXT with Index 0 */
+	{ "json"	}, /**< FORMAT_JSON with Index 1 */
+	{ "csv"		}, /**< FORMAT_CSV  with Index 2 */
+	{ "bin"		}, /**< FORMAT_BIN  with Index 3 */
+	{ 0		}  /**< End Delimiter            */
+};
+
+/** "00" to "99", used to format two digits at once */
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+int outbuf_init(struct outbuf *out, int fd, size_t size)
+{
+	if (size < ROW_MAX)
+		size = ROW_MAX;
+
+	out->buf = malloc(size);
+	if (out->buf == NULL)
+		return -ENOMEM;
+
+	out->fd = fd;
+	out->len = 0;
+	out->size = size;
+	out->err = 0;
+
+	return 0;
+}
+
+int outbuf_flush(struct outbuf *out)
+{
+	size_t off = 0;
+
+	while (off < out->len && out->err == 0) {
+		ssize_t n = write(out->fd, out->buf + off, out->len - off);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			out->err = -errno;
+		else
+			off += n;
+	}
+
+	/* after an error the rest is dropped, the caller sees out->err */
+	out->len = 0;
+	return out->err;
+}
+
+void outbuf_free(struct outbuf *out)
+{
+	outbuf_flush(out);
+	free(out->buf);
+	out->buf = NULL;
+	out->size = 0;
+}
+
+void outbuf_put(struct outbuf *out, const char *str, size_t len)
+{
+	while (len > 0) {
+		if (out->len == out->size)
+			outbuf_flush(out);
+
+		size_t n = out->size - out->len;
+		if (n > len)
+			n = len;
+
+		memcpy(out->buf + out->len, str, n);
+		out->len += n;
+		str += n;
+		len -= n;
+	}
+}
+
+char *fmt_u32(char *p, uint32_t value)
+{
+	char tmp[10];
+	char *t = tmp + sizeof(tmp);
+
+	while (value >= 100) {
+		unsigned int i = (value % 100) * 2;
+		value /= 100;
+		*--t = digit_pairs[i + 1];
+		*--t = digit_pairs[i];
+	}
+
+	if (value >= 10) {
+		*--t = digit_pairs[value * 2 + 1];
+		*--t = digit_pairs[value * 2];
+	} else {
+		*--t = '0' + value;
+	}
+
+	size_t len = tmp + sizeof(tmp) - t;
+	memcpy(p, t, len);
+
+	return p + len;
+}
+
+void format_init(void)
+{
+	int nflags = 0;
+
+	if (format_ready)
+		return;
+
+	for (int i = 0; i < 256; ++i) {
+		const char *str = enum2str(i, type_array, TYPE_MAX);
+		type_strs[i].str = str ? str : "?";
+		type_strs[i].len = strlen(type_strs[i].str);
+	}
+
+	while (nflags < FLAGS_BITS && flags_array[nflags].name != 0)
+		nflags++;
+	flags_mask = (1u << nflags) - 1;
+
+	for (uint32_t bits = 0; bits <= flags_mask; ++bits) {
+		flags2str(bits, flags_array, flags_buf[bits], FLAGS_STR_SIZE);
+		flags_strs[bits].str = flags_buf[bits];
+		flags_strs[bits].len = strlen(flags_buf[bits]);
+
+		/* ["NAME",...], names which do not fit are left out */
+		char *json = flags_json_buf[bits];
+		size_t len = 0;
+		json[len++] = '[';
+		for (int i = 0; i < nflags; ++i) {
+			const char *name = flags_array[i].name;
+			size_t name_len = strlen(name);
+
+			if (!(bits & (1u << i)) ||
+			    len + 6 * name_len + 5 > FLAGS_STR_SIZE)
+				continue;
+			if (len > 1)
+				json[len++] = ',';
+			len += fmt_json_str(json + len, name, name_len);
+		}
+		json[len++] = ']';
+		json[len] = '\0';
+		flags_json[bits].str = json;
+		flags_json[bits].len = len;
+	}
+
+	format_ready = 1;
+}
+
+const char *format_type(uint8_t type, size_t *len)
+{
+	format_init();
+
+	*len = type_strs[type].len;
+	return type_strs[type].str;
+}
+
+const char *format_flags(uint32_t flags, size_t *len)
+{
+	format_init();
+
+	flags &= flags_mask;
+	*len = flags_strs[flags].len;
+	return flags_strs[flags].str;
+}
+
+/**
+ * @fn char *fmt_pad(char *p, char *start, size_t width)
+ * @brief Pads the field which starts at start with spaces to width and
+ *        appends the separating space (like "%-Ns ").
+ * @returns The end of the field.
+ * @ingroup trans
+ */
+static inline char *fmt_pad(char *p, char *start, size_t width)
+{
+	while ((size_t) (p - start) < width)
+		*p++ = ' ';
+	*p++ = ' ';
+
+	return p;
+}
+
+/**
+ * @fn char *fmt_str(char *p, const char *str, size_t len, size_t width)
+ * @brief Appends a string field of at least width characters and a space.
+ * @ingroup trans
+ */
+static inline char *fmt_str(char *p, const char *str, size_t len,
+                            size_t width)
+{
+	memcpy(p, str, len);
+
+	return fmt_pad(p + len, p, width);
+}
+
+/**
+ * @fn char *fmt_num(char *p, uint32_t value, size_t width)
+ * @brief Appends a number field of at least width characters and a space.
+ * @ingroup trans
+ */
+static inline char *fmt_num(char *p, uint32_t value, size_t width)
+{
+	return fmt_pad(fmt_u32(p, value), p, width);
+}
+
+void format_header(struct outbuf *out)
+{
+	static const char header[] =
+		" ID       SRC    DST    TYPE   HANDLED  DROPPED  FLAGS\n";
+
+	outbuf_put(out, header, sizeof(header) - 1);
+}
+
+void format_route(struct outbuf *out, const struct ce_gw_route *route)
+{
+	const char *type_str, *flags_str;
+	size_t type_len, flags_len;
+
+	type_str = format_type(route->type, &type_len);
+	flags_str = format_flags(route->flags, &flags_len);
+
+	/* same columns as " %-8u %-6s %-6s %-6s %-8u %-8u %s\n" */
+	char *p = outbuf_reserve(out, ROW_MAX);
+	*p++ = ' ';
+	p = fmt_num(p, route->id, 8);
+	p = fmt_str(p, route->src, strnlen(route->src, IFNAMSIZ - 1), 6);
+	p = fmt_str(p, route->dst, strnlen(route->dst, IFNAMSIZ - 1), 6);
+	p = fmt_str(p, type_str, type_len, 6);
+	p = fmt_num(p, route->handled, 8);
+	p = fmt_num(p, route->dropped, 8);
+	memcpy(p, flags_str, flags_len);
+	p += flags_len;
+	*p++ = '\n';
+
+	outbuf_commit(out, p);
+}
+
+int str2format(const char *str)
+{
+	for (int i = 0; format_array[i].name != 0; ++i) {
+		if (strcasecmp(str, format_array[i].name) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+size_t fmt_json_str(char *p, const char *str, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	char *start = p;
+
+	*p++ = '"';
+	for (size_t i = 0; i < len; ++i) {
+		unsigned char c = str[i];
+
+		if (c == '"' || c == '\\') {
+			*p++ = '\\';
+			*p++ = c;
+		} else if (c < 0x20) {
+			memcpy(p, "\\u00", 4);
+			p[4] = hex[c >> 4];
+			p[5] = hex[c & 0xf];
+			p += 6;
+		} else {
+			*p++ = c;
+		}
+	}
+	*p++ = '"';
+
+	return p - start;
+}
+
+char *fmt_csv_str(char *p, const char *str, size_t len)
+{
+	if (strcspn(str, ",\"\r\n") >= len) {
+		memcpy(p, str, len);
+		return p + len;
+	}
+
+	*p++ = '"';
+	for (size_t i = 0; i < len; ++i) {
+		if (str[i] == '"')
+			*p++ = '"';
+		*p++ = str[i];
+	}
+	*p++ = '"';
+
+	return p;
+}
+
+/**
+ * @fn void format_json(struct outbuf *out, const struct ce_gw_route *route,
+ *                      int first)
+ * @brief Appends one route as JSON object. All but the first are preceded
+ *        by ','.
+ * @ingroup trans
+ */
+static void format_json(struct outbuf *out, const struct ce_gw_route *route,
+                        int first)
+{
+	const char *type_str;
+	size_t type_len;
+	uint32_t flags = route->flags & flags_mask;
+
+	type_str = format_type(route->type, &type_len);
+
+	char *p = outbuf_reserve(out, ROW_MAX);
+	if (!first)
+		*p++ = ',';
+	p = (char *) memcpy(p, "{\"id\":", 6) + 6;
+	p = fmt_u32(p, route->id);
+	p = (char *) memcpy(p, ",\"src\":", 7) + 7;
+	p += fmt_json_str(p, route->src, strnlen(route->src, IFNAMSIZ - 1));
+	p = (char *) memcpy(p, ",\"dst\":", 7) + 7;
+	p += fmt_json_str(p, route->dst, strnlen(route->dst, IFNAMSIZ - 1));
+	p = (char *) memcpy(p, ",\"type\":", 8) + 8;
+	p += fmt_json_str(p, type_str, type_len);
+	p = (char *) memcpy(p, ",\"handled\":", 11) + 11;
+	p = fmt_u32(p, route->handled);
+	p = (char *) memcpy(p, ",\"dropped\":", 11) + 11;
+	p = fmt_u32(p, route->dropped);
+	p = (char *) memcpy(p, ",\"flags\":", 9) + 9;
+	p = fmt_u32(p, route->flags);
+	p = (char *) memcpy(p, ",\"flag_names\":", 14) + 14;
+	memcpy(p, flags_json[flags].str, flags_json[flags].len);
+	p += flags_json[flags].len;
+	*p++ = '}';
+	*p++ = '\n';
+
+	outbuf_commit(out, p);
+}
+
+/**
+ * @fn void format_csv(struct outbuf *out, const struct ce_gw_route *route)
+ * @brief Appends one route as CSV line: id,src,dst,type,handled,dropped,flags
+ *        where flags is the number.
+ * @ingroup trans
+ */
+static void format_csv(struct outbuf *out, const struct ce_gw_route *route)
+{
+	const char *type_str;
+	size_t type_len;
+
+	type_str = format_type(route->type, &type_len);
+
+	char *p = outbuf_reserve(out, ROW_MAX);
+	p = fmt_u32(p, route->id);
+	*p++ = ',';
+	p = fmt_csv_str(p, route->src, strnlen(route->src, IFNAMSIZ - 1));
+	*p++ = ',';
+	p = fmt_csv_str(p, route->dst, strnlen(route->dst, IFNAMSIZ - 1));
+	*p++ = ',';
+	memcpy(p, type_str, type_len);
+	p += type_len;
+	*p++ = ',';
+	p = fmt_u32(p, route->handled);
+	*p++ = ',';
+	p = fmt_u32(p, route->dropped);
+	*p++ = ',';
+	p = fmt_u32(p, route->flags);
+	*p++ = '\n';
+
+	outbuf_commit(out, p);
+}
+
+/**
+ * @fn void format_bin(struct outbuf *out, const struct ce_gw_route *route)
+ * @brief Appends one route as struct ce_gw_bin_route.
+ * @ingroup trans
+ */
+static void format_bin(struct outbuf *out, const struct ce_gw_route *route)
+{
+	struct ce_gw_bin_route *rec;
+
+	rec = (struct ce_gw_bin_route *) outbuf_reserve(out, sizeof(*rec));
+	memset(rec, 0, sizeof(*rec));
+	rec->id = route->id;
+	rec->flags = route->flags;
+	rec->handled = route->handled;
+	rec->dropped = route->dropped;
+	rec->type = route->type;
+	memcpy(rec->src, route->src, strnlen(route->src, IFNAMSIZ - 1));
+	memcpy(rec->dst, route->dst, strnlen(route->dst, IFNAMSIZ - 1));
+
+	outbuf_commit(out, (char *) (rec + 1));
+}
+
+int format_stream_begin(struct format_stream *fs, int fd,
+                        unsigned int format)
+{
+	static const char csv_header[] =
+		"id,src,dst,type,handled,dropped,flags\n";
+	int header = !(format & FORMAT_NO_HEADER);
+
+	if (outbuf_init(&fs->out, fd, OUTBUF_SIZE) != 0)
+		return -ENOMEM;
+
+	format_init();
+	fs->format = format;
+	fs->rows = 0;
+
+	switch (format & FORMAT_MASK) {
+	case FORMAT_JSON:
+		outbuf_put(&fs->out, "[\n", 2);
+		break;
+	case FORMAT_CSV:
+		if (header)
+			outbuf_put(&fs->out, csv_header,
+			           sizeof(csv_header) - 1);
+		break;
+	case FORMAT_BIN: {
+		struct ce_gw_bin_header hdr;
+
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, CE_GW_BIN_MAGIC, sizeof(hdr.magic));
+		hdr.version = CE_GW_BIN_VERSION;
+		hdr.header_size = sizeof(hdr);
+		hdr.byte_order = CE_GW_BIN_BYTE_ORDER;
+		hdr.record_size = sizeof(struct ce_gw_bin_route);
+		outbuf_put(&fs->out, (char *) &hdr, sizeof(hdr));
+		break;
+	}
+	default:
+		if (header)
+			format_header(&fs->out);
+		break;
+	}
+
+	return 0;
+}
+
+int format_stream_route(const struct ce_gw_route *route, void *arg)
+{
+	struct format_stream *fs = arg;
+
+	switch (fs->format & FORMAT_MASK) {
+	case FORMAT_JSON:
+		format_json(&fs->out, route, fs->rows == 0);
+		break;
+	case FORMAT_CSV:
+		format_csv(&fs->out, route);
+		break;
+	case FORMAT_BIN:
+		format_bin(&fs->out, route);
+		break;
+	default:
+		format_route(&fs->out, route);
+		break;
+	}
+
+	fs->rows++;
+	return 0;
+}
+
+int format_stream_end(struct format_stream *fs)
+{
+	int err;
+
+	if ((fs->format & FORMAT_MASK) == FORMAT_JSON)
+		outbuf_put(&fs->out, "]\n", 2);
+
+	err = outbuf_flush(&fs->out);
+	outbuf_free(&fs->out);
+
+	return err;
+}
@@ -0,0 +1,379 @@
+/**
+ * @file forward.c
+ * @brief Control Area Network - Ethernet - Gateway - UDP Forwarding
+ * (Utility)
+ * @details The userspace TYPE_UDP data path. See forward.h.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/can/raw.h>
+#include "forward.h"
+
+/**
+ * @fn int frame_valid(const struct forward *f,
+ *                     const struct canfd_frame *cf, size_t len)
+ * @brief Checks a received frame of len bytes: CAN_MTU with a DLC up to 8,
+ *        or with F_CAN_FD CANFD_MTU with a length up to 64.
+ */
+static int frame_valid(const struct forward *f, const struct canfd_frame *cf,
+                       size_t len)
+{
+	if (len == CAN_MTU)
+		return cf->len <= CAN_MAX_DLEN;
+	if (len == CANFD_MTU && (f->flags & F_CAN_FD))
+		return cf->len <= CANFD_MAX_DLEN;
+
+	return 0;
+}
+
+int forward_init(struct forward *f, int can_fd, int udp_fd, uint32_t flags,
+                 unsigned int batch)
+{
+	if (batch == 0 || batch > FORWARD_BATCH_MAX)
+		return -EINVAL;
+
+	memset(f, 0, sizeof(*f));
+	f->can_fd = can_fd;
+	f->udp_fd = udp_fd;
+	f->flags = flags;
+	f->batch = batch;
+	f->frames = calloc(batch, sizeof(*f->frames));
+	f->iov = calloc(batch, sizeof(*f->iov));
+	f->msgs = calloc(batch, sizeof(*f->msgs));
+	if (f->frames == NULL || f->iov == NULL || f->msgs == NULL) {
+		free(f->frames);
+		free(f->iov);
+		free(f->msgs);
+		return -ENOMEM;
+	}
+
+	/* every message keeps its iovec, forward_run() swaps the frames */
+	for (unsigned int i = 0; i < batch; ++i) {
+		f->iov[i].iov_base = &f->frames[i];
+		f->msgs[i].msg_hdr.msg_iov = &f->iov[i];
+		f->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	strcpy(f->can_name, "can");
+	strcpy(f->udp_name, "udp");
+	return 0;
+}
+
+/**
+ * @fn int forward_addr(const char *str, int passive,
+ *                      struct sockaddr_storage *ss, socklen_t *len)
+ * @brief Resolves HOST:PORT or [HOST]:PORT.
+ * @retval 0 on success
+ * @retval -EINVAL after printing an error
+ */
+static int forward_addr(const char *str, int passive,
+                        struct sockaddr_storage *ss, socklen_t *len)
+{
+	const char *port = strrchr(str, ':');
+	struct addrinfo hints, *res;
+	char host[256];
+	size_t n;
+	int err;
+
+	if (port == NULL || port == str || port[1] == '\0' ||
+	    (size_t) (port - str) >= sizeof(host)) {
+		fprintf(stderr, "forward: Error: %s is not HOST:PORT\n", str);
+		return -EINVAL;
+	}
+
+	n = port - str;
+	memcpy(host, str, n);
+	host[n] = '\0';
+	if (host[0] == '[' && host[n - 1] == ']') {
+		memmove(host, host + 1, n - 2);
+		host[n - 2] = '\0';
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_flags = AI_NUMERICSERV | (passive ? AI_PASSIVE : 0);
+	err = getaddrinfo(host, port + 1, &hints, &res);
+	if (err != 0) {
+		fprintf(stderr, "forward: Error: %s: %s\n", str,
+		        gai_strerror(err));
+		return -EINVAL;
+	}
+
+	memcpy(ss, res->ai_addr, res->ai_addrlen);
+	*len = res->ai_addrlen;
+	freeaddrinfo(res);
+	return 0;
+}
+
+int forward_can_socket(const char *can, uint32_t flags)
+{
+	struct sockaddr_can addr = { .can_family = AF_CAN };
+	int on = 1;
+	int fd;
+
+	addr.can_ifindex = if_nametoindex(can);
+	if (addr.can_ifindex == 0) {
+		fprintf(stderr, "forward: Error: %s: %s\n", can,
+		        strerror(errno));
+		return -ENODEV;
+	}
+
+	fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+	if (fd < 0 ||
+	    ((flags & F_CAN_FD) &&
+	     setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on,
+	                sizeof(on)) != 0) ||
+	    bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		int err = -errno;
+
+		fprintf(stderr, "forward: Error: %s: %s\n", can,
+		        strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return err;
+	}
+
+	return fd;
+}
+
+/**
+ * @fn int forward_udp_socket(const char *peer, const char *listen,
+ *                            char *name)
+ * @brief Opens a UDP socket bound to listen and connected to peer, and
+ *        writes "udp:PORT" of peer to name (IFNAMSIZ).
+ * @retval >=0 the socket
+ * @retval <0 -errno after printing an error
+ */
+static int forward_udp_socket(const char *peer, const char *listen,
+                              char *name)
+{
+	struct sockaddr_storage peer_addr, listen_addr;
+	socklen_t peer_len, listen_len;
+	int fd;
+
+	if (forward_addr(peer, 0, &peer_addr, &peer_len) != 0 ||
+	    (listen != NULL &&
+	     forward_addr(listen, 1, &listen_addr, &listen_len) != 0))
+		return -EINVAL;
+
+	if (listen != NULL && listen_addr.ss_family != peer_addr.ss_family) {
+		fprintf(stderr, "forward: Error: %s and %s are of different "
+		        "address families\n", listen, peer);
+		return -EINVAL;
+	}
+
+	fd = socket(peer_addr.ss_family, SOCK_DGRAM, 0);
+	if (fd < 0 ||
+	    (listen != NULL &&
+	     bind(fd, (struct sockaddr *) &listen_addr, listen_len) != 0) ||
+	    connect(fd, (struct sockaddr *) &peer_addr, peer_len) != 0) {
+		int err = -errno;
+
+		fprintf(stderr, "forward: Error: %s: %s\n",
+		        fd >= 0 && listen != NULL ? listen : peer,
+		        strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return err;
+	}
+
+	snprintf(name, IFNAMSIZ, "udp:%s", strrchr(peer, ':') + 1);
+	return fd;
+}
+
+int forward_open(struct forward *f, const char *can, const char *peer,
+                 const char *listen, uint32_t flags, unsigned int batch)
+{
+	int rcvbuf = FORWARD_RCVBUF;
+	char udp_name[IFNAMSIZ];
+	int can_fd, udp_fd, err;
+
+	can_fd = forward_can_socket(can, flags);
+	if (can_fd < 0)
+		return can_fd;
+
+	udp_fd = forward_udp_socket(peer, listen, udp_name);
+	if (udp_fd < 0) {
+		close(can_fd);
+		return udp_fd;
+	}
+
+	/* best effort, limited by net.core.rmem_max */
+	setsockopt(can_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	setsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	err = forward_init(f, can_fd, udp_fd, flags, batch);
+	if (err != 0) {
+		close(can_fd);
+		close(udp_fd);
+		return err;
+	}
+
+	snprintf(f->can_name, IFNAMSIZ, "%s", can);
+	strcpy(f->udp_name, udp_name);
+	return 0;
+}
+
+void forward_send(int fd, struct mmsghdr *msgs, unsigned int n,
+                  struct forward_stats *st)
+{
+	unsigned int sent = 0;
+
+	while (sent < n) {
+		int r = sendmmsg(fd, msgs + sent, n - sent, 0);
+
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			st->dropped++;
+			sent++;
+			continue;
+		}
+
+		st->handled += r;
+		sent += r;
+	}
+}
+
+int forward_run(struct forward *f, enum forward_dir dir)
+{
+	struct forward_stats *st = &f->stats[dir];
+	int in = dir == FORWARD_CAN_UDP ? f->can_fd : f->udp_fd;
+	int out = dir == FORWARD_CAN_UDP ? f->udp_fd : f->can_fd;
+	int total = 0;
+
+	for (;;) {
+		unsigned int valid = 0;
+		int n;
+
+		for (unsigned int i = 0; i < f->batch; ++i)
+			f->iov[i].iov_len = sizeof(*f->frames);
+
+		n = recvmmsg(in, f->msgs, f->batch, MSG_DONTWAIT, NULL);
+		if (n < 0) {
+			/* ICMP of a peer which is not listening (yet) */
+			if (errno == EINTR || errno == ECONNREFUSED)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -errno;
+		}
+		st->batches++;
+		total += n;
+
+		/* convert in place and move the good frames to the front,
+		 * the pool stays a permutation of its frames */
+		for (int i = 0; i < n; ++i) {
+			struct mmsghdr *m = &f->msgs[i];
+			struct canfd_frame *cf = f->iov[i].iov_base;
+
+			if ((m->msg_hdr.msg_flags & MSG_TRUNC) ||
+			    !frame_valid(f, cf, m->msg_len)) {
+				st->dropped++;
+				continue;
+			}
+
+			cf->can_id = dir == FORWARD_CAN_UDP ?
+			             htonl(cf->can_id) : ntohl(cf->can_id);
+			f->iov[i].iov_len = m->msg_len;
+
+			if ((unsigned int) i != valid) {
+				struct iovec tmp = f->iov[valid];
+
+				f->iov[valid] = f->iov[i];
+				f->iov[i] = tmp;
+			}
+			valid++;
+		}
+
+		forward_send(out, f->msgs, valid, st);
+
+		if ((unsigned int) n < f->batch)
+			break;
+	}
+
+	return total;
+}
+
+int forward_poll(struct forward *f, int both, int timeout)
+{
+	struct pollfd pfd[FORWARD_DIRS] = {
+		{ f->can_fd, POLLIN, 0 },
+		{ f->udp_fd, POLLIN, 0 },
+	};
+	int total = 0;
+
+	if (poll(pfd, both ? FORWARD_DIRS : 1, timeout) < 0)
+		return -errno;
+
+	for (int dir = 0; dir < FORWARD_DIRS; ++dir) {
+		if (!(pfd[dir].revents & (POLLIN | POLLERR)))
+			continue;
+
+		int n = forward_run(f, dir);
+		if (n < 0)
+			return n;
+		total += n;
+	}
+
+	return total;
+}
+
+void forward_route(const struct forward *f, enum forward_dir dir,
+                   struct ce_gw_route *route)
+{
+	memset(route, 0, sizeof(*route));
+	route->id = dir + 1;
+	route->flags = f->flags;
+	route->type = TYPE_UDP;
+	route->handled = f->stats[dir].handled;
+	route->dropped = f->stats[dir].dropped;
+	strcpy(route->src, dir == FORWARD_CAN_UDP ? f->can_name : f->udp_name);
+	strcpy(route->dst, dir == FORWARD_CAN_UDP ? f->udp_name : f->can_name);
+}
+
+void forward_close(struct forward *f)
+{
+	if (f->can_fd >= 0)
+		close(f->can_fd);
+	if (f->udp_fd >= 0)
+		close(f->udp_fd);
+	free(f->frames);
+	free(f->iov);
+	free(f->msgs);
+	f->can_fd = f->udp_fd = -1;
+	f->frames = NULL;
+	f->iov = NULL;
+	f->msgs = NULL;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file forward_main.c
+ * @brief Control Area Network - Ethernet - Gateway - UDP Forwarding
+ * (Utility)
+ * @details "cegwctl forward", the frontend of the userspace TYPE_UDP data
+ *          path. See forward.h.
+ * @author agent (agent@local)
+ * @date October, 2026
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "forward.h"
+#include "timing.h"
+
+/** set by SIGINT, ends forward_main() */
+static volatile sig_atomic_t forward_stop;
+
+/**
+ * @fn void forward_sigint(int sig)
+ * @brief Handler of SIGINT.
+ */
+static void forward_sigint(int sig)
+{
+	forward_stop = 1;
+}
+
+/**
+ * @fn void forward_print(const struct forward *f, int both)
+ * @brief Prints the directions of f as routes.
+ */
+static void forward_print(const struct forward *f, int both)
+{
+	struct ce_gw_route route;
+
+	ce_gw_route_print_header();
+	for (int dir = 0; dir < (both ? FORWARD_DIRS : 1); ++dir) {
+		forward_route(f, dir, &route);
+		ce_gw_route_print(&route, NULL);
+	}
+	fflush(stdout);
+}
+
+int forward_main(int argc, char *argv[])
+{
+	const char *prog = "cegwctl forward";
+	const char *listen = NULL;
+	unsigned int batch = FORWARD_BATCH;
+	uint32_t flags = 0;
+	double interval = 0;
+	struct forward f;
+	char *end;
+	int c, err;
+
+	static struct option long_options[] = {
+		{"can-fd",   no_argument,       0, 'f'},
+		{"listen",   required_argument, 0, 'l'},
+		{"batch",    required_argument, 0, 'B'},
+		{"interval", required_argument, 0, 'i'},
+		{0, 0, 0, 0},
+	};
+
+	optind = 1;
+	while ((c = getopt_long(argc, argv, "fl:B:i:", long_options,
+	                        NULL)) != -1) {
+		switch (c) {
+		case 'f':
+			flags |= F_CAN_FD;
+			break;
+
+		case 'l':
+			listen = optarg;
+			break;
+
+		case 'B':
+			batch = strtoul(optarg, &end, 0);
+			if (end == optarg || *end != '\0' || batch == 0 ||
+			    batch > FORWARD_BATCH_MAX) {
+				fprintf(stderr, "%s: Error: batch must be "
+				        "between 1 and %d\n", prog,
+				        FORWARD_BATCH_MAX);
+				return EXIT_FAILURE;
+			}
+			break;
+
+		case 'i':
+			interval = strtod(optarg, &end);
+			if (end == optarg || *end != '\0' || interval < 0) {
+				fprintf(stderr, "%s: Error: interval must be "
+				        "a number of seconds\n", prog);
+				return EXIT_FAILURE;
+			}
+			break;
+
+		default:
+			/* getopt_long already printed an error message. */
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind + 2 != argc) {
+		fprintf(stderr, "%s: Error: expected CAN HOST:PORT\n", prog);
+		return EXIT_FAILURE;
+	}
+
+	err = forward_open(&f, argv[optind], argv[optind + 1], listen, flags,
+	                   batch);
+	if (err != 0)
+		return EXIT_FAILURE;
+
+	struct sigaction sa, old;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = forward_sigint;
+	sigaction(SIGINT, &sa, &old);
+
+	printf("FORWARD %s %s %s%s, batch %u\n", f.can_name,
+	       listen ? "<->" : "->", argv[optind + 1],
+	       flags & F_CAN_FD ? " (CAN-FD)" : "", batch);
+	fflush(stdout);
+
+	uint64_t step = interval * 1e9;
+	uint64_t next = timing_now() + step;
+	while (!forward_stop) {
+		int timeout = -1;
+
+		if (interval > 0) {
+			uint64_t now = timing_now();
+			timeout = next > now ? (next - now) / 1000000 + 1 : 0;
+		}
+
+		err = forward_poll(&f, listen != NULL, timeout);
+		if (err < 0 && err != -EINTR) {
+			fprintf(stderr, "%s: Error: %s\n", prog,
+			        strerror(-err));
+			break;
+		}
+
+		if (interval > 0 && timing_now() >= next) {
+			forward_print(&f, listen != NULL);
+			next += step;
+		}
+	}
+
+	sigaction(SIGINT, &old, NULL);
+	printf("\n");
+	forward_print(&f, listen != NULL);
+	forward_close(&f);
+
+	return forward_stop ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file hist.c
+ * @brief Control Area Network - Ethernet - Gateway - Latency Histogram
+ * (Utility)
+ * @details Histogram with logarithmic buckets for latencies, used by the
+ *          benchmarks.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "hist.h"
+
+#define SUB_HALF (1u << (HIST_SUB_BITS - 1)) /**< buckets per power of 2 */
+
+/**
+ * @fn unsigned int bucket_index(uint64_t value)
+ * @brief Returns the bucket of value. Values below 2^HIST_SUB_BITS have a
+ *        bucket of their own, above the buckets get twice as wide with
+ *        every power of 2.
+ */
+static unsigned int bucket_index(uint64_t value)
+{
+	if (value < (1u << HIST_SUB_BITS))
+		return value;
+
+	unsigned int shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS + 1;
+	return shift * SUB_HALF + (value >> shift);
+}
+
+/**
+ * @fn uint64_t bucket_high(unsigned int idx)
+ * @brief Returns the largest value of bucket idx.
+ */
+static uint64_t bucket_high(unsigned int idx)
+{
+	if (idx < (1u << HIST_SUB_BITS))
+		return idx;
+
+	unsigned int shift = idx / SUB_HALF - 1;
+	uint64_t low = (uint64_t) (idx - shift * SUB_HALF) << shift;
+	return low + ((1ull << shift) - 1);
+}
+
+void hist_init(struct hist *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = UINT64_MAX;
+}
+
+void hist_record(struct hist *h, uint64_t value)
+{
+	h->counts[bucket_index(value)]++;
+	h->n++;
+	h->sum += value;
+	h->sum2 += (double) value * value;
+	if (value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+}
+
+void hist_merge(struct hist *h, const struct hist *from)
+{
+	for (unsigned int i = 0; i < HIST_BUCKETS; ++i)
+		h->counts[i] += from->counts[i];
+	h->n += from->n;
+	h->sum += from->sum;
+	h->sum2 += from->sum2;
+	if (from->min < h->min)
+		h->min = from->min;
+	if (from->max > h->max)
+		h->max = from->max;
+}
+
+uint64_t hist_percentile(const struct hist *h, double p)
+{
+	uint64_t rank, seen = 0;
+
+	if (h->n == 0)
+		return 0;
+
+	rank = (uint64_t) ceil(p / 100.0 * h->n);
+	if (rank == 0)
+		rank = 1;
+
+	for (unsigned int i = 0; i < HIST_BUCKETS; ++i) {
+		seen += h->counts[i];
+		if (seen >= rank) {
+			uint64_t high = bucket_high(i);
+			return high < h->max ? high : h->max;
+		}
+	}
+
+	return h->max;
+}
+
+uint64_t hist_count_below(const struct hist *h, uint64_t value)
+{
+	uint64_t n = 0;
+
+	for (unsigned int i = 0; i < bucket_index(value); ++i)
+		n += h->counts[i];
+
+	return n;
+}
+
+double hist_mean(const struct hist *h)
+{
+	return h->n ? h->sum / h->n : 0.0;
+}
+
+double hist_stddev(const struct hist *h)
+{
+	double mean = hist_mean(h);
+	double var = h->n ? h->sum2 / h->n - mean * mean : 0.0;
+
+	return var > 0 ? sqrt(var) : 0.0;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file ifcache.c
+ * @brief Control Area Network - Ethernet - Gateway - Interface Cache
+ * (Utility)
+ * @details Name to interface index map of the network devices, see
+ *          ifcache.h.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <linux/rtnetlink.h>
+#include "ifcache.h"
+
+/**
+ * @fn uint32_t hash_name(const char *name)
+ * @brief FNV-1a hash of name.
+ */
+static uint32_t hash_name(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	for (; *name != '\0'; ++name)
+		hash = (hash ^ (uint8_t) *name) * 16777619u;
+	return hash;
+}
+
+/**
+ * @fn uint32_t hash_index(int index)
+ * @brief Multiplicative hash of an interface index.
+ */
+static uint32_t hash_index(int index)
+{
+	return (uint32_t) index * 2654435761u;
+}
+
+int ifcache_add(struct ifcache *c, int index, const char *name)
+{
+	if (c->len == c->size) {
+		size_t size = c->size ? c->size * 2 : 64;
+		struct ifcache_entry *e = realloc(c->entries,
+		                                  size * sizeof(*e));
+		if (e == NULL)
+			return -ENOMEM;
+
+		c->entries = e;
+		c->size = size;
+	}
+
+	struct ifcache_entry *e = &c->entries[c->len++];
+	e->index = index;
+	memset(e->name, 0, sizeof(e->name));
+	strncpy(e->name, name, IFNAMSIZ - 1);
+
+	return 0;
+}
+
+int ifcache_build(struct ifcache *c)
+{
+	size_t slots = 16;
+
+	/* at most half full */
+	while (slots < 2 * c->len)
+		slots *= 2;
+
+	free(c->by_name);
+	free(c->by_index);
+	c->by_name = calloc(slots, sizeof(*c->by_name));
+	c->by_index = calloc(slots, sizeof(*c->by_index));
+	c->loaded = 1;
+	if (c->by_name == NULL || c->by_index == NULL) {
+		free(c->by_name);
+		free(c->by_index);
+		c->by_name = c->by_index = NULL;
+		return -ENOMEM;
+	}
+	c->mask = slots - 1;
+
+	for (size_t i = 0; i < c->len; ++i) {
+		size_t s = hash_name(c->entries[i].name) & c->mask;
+		while (c->by_name[s] != 0)
+			s = (s + 1) & c->mask;
+		c->by_name[s] = i + 1;
+
+		s = hash_index(c->entries[i].index) & c->mask;
+		while (c->by_index[s] != 0)
+			s = (s + 1) & c->mask;
+		c->by_index[s] = i + 1;
+	}
+
+	return 0;
+}
+
+int ifcache_index(const struct ifcache *c, const char *name)
+{
+	if (c->by_name == NULL)
+		return 0;
+
+	for (size_t s = hash_name(name) & c->mask; c->by_name[s] != 0;
+	     s = (s + 1) & c->mask) {
+		const struct ifcache_entry *e = &c->entries[c->by_name[s] - 1];
+		if (strcmp(e->name, name) == 0)
+			return e->index;
+	}
+
+	return 0;
+}
+
+const char *ifcache_name(const struct ifcache *c, int index)
+{
+	if (c->by_index == NULL)
+		return NULL;
+
+	for (size_t s = hash_index(index) & c->mask; c->by_index[s] != 0;
+	     s = (s + 1) & c->mask) {
+		const struct ifcache_entry *e = &c->entries[c->by_index[s] - 1];
+		if (e->index == index)
+			return e->name;
+	}
+
+	return NULL;
+}
+
+void ifcache_free(struct ifcache *c)
+{
+	free(c->entries);
+	free(c->by_name);
+	free(c->by_index);
+	memset(c, 0, sizeof(*c));
+}
+
+/**
+ * @fn int nl_cb_link(struct nl_msg *msg, void *arg)
+ * @brief Called for every RTM_NEWLINK message of the link dump, adds the
+ *        device to the struct ifcache arg.
+ * @retval NL_OK
+ * @retval NL_STOP if the cache could not grow
+ * @ingroup cb
+ * @see defined as callback in ifcache_rtnl_load()
+ */
+static int nl_cb_link(struct nl_msg *msg, void *arg)
+{
+	struct nlmsghdr *hdr = nlmsg_hdr(msg);
+	struct nlattr *tb[IFLA_MAX + 1];
+
+	if (hdr->nlmsg_type != RTM_NEWLINK ||
+	    nlmsg_parse(hdr, sizeof(struct ifinfomsg), tb, IFLA_MAX,
+	                NULL) < 0 || tb[IFLA_IFNAME] == NULL)
+		return NL_OK;
+
+	struct ifinfomsg *ifi = nlmsg_data(hdr);
+	char name[IFNAMSIZ];
+
+	nla_strlcpy(name, tb[IFLA_IFNAME], sizeof(name));
+	if (ifcache_add(arg, ifi->ifi_index, name) != 0)
+		return NL_STOP;
+
+	return NL_OK;
+}
+
+int ifcache_rtnl_load(struct ifcache *c)
+{
+	struct nl_sock *sk = nl_socket_alloc();
+	struct rtgenmsg gen = { .rtgen_family = AF_UNSPEC };
+	int err;
+
+	if (sk == NULL)
+		return -NLE_NOMEM;
+
+	err = nl_connect(sk, NETLINK_ROUTE);
+	if (err == 0)
+		err = nl_socket_modify_cb(sk, NL_CB_VALID, NL_CB_CUSTOM,
+		                          nl_cb_link, c);
+	if (err == 0)
+		err = nl_send_simple(sk, RTM_GETLINK, NLM_F_DUMP, &gen,
+		                     sizeof(gen));
+	if (err >= 0)
+		err = nl_recvmsgs_default(sk);
+
+	nl_socket_free(sk);
+	return err < 0 ? err : 0;
+}
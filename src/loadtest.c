@@ -0,0 +1,804 @@
+/**
+ * @file loadtest.c
+ * @brief Control Area Network - Ethernet - Gateway - Load Test (Utility)
+ * @details See loadtest.h.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if_arp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+#include "codec.h"
+#include "forward.h"
+#include "hist.h"
+#include "loadtest.h"
+#include "timing.h"
+
+/** set by SIGINT, ends the load test */
+static volatile sig_atomic_t loadtest_stop;
+
+/**
+ * @fn void loadtest_sigint(int sig)
+ * @brief Handler of SIGINT.
+ */
+static void loadtest_sigint(int sig)
+{
+	loadtest_stop = 1;
+}
+
+/**
+ * @struct lt_port
+ * @brief The socket of the source or destination of the route.
+ */
+struct lt_port {
+	int fd;			/**< raw CAN socket or packet socket */
+	int can;		/**< 1 if the device is a CAN device */
+	struct codec codec;	/**< layout of the frames of a packet socket */
+	const char *name;	/**< the device */
+};
+
+/**
+ * @struct loadtest
+ * @brief The state of loadtest_main().
+ */
+struct loadtest {
+	struct lt_port src, dst;	/**< the ends of the route */
+	uint32_t count;		/**< frames to send */
+	uint32_t tag;		/**< marks the frames of this run */
+	size_t mtu;		/**< CAN_MTU or CANFD_MTU */
+	uint8_t dlen;		/**< data bytes of a frame */
+	uint64_t *tx;		/**< send time of each frame, ns */
+	uint64_t *rx;		/**< receive time of each frame, 0 if none */
+	uint32_t sent;		/**< number of sent frames */
+	uint32_t received;	/**< number of received frames */
+	uint32_t dups;		/**< frames received more than once */
+	uint32_t reordered;	/**< frames received after a later one */
+	uint32_t tx_kernel;	/**< frames with a kernel send timestamp */
+	uint32_t highest;	/**< highest received number + 1 */
+	uint64_t first_rx;	/**< receive time of the first frame */
+	uint64_t last_rx;	/**< receive time of the last frame */
+	struct canfd_frame frames[LOADTEST_BATCH]; /**< a batch */
+	uint8_t mtus[LOADTEST_BATCH];	/**< sizes of frames */
+	uint16_t lens[LOADTEST_BATCH];	/**< sizes of the packets */
+	uint8_t *buf;			/**< LOADTEST_BATCH slots */
+	struct iovec iov[LOADTEST_BATCH];	/**< one per slot */
+	struct mmsghdr msgs[LOADTEST_BATCH];	/**< one per slot */
+	struct sockaddr_ll sll[LOADTEST_BATCH];	/**< senders of packets */
+	char ctrl[LOADTEST_BATCH][CMSG_SPACE(sizeof(struct scm_timestamping))];
+	/**< control data with the timestamps */
+};
+
+/**
+ * @fn uint64_t lt_realtime(void)
+ * @brief CLOCK_REALTIME in ns, the clock of the socket timestamps.
+ */
+static uint64_t lt_realtime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @fn int lt_port_open(struct lt_port *p, const char *name,
+ *                      const struct ce_gw_route *route, uint32_t flags,
+ *                      int rx)
+ * @brief Opens the socket of the device name, which captures the frames
+ *        of the load test if rx is 1, else sends them.
+ * @retval 0 on success
+ * @retval <0 -errno on failure, after printing an error
+ */
+static int lt_port_open(struct lt_port *p, const char *name,
+                        const struct ce_gw_route *route, uint32_t flags,
+                        int rx)
+{
+	const char *prog = "cegwctl loadtest";
+	struct ifreq ifr;
+	int ifindex = if_nametoindex(name);
+	int fd, err;
+
+	memset(p, 0, sizeof(*p));
+	p->fd = -1;
+	p->name = name;
+	if (ifindex == 0) {
+		fprintf(stderr, "%s: Error: %s: %s\n", prog, name,
+		        strerror(errno));
+		return -ENODEV;
+	}
+
+	/* the type of the device decides the socket */
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, IFNAMSIZ, "%s", name);
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd >= 0) {
+		if (ioctl(fd, SIOCGIFHWADDR, &ifr) == 0)
+			p->can = ifr.ifr_hwaddr.sa_family == ARPHRD_CAN;
+		close(fd);
+	}
+
+	if (p->can) {
+		struct can_filter filter = {
+			LOADTEST_CAN_ID,
+			CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_SFF_MASK,
+		};
+
+		fd = forward_can_socket(name, flags);
+		if (fd < 0)
+			return fd;
+		/* the sender receives nothing */
+		setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, &filter,
+		           rx ? sizeof(filter) : 0);
+	} else {
+		struct sockaddr_ll sll = {
+			.sll_family = AF_PACKET,
+			.sll_protocol = rx ? htons(ETH_P_ALL) : 0,
+			.sll_ifindex = ifindex,
+		};
+		int on = 1;
+
+		err = route->type == TYPE_NET || route->type == TYPE_ETH ?
+		      codec_init(&p->codec, route->type, flags, NULL,
+		                 CODEC_AUTO) : -EOPNOTSUPP;
+		if (err != 0) {
+			fprintf(stderr, "%s: Error: frames of type %s can not "
+			        "be %s on %s\n", prog,
+			        enum2str(route->type, type_array, TYPE_MAX),
+			        rx ? "captured" : "sent", name);
+			return err;
+		}
+		p->codec.stride = LOADTEST_SLOT;
+
+		fd = socket(AF_PACKET, SOCK_RAW, 0);
+		if (fd < 0 || bind(fd, (struct sockaddr *) &sll,
+		                   sizeof(sll)) != 0) {
+			err = -errno;
+			fprintf(stderr, "%s: Error: %s: %s\n", prog, name,
+			        strerror(errno));
+			if (fd >= 0)
+				close(fd);
+			return err;
+		}
+		setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &on,
+		           sizeof(on));
+	}
+
+	if (rx) {
+		int rcvbuf = FORWARD_RCVBUF;
+		int ts = SOF_TIMESTAMPING_RX_SOFTWARE |
+		         SOF_TIMESTAMPING_SOFTWARE;
+
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+		           sizeof(rcvbuf));
+		setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &ts, sizeof(ts));
+	} else {
+		/* the number of the frame is the ID of its timestamp, the
+		 * SCHED one exists for every device, also without a driver
+		 * which timestamps */
+		int ts = SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_SOFTWARE |
+		         SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+		setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &ts, sizeof(ts));
+	}
+
+	p->fd = fd;
+	return 0;
+}
+
+/**
+ * @fn int lt_send(struct loadtest *lt, unsigned int n)
+ * @brief Sends the next n frames, at most LOADTEST_BATCH, as far as the
+ *        source takes them.
+ * @retval >=0 the number of sent frames
+ * @retval <0 -errno on failure
+ */
+static int lt_send(struct loadtest *lt, unsigned int n)
+{
+	struct lt_port *p = &lt->src;
+
+	for (unsigned int i = 0; i < n; ++i) {
+		struct canfd_frame *cf = &lt->frames[i];
+		uint32_t seq = lt->sent + i;
+
+		memset(cf, seq & 0xff, sizeof(*cf));
+		cf->can_id = LOADTEST_CAN_ID;
+		cf->len = lt->dlen;
+		cf->flags = lt->mtu == CANFD_MTU ? CANFD_BRS : 0;
+		cf->__res0 = 0;
+		cf->__res1 = 0;
+		memcpy(cf->data, &seq, sizeof(seq));
+		memcpy(cf->data + 4, &lt->tag, sizeof(lt->tag));
+		lt->mtus[i] = lt->mtu;
+
+		lt->iov[i].iov_base = cf;
+		lt->iov[i].iov_len = lt->mtu;
+		memset(&lt->msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+		lt->msgs[i].msg_hdr.msg_iov = &lt->iov[i];
+		lt->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	if (!p->can) {
+		codec_encode(&p->codec, lt->frames, lt->mtus, n, lt->buf,
+		             lt->lens);
+		for (unsigned int i = 0; i < n; ++i) {
+			lt->iov[i].iov_base = lt->buf + i * LOADTEST_SLOT;
+			lt->iov[i].iov_len = lt->lens[i];
+		}
+	}
+
+	uint64_t now = lt_realtime();
+	int r = sendmmsg(p->fd, lt->msgs, n, MSG_DONTWAIT);
+	if (r < 0)
+		return errno == EAGAIN || errno == ENOBUFS || errno == EINTR ?
+		       0 : -errno;
+
+	for (int i = 0; i < r; ++i)
+		lt->tx[lt->sent + i] = now;
+	lt->sent += r;
+	return r;
+}
+
+/**
+ * @fn uint64_t lt_stamp(struct msghdr *mh, uint32_t *id)
+ * @brief Returns the software timestamp of the control data of mh in ns, 0
+ *        if there is none. Sets *id to the ID of a send timestamp.
+ */
+static uint64_t lt_stamp(struct msghdr *mh, uint32_t *id)
+{
+	uint64_t ns = 0;
+
+	for (struct cmsghdr *cm = CMSG_FIRSTHDR(mh); cm != NULL;
+	     cm = CMSG_NXTHDR(mh, cm)) {
+		if (cm->cmsg_level == SOL_SOCKET &&
+		    cm->cmsg_type == SCM_TIMESTAMPING) {
+			struct scm_timestamping ts;
+
+			memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+			ns = ts.ts[0].tv_sec * 1000000000ull +
+			     ts.ts[0].tv_nsec;
+		} else if (id != NULL && cm->cmsg_len >=
+		           CMSG_LEN(sizeof(struct sock_extended_err))) {
+			/* the level differs with the socket family */
+			struct sock_extended_err serr;
+
+			memcpy(&serr, CMSG_DATA(cm), sizeof(serr));
+			if (serr.ee_origin == SO_EE_ORIGIN_TIMESTAMPING)
+				*id = serr.ee_data;
+		}
+	}
+
+	return ns;
+}
+
+/**
+ * @fn void lt_tx_stamps(struct loadtest *lt)
+ * @brief Replaces the send times by the waiting kernel timestamps.
+ */
+static void lt_tx_stamps(struct loadtest *lt)
+{
+	char ctrl[256];
+	uint8_t data[LOADTEST_SLOT];
+	struct iovec iov = { data, sizeof(data) };
+
+	for (;;) {
+		struct msghdr mh = {
+			.msg_iov = &iov, .msg_iovlen = 1,
+			.msg_control = ctrl, .msg_controllen = sizeof(ctrl),
+		};
+		uint32_t id = UINT32_MAX;
+
+		if (recvmsg(lt->src.fd, &mh, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		uint64_t ns = lt_stamp(&mh, &id);
+		if (ns != 0 && id < lt->sent) {
+			lt->tx[id] = ns;
+			lt->tx_kernel++;
+		}
+	}
+}
+
+/**
+ * @fn int lt_receive(struct loadtest *lt)
+ * @brief Receives and records the waiting frames of the load test at the
+ *        destination, other frames are skipped.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int lt_receive(struct loadtest *lt)
+{
+	struct lt_port *p = &lt->dst;
+	int n;
+
+	do {
+		for (int i = 0; i < LOADTEST_BATCH; ++i) {
+			struct msghdr *mh = &lt->msgs[i].msg_hdr;
+
+			lt->iov[i].iov_base = lt->buf + i * LOADTEST_SLOT;
+			lt->iov[i].iov_len = LOADTEST_SLOT;
+			memset(mh, 0, sizeof(*mh));
+			mh->msg_iov = &lt->iov[i];
+			mh->msg_iovlen = 1;
+			mh->msg_name = &lt->sll[i];
+			mh->msg_namelen = sizeof(lt->sll[i]);
+			mh->msg_control = lt->ctrl[i];
+			mh->msg_controllen = sizeof(lt->ctrl[i]);
+		}
+
+		n = recvmmsg(p->fd, lt->msgs, LOADTEST_BATCH, MSG_DONTWAIT,
+		             NULL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN || errno == EWOULDBLOCK ? 0
+			       : -errno;
+		}
+
+		if (p->can) {
+			for (int i = 0; i < n; ++i) {
+				size_t len = lt->msgs[i].msg_len;
+
+				lt->mtus[i] = len == CAN_MTU ||
+				              len == CANFD_MTU ? len : 0;
+				memcpy(&lt->frames[i], lt->iov[i].iov_base,
+				       lt->mtus[i]);
+			}
+		} else {
+			for (int i = 0; i < n; ++i)
+				lt->lens[i] = lt->sll[i].sll_pkttype ==
+				              PACKET_OUTGOING ? 0
+				              : lt->msgs[i].msg_len;
+			codec_decode(&p->codec, lt->buf, lt->lens, n,
+			             lt->frames, lt->mtus);
+		}
+
+		for (int i = 0; i < n; ++i) {
+			const struct canfd_frame *cf = &lt->frames[i];
+			uint32_t seq, tag;
+
+			if (lt->mtus[i] == 0 || cf->len < 8 ||
+			    (cf->can_id & CAN_EFF_MASK) != LOADTEST_CAN_ID)
+				continue;
+			memcpy(&seq, cf->data, sizeof(seq));
+			memcpy(&tag, cf->data + 4, sizeof(tag));
+			if (tag != lt->tag || seq >= lt->sent)
+				continue;
+
+			uint64_t ns = lt_stamp(&lt->msgs[i].msg_hdr, NULL);
+			if (ns == 0)
+				ns = lt_realtime();
+
+			if (lt->rx[seq] != 0) {
+				lt->dups++;
+				continue;
+			}
+			lt->rx[seq] = ns;
+			if (lt->received++ == 0)
+				lt->first_rx = ns;
+			lt->last_rx = ns;
+			if (seq + 1 < lt->highest)
+				lt->reordered++;
+			else
+				lt->highest = seq + 1;
+		}
+	} while (n == LOADTEST_BATCH);
+
+	return 0;
+}
+
+/**
+ * @fn int lt_route(struct cegw_ctx *ctx, uint32_t id,
+ *                  struct ce_gw_route *route)
+ * @brief Gets the route id with CE_GW_C_LIST.
+ * @retval 0 on success
+ * @retval <0 on failure, after printing an error
+ */
+static int lt_route(struct cegw_ctx *ctx, uint32_t id,
+                    struct ce_gw_route *route)
+{
+	size_t count = 0;
+	int err = ce_gw_list_routes(ctx, id, route, 1, &count);
+
+	if (err < 0) {
+		fprintf(stderr, "cegwctl loadtest: Error: route %" PRIu32
+		        " could not be listed\n", id);
+		return err;
+	}
+	if (count == 0 || route->id != id) {
+		fprintf(stderr, "cegwctl loadtest: Error: route %" PRIu32
+		        " does not exist\n", id);
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+/**
+ * @fn void lt_histogram(const struct hist *h)
+ * @brief Prints the number of values of h per power of 2.
+ */
+static void lt_histogram(const struct hist *h)
+{
+	uint64_t low = 1, high;
+	uint64_t most = 0;
+
+	while (low * 2 <= h->min)
+		low *= 2;
+
+	for (uint64_t b = low; b <= h->max && b < UINT64_MAX / 2; b *= 2) {
+		uint64_t n = hist_count_below(h, b * 2) -
+		             hist_count_below(h, b);
+		if (n > most)
+			most = n;
+	}
+
+	for (; low <= h->max && low < UINT64_MAX / 2; low = high) {
+		high = low * 2;
+		uint64_t n = hist_count_below(h, high) -
+		             hist_count_below(h, low);
+		int bar = most ? (n * 40 + most - 1) / most : 0;
+
+		printf("  %10.3f - %10.3f us %10" PRIu64 " %.*s\n", low / 1e3,
+		       high / 1e3, n, bar,
+		       "########################################");
+	}
+}
+
+/**
+ * @fn int lt_number(const char *name, const char *str, double min,
+ *                   double max, double *value)
+ * @brief Parses the option name and checks its range.
+ * @retval 0 on success
+ * @retval -EINVAL after printing an error
+ */
+static int lt_number(const char *name, const char *str, double min,
+                     double max, double *value)
+{
+	char *end;
+
+	*value = strtod(str, &end);
+	if (end == str || *end != '\0' || *value < min || *value > max) {
+		fprintf(stderr, "cegwctl loadtest: Error: %s must be between "
+		        "%g and %g\n", name, min, max);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * @fn void lt_run(struct loadtest *lt, double rate, unsigned int burst,
+ *                 double timeout)
+ * @brief Sends the frames of lt and receives them until all arrived or
+ *        timeout seconds after the last one was sent.
+ */
+static void lt_run(struct loadtest *lt, double rate, unsigned int burst,
+                   double timeout)
+{
+	uint64_t interval = rate > 0 ? burst * 1e9 / rate : 0;
+	uint64_t next = timing_now(), end = 0;
+	unsigned int left = 0;
+	int blocked = 0;
+
+	while (!loadtest_stop) {
+		uint64_t now = timing_now();
+		int wait;
+
+		if (lt->sent < lt->count && left == 0 && now >= next) {
+			left = lt->count - lt->sent < burst ?
+			       lt->count - lt->sent : burst;
+			next = interval ? next + interval : now;
+		}
+
+		blocked = 0;
+		while (left > 0) {
+			int r = lt_send(lt, left < LOADTEST_BATCH ? left
+			                    : LOADTEST_BATCH);
+			if (r < 0) {
+				fprintf(stderr, "cegwctl loadtest: Error: "
+				        "sending to %s: %s\n", lt->src.name,
+				        strerror(-r));
+				return;
+			}
+			if (r == 0) {
+				blocked = 1;
+				break;
+			}
+			left -= r;
+		}
+
+		if (lt->sent == lt->count && end == 0)
+			end = now + timeout * 1e9;
+		if (end != 0 && (lt->received == lt->count || now >= end))
+			break;
+
+		/* until the next burst, the source takes frames again or the
+		 * timeout of the last frames */
+		if (blocked)
+			wait = 1;
+		else if (lt->sent < lt->count)
+			wait = left > 0 || next <= now ? 0
+			       : (next - now + 999999) / 1000000;
+		else
+			wait = end > now ? (end - now + 999999) / 1000000 : 0;
+
+		struct pollfd pfd[2] = {
+			{ lt->dst.fd, POLLIN, 0 },
+			{ lt->src.fd, 0, 0 },	/* POLLERR: the timestamps */
+		};
+		if (poll(pfd, 2, wait) < 0 && errno != EINTR) {
+			perror("cegwctl loadtest: Error: poll");
+			return;
+		}
+
+		if (lt_receive(lt) < 0) {
+			perror("cegwctl loadtest: Error: receiving");
+			return;
+		}
+		lt_tx_stamps(lt);
+	}
+}
+
+int loadtest_main(int argc, char *argv[])
+{
+	const char *prog = "cegwctl loadtest";
+	uint32_t count = LOADTEST_COUNT;
+	double rate = LOADTEST_RATE, timeout = LOADTEST_TIMEOUT;
+	unsigned int burst = 1;
+	int fd = 0, size = -1;
+	struct ce_gw_route before, after;
+	struct loadtest *lt = NULL;
+	struct cegw_ctx *ctx = NULL;
+	int ret = EXIT_FAILURE;
+	double num;
+	int c;
+
+	static struct option long_options[] = {
+		{"count",   required_argument, 0, 'c'},
+		{"rate",    required_argument, 0, 'r'},
+		{"burst",   required_argument, 0, 'b'},
+		{"can-fd",  no_argument,       0, 'f'},
+		{"size",    required_argument, 0, 's'},
+		{"timeout", required_argument, 0, 'W'},
+		{0, 0, 0, 0},
+	};
+
+	optind = 1;
+	while ((c = getopt_long(argc, argv, "c:r:b:fs:W:", long_options,
+	                        NULL)) != -1) {
+		switch (c) {
+		case 'c':
+			if (lt_number("count", optarg, 1, 100000000, &num))
+				return EXIT_FAILURE;
+			count = num;
+			break;
+
+		case 'r':
+			if (lt_number("rate", optarg, 0, 1e9, &num))
+				return EXIT_FAILURE;
+			rate = num;
+			break;
+
+		case 'b':
+			if (lt_number("burst", optarg, 1, 1000000, &num))
+				return EXIT_FAILURE;
+			burst = num;
+			break;
+
+		case 'f':
+			fd = 1;
+			break;
+
+		case 's':
+			if (lt_number("size", optarg, 8, CANFD_MAX_DLEN, &num))
+				return EXIT_FAILURE;
+			size = num;
+			break;
+
+		case 'W':
+			if (lt_number("timeout", optarg, 0.001, 3600, &num))
+				return EXIT_FAILURE;
+			timeout = num;
+			break;
+
+		default:
+			/* getopt_long already printed an error message. */
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind + 1 != argc) {
+		fprintf(stderr, "%s: Error: expected ROUTE_ID\n", prog);
+		return EXIT_FAILURE;
+	}
+	char *end;
+	unsigned long id = strtoul(argv[optind], &end, 0);
+	if (end == argv[optind] || *end != '\0' || id == 0 ||
+	    id > UINT32_MAX) {
+		fprintf(stderr, "%s: Error: invalid route id %s\n", prog,
+		        argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	/* a CAN-FD frame has one of the lengths of its DLC */
+	if (size < 0)
+		size = fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+	if ((!fd && size != CAN_MAX_DLEN) ||
+	    (fd && size > 24 && size % 16 != 0) || size % 4 != 0) {
+		fprintf(stderr, "%s: Error: size must be 8, or with -f one of "
+		        "8, 12, 16, 20, 24, 32, 48, 64\n", prog);
+		return EXIT_FAILURE;
+	}
+
+	ctx = cegw_ctx_alloc();
+	if (ctx == NULL) {
+		fprintf(stderr, "Error during initialisation of Socket or "
+		        "Netlink Family\n");
+		return EXIT_FAILURE;
+	}
+	if (lt_route(ctx, id, &before) != 0)
+		goto out;
+
+	lt = calloc(1, sizeof(*lt));
+	if (lt != NULL) {
+		lt->tx = calloc(count, sizeof(*lt->tx));
+		lt->rx = calloc(count, sizeof(*lt->rx));
+		lt->buf = malloc(LOADTEST_BATCH * LOADTEST_SLOT);
+	}
+	if (lt == NULL || lt->tx == NULL || lt->rx == NULL ||
+	    lt->buf == NULL) {
+		fprintf(stderr, "%s: Error: %s\n", prog, strerror(ENOMEM));
+		goto out;
+	}
+	lt->src.fd = lt->dst.fd = -1;
+	lt->count = count;
+	lt->mtu = fd ? CANFD_MTU : CAN_MTU;
+	lt->dlen = size;
+	lt->tag = lt_realtime() ^ getpid();
+
+	uint32_t flags = before.flags | (fd ? F_CAN_FD : 0);
+	if (lt_port_open(&lt->src, before.src, &before, flags, 0) != 0 ||
+	    lt_port_open(&lt->dst, before.dst, &before, flags, 1) != 0)
+		goto out;
+
+	struct sigaction sa, old;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = loadtest_sigint;
+	sigaction(SIGINT, &sa, &old);
+
+	printf("LOADTEST route %" PRIu32 ": %s -> %s, type %s: %" PRIu32
+	       " %s frames of %u bytes, ", before.id, before.src, before.dst,
+	       enum2str(before.type, type_array, TYPE_MAX), count,
+	       fd ? "CAN-FD" : "CAN", lt->dlen);
+	if (rate > 0)
+		printf("%g/s in bursts of %u\n", rate, burst);
+	else
+		printf("as fast as possible\n");
+	fflush(stdout);
+
+	uint64_t start = timing_now();
+	lt_run(lt, rate, burst, timeout);
+	double sec = (timing_now() - start) / 1e9;
+	sigaction(SIGINT, &old, NULL);
+
+	/* the last send timestamps */
+	struct pollfd pfd = { lt->src.fd, 0, 0 };
+	while (lt->tx_kernel < lt->sent && poll(&pfd, 1, 10) > 0)
+		lt_tx_stamps(lt);
+
+	struct hist h;
+	hist_init(&h);
+	for (uint32_t i = 0; i < lt->sent; ++i)
+		if (lt->rx[i] != 0)
+			hist_record(&h, lt->rx[i] > lt->tx[i] ?
+			            lt->rx[i] - lt->tx[i] : 0);
+
+	uint32_t lost = lt->sent - lt->received;
+	printf("\n--- route %" PRIu32 " loadtest statistics ---\n",
+	       before.id);
+	printf("%" PRIu32 " sent, %" PRIu32 " received, %" PRIu32 " lost "
+	       "(%.1f%%), %" PRIu32 " duplicates, %" PRIu32 " reordered, "
+	       "time %.0f ms\n", lt->sent, lt->received, lost,
+	       lt->sent ? 100.0 * lost / lt->sent : 0.0, lt->dups,
+	       lt->reordered, sec * 1e3);
+	if (lt->sent > 1 && lt->tx[lt->sent - 1] > lt->tx[0])
+		printf("throughput sent %.0f frames/s",
+		       (lt->sent - 1) * 1e9 / (lt->tx[lt->sent - 1] -
+		                               lt->tx[0]));
+	if (lt->received > 1 && lt->last_rx > lt->first_rx)
+		printf(", received %.0f frames/s",
+		       (lt->received - 1) * 1e9 / (lt->last_rx -
+		                                   lt->first_rx));
+	printf("\n");
+
+	if (h.n > 0) {
+		printf("latency (%s send, kernel receive timestamps)\n",
+		       lt->tx_kernel >= lt->sent ? "kernel"
+		       : lt->tx_kernel ? "partly kernel" : "userspace");
+		printf("latency min/avg/max/mdev = %.3f/%.3f/%.3f/%.3f us\n",
+		       h.min / 1e3, hist_mean(&h) / 1e3, h.max / 1e3,
+		       hist_stddev(&h) / 1e3);
+		printf("latency p50/p90/p99/p99.9 = %.3f/%.3f/%.3f/%.3f us\n",
+		       hist_percentile(&h, 50) / 1e3,
+		       hist_percentile(&h, 90) / 1e3,
+		       hist_percentile(&h, 99) / 1e3,
+		       hist_percentile(&h, 99.9) / 1e3);
+		lt_histogram(&h);
+	}
+
+	/* the counters of the route have to explain what was seen */
+	if (lt_route(ctx, id, &after) == 0) {
+		uint32_t handled = after.handled - before.handled;
+		uint32_t dropped = after.dropped - before.dropped;
+
+		printf("route counters: handled +%" PRIu32 ", dropped +%"
+		       PRIu32 "\n", handled, dropped);
+		if (handled + dropped < lt->sent)
+			printf("warning: %" PRIu32 " frames did not reach the "
+			       "route\n", lt->sent - handled - dropped);
+		else if (handled + dropped > lt->sent)
+			printf("warning: the route counted %" PRIu32 " frames "
+			       "of other senders\n",
+			       handled + dropped - lt->sent);
+		if (handled > lt->received)
+			printf("warning: %" PRIu32 " handled frames were lost "
+			       "behind the route\n", handled - lt->received);
+		else if (handled < lt->received)
+			printf("warning: %" PRIu32 " received frames were not "
+			       "counted as handled\n",
+			       lt->received - handled);
+	}
+
+	ret = lt->sent == count && lost == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+out:
+	if (lt != NULL) {
+		if (lt->src.fd >= 0)
+			close(lt->src.fd);
+		if (lt->dst.fd >= 0)
+			close(lt->dst.fd);
+		free(lt->tx);
+		free(lt->rx);
+		free(lt->buf);
+		free(lt);
+	}
+	cegw_ctx_free(ctx);
+	return ret;
+}
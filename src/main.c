@@ -39,42 +39,170 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include "netlink.h"
+#include "batch.h"
+#include "apply.h"
+#include "snapshot.h"
+#include "ping.h"
+#include "forward.h"
+#include "bridge.h"
+#include "loadtest.h"
+#include "exporter.h"
+#include "cegwd.h"
+#include "format.h"
+#include "watch.h"
+#include "timing.h"
+
+/**
+ * @struct ctl_ops
+ * @brief The functions which execute the commands. Either directly over
+ *        netlink or forwarded to cegwd.
+ */
+struct ctl_ops {
+	int (*add)(char *dst_name, char *src_name, uint8_t type,
+	           uint32_t flags);
+	int (*del)(uint32_t id, char *dev_name);
+	int (*list)(uint32_t id, unsigned int format);
+	int (*echo)(char *message);
+	void (*exit)(void);
+};
+
+struct cegw_ctx *ctx; /**< connection of netlink_ops to the kernel */
+int dump_stats_flag = 0; /**< set by --dump-stats */
+int dry_run_flag = 0; /**< set by --dry-run, apply prints its plan */
+/** routes of route, set by --src, --dst, --type and --flags */
+struct ce_gw_route_filter route_filter;
+
+/**
+ * @fn int netlink_add(char *dst_name, char *src_name, uint8_t type,
+ *                     uint32_t flags)
+ * @brief ce_gw_add() over ctx.
+ */
+static int netlink_add(char *dst_name, char *src_name, uint8_t type,
+                       uint32_t flags)
+{
+	return ce_gw_add(ctx, dst_name, src_name, type, flags);
+}
+
+/**
+ * @fn int netlink_del(uint32_t id, char *dev_name)
+ * @brief ce_gw_del() over ctx.
+ */
+static int netlink_del(uint32_t id, char *dev_name)
+{
+	return ce_gw_del(ctx, id, dev_name);
+}
+
+/**
+ * @fn int netlink_list(uint32_t id, unsigned int format)
+ * @brief ce_gw_list() over ctx. With --dump-stats the counters of the dump
+ *        are printed to stderr afterwards.
+ */
+static int netlink_list(uint32_t id, unsigned int format)
+{
+	int err = ce_gw_list(ctx, id, &route_filter, format);
+
+	if (dump_stats_flag) {
+		const struct ce_gw_dump_stats *st = cegw_ctx_dump_stats(ctx);
+
+		fprintf(stderr, "dump: %" PRIu64 " messages, %" PRIu64
+		        " bytes, %" PRIu64 " restarts, %" PRIu64
+		        " overruns, %d bytes receive buffer\n", st->messages,
+		        st->bytes, st->restarts, st->overruns, st->rcvbuf);
+	}
+
+	return err;
+}
+
+/**
+ * @fn int netlink_echo(char *message)
+ * @brief ce_gw_echo() over ctx.
+ */
+static int netlink_echo(char *message)
+{
+	return ce_gw_echo(ctx, message);
+}
+
+/**
+ * @fn void netlink_exit(void)
+ * @brief frees ctx.
+ */
+static void netlink_exit(void)
+{
+	cegw_ctx_free(ctx);
+}
+
+const struct ctl_ops netlink_ops = {
+	netlink_add, netlink_del, netlink_list, netlink_echo, netlink_exit
+};
+
+const struct ctl_ops daemon_ops = {
+	cegwd_add, cegwd_del, cegwd_list, cegwd_echo, cegwd_close
+};
+
+const struct ctl_ops *ops = &netlink_ops;
 
 int verbose_flag;
+int daemon_flag = 0;
+int no_header_flag = 0;
 int bidirectional_flag = 0;
 uint32_t flags = 0;
 uint8_t gw_type = TYPE_NET;
+char *batch_file = NULL;
+unsigned int batch_window = BATCH_WINDOW;
+int window_flag = 0; /**< set by -w, else restore uses CE_GW_SNAP_WINDOW */
+unsigned int batch_jobs = 1; /**< worker threads of -batch, set by -j */
+double watch_interval = 0; /**< > 0 for route --watch or --delta */
+int watch_once = 0; /**< set by --delta */
 
 int main(int argc, char *argv[])
 {
 	int err = 0;
-
-	err = nl_sk_fam_init();
-	if (err != 0) {
-		fprintf(stderr,
-		        "Error during initialisation of Socket or Netlink "
-		        "Family: %d\n", err);
-		return EXIT_FAILURE;
-	}
-
 	int c;
+	unsigned int list_format = FORMAT_TEXT;
+
+	/* ping has options of its own, e.g. -s SIZE instead of --src */
+	if (argc >= 2 && !strcmp(argv[1], "ping"))
+		return ping_main(argc - 1, argv + 1);
+	if (argc >= 2 && !strcmp(argv[1], "forward"))
+		return forward_main(argc - 1, argv + 1);
+	if (argc >= 2 && !strcmp(argv[1], "bridge"))
+		return bridge_main(argc - 1, argv + 1);
+	if (argc >= 2 && !strcmp(argv[1], "loadtest"))
+		return loadtest_main(argc - 1, argv + 1);
+	if (argc >= 2 && !strcmp(argv[1], "exporter"))
+		return exporter_main(argc - 1, argv + 1);
 
 	while (1) {
 		static struct option long_options[] = {
 			/* These options set a flag. */
+			{"daemon",  no_argument, &daemon_flag, 1},
+			{"no-header", no_argument, &no_header_flag, 1},
+			{"dump-stats", no_argument, &dump_stats_flag, 1},
+			{"dry-run", no_argument, &dry_run_flag, 1},
 
 			/* These options don't set a flag.
 			   We distinguish them by their indices. */
 			{"bidirectional", no_argument, 0, 'b'},
 			{"can-fd",        no_argument, 0, 'f'},
 			{"type",    required_argument, 0, 't'},
+			{"batch",   required_argument, 0, 'B'},
+			{"window",  required_argument, 0, 'w'},
+			{"jobs",    required_argument, 0, 'j'},
+			{"watch",   optional_argument, 0, 'W'},
+			{"delta",   required_argument, 0, 'D'},
+			{"format",  required_argument, 0, 'F'},
+			{"timing",  optional_argument, 0, 'T'},
+			{"src",     required_argument, 0, 's'},
+			{"dst",     required_argument, 0, 'd'},
+			{"flags",   required_argument, 0, 'g'},
 			{0, 0, 0, 0},
 		};
 		/* getopt_long stores the option index here. */
 		int option_index = 0;
 
-		c = getopt_long (argc, argv, "bft:",
-		                 long_options, &option_index);
+		/* long_only to accept "-batch FILE" like ip(8) */
+		c = getopt_long_only (argc, argv, "bft:w:j:",
+		                      long_options, &option_index);
 
 		/* Detect the end of the options. */
 		if (c == -1)
@@ -101,22 +229,109 @@ int main(int argc, char *argv[])
 			break;
 
 		case 't':
-			if(!strcmp(optarg, "none")) {
-				gw_type = TYPE_NONE;
-			} else if(!strcmp(optarg, "eth")) {
-				gw_type = TYPE_ETH;
-			} else if (!strcmp(optarg, "net")) {
-				gw_type = TYPE_NET;
-			} else if (!strcmp(optarg, "tcp")) {
-				gw_type = TYPE_TCP;
-			} else if (!strcmp(optarg, "udp")) {
-				gw_type = TYPE_UDP;
-			} else {
+			err = str2type(optarg);
+			if (err < 0) {
 				fprintf(stderr, "%s: Supported Types: "
 				        "none, eth, net, tcp, udp\n", argv[0]);
 				return EXIT_FAILURE;
 			}
 
+			gw_type = err;
+			route_filter.type = err;
+			route_filter.fields |= CE_GW_FILTER_TYPE;
+			err = 0;
+			break;
+
+		case 's':
+		case 'd': {
+			char *name = c == 's' ? route_filter.src
+			             : route_filter.dst;
+			if (strlen(optarg) >= IFNAMSIZ) {
+				fprintf(stderr, "%s: Error: device name %s "
+				        "is too long\n", argv[0], optarg);
+				return EXIT_FAILURE;
+			}
+
+			strcpy(name, optarg);
+			route_filter.fields |= c == 's' ? CE_GW_FILTER_SRC
+			                       : CE_GW_FILTER_DST;
+			break;
+		}
+
+		case 'g':
+			if (str2flags(optarg, &route_filter.flags) != 0) {
+				fprintf(stderr, "%s: Supported Flags: "
+				        "can-fd or a number\n", argv[0]);
+				return EXIT_FAILURE;
+			}
+
+			route_filter.fields |= CE_GW_FILTER_FLAGS;
+			break;
+
+		case 'B':
+			batch_file = optarg;
+			break;
+
+		case 'w': {
+			uintmax_t num = strtoumax(optarg, NULL, 0);
+			if (num == 0 || num > UINT16_MAX) {
+				fprintf(stderr, "%s: Error: window must be "
+				        "between 1 and %d\n", argv[0],
+				        UINT16_MAX);
+				return EXIT_FAILURE;
+			}
+
+			batch_window = num;
+			window_flag = 1;
+			break;
+		}
+
+		case 'j': {
+			uintmax_t num = strtoumax(optarg, NULL, 0);
+			if (num == 0 || num > BATCH_MAX_JOBS) {
+				fprintf(stderr, "%s: Error: jobs must be "
+				        "between 1 and %d\n", argv[0],
+				        BATCH_MAX_JOBS);
+				return EXIT_FAILURE;
+			}
+
+			batch_jobs = num;
+			break;
+		}
+
+		case 'F':
+			err = str2format(optarg);
+			if (err < 0) {
+				fprintf(stderr, "%s: Supported Formats: "
+				        "text, json, csv, bin\n", argv[0]);
+				return EXIT_FAILURE;
+			}
+
+			list_format = err;
+			err = 0;
+			break;
+
+		case 'T':
+			err = timing_init(optarg);
+			if (err < 0) {
+				fprintf(stderr, "%s: Error: cannot open %s: "
+				        "%s\n", argv[0], optarg, strerror(-err));
+				return EXIT_FAILURE;
+			}
+			err = 0;
+			break;
+
+		case 'W':
+		case 'D':
+			watch_interval = optarg ? strtod(optarg, NULL)
+			                 : WATCH_INTERVAL;
+			watch_once = (c == 'D');
+			if (!(watch_interval > 0)) {
+				fprintf(stderr, "%s: Error: interval must be "
+				        "a positive number of seconds\n",
+				        argv[0]);
+				return EXIT_FAILURE;
+			}
 			break;
 
 		case '?':
@@ -134,6 +349,71 @@ int main(int argc, char *argv[])
 	if (verbose_flag)
 		puts ("verbose flag is set\n");
 
+	if (no_header_flag)
+		list_format |= FORMAT_NO_HEADER;
+
+	if (watch_interval > 0 && (list_format & FORMAT_MASK) == FORMAT_BIN) {
+		fprintf(stderr, "%s: Error: --format=bin is not supported by "
+		        "--watch and --delta\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	/* monitor uses an own socket and needs no family */
+	if (optind < argc && !strcmp(argv[optind], "monitor")) {
+		err = ce_gw_monitor(ce_gw_event_print, NULL);
+		if (err != 0) {
+			fprintf(stderr, "%s: Error during monitor: %d\n",
+			        argv[0], err);
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	/* forward to cegwd if it is running, batch, the file commands, watch
+	 * and filtered routes need the socket itself */
+	int filtered = route_filter.fields != 0 && optind < argc &&
+	               !strcmp(argv[optind], "route");
+	int file_cmd = optind + 2 <= argc && (!strcmp(argv[optind], "apply") ||
+	               !strcmp(argv[optind], "save") ||
+	               !strcmp(argv[optind], "restore"));
+	if (daemon_flag && batch_file == NULL && watch_interval == 0 &&
+	    !filtered && !file_cmd && cegwd_connect() == 0) {
+		ops = &daemon_ops;
+	} else {
+		ctx = cegw_ctx_alloc();
+		if (ctx == NULL) {
+			fprintf(stderr,
+			        "Error during initialisation of Socket or "
+			        "Netlink Family\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* -batch FILE */
+	if (batch_file != NULL) {
+		err = batch_run_file(ctx, batch_file, batch_window,
+		                     batch_jobs, gw_type, flags,
+		                     bidirectional_flag);
+		cegw_ctx_free(ctx);
+		return err == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	/* apply FILE, save FILE, restore FILE */
+	if (file_cmd) {
+		if (!strcmp(argv[optind], "apply"))
+			err = apply_file(ctx, argv[optind+1], batch_window,
+			                 gw_type, flags, bidirectional_flag,
+			                 dry_run_flag);
+		else if (!strcmp(argv[optind], "save"))
+			err = snapshot_save(ctx, argv[optind+1]);
+		else
+			err = snapshot_restore(ctx, argv[optind+1], window_flag
+			                       ? batch_window
+			                       : CE_GW_SNAP_WINDOW);
+		cegw_ctx_free(ctx);
+		return err == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 
 	/***************************************************/
 	/* Remaining command line arguments (not options). */
@@ -144,20 +424,20 @@ int main(int argc, char *argv[])
 		if(!strcmp(argv[optind], "add") &&
 		    !strcmp(argv[optind+1], "route") && optind+4 <= argc) {
 
-			err = ce_gw_add(argv[optind+3], argv[optind+2],
-			                gw_type, flags);
+			err = ops->add(argv[optind+3], argv[optind+2],
+			               gw_type, flags);
 			if (err != 0) {
-				fprintf(stderr, "%s: Error during add: %d",
+				fprintf(stderr, "%s: Error during add: %d\n",
 				        argv[0], err);
 				return EXIT_FAILURE;
 			}
 
 			if (bidirectional_flag == 1) {
-				err = ce_gw_add(argv[optind+2], argv[optind+3],
-				                gw_type, flags);
+				err = ops->add(argv[optind+2], argv[optind+3],
+				               gw_type, flags);
 				if (err != 0) {
 					fprintf(stderr, "%s: Error during "
-					        "add: %d", argv[0], err);
+					        "add: %d\n", argv[0], err);
 					return EXIT_FAILURE;
 				}
 			}
@@ -169,21 +449,21 @@ int main(int argc, char *argv[])
 		           !strcmp(argv[optind+1], "dev") && optind+2 <= argc) {
 
 			if (optind+3 <= argc) {
-				err = ce_gw_add(argv[optind+2], NULL, gw_type,
-				                flags);
+				err = ops->add(argv[optind+2], NULL, gw_type,
+				               flags);
 				if (err != 0) {
 					fprintf(stderr, "%s: Error during "
-					        "add: %d", argv[0], err);
+					        "add: %d\n", argv[0], err);
 					return EXIT_FAILURE;
 				}
 
 				optind += 3;
 			} else {
 
-				err = ce_gw_add("cegw%d", NULL, gw_type, flags);
+				err = ops->add("cegw%d", NULL, gw_type, flags);
 				if (err != 0) {
 					fprintf(stderr, "%s: Error during "
-					        "add: %d", argv[0], err);
+					        "add: %d\n", argv[0], err);
 					return EXIT_FAILURE;
 				}
 
@@ -201,7 +481,7 @@ int main(int argc, char *argv[])
 				        argv[0], errno);
 			}
 
-			err = ce_gw_del((uint32_t) num, NULL);
+			err = ops->del((uint32_t) num, NULL);
 			if (err != 0) {
 				fprintf(stderr, "%s: Error during del: %d\n",
 				        argv[0], err);
@@ -214,7 +494,7 @@ int main(int argc, char *argv[])
 		} else if(!strcmp(argv[optind], "del") &&
 		          !strcmp(argv[optind+1], "dev") && optind+3 <= argc ) {
 
-			err = ce_gw_del(0, argv[optind+2]);
+			err = ops->del(0, argv[optind+2]);
 			if (err != 0) {
 				fprintf(stderr, "%s: Error during del: %d\n",
 				        argv[0], err);
@@ -226,9 +506,9 @@ int main(int argc, char *argv[])
 			/* echo MSG */
 		} else if(!strcmp(argv[optind], "echo") && optind+2 <= argc) {
 
-			err = ce_gw_echo(argv[optind+1]);
+			err = ops->echo(argv[optind+1]);
 			if (err != 0) {
-				fprintf(stderr, "%s: Error during echo: %d",
+				fprintf(stderr, "%s: Error during echo: %d\n",
 				        argv[0], err);
 				return EXIT_FAILURE;
 			}
@@ -247,16 +527,30 @@ int main(int argc, char *argv[])
 					        argv[0], errno);
 				}
 
-				err = ce_gw_list(num);
+				if (watch_interval > 0)
+					err = ce_gw_watch(ctx, num,
+					                  &route_filter,
+					                  watch_interval,
+					                  watch_once,
+					                  list_format);
+				else
+					err = ops->list(num, list_format);
 				optind += 2;
 
 			} else {
-				err = ce_gw_list(0);
+				if (watch_interval > 0)
+					err = ce_gw_watch(ctx, 0,
+					                  &route_filter,
+					                  watch_interval,
+					                  watch_once,
+					                  list_format);
+				else
+					err = ops->list(0, list_format);
 				optind += 1;
 			}
 
 			if (err != 0) {
-				fprintf(stderr, "%s: Error during list: %d",
+				fprintf(stderr, "%s: Error during list: %d\n",
 				        argv[0], err);
 				return EXIT_FAILURE;
 			}
@@ -276,7 +570,7 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	nl_sk_fam_exit();
+	ops->exit();
 	return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,1347 @@
+/**
+ * @file mock.c
+ * @brief Control Area Network - Ethernet - Gateway - Mock Kernel (Utility)
+ * @details The transport "mock": the messages of the libnl socket are not
+ *          sent to the kernel but answered in this process, like the ce_gw
+ *          module and the generic netlink controller would answer them.
+ *          Like in the kernel, the tables are shared by all sockets and
+ *          locked, while every socket has its own answers and dump.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <linux/genetlink.h>
+
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+#include <netlink/errno.h>
+#include <netlink/handlers.h>
+#include <netlink/genl/genl.h>
+#include <netlink/genl/ctrl.h>
+#include "netlink.h"
+#include "protocol.h"
+#include "transport.h"
+#include "ifcache.h"
+#include "mock.h"
+
+#define MOCK_FAMILY_ID (GENL_MIN_ID + 8) /**< family ID of CE_GW */
+
+/**
+ * @enum mock_op
+ * @brief Requests in which the mock can inject errors. See mock_fail().
+ */
+enum mock_op {
+	MOCK_OP_ECHO,	/**< CE_GW_C_ECHO */
+	MOCK_OP_ADD,	/**< CE_GW_C_ADD */
+	MOCK_OP_DEL,	/**< CE_GW_C_DEL */
+	MOCK_OP_LIST,	/**< CE_GW_C_LIST */
+	MOCK_OP_FAMILY,	/**< CTRL_CMD_GETFAMILY */
+	MOCK_OP_SEND,	/**< sending of any message */
+	MOCK_OP_RECV,	/**< receiving of any buffer */
+	MOCK_OP_INTR,	/**< a buffer of a dump is marked NLM_F_DUMP_INTR */
+	__MOCK_OP_MAX,	/**< Maximum Number of Operations plus 1 */
+};
+#define MOCK_OP_MAX (__MOCK_OP_MAX - 1)
+
+/** Names of enum mock_op for mock_fail(), the index is the value. */
+static const struct enums op_array[] = {
+	{ "echo"	},
+	{ "add"		},
+	{ "del"		},
+	{ "list"	},
+	{ "family"	},
+	{ "send"	},
+	{ "recv"	},
+	{ "intr"	},
+	{ 0		}
+};
+
+/**
+ * @struct errno_name
+ * @brief Name of an errno for mock_fail().
+ */
+struct errno_name {
+	const char *name;
+	int err;
+};
+
+/** errnos which mock_fail() knows by name. Ends with {0}. */
+static const struct errno_name errno_array[] = {
+	{ "EPERM",	EPERM		},
+	{ "ENOENT",	ENOENT		},
+	{ "EINTR",	EINTR		},
+	{ "EIO",	EIO		},
+	{ "EAGAIN",	EAGAIN		},
+	{ "ENOMEM",	ENOMEM		},
+	{ "EBUSY",	EBUSY		},
+	{ "EEXIST",	EEXIST		},
+	{ "ENODEV",	ENODEV		},
+	{ "EINVAL",	EINVAL		},
+	{ "ENOSPC",	ENOSPC		},
+	{ "EMSGSIZE",	EMSGSIZE	},
+	{ "EOPNOTSUPP",	EOPNOTSUPP	},
+	{ "ENOBUFS",	ENOBUFS		},
+	{ "ETIMEDOUT",	ETIMEDOUT	},
+	{ 0,		0		}
+};
+
+/**
+ * @struct mock_fault
+ * @brief An injected error of one enum mock_op.
+ */
+struct mock_fault {
+	int err;		/**< positive errno, 0 for none */
+	unsigned int every;	/**< every n-th request fails */
+	unsigned int count;	/**< requests since the last failure */
+	int left;		/**< failures left, -1 for no limit */
+};
+
+/**
+ * @struct mock_dev
+ * @brief A device known to the mock.
+ */
+struct mock_dev {
+	char name[IFNAMSIZ];	/**< name of the device */
+	uint8_t type;		/**< enum gw_type of a gateway device */
+	uint32_t flags;		/**< see F_CAN_FD */
+	int can;		/**< a CAN device, which can not be deleted */
+	int ifindex;		/**< interface index, unique until the reset */
+};
+
+/**
+ * @struct mock_route
+ * @brief A route of the mock. Deleted routes stay in the table as dead
+ *        ones until it is compacted, so the table stays sorted by ID.
+ */
+struct mock_route {
+	struct ce_gw_route route;	/**< the route */
+	int src_if;			/**< interface index of route.src */
+	int dst_if;			/**< interface index of route.dst */
+	int dead;			/**< 1 if the route is deleted */
+};
+
+/**
+ * @struct mock_dgram
+ * @brief A buffer of answers, returned by one receive.
+ */
+struct mock_dgram {
+	struct mock_dgram *next;	/**< next buffer of the queue */
+	unsigned char *buf;		/**< the messages */
+	size_t len;			/**< used bytes of buf */
+	size_t size;			/**< allocated bytes of buf */
+};
+
+/**
+ * @struct mock_dump
+ * @brief A CE_GW_C_LIST in progress. Its buffers are built when they are
+ *        received, like the kernel does with a dump.
+ */
+struct mock_dump {
+	int active;		/**< 1 while the dump is not finished */
+	int intr;		/**< 1 if the tables changed since the start */
+	uint32_t gen;		/**< mock.gen at the start */
+	uint32_t id;		/**< requested route ID, 0 for all */
+	struct ce_gw_route_filter filter; /**< routes of the dump */
+	size_t pos;		/**< next index in the route table */
+	struct nlmsghdr req;	/**< header of the request */
+};
+
+/**
+ * @struct mock_sock
+ * @brief A socket opened with mock_open(): its answers and its dump.
+ */
+struct mock_sock {
+	struct mock_sock *next;		/**< next socket of the mock */
+	struct nl_sock *sk;		/**< the libnl socket */
+	struct mock_dump dump;		/**< the running dump */
+	struct mock_dgram *head;	/**< first buffer to receive */
+	struct mock_dgram *tail;	/**< last buffer to receive */
+};
+
+/**
+ * @brief State of the mock kernel.
+ */
+static struct {
+	pthread_mutex_t lock;		/**< held by every request */
+	int init;			/**< 1 after the first open */
+	struct mock_dev *devs;		/**< the devices */
+	size_t n_devs;			/**< number of devices */
+	size_t size_devs;		/**< allocated devices */
+	struct mock_route *routes;	/**< the routes, sorted by ID */
+	size_t n_routes;		/**< number of routes incl. dead ones */
+	size_t size_routes;		/**< allocated routes */
+	size_t dead;			/**< number of dead routes */
+	uint32_t next_id;		/**< ID of the next added route */
+	int next_ifindex;		/**< index of the next added device */
+	uint32_t gen;			/**< changed by every add and del */
+	struct mock_sock *socks;	/**< the open sockets */
+	struct mock_fault faults[__MOCK_OP_MAX]; /**< injected errors */
+} mock = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * @fn int fault(enum mock_op op)
+ * @brief Counts a request op and checks if it has to fail.
+ * @retval 0 if it does not fail
+ * @retval <0 the injected -errno
+ */
+static int fault(enum mock_op op)
+{
+	struct mock_fault *f = &mock.faults[op];
+
+	if (f->err == 0 || f->left == 0 || ++f->count < f->every)
+		return 0;
+
+	f->count = 0;
+	if (f->left > 0)
+		f->left--;
+	return -f->err;
+}
+
+/**
+ * @fn struct mock_dgram *dgram_alloc(size_t size)
+ * @brief Allocates an empty buffer for size bytes of answers.
+ * @retval NULL on failure
+ */
+static struct mock_dgram *dgram_alloc(size_t size)
+{
+	struct mock_dgram *d = calloc(1, sizeof(*d));
+	if (d == NULL)
+		return NULL;
+
+	d->buf = calloc(1, size);
+	if (d->buf == NULL) {
+		free(d);
+		return NULL;
+	}
+	d->size = size;
+
+	return d;
+}
+
+/**
+ * @fn void dgram_free(struct mock_dgram *d)
+ * @brief Frees a buffer which was not received.
+ */
+static void dgram_free(struct mock_dgram *d)
+{
+	free(d->buf);
+	free(d);
+}
+
+/**
+ * @fn void dgram_queue(struct mock_sock *ms, struct mock_dgram *d)
+ * @brief Appends d to the buffers waiting to be received by ms.
+ */
+static void dgram_queue(struct mock_sock *ms, struct mock_dgram *d)
+{
+	d->next = NULL;
+	if (ms->tail != NULL)
+		ms->tail->next = d;
+	else
+		ms->head = d;
+	ms->tail = d;
+}
+
+/**
+ * @fn struct nlmsghdr *dgram_msg(struct mock_dgram *d,
+ *                                const struct nlmsghdr *req, int type,
+ *                                int flags, size_t payload)
+ * @brief Appends the header of an answer to req with payload bytes.
+ * @retval NULL if d has no space left
+ */
+static struct nlmsghdr *dgram_msg(struct mock_dgram *d,
+                                  const struct nlmsghdr *req, int type,
+                                  int flags, size_t payload)
+{
+	size_t len = NLMSG_ALIGN(NLMSG_HDRLEN + payload);
+	struct nlmsghdr *hdr;
+
+	if (d->len + len > d->size)
+		return NULL;
+
+	hdr = (struct nlmsghdr *) (d->buf + d->len);
+	memset(hdr, 0, len);
+	hdr->nlmsg_len = NLMSG_HDRLEN + payload;
+	hdr->nlmsg_type = type;
+	hdr->nlmsg_flags = flags;
+	hdr->nlmsg_seq = req->nlmsg_seq;
+	hdr->nlmsg_pid = req->nlmsg_pid;
+	d->len += len;
+
+	return hdr;
+}
+
+/**
+ * @fn struct nlmsghdr *dgram_genl(struct mock_dgram *d,
+ *                                 const struct nlmsghdr *req, int type,
+ *                                 int flags, uint8_t cmd)
+ * @brief Appends the headers of a generic netlink answer to req. The
+ *        attributes are added with dgram_attr().
+ * @retval NULL if d has no space left
+ */
+static struct nlmsghdr *dgram_genl(struct mock_dgram *d,
+                                   const struct nlmsghdr *req, int type,
+                                   int flags, uint8_t cmd)
+{
+	struct nlmsghdr *hdr;
+	struct genlmsghdr *ghdr;
+
+	hdr = dgram_msg(d, req, type, flags, GENL_HDRLEN + USER_HDR_SIZE);
+	if (hdr == NULL)
+		return NULL;
+
+	ghdr = nlmsg_data(hdr);
+	ghdr->cmd = cmd;
+	ghdr->version = GE_FAMILY_VERSION;
+
+	return hdr;
+}
+
+/**
+ * @fn int dgram_attr(struct mock_dgram *d, struct nlmsghdr *hdr, int type,
+ *                    const void *data, size_t len)
+ * @brief Appends an attribute to hdr, the last message of d.
+ * @retval 0 on success
+ * @retval -EMSGSIZE if d has no space left
+ */
+static int dgram_attr(struct mock_dgram *d, struct nlmsghdr *hdr, int type,
+                      const void *data, size_t len)
+{
+	size_t size = nla_total_size(len);
+	struct nlattr *nla;
+
+	if (d->len + size > d->size)
+		return -EMSGSIZE;
+
+	nla = (struct nlattr *) (d->buf + d->len);
+	memset(nla, 0, size);
+	nla->nla_type = type;
+	nla->nla_len = nla_attr_size(len);
+	memcpy(nla_data(nla), data, len);
+
+	hdr->nlmsg_len = NLMSG_ALIGN(hdr->nlmsg_len) + size;
+	d->len += size;
+
+	return 0;
+}
+
+/**
+ * @fn int dgram_str(struct mock_dgram *d, struct nlmsghdr *hdr, int type,
+ *                   const char *str)
+ * @brief Appends a NLA_STRING attribute, see dgram_attr().
+ */
+static int dgram_str(struct mock_dgram *d, struct nlmsghdr *hdr, int type,
+                     const char *str)
+{
+	return dgram_attr(d, hdr, type, str, strlen(str) + 1);
+}
+
+/**
+ * @fn void mock_answer(struct mock_sock *ms, const struct nlmsghdr *req,
+ *                      int err)
+ * @brief Queues the ACK (err is 0) or the error of req.
+ */
+static void mock_answer(struct mock_sock *ms, const struct nlmsghdr *req,
+                        int err)
+{
+	struct mock_dgram *d;
+	struct nlmsghdr *hdr;
+	struct nlmsgerr *nlerr;
+
+	d = dgram_alloc(NLMSG_ALIGN(NLMSG_HDRLEN + sizeof(*nlerr)));
+	if (d == NULL)
+		return;
+
+	/* like NETLINK_CAP_ACK, only the header of the request is copied */
+	hdr = dgram_msg(d, req, NLMSG_ERROR, 0, sizeof(*nlerr));
+	nlerr = nlmsg_data(hdr);
+	nlerr->error = err;
+	nlerr->msg = *req;
+
+	dgram_queue(ms, d);
+}
+
+/**
+ * @fn int name_get(struct nlattr *attr, char *name)
+ * @brief Copies a device name from attr.
+ * @param name buffer of IFNAMSIZ bytes
+ * @retval 0 on success
+ * @retval -EINVAL if attr is missing, empty or too long
+ */
+static int name_get(struct nlattr *attr, char *name)
+{
+	if (attr == NULL || nla_len(attr) < 1)
+		return -EINVAL;
+
+	size_t len = strnlen(nla_data(attr), nla_len(attr));
+	if (len == 0 || len >= IFNAMSIZ)
+		return -EINVAL;
+
+	memcpy(name, nla_data(attr), len);
+	name[len] = '\0';
+	return 0;
+}
+
+/**
+ * @fn struct mock_dev *dev_find(const char *name)
+ * @brief Returns the device of this name or NULL.
+ */
+static struct mock_dev *dev_find(const char *name)
+{
+	for (size_t i = 0; i < mock.n_devs; ++i) {
+		if (strcmp(mock.devs[i].name, name) == 0)
+			return &mock.devs[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * @fn int dev_add(const char *name, uint8_t type, uint32_t flags, int can)
+ * @brief Adds a device.
+ * @retval 0 on success
+ * @retval -EEXIST if there is a device of this name
+ * @retval -ENOMEM if the table could not grow
+ */
+static int dev_add(const char *name, uint8_t type, uint32_t flags, int can)
+{
+	struct mock_dev *dev;
+
+	if (dev_find(name) != NULL)
+		return -EEXIST;
+
+	if (mock.n_devs == mock.size_devs) {
+		size_t size = mock.size_devs ? mock.size_devs * 2 : 32;
+		dev = realloc(mock.devs, size * sizeof(*dev));
+		if (dev == NULL)
+			return -ENOMEM;
+
+		mock.devs = dev;
+		mock.size_devs = size;
+	}
+
+	dev = &mock.devs[mock.n_devs++];
+	memset(dev, 0, sizeof(*dev));
+	strncpy(dev->name, name, IFNAMSIZ - 1);
+	dev->type = type;
+	dev->flags = flags;
+	dev->can = can;
+	dev->ifindex = mock.next_ifindex++;
+
+	return 0;
+}
+
+/**
+ * @fn struct mock_dev *dev_find_index(int ifindex)
+ * @brief Returns the device with this interface index or NULL.
+ */
+static struct mock_dev *dev_find_index(int ifindex)
+{
+	for (size_t i = 0; i < mock.n_devs; ++i) {
+		if (mock.devs[i].ifindex == ifindex)
+			return &mock.devs[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * @fn struct mock_dev *dev_get(struct nlattr *name, struct nlattr *ifindex)
+ * @brief Returns the device of an interface index attribute or, without
+ *        it, of a name attribute.
+ * @retval NULL if there is no such device or no attribute
+ */
+static struct mock_dev *dev_get(struct nlattr *name, struct nlattr *ifindex)
+{
+	char buf[IFNAMSIZ];
+
+	if (ifindex != NULL)
+		return dev_find_index(nla_get_u32(ifindex));
+	if (name_get(name, buf) != 0)
+		return NULL;
+	return dev_find(buf);
+}
+
+/**
+ * @fn struct mock_route *route_find(uint32_t id)
+ * @brief Returns the living route with this ID or NULL.
+ */
+static struct mock_route *route_find(uint32_t id)
+{
+	size_t lo = 0, hi = mock.n_routes;
+
+	/* the IDs are ascending, dead routes keep their place */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		struct mock_route *r = &mock.routes[mid];
+
+		if (r->route.id == id)
+			return r->dead ? NULL : r;
+		if (r->route.id < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+/**
+ * @fn struct ce_gw_route *route_add(const struct mock_dev *src,
+ *                                   const struct mock_dev *dst,
+ *                                   uint8_t type, uint32_t flags)
+ * @brief Appends a route with the next ID from src to dst.
+ * @retval NULL if the table could not grow
+ */
+static struct ce_gw_route *route_add(const struct mock_dev *src,
+                                     const struct mock_dev *dst,
+                                     uint8_t type, uint32_t flags)
+{
+	struct mock_route *r;
+
+	if (mock.n_routes == mock.size_routes) {
+		size_t size = mock.size_routes ? mock.size_routes * 2 : 1024;
+		r = realloc(mock.routes, size * sizeof(*r));
+		if (r == NULL)
+			return NULL;
+
+		mock.routes = r;
+		mock.size_routes = size;
+	}
+
+	r = &mock.routes[mock.n_routes++];
+	memset(r, 0, sizeof(*r));
+	r->route.id = mock.next_id++;
+	r->route.type = type;
+	r->route.flags = flags;
+	strcpy(r->route.src, src->name);
+	strcpy(r->route.dst, dst->name);
+	r->src_if = src->ifindex;
+	r->dst_if = dst->ifindex;
+
+	return &r->route;
+}
+
+/**
+ * @fn int dump_running(void)
+ * @brief Returns 1 if a socket has a running dump, which walks the table by
+ *        index.
+ */
+static int dump_running(void)
+{
+	for (struct mock_sock *ms = mock.socks; ms != NULL; ms = ms->next) {
+		if (ms->dump.active)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @fn void routes_compact(void)
+ * @brief Removes the dead routes from the table if they are more than half
+ *        of it and no dump is running.
+ */
+static void routes_compact(void)
+{
+	size_t n = 0;
+
+	if (mock.dead * 2 < mock.n_routes || dump_running())
+		return;
+
+	for (size_t i = 0; i < mock.n_routes; ++i) {
+		if (!mock.routes[i].dead)
+			mock.routes[n++] = mock.routes[i];
+	}
+	mock.n_routes = n;
+	mock.dead = 0;
+}
+
+/**
+ * @fn int mock_add(struct nlattr **attrs)
+ * @brief CE_GW_C_ADD: adds a gateway device (no CE_GW_A_SRC) or a route
+ *        between two existing devices.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int mock_add(struct nlattr **attrs)
+{
+	char dst[IFNAMSIZ];
+	uint8_t type = TYPE_NONE;
+	uint32_t flags = 0;
+	int err;
+
+	err = fault(MOCK_OP_ADD);
+	if (err != 0)
+		return err;
+
+	if (name_get(attrs[CE_GW_A_DST], dst) != 0)
+		return -EINVAL;
+	if (attrs[CE_GW_A_TYPE] != NULL)
+		type = nla_get_u8(attrs[CE_GW_A_TYPE]);
+	if (attrs[CE_GW_A_FLAGS] != NULL)
+		flags = nla_get_u32(attrs[CE_GW_A_FLAGS]);
+	if (type > TYPE_MAX)
+		return -EINVAL;
+
+	if (attrs[CE_GW_A_SRC] == NULL)
+		return dev_add(dst, type, flags, 0);
+
+	/* the interface indexes win over the names, like in a kernel which
+	 * knows them */
+	struct mock_dev *s = dev_get(attrs[CE_GW_A_SRC], attrs[CE_GW_A_SRC_IF]);
+	struct mock_dev *d = dev_get(attrs[CE_GW_A_DST], attrs[CE_GW_A_DST_IF]);
+	if (s == NULL || d == NULL)
+		return -ENODEV;
+	if (s == d)
+		return -EINVAL;
+
+	return route_add(s, d, type, flags) ? 0 : -ENOMEM;
+}
+
+/**
+ * @fn int mock_del(struct nlattr **attrs)
+ * @brief CE_GW_C_DEL: deletes a gateway device with its routes or a route.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int mock_del(struct nlattr **attrs)
+{
+	char name[IFNAMSIZ];
+	uint32_t id = 0;
+	int err;
+
+	err = fault(MOCK_OP_DEL);
+	if (err != 0)
+		return err;
+
+	if (attrs[CE_GW_A_ID] != NULL)
+		id = nla_get_u32(attrs[CE_GW_A_ID]);
+
+	if (attrs[CE_GW_A_DST] == NULL) {
+		struct mock_route *r = route_find(id);
+		if (id == 0 || r == NULL)
+			return -ENOENT;
+
+		r->dead = 1;
+		mock.dead++;
+		routes_compact();
+		return 0;
+	}
+
+	if (id != 0 || name_get(attrs[CE_GW_A_DST], name) != 0)
+		return -EINVAL;
+
+	struct mock_dev *dev = dev_find(name);
+	if (dev == NULL)
+		return -ENODEV;
+	if (dev->can)
+		return -EPERM;
+
+	/* the routes go with their device */
+	for (size_t i = 0; i < mock.n_routes; ++i) {
+		struct mock_route *r = &mock.routes[i];
+		if (!r->dead && (strcmp(r->route.src, name) == 0 ||
+		                 strcmp(r->route.dst, name) == 0)) {
+			r->dead = 1;
+			mock.dead++;
+		}
+	}
+	routes_compact();
+
+	*dev = mock.devs[--mock.n_devs];
+	return 0;
+}
+
+/**
+ * @fn int mock_list(struct mock_sock *ms, const struct nlmsghdr *req,
+ *                   struct nlattr **attrs)
+ * @brief CE_GW_C_LIST: starts the dump of one or all routes. The messages
+ *        are built by mock_dump_next() as they are received. Like a kernel
+ *        with filter support, only the routes selected by CE_GW_A_SRC,
+ *        CE_GW_A_DST, CE_GW_A_TYPE and CE_GW_A_FLAGS are dumped.
+ * @retval 0 on success
+ * @retval -EBUSY if the last dump is still running
+ */
+static int mock_list(struct mock_sock *ms, const struct nlmsghdr *req,
+                     struct nlattr **attrs)
+{
+	struct mock_dump *dump = &ms->dump;
+	int err;
+
+	err = fault(MOCK_OP_LIST);
+	if (err != 0)
+		return err;
+
+	if (dump->active)
+		return -EBUSY;
+
+	dump->active = 1;
+	dump->intr = 0;
+	dump->gen = mock.gen;
+	dump->req = *req;
+	dump->pos = 0;
+	dump->id = 0;
+	if (attrs[CE_GW_A_ID] != NULL)
+		dump->id = nla_get_u32(attrs[CE_GW_A_ID]);
+
+	/* the filter of ce_gw_lister_filter() */
+	memset(&dump->filter, 0, sizeof(dump->filter));
+	if (attrs[CE_GW_A_SRC] != NULL &&
+	    name_get(attrs[CE_GW_A_SRC], dump->filter.src) == 0)
+		dump->filter.fields |= CE_GW_FILTER_SRC;
+	if (attrs[CE_GW_A_DST] != NULL &&
+	    name_get(attrs[CE_GW_A_DST], dump->filter.dst) == 0)
+		dump->filter.fields |= CE_GW_FILTER_DST;
+	if (attrs[CE_GW_A_TYPE] != NULL) {
+		dump->filter.type = nla_get_u8(attrs[CE_GW_A_TYPE]);
+		dump->filter.fields |= CE_GW_FILTER_TYPE;
+	}
+	if (attrs[CE_GW_A_FLAGS] != NULL) {
+		dump->filter.flags = nla_get_u32(attrs[CE_GW_A_FLAGS]);
+		dump->filter.fields |= CE_GW_FILTER_FLAGS;
+	}
+
+	return 0;
+}
+
+/**
+ * @fn int route_put(struct mock_dgram *d, const struct nlmsghdr *req,
+ *                   uint16_t flags, struct mock_route *r)
+ * @brief Appends the multipart message of route with flags to d, like the
+ *        kernel sends it for the CE_GW_C_LIST req.
+ * @retval 0 on success
+ * @retval -EMSGSIZE if d has no space left. d is unchanged.
+ */
+static int route_put(struct mock_dgram *d, const struct nlmsghdr *req,
+                     uint16_t flags, struct mock_route *r)
+{
+	struct ce_gw_route *route = &r->route;
+	size_t len = d->len;
+	struct nlmsghdr *hdr;
+
+	hdr = dgram_genl(d, req, MOCK_FAMILY_ID, flags, CE_GW_C_LIST);
+	if (hdr == NULL ||
+	    dgram_attr(d, hdr, CE_GW_A_ID, &route->id, sizeof(uint32_t)) ||
+	    dgram_str(d, hdr, CE_GW_A_SRC, route->src) ||
+	    dgram_str(d, hdr, CE_GW_A_DST, route->dst) ||
+	    dgram_attr(d, hdr, CE_GW_A_SRC_IF, &r->src_if, sizeof(uint32_t)) ||
+	    dgram_attr(d, hdr, CE_GW_A_DST_IF, &r->dst_if, sizeof(uint32_t)) ||
+	    dgram_attr(d, hdr, CE_GW_A_TYPE, &route->type, sizeof(uint8_t)) ||
+	    dgram_attr(d, hdr, CE_GW_A_FLAGS, &route->flags,
+	               sizeof(uint32_t)) ||
+	    dgram_attr(d, hdr, CE_GW_A_HNDL, &route->handled,
+	               sizeof(uint32_t)) ||
+	    dgram_attr(d, hdr, CE_GW_A_DROP, &route->dropped,
+	               sizeof(uint32_t))) {
+		d->len = len;
+		return -EMSGSIZE;
+	}
+
+	return 0;
+}
+
+/**
+ * @fn void mock_dump_next(struct mock_sock *ms, int lost)
+ * @brief Queues the next buffer of the running dump of ms, with as many routes
+ *        as fit into MOCK_RECV_SIZE and the NLMSG_DONE at the end.
+ * @details Every listed route has handled frames since the last listing,
+ *          so repeated listings show rates. For a request with NLM_F_DUMP,
+ *          every message is marked NLM_F_DUMP_INTR from the first buffer
+ *          after an add or del on, like genl_dump_check_consistent() of the
+ *          kernel. cegwctl does not set it: the module answers from its
+ *          doit handler, which does not check the consistency.
+ * @param lost If 1, the routes of the buffer overran the socket, they are
+ *        dropped as the unicasts of a doit handler are. Only the
+ *        NLMSG_DONE is kept.
+ */
+static void mock_dump_next(struct mock_sock *ms, int lost)
+{
+	struct mock_dump *dump = &ms->dump;
+	struct mock_dgram *d = dgram_alloc(MOCK_RECV_SIZE);
+	uint16_t flags = NLM_F_MULTI;
+
+	if (d == NULL) {
+		dump->active = 0;
+		mock_answer(ms, &dump->req, -ENOMEM);
+		return;
+	}
+
+	if ((dump->req.nlmsg_flags & NLM_F_DUMP) &&
+	    (dump->gen != mock.gen || fault(MOCK_OP_INTR) != 0))
+		dump->intr = 1;
+	if (dump->intr)
+		flags |= NLM_F_DUMP_INTR;
+
+	if (dump->id != 0) {
+		struct mock_route *r = route_find(dump->id);
+		dump->pos = mock.n_routes;
+		if (r != NULL) {
+			r->route.handled += 1 + r->route.id % 16;
+			route_put(d, &dump->req, flags, r);
+		}
+	}
+
+	for (; dump->pos < mock.n_routes; dump->pos++) {
+		struct ce_gw_route *route = &mock.routes[dump->pos].route;
+
+		if (mock.routes[dump->pos].dead ||
+		    !ce_gw_route_match(&dump->filter, route))
+			continue;
+		if (route_put(d, &dump->req, flags, &mock.routes[dump->pos])
+		    != 0)
+			break;
+
+		route->handled += 1 + route->id % 16;
+		if (route->id % 64 == 0)
+			route->dropped++;
+	}
+
+	if (lost)
+		d->len = 0;
+
+	/* NLMSG_DONE if it fits, else it comes with the next buffer */
+	if (dump->pos == mock.n_routes) {
+		struct nlmsghdr *hdr = dgram_msg(d, &dump->req, NLMSG_DONE,
+		                                 flags, sizeof(int));
+		if (hdr != NULL)
+			dump->active = 0;
+	}
+
+	if (d->len > 0)
+		dgram_queue(ms, d);
+	else
+		dgram_free(d);
+
+	if (!dump->active && (dump->req.nlmsg_flags & NLM_F_ACK))
+		mock_answer(ms, &dump->req, 0);
+}
+
+/**
+ * @fn int mock_echo(struct mock_sock *ms, const struct nlmsghdr *req,
+ *                   struct nlattr **attrs)
+ * @brief CE_GW_C_ECHO: sends CE_GW_A_DATA back.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int mock_echo(struct mock_sock *ms, const struct nlmsghdr *req,
+                     struct nlattr **attrs)
+{
+	struct nlattr *data = attrs[CE_GW_A_DATA];
+	struct mock_dgram *d;
+	struct nlmsghdr *hdr;
+	int err;
+
+	err = fault(MOCK_OP_ECHO);
+	if (err != 0)
+		return err;
+	if (data == NULL)
+		return -EINVAL;
+
+	d = dgram_alloc(NLMSG_HDRLEN + GENL_HDRLEN + USER_HDR_SIZE +
+	                nla_total_size(nla_len(data)));
+	if (d == NULL)
+		return -ENOMEM;
+
+	hdr = dgram_genl(d, req, MOCK_FAMILY_ID, 0, CE_GW_C_ECHO);
+	dgram_attr(d, hdr, CE_GW_A_DATA, nla_data(data), nla_len(data));
+	dgram_queue(ms, d);
+
+	return 0;
+}
+
+/**
+ * @fn int mock_ctrl(struct mock_sock *ms, const struct nlmsghdr *req)
+ * @brief CTRL_CMD_GETFAMILY of the generic netlink controller. Only
+ *        GE_FAMILY_NAME is known.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int mock_ctrl(struct mock_sock *ms, const struct nlmsghdr *req)
+{
+	struct nlattr *attrs[CTRL_ATTR_MAX + 1];
+	struct mock_dgram *d;
+	struct nlmsghdr *hdr;
+	int err;
+
+	if (genlmsg_parse((struct nlmsghdr *) req, 0, attrs, CTRL_ATTR_MAX,
+	                  NULL) < 0)
+		return -EINVAL;
+	if (genlmsg_hdr((struct nlmsghdr *) req)->cmd != CTRL_CMD_GETFAMILY)
+		return -EOPNOTSUPP;
+
+	err = fault(MOCK_OP_FAMILY);
+	if (err != 0)
+		return err;
+
+	if (attrs[CTRL_ATTR_FAMILY_NAME] == NULL ||
+	    nla_strcmp(attrs[CTRL_ATTR_FAMILY_NAME], GE_FAMILY_NAME) != 0)
+		return -ENOENT;
+
+	uint16_t id = MOCK_FAMILY_ID;
+	uint32_t version = GE_FAMILY_VERSION;
+	uint32_t hdrsize = USER_HDR_SIZE;
+	uint32_t maxattr = CE_GW_A_MAX;
+
+	d = dgram_alloc(NLMSG_HDRLEN + GENL_HDRLEN + nla_total_size(sizeof(id)) +
+	                nla_total_size(sizeof(GE_FAMILY_NAME)) +
+	                3 * nla_total_size(sizeof(uint32_t)));
+	if (d == NULL)
+		return -ENOMEM;
+
+	hdr = dgram_genl(d, req, GENL_ID_CTRL, 0, CTRL_CMD_NEWFAMILY);
+	dgram_attr(d, hdr, CTRL_ATTR_FAMILY_ID, &id, sizeof(id));
+	dgram_str(d, hdr, CTRL_ATTR_FAMILY_NAME, GE_FAMILY_NAME);
+	dgram_attr(d, hdr, CTRL_ATTR_VERSION, &version, sizeof(version));
+	dgram_attr(d, hdr, CTRL_ATTR_HDRSIZE, &hdrsize, sizeof(hdrsize));
+	dgram_attr(d, hdr, CTRL_ATTR_MAXATTR, &maxattr, sizeof(maxattr));
+	dgram_queue(ms, d);
+
+	return 0;
+}
+
+/**
+ * @fn int mock_request(struct mock_sock *ms, const struct nlmsghdr *req)
+ * @brief Validates req against ce_gw_genl_policy and calls its command.
+ * @retval 0 on success
+ * @retval <0 -errno for the answer on failure
+ */
+static int mock_request(struct mock_sock *ms, const struct nlmsghdr *req)
+{
+	struct nlattr *attrs[CE_GW_A_MAX + 1];
+	struct nlmsghdr *hdr = (struct nlmsghdr *) req;
+	int err;
+
+	if (req->nlmsg_type == GENL_ID_CTRL)
+		return mock_ctrl(ms, req);
+	if (req->nlmsg_type != MOCK_FAMILY_ID)
+		return -ENOENT;
+
+	if (!genlmsg_valid_hdr(hdr, USER_HDR_SIZE) ||
+	    genlmsg_parse(hdr, USER_HDR_SIZE, attrs, CE_GW_A_MAX,
+	                  ce_gw_genl_policy) < 0)
+		return -EINVAL;
+
+	switch (genlmsg_hdr(hdr)->cmd) {
+	case CE_GW_C_ECHO:
+		return mock_echo(ms, req, attrs);
+	case CE_GW_C_ADD:
+		err = mock_add(attrs);
+		break;
+	case CE_GW_C_DEL:
+		err = mock_del(attrs);
+		break;
+	case CE_GW_C_LIST:
+		return mock_list(ms, req, attrs);
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	/* running dumps are inconsistent from now on */
+	if (err == 0)
+		mock.gen++;
+
+	return err;
+}
+
+/**
+ * @fn struct mock_sock *sock_find(struct nl_sock *sk)
+ * @brief Returns the state of sk, which was opened by mock_open().
+ * @retval NULL if sk is not open
+ */
+static struct mock_sock *sock_find(struct nl_sock *sk)
+{
+	for (struct mock_sock *ms = mock.socks; ms != NULL; ms = ms->next) {
+		if (ms->sk == sk)
+			return ms;
+	}
+
+	return NULL;
+}
+
+/**
+ * @fn int mock_send(struct nl_sock *sk, struct nl_msg *msg)
+ * @brief Replaces the sending of the socket: msg is handled at once and
+ *        its answers are queued for mock_recv().
+ * @retval >=0 the number of bytes sent
+ * @retval <0 libnl error code of an injected error
+ */
+static int mock_send(struct nl_sock *sk, struct nl_msg *msg)
+{
+	struct nlmsghdr *req = nlmsg_hdr(msg);
+	struct mock_sock *ms;
+	int err;
+
+	pthread_mutex_lock(&mock.lock);
+
+	ms = sock_find(sk);
+	if (ms == NULL) {
+		pthread_mutex_unlock(&mock.lock);
+		return -NLE_BAD_SOCK;
+	}
+
+	err = fault(MOCK_OP_SEND);
+	if (err != 0) {
+		pthread_mutex_unlock(&mock.lock);
+		return -nl_syserr2nlerr(-err);
+	}
+
+	err = mock_request(ms, req);
+
+	/* the ACK of a list follows its dump */
+	if (err != 0 || ((req->nlmsg_flags & NLM_F_ACK) &&
+	                 !(ms->dump.active && ms->dump.req.nlmsg_seq ==
+	                   req->nlmsg_seq)))
+		mock_answer(ms, req, err);
+
+	pthread_mutex_unlock(&mock.lock);
+
+	return req->nlmsg_len;
+}
+
+/**
+ * @fn int mock_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+ *                   unsigned char **buf, struct ucred **creds)
+ * @brief Replaces the receiving of the socket: returns the next queued
+ *        buffer or the next part of the running dump.
+ * @retval >0 the size of buf, which is freed by libnl
+ * @retval -NLE_AGAIN if there is no answer. The kernel would block forever.
+ * @retval <0 libnl error code of an injected error
+ */
+static int mock_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+                     unsigned char **buf, struct ucred **creds)
+{
+	struct mock_sock *ms;
+	struct mock_dgram *d;
+	int err, len;
+
+	pthread_mutex_lock(&mock.lock);
+
+	ms = sock_find(sk);
+	err = ms ? fault(MOCK_OP_RECV) : -EBADF;
+	if (err != 0) {
+		/* an overrun loses the next routes of a list without
+		 * NLM_F_DUMP, the kernel does not continue it */
+		if (err == -ENOBUFS && ms->head == NULL && ms->dump.active &&
+		    !(ms->dump.req.nlmsg_flags & NLM_F_DUMP))
+			mock_dump_next(ms, 1);
+		pthread_mutex_unlock(&mock.lock);
+		return -nl_syserr2nlerr(-err);
+	}
+
+	if (ms->head == NULL && ms->dump.active)
+		mock_dump_next(ms, 0);
+
+	d = ms->head;
+	if (d != NULL) {
+		ms->head = d->next;
+		if (ms->head == NULL)
+			ms->tail = NULL;
+	}
+
+	pthread_mutex_unlock(&mock.lock);
+
+	if (d == NULL)
+		return -NLE_AGAIN;
+
+	memset(nla, 0, sizeof(*nla));
+	nla->nl_family = AF_NETLINK; /* nl_pid 0 is the kernel */
+	if (creds != NULL)
+		*creds = NULL;
+
+	*buf = d->buf;
+	len = d->len;
+	free(d);
+
+	return len;
+}
+
+/**
+ * @fn void mock_drop(struct mock_sock *ms)
+ * @brief Drops the queued answers and the running dump of ms.
+ */
+static void mock_drop(struct mock_sock *ms)
+{
+	while (ms->head != NULL) {
+		struct mock_dgram *d = ms->head;
+		ms->head = d->next;
+		dgram_free(d);
+	}
+	ms->tail = NULL;
+	ms->dump.active = 0;
+}
+
+/**
+ * @fn int tables_reset(unsigned int routes)
+ * @brief Does the work of mock_reset() with the lock held.
+ */
+static int tables_reset(unsigned int routes)
+{
+	char name[IFNAMSIZ];
+
+	for (struct mock_sock *ms = mock.socks; ms != NULL; ms = ms->next)
+		mock_drop(ms);
+	free(mock.devs);
+	free(mock.routes);
+	mock.devs = NULL;
+	mock.routes = NULL;
+	mock.n_devs = mock.size_devs = 0;
+	mock.n_routes = mock.size_routes = 0;
+	mock.dead = 0;
+	mock.next_id = 1;
+	mock.next_ifindex = 1;
+
+	for (int i = 0; i < MOCK_CAN_DEVS; ++i) {
+		snprintf(name, sizeof(name), "can%d", i);
+		if (dev_add(name, TYPE_NONE, 0, 1) != 0)
+			return -ENOMEM;
+	}
+
+	if (routes == 0)
+		return 0;
+
+	for (int i = 0; i < MOCK_GW_DEVS; ++i) {
+		snprintf(name, sizeof(name), "cegw%d", i);
+		if (dev_add(name, 1 + i % TYPE_MAX, 0, 0) != 0)
+			return -ENOMEM;
+	}
+
+	/* both directions, all types and some traffic */
+	for (unsigned int i = 0; i < routes; ++i) {
+		struct ce_gw_route *route;
+
+		const struct mock_dev *can = &mock.devs[i % MOCK_CAN_DEVS];
+		const struct mock_dev *gw = &mock.devs[MOCK_CAN_DEVS +
+		                                       i % MOCK_GW_DEVS];
+		route = (i & 1) ? route_add(gw, can, 1 + i % TYPE_MAX, 0)
+		        : route_add(can, gw, 1 + i % TYPE_MAX, 0);
+		if (route == NULL)
+			return -ENOMEM;
+
+		route->flags = (i % 3 == 0) ? F_CAN_FD : 0;
+		route->handled = (i * 2654435761u) % 1000000;
+		route->dropped = (i % 7 == 0) ? route->handled % 1000 : 0;
+	}
+
+	return 0;
+}
+
+int mock_reset(unsigned int routes)
+{
+	pthread_mutex_lock(&mock.lock);
+	int err = tables_reset(routes);
+	pthread_mutex_unlock(&mock.lock);
+
+	return err;
+}
+
+/**
+ * @fn int errno_parse(const char *str)
+ * @brief Returns the errno of a name of errno_array or a number.
+ * @retval 0 if str is unknown
+ */
+static int errno_parse(const char *str)
+{
+	char *end;
+
+	for (int i = 0; errno_array[i].name != 0; ++i) {
+		if (strcasecmp(str, errno_array[i].name) == 0)
+			return errno_array[i].err;
+	}
+
+	long err = strtol(str, &end, 10);
+	if (*end != '\0' || err <= 0 || err > 4095)
+		return 0;
+
+	return err;
+}
+
+/**
+ * @fn int faults_parse(const char *spec, struct mock_fault *faults)
+ * @brief Parses the spec of mock_fail() into __MOCK_OP_MAX faults.
+ * @retval 0 on success
+ * @retval -EINVAL if spec is malformed
+ */
+static int faults_parse(const char *spec, struct mock_fault *faults)
+{
+	char buf[256];
+
+	memset(faults, 0, __MOCK_OP_MAX * sizeof(*faults));
+
+	if (spec != NULL && spec[0] != '\0') {
+		if (strlen(spec) >= sizeof(buf))
+			return -EINVAL;
+		strcpy(buf, spec);
+
+		char *save, *field;
+		for (char *tok = strtok_r(buf, ",", &save); tok != NULL;
+		     tok = strtok_r(NULL, ",", &save)) {
+			char *op = strtok_r(tok, ":", &field);
+			char *err = strtok_r(NULL, ":", &field);
+			char *every = strtok_r(NULL, ":", &field);
+			char *times = strtok_r(NULL, ":", &field);
+			int i;
+
+			for (i = 0; i <= MOCK_OP_MAX; ++i) {
+				if (op != NULL &&
+				    strcmp(op, op_array[i].name) == 0)
+					break;
+			}
+			if (i > MOCK_OP_MAX || err == NULL)
+				return -EINVAL;
+
+			faults[i].err = errno_parse(err);
+			faults[i].every = every ? strtoul(every, NULL, 10) : 1;
+			faults[i].left = times ? atoi(times) : -1;
+			if (faults[i].err == 0 || faults[i].every == 0 ||
+			    faults[i].left == 0)
+				return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+int mock_fail(const char *spec)
+{
+	struct mock_fault faults[__MOCK_OP_MAX];
+
+	if (faults_parse(spec, faults) != 0)
+		return -EINVAL;
+
+	pthread_mutex_lock(&mock.lock);
+	memcpy(mock.faults, faults, sizeof(faults));
+	pthread_mutex_unlock(&mock.lock);
+
+	return 0;
+}
+
+/**
+ * @fn void mock_setup_cb(struct nl_cb *cb)
+ * @brief Installs mock_send() and mock_recv() in cb.
+ */
+static void mock_setup_cb(struct nl_cb *cb)
+{
+	nl_cb_overwrite_send(cb, mock_send);
+	nl_cb_overwrite_recv(cb, mock_recv);
+}
+
+/**
+ * @fn int mock_open(struct nl_sock *sk)
+ * @brief Prepares the callbacks of sk. The tables and the injected errors
+ *        are set up from MOCK_ROUTES_ENV and MOCK_FAIL_ENV once per process.
+ * @retval 0 on success
+ * @retval <0 libnl error code on failure
+ */
+static int mock_open(struct nl_sock *sk)
+{
+	struct mock_sock *ms = calloc(1, sizeof(*ms));
+	if (ms == NULL)
+		return -NLE_NOMEM;
+	ms->sk = sk;
+
+	pthread_mutex_lock(&mock.lock);
+	if (!mock.init) {
+		const char *routes = getenv(MOCK_ROUTES_ENV);
+		int err = 0;
+
+		if (tables_reset(routes ? strtoul(routes, NULL, 10) : 0) != 0) {
+			err = -NLE_NOMEM;
+		} else if (faults_parse(getenv(MOCK_FAIL_ENV),
+		                        mock.faults) != 0) {
+			fprintf(stderr, "mock: Invalid %s\n", MOCK_FAIL_ENV);
+			err = -NLE_INVAL;
+		}
+
+		if (err != 0) {
+			pthread_mutex_unlock(&mock.lock);
+			free(ms);
+			return err;
+		}
+		mock.init = 1;
+	}
+	ms->next = mock.socks;
+	mock.socks = ms;
+	pthread_mutex_unlock(&mock.lock);
+
+	struct nl_cb *cb = nl_socket_get_cb(sk);
+	mock_setup_cb(cb);
+	nl_cb_put(cb);
+
+	return 0;
+}
+
+/**
+ * @fn int mock_links(struct ifcache *c)
+ * @brief Adds the devices of the mock to c, like a link dump.
+ * @retval 0 on success
+ * @retval -ENOMEM if c could not grow
+ */
+static int mock_links(struct ifcache *c)
+{
+	int err = 0;
+
+	pthread_mutex_lock(&mock.lock);
+	for (size_t i = 0; err == 0 && i < mock.n_devs; ++i)
+		err = ifcache_add(c, mock.devs[i].ifindex, mock.devs[i].name);
+	pthread_mutex_unlock(&mock.lock);
+
+	return err;
+}
+
+/**
+ * @fn void mock_close(struct nl_sock *sk)
+ * @brief Drops the unreceived answers of sk. The tables are kept.
+ */
+static void mock_close(struct nl_sock *sk)
+{
+	pthread_mutex_lock(&mock.lock);
+	for (struct mock_sock **p = &mock.socks; *p != NULL; p = &(*p)->next) {
+		struct mock_sock *ms = *p;
+
+		if (ms->sk == sk) {
+			*p = ms->next;
+			mock_drop(ms);
+			free(ms);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mock.lock);
+}
+
+const struct ce_gw_transport mock_transport = {
+	.name = "mock",
+	.cache_family = 0,
+	.open = mock_open,
+	.close = mock_close,
+	.setup_cb = mock_setup_cb,
+	.links = mock_links,
+};
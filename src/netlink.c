@@ -28,8 +28,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 
 #include <netlink/netlink.h>
 #include <netlink/cache.h>
@@ -43,39 +49,17 @@
 #include <netlink/genl/genl.h>
 #include <netlink/genl/mngt.h>
 #include "netlink.h"
-
-/**
- * Netlink Family Settings
- */
-#define GE_FAMILY_NAME "CE_GW"
-#define GE_FAMILY_VERSION 1
-#define USER_HDR_SIZE 0 /**< user header size */
-#define NO_FLAG 0
-#define IFACE_VERSION 0
-
-/**
- * @enum
- * @brief Data which can be send and received.
- * @details Set int values as Identifiers for userspace application.
- */
-enum {
-	CE_GW_A_UNSPEC, /**< Only a Dummy to skip index 0. */
-	CE_GW_A_DATA,	/**< NLA_STRING */
-	CE_GW_A_SRC,	/**< NLA_STRING */
-	CE_GW_A_DST,	/**< NLA_STRING */
-	CE_GW_A_ID,	/**< NLA_U32 */
-	CE_GW_A_FLAGS,	/**< NLA_U32 */
-	CE_GW_A_TYPE,	/**< NLA_U8 */
-	CE_GW_A_HNDL,	/**< NLA_U32 Handled Frames */
-	CE_GW_A_DROP,	/**< NLA_U32 Dropped Frames */
-	__CE_GW_A_MAX,	/**< Maximum Number of Attribute plus 1 */
-};
-#define CE_GW_A_MAX (__CE_GW_A_MAX - 1) /**< Maximum Number of Attribute */
+#include "protocol.h"
+#include "transport.h"
+#include "famcache.h"
+#include "ifcache.h"
+#include "format.h"
+#include "timing.h"
 
 /**
  * @brief Netlink Policy - Defines the Type for the Netlink Attributes
  */
-static struct nla_policy ce_gw_genl_policy[CE_GW_A_MAX + 1] = {
+struct nla_policy ce_gw_genl_policy[CE_GW_A_MAX + 1] = {
 	[CE_GW_A_DATA] = 	{ .type = NLA_STRING },
 	[CE_GW_A_SRC] = 	{ .type = NLA_STRING },
 	[CE_GW_A_DST] = 	{ .type = NLA_STRING },
@@ -84,41 +68,70 @@ static struct nla_policy ce_gw_genl_policy[CE_GW_A_MAX + 1] = {
 	[CE_GW_A_TYPE] = 	{ .type = NLA_U8 },
 	[CE_GW_A_HNDL] = 	{ .type = NLA_U32 },
 	[CE_GW_A_DROP] = 	{ .type = NLA_U32 },
+	[CE_GW_A_EVENT] = 	{ .type = NLA_U8 },
+	[CE_GW_A_TIME] = 	{ .type = NLA_U64 },
+	[CE_GW_A_SRC_IF] = 	{ .type = NLA_U32 },
+	[CE_GW_A_DST_IF] = 	{ .type = NLA_U32 },
 };
 
-struct genl_family *genl_fam; /**< Generic Netlink Family */
-struct nl_sock *nl_sk; /**< Socket to Kernel Application */
+/**
+ * @struct cegw_ctx
+ * @brief A connection to the kernel module. Everything a request changes
+ *        lives here, so contexts can be used by different threads at once.
+ */
+struct cegw_ctx {
+	struct nl_sock *sk;	/**< Socket to Kernel Application */
+	const struct ce_gw_transport *transport; /**< carries the messages */
+	int family;		/**< Generic Netlink Family ID */
+	int version;		/**< version of the family */
+	int errno_quiet;	/**< errno which is not printed by
+				 * nl_cb_general_errno() */
+	int errno_retry;	/**< another one, the request is sent again
+				 * on it */
+	uint32_t seq_sent;	/**< sequence number of the last ce_gw_send() */
+	struct nl_msg *msg;	/**< buffer of add, del and echo requests, see
+				 * ctx_msg() */
+	struct ce_gw_dump_stats dump; /**< see cegw_ctx_dump_stats() */
+	struct ifcache ifc;	/**< the network devices, see ctx_ifcache() */
+	uint64_t ifc_time;	/**< timing_now() of the last link dump */
+	struct async_state *async; /**< see ctx_async(), NULL until used */
+};
 
 /**
- * @struct flags
  * @brief Flags defined in netlink.h. Can used by flags2str().
  */
-const struct flags {
-	char *name;
-} flags_array[] = {
+const struct flags flags_array[] = {
 	{ "CAN-FD"	},	/**< Flag with index 0 */
 	{ 0		}	/**< End Delimiter */
 };
 
 /**
- * @fn char *flags2str(uint32_t bits, const struct flags *flags, size_t size)
+ * @fn char *flags2str(uint32_t bits, const struct flags *flags, char *str,
+ *                     size_t size)
  * @brief Convert Flags in ist textual represenation
  * @param bits The bits variable which will be checked with the highest bit
  * @param flags An Array with its textual representation the index of the
  * one array entry must be the same as the position in param bits from the left.
  * The Last entry in the array bust be {0}, because the function will stop here.
- * @param size the size of the retuned char pointer. Must be big enough
- * for all flags names plus 2 for < and > plus 1 for ',' after each flag
- * plus 1 for \0
+ * @param str The buffer for the result.
+ * @param size the size of str. Should be big enough for all flags names
+ * plus 2 for < and > plus 1 for ',' after each flag plus 1 for \0. A too
+ * long result is truncated.
  * @ingroup trans
- * @returns a char pointer in the form <Flag1,Flag2,Flag3,...> if the flags
+ * @returns str in the form <Flag1,Flag2,Flag3,...> if the flags
  * flag1, flag2, flag3, ... are set. The Pointer has a ending \0.
  */
-char *flags2str(uint32_t bits, const struct flags *flags, size_t size)
+char *flags2str(uint32_t bits, const struct flags *flags, char *str,
+                size_t size)
 {
-	char *str = malloc(size);
-	str[0] = '<';
-	str[1] = '\0';
+	size_t len = 0;
+
+	if (size < 3) {
+		if (size > 0)
+			str[0] = '\0';
+		return str;
+	}
+	str[len++] = '<';
 
 	/* Iterate until the end of bits or thh end of flags array */
 	for (int i = 0; i < sizeof(uint32_t) * 8 && flags[i].name != 0; ++i) {
@@ -127,28 +140,27 @@ char *flags2str(uint32_t bits, const struct flags *flags, size_t size)
 		// b will be 1 if i-th bit is set, 0 otherwise
 
 		if (b == 1) {
-			strcat(str, flags[i].name);
-			strcat(str, ",");
+			/* name and ',' but keep space for '>' and '\0' */
+			for (const char *c = flags[i].name;
+			     *c != '\0' && len < size - 3; ++c)
+				str[len++] = *c;
+			if (len < size - 2)
+				str[len++] = ',';
 		}
 	}
-	int len = strlen(str);
 
-	if (len <= 1) {
-		strcat(str, ">");
-	} else {
-		str[len-1] = '>'; /* replace ',' with '>' */
-	}
+	if (len > 1)
+		len--; /* replace ',' with '>' */
+	str[len++] = '>';
+	str[len] = '\0';
 
 	return str;
 }
 
 /**
- * @struct enums
  * @brief Array of type "enum gw_type" in netlink.h. Can use by enum2str().
  */
-const struct enums {
-	char *name;
-} type_array[] = {
+const struct enums type_array[] = {
 	{ "NONE"	}, /**< TYPE_NONE with Index 0 */
 	{ "ETH"		}, /**< TYPE_ETH  with Index 1 */
 	{ "NET"		}, /**< TYPE_NET  with Index 2 */
@@ -157,36 +169,84 @@ const struct enums {
 	{ 0		}  /**< End Delimiter          */
 };
 
+/**
+ * @brief Array of type "enum ce_gw_event_type" in netlink.h. Can use by
+ *        enum2str().
+ */
+const struct enums event_array[] = {
+	{ "?"		}, /**< CE_GW_E_UNSPEC    with Index 0 */
+	{ "route-add"	}, /**< CE_GW_E_ROUTE_ADD with Index 1 */
+	{ "route-del"	}, /**< CE_GW_E_ROUTE_DEL with Index 2 */
+	{ "dev-add"	}, /**< CE_GW_E_DEV_ADD   with Index 3 */
+	{ "dev-del"	}, /**< CE_GW_E_DEV_DEL   with Index 4 */
+	{ "drop"	}, /**< CE_GW_E_DROP      with Index 5 */
+	{ 0		}  /**< End Delimiter               */
+};
+
 /**
  * @brief Returns the textual representation of an numeric identifier (enum)
  * @param value the numeric identifier (value) of an enum
  * @param enums A array with the textual representation of the int value.
  * The Last entry in the array bust be {0}, because the function will stop here.
  * The index af an array entry must be the same as param value.
- * @param size the size of the retuned char pointer. Must be big enough
- * for the largest entry in the array.
+ * @param max the maximum value.
  * @retval NULL if not found
  * @ingroup trans
- * @returns A char pointer with the textual representation of value ending
- * with \0.
+ * @returns The constant textual representation of value ending with \0.
  */
-char *enum2str(int value, const struct enums *enums, size_t size, int max)
+const char *enum2str(int value, const struct enums *enums, int max)
 {
-	char *str = malloc(size+1); /* +1 for \0 */
-	str[0] = '\0';
-
 	/* Iterate until the end of value or the end of enums array */
 	for (int i = 0; i <= max && enums[i].name != 0; ++i) {
-		if (i == value) {
-			strcat(str, enums[i].name);
-			return str;
-		}
+		if (i == value)
+			return enums[i].name;
 	}
 
-	free(str);
 	return NULL;
 }
 
+int str2type(const char *str)
+{
+	for (int i = 0; i <= TYPE_MAX && type_array[i].name != 0; ++i) {
+		if (strcasecmp(str, type_array[i].name) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+int str2flags(const char *str, uint32_t *bits)
+{
+	char *end;
+	unsigned long num = strtoul(str, &end, 0);
+
+	if (end != str && *end == '\0') {
+		*bits = num;
+		return 0;
+	}
+
+	*bits = 0;
+	while (*str != '\0') {
+		size_t len = strcspn(str, ",");
+		int i;
+
+		for (i = 0; flags_array[i].name != 0; ++i) {
+			if (strlen(flags_array[i].name) == len &&
+			    strncasecmp(str, flags_array[i].name, len) == 0)
+				break;
+		}
+		if (flags_array[i].name == 0)
+			return -1;
+
+		*bits |= 1 << i;
+		str += len;
+		if (*str == ',')
+			str++;
+	}
+
+	return 0;
+}
+
 
 /**
  * @fn int nl_cb_general_errno(struct sockaddr_nl *nla,
@@ -194,8 +254,8 @@ char *enum2str(int value, const struct enums *enums, size_t size, int max)
  * @brief A callback wich prints the errno to stderr.
  * @param nla Socket address informations
  * @param nlerr error Message
- * @raram arg a file
- * @details A callback wich prints the errno to stderr. In nl_sk_fam_init() it
+ * @raram arg the struct cegw_ctx of the request or NULL
+ * @details A callback wich prints the errno to stderr. In cegw_ctx_alloc() it
  *          is delcared as standart error callback.
  * @ingroup cb
  * @retval NL_STOP
@@ -203,27 +263,463 @@ char *enum2str(int value, const struct enums *enums, size_t size, int max)
 int nl_cb_general_errno(struct sockaddr_nl *nla,
                         struct nlmsgerr *nlerr, void *arg)
 {
+	struct cegw_ctx *ctx = arg;
 	int err = nlerr->error;
-	fprintf(stderr, "NETLINK returned Error: %s\n", strerror(err));
+	if (ctx == NULL ||
+	    (-err != ctx->errno_quiet && -err != ctx->errno_retry))
+		fprintf(stderr, "NETLINK returned Error: %s\n",
+		        strerror(-err));
 
 	return NL_STOP;
 }
 
-int ce_gw_add(char *dst_name, char *src_name, uint8_t type, uint32_t flags)
+/**
+ * @fn int nl_cb_seq_check(struct nl_msg *msg, void *arg)
+ * @brief Accepts only answers to the last request of ce_gw_send().
+ * @details Replaces the strict ordering of libnl, which counts the ACKs
+ *          and gets out of step after a request without ACK, e.g.
+ *          fam_resolve(). The next ACK was then a sequence mismatch.
+ * @param arg the struct cegw_ctx of the socket
+ * @retval NL_OK
+ * @retval NL_SKIP for a stale answer
+ * @ingroup cb
+ * @see defined as callback of the socket in cegw_ctx_alloc()
+ */
+static int nl_cb_seq_check(struct nl_msg *msg, void *arg)
 {
-	int err = 0;
+	struct cegw_ctx *ctx = arg;
+
+	return nlmsg_hdr(msg)->nlmsg_seq == ctx->seq_sent ? NL_OK : NL_SKIP;
+}
+
+/**
+ * @fn enum timing_cmd msg_timing_cmd(struct nl_msg *msg)
+ * @brief Returns the command of msg for the timing of its phases.
+ * @ingroup net
+ */
+static enum timing_cmd msg_timing_cmd(struct nl_msg *msg)
+{
+	struct nlmsghdr *hdr = nlmsg_hdr(msg);
+
+	if (hdr->nlmsg_type == GENL_ID_CTRL)
+		return TIMING_C_FAMILY;
+
+	switch (genlmsg_hdr(hdr)->cmd) {
+	case CE_GW_C_ECHO:
+		return TIMING_C_ECHO;
+	case CE_GW_C_ADD:
+		return TIMING_C_ADD;
+	case CE_GW_C_DEL:
+		return TIMING_C_DEL;
+	default:
+		return TIMING_C_LIST;
+	}
+}
+
+/**
+ * @fn int ce_gw_send(struct cegw_ctx *ctx, struct nl_msg *msg)
+ * @brief nl_send_auto() which remembers the sequence number of msg for
+ *        nl_cb_seq_check().
+ * @retval >=0 on success
+ * @retval <0 libnl error code on failure
+ * @ingroup net
+ */
+static int ce_gw_send(struct cegw_ctx *ctx, struct nl_msg *msg)
+{
+	uint64_t t = 0;
+
+	TIMING_STAMP(t);
+	int err = nl_send_auto(ctx->sk, msg);
+	TIMING_PHASE(msg_timing_cmd(msg), TIMING_P_SEND, t);
+
+	if (err >= 0)
+		ctx->seq_sent = nlmsg_hdr(msg)->nlmsg_seq;
+
+	return err;
+}
+
+/**
+ * @fn int ce_gw_wait(struct cegw_ctx *ctx, struct nl_msg *msg)
+ * @brief nl_wait_for_ack() for msg, timed as TIMING_P_WAIT.
+ * @retval 0 on success
+ * @retval <0 libnl error code on failure
+ * @ingroup net
+ */
+static int ce_gw_wait(struct cegw_ctx *ctx, struct nl_msg *msg)
+{
+	uint64_t t = 0;
+
+	TIMING_STAMP(t);
+	int err = nl_wait_for_ack(ctx->sk);
+	TIMING_PHASE(msg_timing_cmd(msg), TIMING_P_WAIT, t);
+
+	return err;
+}
+
+/**
+ * @fn int ce_gw_recv(struct cegw_ctx *ctx, struct nl_msg *msg,
+ *                    struct nl_cb *cb)
+ * @brief nl_recvmsgs() of the answer to msg, timed as TIMING_P_RECV.
+ * @retval >=0 on success
+ * @retval <0 libnl error code on failure
+ * @ingroup net
+ */
+static int ce_gw_recv(struct cegw_ctx *ctx, struct nl_msg *msg,
+                      struct nl_cb *cb)
+{
+	uint64_t t = 0;
+
+	TIMING_STAMP(t);
+	int err = nl_recvmsgs(ctx->sk, cb);
+	TIMING_PHASE(msg_timing_cmd(msg), TIMING_P_RECV, t);
+
+	return err;
+}
+
+/**
+ * @struct fam_probe
+ * @brief Answer of the generic netlink controller. See fam_resolve().
+ */
+struct fam_probe {
+	int id;		/**< family ID */
+	int version;	/**< family version */
+};
+
+/**
+ * @fn int nl_cb_fam_probe(struct nl_msg *msg, void *arg)
+ * @brief Extracts ID and version of the answer to CTRL_CMD_GETFAMILY.
+ * @param msg Netlink Message
+ * @param arg a struct fam_probe
+ * @retval NL_OK
+ * @ingroup cb
+ * @see defined as callback in fam_resolve()
+ */
+static int nl_cb_fam_probe(struct nl_msg *msg, void *arg)
+{
+	struct fam_probe *probe = arg;
+	struct nlattr *attrs[CTRL_ATTR_MAX + 1];
+
+	if (genlmsg_parse(nlmsg_hdr(msg), 0, attrs, CTRL_ATTR_MAX, NULL) < 0)
+		return NL_SKIP;
+
+	if (attrs[CTRL_ATTR_FAMILY_ID] != NULL)
+		probe->id = nla_get_u16(attrs[CTRL_ATTR_FAMILY_ID]);
+	if (attrs[CTRL_ATTR_VERSION] != NULL)
+		probe->version = nla_get_u32(attrs[CTRL_ATTR_VERSION]);
+
+	return NL_OK;
+}
+
+/**
+ * @fn int fam_resolve(struct cegw_ctx *ctx, int *id, int *version)
+ * @brief Asks the generic netlink controller for ID and version of the
+ *        CE_GW family. Like genl_ctrl_resolve(), but returns the version too.
+ * @retval 0 on success
+ * @retval <0 on failure, e.g. -NLE_OBJ_NOTFOUND if the module is not loaded
+ * @ingroup net
+ */
+static int fam_resolve(struct cegw_ctx *ctx, int *id, int *version)
+{
+	int err;
 	struct nl_msg *msg;
+	struct fam_probe probe = { -1, 0 };
+	uint64_t t = 0;
 
-	/* create */
+	TIMING_BEGIN(TIMING_C_FAMILY, t);
 	msg = nlmsg_alloc();
-	if(msg == NULL) {
-		fprintf(stderr,"add: Message allocation failed.\n");
-		return -ENOMEM;
+	if (msg == NULL) {
+		TIMING_END(TIMING_C_FAMILY, 0, -NLE_NOMEM);
+		return -NLE_NOMEM;
+	}
+	TIMING_PHASE(TIMING_C_FAMILY, TIMING_P_ALLOC, t);
+
+	if (genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, GENL_ID_CTRL, 0,
+	                NO_FLAG, CTRL_CMD_GETFAMILY, 1) == NULL ||
+	    nla_put_string(msg, CTRL_ATTR_FAMILY_NAME, GE_FAMILY_NAME) < 0) {
+		nlmsg_free(msg);
+		TIMING_END(TIMING_C_FAMILY, 0, -NLE_MSGSIZE);
+		return -NLE_MSGSIZE;
+	}
+	TIMING_PHASE(TIMING_C_FAMILY, TIMING_P_ENCODE, t);
+
+	/* the answer or the error, no ACK */
+	nl_socket_disable_auto_ack(ctx->sk);
+
+	struct nl_cb *cb = nl_cb_clone(nl_socket_get_cb(ctx->sk));
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, nl_cb_fam_probe, &probe);
+
+	err = ce_gw_send(ctx, msg);
+	if (err >= 0) {
+		ctx->errno_quiet = ENOENT; /* reported by the caller */
+		err = ce_gw_recv(ctx, msg, cb);
+		ctx->errno_quiet = 0;
+	}
+	TIMING_END(TIMING_C_FAMILY, nlmsg_hdr(msg)->nlmsg_seq,
+	           err < 0 ? err : 0);
+
+	nl_cb_put(cb);
+	nlmsg_free(msg);
+
+	if (err < 0)
+		return err;
+	if (probe.id <= 0)
+		return -NLE_OBJ_NOTFOUND;
+
+	*id = probe.id;
+	*version = probe.version;
+	return 0;
+}
+
+/**
+ * @fn int fam_retry(struct cegw_ctx *ctx, int err)
+ * @brief Checks if a request failed because the family ID is outdated, e.g.
+ *        it was read from the cache or the module was reloaded.
+ * @details If the kernel does not know the family, the ID is resolved again
+ *          and the cache is rewritten if the ID or version changed.
+ * @param err Error of the request (libnl error code)
+ * @retval 1 if the ID changed and the request should be sent again
+ * @retval 0 otherwise
+ * @ingroup net
+ */
+static int fam_retry(struct cegw_ctx *ctx, int err)
+{
+	int id, version;
+
+	if (err != -NLE_OBJ_NOTFOUND)
+		return 0;
+
+	if (fam_resolve(ctx, &id, &version) != 0)
+		return 0;
+
+	/* most -ENOENT are answers of the module, e.g. an unknown route ID,
+	 * then the file stays as it is */
+	if (id == ctx->family && version == ctx->version)
+		return 0;
+
+	if (ctx->transport->cache_family)
+		famcache_write(id, version);
+	ctx->version = version;
+	if (id == ctx->family)
+		return 0;
+
+	ctx->family = id;
+	return 1;
+}
+
+/**
+ * @fn void fam_msg_update(struct cegw_ctx *ctx, struct nl_msg *msg)
+ * @brief Prepares an already sent message to be sent again after
+ *        fam_retry(): sets the new family ID and a new sequence number.
+ * @ingroup net
+ */
+static void fam_msg_update(struct cegw_ctx *ctx, struct nl_msg *msg)
+{
+	struct nlmsghdr *hdr = nlmsg_hdr(msg);
+
+	hdr->nlmsg_type = ctx->family;
+	hdr->nlmsg_seq = NL_AUTO_SEQ;
+}
+
+/**
+ * @fn int ce_gw_send_ack(struct cegw_ctx *ctx, struct nl_msg *msg)
+ * @brief Sends msg and waits for the ACK. If the family ID turns out to be
+ *        outdated, it is resolved again and msg is sent once more.
+ * @retval 0 on success
+ * @retval <0 libnl error code on failure
+ * @ingroup net
+ */
+static int ce_gw_send_ack(struct cegw_ctx *ctx, struct nl_msg *msg)
+{
+	int err;
+
+	nl_socket_enable_auto_ack(ctx->sk);
+
+	/* printed below unless it is a stale family */
+	ctx->errno_quiet = ENOENT;
+	err = ce_gw_send(ctx, msg);
+	if (err >= 0)
+		err = ce_gw_wait(ctx, msg);
+	ctx->errno_quiet = 0;
+
+	if (err < 0 && fam_retry(ctx, err)) {
+		fam_msg_update(ctx, msg);
+		err = ce_gw_send(ctx, msg);
+		if (err >= 0)
+			err = ce_gw_wait(ctx, msg);
+	} else if (err == -NLE_OBJ_NOTFOUND) {
+		fprintf(stderr, "NETLINK returned Error: %s\n",
+		        strerror(ENOENT));
+	}
+
+	return err < 0 ? err : 0;
+}
+
+/**
+ * @fn int ce_gw_send_recv(struct cegw_ctx *ctx, struct nl_msg *msg,
+ *                         struct nl_cb *cb)
+ * @brief Sends msg and receives the answer with cb. No ACK is requested.
+ *        If the family ID turns out to be outdated, it is resolved again and
+ *        msg is sent once more.
+ * @retval >=0 on success
+ * @retval <0 libnl error code on failure
+ * @ingroup net
+ */
+static int ce_gw_send_recv(struct cegw_ctx *ctx, struct nl_msg *msg,
+                           struct nl_cb *cb)
+{
+	int err;
+
+	nl_socket_disable_auto_ack(ctx->sk);
+
+	ctx->errno_quiet = ENOENT;
+	err = ce_gw_send(ctx, msg);
+	if (err >= 0)
+		err = ce_gw_recv(ctx, msg, cb);
+	ctx->errno_quiet = 0;
+
+	if (err < 0 && fam_retry(ctx, err)) {
+		fam_msg_update(ctx, msg);
+		err = ce_gw_send(ctx, msg);
+		if (err >= 0)
+			err = ce_gw_recv(ctx, msg, cb);
+	} else if (err == -NLE_OBJ_NOTFOUND) {
+		fprintf(stderr, "NETLINK returned Error: %s\n",
+		        strerror(ENOENT));
+	}
+
+	return err;
+}
+
+/**
+ * @fn struct nl_msg *ctx_msg(struct cegw_ctx *ctx)
+ * @brief Returns the request buffer of ctx, emptied for the next request.
+ * @details genlmsg_put() writes the header again and the attributes are
+ *          appended from there, so a request costs no allocation.
+ * @ingroup net
+ */
+static struct nl_msg *ctx_msg(struct cegw_ctx *ctx)
+{
+	nlmsg_hdr(ctx->msg)->nlmsg_len = NLMSG_HDRLEN;
+
+	return ctx->msg;
+}
+
+/** Minimal age of the interface cache before a miss dumps the links again */
+#define IFCACHE_RELOAD_NS 100000000ULL
+
+/**
+ * @fn struct ifcache *ctx_ifcache(struct cegw_ctx *ctx)
+ * @brief Returns the interface cache of ctx, filled by the transport on the
+ *        first call and after it was dropped, see ctx_ifcache_miss(). With
+ *        the async API it stays empty once it was dropped.
+ * @ingroup net
+ */
+static struct ifcache *ctx_ifcache(struct cegw_ctx *ctx)
+{
+	struct ifcache *ifc = &ctx->ifc;
+
+	/* the async API must not block on a link dump, it loads the cache
+	 * once in ctx_async() and then uses names for unknown devices */
+	if (ifc->loaded || ctx->async != NULL)
+		return ifc;
+
+	if (ctx->transport->links != NULL &&
+	    ctx->transport->links(ifc) != 0) {
+		fprintf(stderr, "Interface indexes could not be read, "
+		        "using names\n");
+		ifcache_free(ifc);
 	}
+	ifcache_build(ifc);
+	ctx->ifc_time = timing_now();
+
+	return ifc;
+}
+
+/**
+ * @fn int ctx_ifcache_miss(struct cegw_ctx *ctx)
+ * @brief Drops the interface cache of ctx after a lookup missed, so the
+ *        next ctx_ifcache() sees devices added since. A cache younger than
+ *        IFCACHE_RELOAD_NS is kept, unknown names do not dump the links for
+ *        every request.
+ * @retval 1 if the cache was dropped and the lookup should be repeated
+ * @retval 0 otherwise
+ * @ingroup net
+ */
+static int ctx_ifcache_miss(struct cegw_ctx *ctx)
+{
+	if (!ctx->ifc.loaded || ctx->transport->links == NULL ||
+	    ctx->async != NULL ||
+	    timing_now() - ctx->ifc_time < IFCACHE_RELOAD_NS)
+		return 0;
+
+	ifcache_free(&ctx->ifc);
+	return 1;
+}
+
+/**
+ * @fn int ctx_ifindex(struct cegw_ctx *ctx, const char *name)
+ * @brief Returns the interface index of the device name, the cache is
+ *        reloaded once if it does not know it.
+ * @retval 0 if there is no such device, it is addressed by name only
+ * @ingroup net
+ */
+static int ctx_ifindex(struct cegw_ctx *ctx, const char *name)
+{
+	int index = ifcache_index(ctx_ifcache(ctx), name);
+
+	if (index == 0 && ctx_ifcache_miss(ctx))
+		index = ifcache_index(ctx_ifcache(ctx), name);
+
+	return index;
+}
+
+/**
+ * @fn int ctx_ifindex_sent(struct cegw_ctx *ctx, const char *dst_name,
+ *                          const char *src_name)
+ * @brief Checks if ce_gw_add_msg() put an interface index of the cache into
+ *        the add of the route from src_name to dst_name.
+ * @retval 1 if it did, the index may belong to a device which is gone
+ * @retval 0 otherwise
+ * @ingroup net
+ */
+static int ctx_ifindex_sent(struct cegw_ctx *ctx, const char *dst_name,
+                            const char *src_name)
+{
+	if (src_name == NULL || ctx->version < CE_GW_IFINDEX_VERSION ||
+	    !ctx->ifc.loaded)
+		return 0;
+
+	return ifcache_index(&ctx->ifc, src_name) > 0 ||
+	       ifcache_index(&ctx->ifc, dst_name) > 0;
+}
+
+/**
+ * @fn struct nl_msg *ce_gw_add_msg(struct cegw_ctx *ctx, char *dst_name,
+ *                                  char *src_name, uint8_t type,
+ *                                  uint32_t flags)
+ * @brief Create and validate a CE_GW_C_ADD message. See ce_gw_add() for the
+ *        parameters.
+ * @retval NULL on failure
+ * @ingroup net
+ * @returns The request buffer of ctx (see ctx_msg()). Valid until the next
+ *          request of ctx.
+ */
+static struct nl_msg *ce_gw_add_msg(struct cegw_ctx *ctx, char *dst_name,
+                                    char *src_name, uint8_t type,
+                                    uint32_t flags)
+{
+	int err = 0;
+	struct nl_msg *msg;
+	uint64_t t = 0;
+
+	/* create */
+	TIMING_BEGIN(TIMING_C_ADD, t);
+	msg = ctx_msg(ctx);
+	TIMING_PHASE(TIMING_C_ADD, TIMING_P_ALLOC, t);
 
 	void *user_hdr;
 	user_hdr = genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ,
-	                       genl_family_get_id(genl_fam), USER_HDR_SIZE,
+	                       ctx->family, USER_HDR_SIZE,
 	                       NO_FLAG, CE_GW_C_ADD, IFACE_VERSION);
 	if (user_hdr == NULL)
 		fprintf(stderr, "add: Message Haeder creation failed\n");
@@ -234,8 +730,20 @@ int ce_gw_add(char *dst_name, char *src_name, uint8_t type, uint32_t flags)
 
 	/* Attributes needed by both, add route and add dev */
 	NLA_PUT_STRING(msg, CE_GW_A_DST, dst_name);
+
+	/* the names stay for devices the cache does not know */
+	if (src_name != NULL && ctx->version >= CE_GW_IFINDEX_VERSION) {
+		int src_if = ctx_ifindex(ctx, src_name);
+		int dst_if = ctx_ifindex(ctx, dst_name);
+
+		if (src_if > 0)
+			NLA_PUT_U32(msg, CE_GW_A_SRC_IF, src_if);
+		if (dst_if > 0)
+			NLA_PUT_U32(msg, CE_GW_A_DST_IF, dst_if);
+	}
 	NLA_PUT_U8(msg, CE_GW_A_TYPE, type);
 	NLA_PUT_U32(msg, CE_GW_A_FLAGS, flags);
+	TIMING_PHASE(TIMING_C_ADD, TIMING_P_ENCODE, t);
 
 	/* vaildate */
 	struct nlmsghdr *msghdr = nlmsg_hdr(msg);
@@ -243,48 +751,86 @@ int ce_gw_add(char *dst_name, char *src_name, uint8_t type, uint32_t flags)
 	                       CE_GW_A_MAX, ce_gw_genl_policy);
 	if (err != 0) {
 		fprintf(stderr, "add: Validation of Message Failed: %i\n", err);
+		return NULL;
+	}
+	TIMING_PHASE(TIMING_C_ADD, TIMING_P_VALIDATE, t);
+
+	return msg;
+
+nla_put_failure:
+	fprintf(stderr, "Attribute Modification failed: %d\n",-EMSGSIZE);
+	return NULL;
+}
+
+int ce_gw_add(struct cegw_ctx *ctx, char *dst_name, char *src_name,
+              uint8_t type, uint32_t flags)
+{
+	int err = 0;
+	struct nl_msg *msg;
+	int stale;
+
+	msg = ce_gw_add_msg(ctx, dst_name, src_name, type, flags);
+	if (msg == NULL) {
+		TIMING_END(TIMING_C_ADD, 0, -EINVAL);
 		return -1;
 	}
 
+	/* an index of the cache may belong to a device which is gone, then
+	 * the add is sent once more after a new link dump */
+	stale = ctx_ifindex_sent(ctx, dst_name, src_name);
+
 	/* send */
-	nl_send_auto(nl_sk, msg);
+	ctx->errno_retry = stale ? ENODEV : 0;
+	err = ce_gw_send_ack(ctx, msg);
+	ctx->errno_retry = 0;
+	TIMING_END(TIMING_C_ADD, nlmsg_hdr(msg)->nlmsg_seq, err);
+
+	if (stale && err == -nl_syserr2nlerr(ENODEV)) {
+		ifcache_free(&ctx->ifc);
+		msg = ce_gw_add_msg(ctx, dst_name, src_name, type, flags);
+		if (msg == NULL) {
+			TIMING_END(TIMING_C_ADD, 0, -EINVAL);
+			return -1;
+		}
+
+		err = ce_gw_send_ack(ctx, msg);
+		TIMING_END(TIMING_C_ADD, nlmsg_hdr(msg)->nlmsg_seq, err);
+	}
 
-	err = nl_wait_for_ack(nl_sk);
 	if (err != 0) {
 		fprintf(stderr,
 		        "add: ACK is missing or Error returned. "
 		        "Operation might fail: %i\n", err);
 	}
 
-	nlmsg_free(msg);
-
 	return 0;
-
-nla_put_failure:
-	fprintf(stderr, "Attribute Modification failed: %d\n",-EMSGSIZE);
-	nlmsg_free(msg);
-	return -EMSGSIZE;
 }
 
-int ce_gw_del(uint32_t id, char *dev_name)
+/**
+ * @fn struct nl_msg *ce_gw_del_msg(struct cegw_ctx *ctx, uint32_t id,
+ *                                  char *dev_name)
+ * @brief Create and validate a CE_GW_C_DEL message. See ce_gw_del() for the
+ *        parameters.
+ * @retval NULL on failure
+ * @ingroup net
+ * @returns The request buffer of ctx (see ctx_msg()). Valid until the next
+ *          request of ctx.
+ */
+static struct nl_msg *ce_gw_del_msg(struct cegw_ctx *ctx, uint32_t id,
+                                    char *dev_name)
 {
 	int err;
 	struct nl_msg *msg;
-	if (id != 0 && dev_name != NULL) {
-		err = -EINVAL;
-		return err;
-	}
+	uint64_t t = 0;
 
 	/* create */
-	msg = nlmsg_alloc();
-	if(msg == NULL) {
-		fprintf(stderr,"del: Message allocation failed.\n");
-		return -1;
-	}
+	TIMING_BEGIN(TIMING_C_DEL, t);
+	msg = ctx_msg(ctx);
+	TIMING_PHASE(TIMING_C_DEL, TIMING_P_ALLOC, t);
 
 	void *user_hdr;
 	user_hdr = genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ,
-	                       genl_family_get_id(genl_fam), USER_HDR_SIZE,
+	                       ctx->family, USER_HDR_SIZE,
 	                       NO_FLAG, CE_GW_C_DEL, IFACE_VERSION);
 	if (user_hdr == NULL)
 		fprintf(stderr, "del: Message Haeder creation failed\n");
@@ -292,7 +838,11 @@ int ce_gw_del(uint32_t id, char *dev_name)
 	NLA_PUT_U32(msg, CE_GW_A_ID, id);
 	if (dev_name != NULL) { /* del dev is called */
 		NLA_PUT_STRING(msg, CE_GW_A_DST, dev_name);
+
+		/* its index must not be sent for a new device of the name */
+		ifcache_free(&ctx->ifc);
 	}
+	TIMING_PHASE(TIMING_C_DEL, TIMING_P_ENCODE, t);
 
 	/* vaildate */
 	struct nlmsghdr *msghdr = nlmsg_hdr(msg);
@@ -300,70 +850,408 @@ int ce_gw_del(uint32_t id, char *dev_name)
 	                       CE_GW_A_MAX, ce_gw_genl_policy);
 	if (err != 0) {
 		fprintf(stderr, "del: Validation of Message Failed: %i\n", err);
+		return NULL;
+	}
+	TIMING_PHASE(TIMING_C_DEL, TIMING_P_VALIDATE, t);
+
+	return msg;
+
+nla_put_failure:
+	fprintf(stderr, "Attribute Modification failed: %d\n",-EMSGSIZE);
+	return NULL;
+}
+
+int ce_gw_del(struct cegw_ctx *ctx, uint32_t id, char *dev_name)
+{
+	int err;
+	struct nl_msg *msg;
+	if (id != 0 && dev_name != NULL) {
+		err = -EINVAL;
+		return err;
+	}
+
+	msg = ce_gw_del_msg(ctx, id, dev_name);
+	if (msg == NULL) {
+		TIMING_END(TIMING_C_DEL, 0, -EINVAL);
 		return -1;
 	}
 
 	/* send */
-	nl_send_auto(nl_sk, msg);
-
-	err = nl_wait_for_ack(nl_sk);
+	err = ce_gw_send_ack(ctx, msg);
+	TIMING_END(TIMING_C_DEL, nlmsg_hdr(msg)->nlmsg_seq, err);
 	if (err != 0) {
 		fprintf(stderr,
 		        "add: ACK is missing or Error returned. "
 		        "Operation might fail: %i\n", err);
 	}
 
-	nlmsg_free(msg);
 	return 0;
-
-nla_put_failure:
-	fprintf(stderr, "Attribute Modification failed: %d\n",-EMSGSIZE);
-	nlmsg_free(msg);
-	return -EMSGSIZE;
 }
 
 /**
- * @fn int nl_cb_list_entry(struct nl_msg *msg, void *arg)
- * @brief will be called for every multipart message and prints informations to
- *        stdout.
- * @param msg Netlink Message
- * @raram arg a file
- * @retval NL_OK
- * @ingroup cb
- * @see defined as callback in ce_gw_list()
+ * @struct batch_slot
+ * @brief Maps the sequence number of an outstanding batch message to the
+ *        index of its operation. See ce_gw_batch().
  */
-int nl_cb_list_entry(struct nl_msg *msg, void *arg)
-{
-	int err;
+struct batch_slot {
+	uint32_t seq;	/**< sequence number of the sent message */
+	size_t idx;	/**< index in the operation array */
+	int used;	/**< 1 while waiting for the ACK */
+};
 
-	struct nlmsghdr *msghdr = nlmsg_hdr(msg);
+/**
+ * @struct batch_state
+ * @brief State of a running ce_gw_batch(). Passed to the batch callbacks.
+ */
+struct batch_state {
+	struct ce_gw_op *ops;		/**< operations of the batch */
+	struct batch_slot *slots;	/**< ring with window entries */
+	unsigned int window;		/**< max. number of outstanding msgs */
+	unsigned int pending;		/**< number of outstanding msgs */
+};
+
+/**
+ * @fn void batch_complete(struct batch_state *st, uint32_t seq, int err)
+ * @brief Stores the result of the message with sequence number seq in its
+ *        operation. Unknown sequence numbers are ignored.
+ * @ingroup net
+ */
+static void batch_complete(struct batch_state *st, uint32_t seq, int err)
+{
+	struct batch_slot *slot = &st->slots[seq % st->window];
+
+	if (!slot->used || slot->seq != seq)
+		return;
+
+	st->ops[slot->idx].err = err;
+	slot->used = 0;
+	st->pending--;
+}
+
+/**
+ * @fn int nl_cb_batch_ack(struct nl_msg *msg, void *arg)
+ * @brief Called for every ACK of a batch message.
+ * @param msg Netlink Message
+ * @param arg the struct batch_state of the batch
+ * @retval NL_OK
+ * @ingroup cb
+ * @see defined as callback in ce_gw_batch()
+ */
+static int nl_cb_batch_ack(struct nl_msg *msg, void *arg)
+{
+	batch_complete(arg, nlmsg_hdr(msg)->nlmsg_seq, 0);
+	return NL_OK;
+}
+
+/**
+ * @fn int nl_cb_batch_errno(struct sockaddr_nl *nla,
+ *                    struct nlmsgerr *nlerr, void *arg)
+ * @brief Called for every error returned for a batch message. The error
+ *        is stored in the operation and the remaining messages are processed.
+ * @param nla Socket address informations
+ * @param nlerr error Message
+ * @param arg the struct batch_state of the batch
+ * @retval NL_SKIP
+ * @ingroup cb
+ * @see defined as callback in ce_gw_batch()
+ */
+static int nl_cb_batch_errno(struct sockaddr_nl *nla,
+                             struct nlmsgerr *nlerr, void *arg)
+{
+	batch_complete(arg, nlerr->msg.nlmsg_seq, nlerr->error);
+	return NL_SKIP;
+}
+
+/**
+ * @fn int nl_cb_batch_seq(struct nl_msg *msg, void *arg)
+ * @brief Accepts every sequence number. ACKs are matched to their operation
+ *        in nl_cb_batch_ack() and nl_cb_batch_errno().
+ * @retval NL_OK
+ * @ingroup cb
+ * @see defined as callback in ce_gw_batch()
+ */
+static int nl_cb_batch_seq(struct nl_msg *msg, void *arg)
+{
+	return NL_OK;
+}
+
+/**
+ * @fn int batch_run(struct cegw_ctx *ctx, struct ce_gw_op *ops, size_t n,
+ *                   unsigned int window, int only_err)
+ * @brief Does the work of ce_gw_batch().
+ * @param only_err if != 0 only the operations with this ce_gw_op.err are
+ *        sent, all others are left untouched.
+ * @ingroup net
+ */
+static int batch_run(struct cegw_ctx *ctx, struct ce_gw_op *ops, size_t n,
+                     unsigned int window, int only_err)
+{
+	int err = 0;
+	size_t next = 0;
+	struct batch_state st;
+	uint64_t t = 0;
+
+	if (window == 0)
+		window = 1;
+
+	st.ops = ops;
+	st.window = window;
+	st.pending = 0;
+	st.slots = calloc(window, sizeof(*st.slots));
+	if (st.slots == NULL) {
+		fprintf(stderr, "batch: Slot allocation failed.\n");
+		return -ENOMEM;
+	}
+
+	/* create callback system */
+	struct nl_cb *cb = transport_cb_alloc(ctx->transport, NL_CB_DEFAULT);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, nl_cb_batch_ack, &st);
+	nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, nl_cb_batch_seq, &st);
+	nl_cb_err(cb, NL_CB_CUSTOM, nl_cb_batch_errno, &st);
+
+	/* every message must be acknowledged */
+	nl_socket_enable_auto_ack(ctx->sk);
+
+	while (next < n || st.pending > 0) {
+
+		/* fill the window */
+		while (next < n && st.pending < window) {
+			struct ce_gw_op *op = &ops[next];
+			char *src = op->src[0] ? op->src : NULL;
+			char *dst = op->dst[0] ? op->dst : NULL;
+			struct nl_msg *msg;
+			enum timing_cmd tcmd = op->cmd == CE_GW_C_ADD ?
+			                       TIMING_C_ADD : TIMING_C_DEL;
+
+			if (only_err != 0 && op->err != only_err) {
+				next++;
+				continue;
+			}
+
+			if (op->cmd == CE_GW_C_ADD)
+				msg = ce_gw_add_msg(ctx, dst, src, op->type,
+				                    op->flags);
+			else
+				msg = ce_gw_del_msg(ctx, op->id, dst);
+
+			if (msg == NULL) {
+				TIMING_END(tcmd, 0, -EINVAL);
+				op->err = -EINVAL;
+				next++;
+				continue;
+			}
+			op->err = 0;
+
+			/* the ACK is received with the others, see below */
+			err = ce_gw_send(ctx, msg);
+			uint32_t seq = nlmsg_hdr(msg)->nlmsg_seq;
+			TIMING_END(tcmd, seq, err < 0 ? err : 0);
+			if (err < 0)
+				goto out;
+
+			struct batch_slot *slot = &st.slots[seq % window];
+			slot->seq = seq;
+			slot->idx = next;
+			slot->used = 1;
+			st.pending++;
+			next++;
+		}
+
+		/* collect at least one answer */
+		if (st.pending > 0) {
+			TIMING_STAMP(t);
+			err = nl_recvmsgs(ctx->sk, cb);
+			TIMING_PHASE(TIMING_C_BATCH, TIMING_P_RECV, t);
+			if (err < 0)
+				goto out;
+		}
+	}
+
+	err = 0;
+
+out:
+	if (err < 0) {
+		fprintf(stderr, "batch: Sending or receiving failed: %s\n",
+		        nl_geterror(err));
+
+		/* everything not acknowledged yet has failed */
+		for (unsigned int i = 0; i < window; i++) {
+			if (st.slots[i].used)
+				ops[st.slots[i].idx].err = -EIO;
+		}
+		for (; next < n; next++) {
+			if (only_err == 0 || ops[next].err == only_err)
+				ops[next].err = -EIO;
+		}
+	}
+
+	nl_cb_put(cb);
+	free(st.slots);
+
+	return err;
+}
+
+int ce_gw_batch(struct cegw_ctx *ctx, struct ce_gw_op *ops, size_t n,
+                unsigned int window)
+{
+	int err = batch_run(ctx, ops, n, window, 0);
+	if (err != 0)
+		return err;
+
+	/* send the operations failed due to an outdated family ID again */
+	for (size_t i = 0; i < n; ++i) {
+		if (ops[i].err == -ENOENT) {
+			if (fam_retry(ctx, -nl_syserr2nlerr(ENOENT)))
+				err = batch_run(ctx, ops, n, window, -ENOENT);
+			break;
+		}
+	}
+	if (err != 0)
+		return err;
+
+	/* and the adds failed due to an interface index of a device which is
+	 * gone, after a new link dump */
+	for (size_t i = 0; i < n; ++i) {
+		struct ce_gw_op *op = &ops[i];
+		char *src = op->src[0] ? op->src : NULL;
+
+		if (op->err == -ENODEV && op->cmd == CE_GW_C_ADD &&
+		    ctx_ifindex_sent(ctx, op->dst, src)) {
+			ifcache_free(&ctx->ifc);
+			err = batch_run(ctx, ops, n, window, -ENODEV);
+			break;
+		}
+	}
+
+	return err;
+}
+
+/**
+ * @struct list_arg
+ * @brief Argument of nl_cb_list_entry(). See ce_gw_list_foreach().
+ */
+struct list_arg {
+	ce_gw_route_cb cb;	/**< called for every route */
+	void *arg;		/**< passed to cb */
+	int err;		/**< != 0 if cb stopped the listing */
+	int intr;		/**< 1 if the dump is inconsistent from here on */
+	int sorted;		/**< 1 while the IDs arrived in ascending order */
+	uint32_t last_id;	/**< ID of the last route passed to cb */
+	uint32_t skip;		/**< routes up to this ID were passed to cb
+				 * before a restart */
+	struct ce_gw_dump_stats *stats; /**< counters of the context */
+	const struct ce_gw_route_filter *filter; /**< routes passed to cb, NULL
+						  * for all */
+	struct cegw_ctx *ctx;	/**< translates interface indexes to names */
+};
+
+/**
+ * @fn void route_ifname(struct cegw_ctx *ctx, struct nlattr *attr,
+ *                       char *name)
+ * @brief Fills the empty name with the name of the interface index attr,
+ *        if ctx is set and its cache knows it. A name sent by the kernel
+ *        is kept.
+ * @ingroup trans
+ */
+static void route_ifname(struct cegw_ctx *ctx, struct nlattr *attr,
+                         char *name)
+{
+	if (ctx == NULL || attr == NULL || name[0] != '\0')
+		return;
+
+	int index = nla_get_u32(attr);
+	const char *cached = ifcache_name(ctx_ifcache(ctx), index);
+
+	if (cached == NULL && ctx_ifcache_miss(ctx))
+		cached = ifcache_name(ctx_ifcache(ctx), index);
+	if (cached != NULL)
+		strcpy(name, cached);
+}
+
+/**
+ * @fn void route_parse(struct nlattr **attrs, struct ce_gw_route *route,
+ *                      struct cegw_ctx *ctx)
+ * @brief Fills route from the parsed attributes of a CE_GW_C_LIST or
+ *        CE_GW_C_EVENT message. Missing attributes are 0.
+ * @param ctx If not NULL, the interface indexes of routes without names
+ *        are translated to names with its cache.
+ * @ingroup trans
+ */
+static void route_parse(struct nlattr **attrs, struct ce_gw_route *route,
+                        struct cegw_ctx *ctx)
+{
+	memset(route, 0, sizeof(*route));
+	if (attrs[CE_GW_A_SRC] != NULL)
+		nla_strlcpy(route->src, attrs[CE_GW_A_SRC], IFNAMSIZ);
+	if (attrs[CE_GW_A_DST] != NULL)
+		nla_strlcpy(route->dst, attrs[CE_GW_A_DST], IFNAMSIZ);
+	route_ifname(ctx, attrs[CE_GW_A_SRC_IF], route->src);
+	route_ifname(ctx, attrs[CE_GW_A_DST_IF], route->dst);
+	if (attrs[CE_GW_A_ID] != NULL)
+		route->id = nla_get_u32(attrs[CE_GW_A_ID]);
+	if (attrs[CE_GW_A_FLAGS] != NULL)
+		route->flags = nla_get_u32(attrs[CE_GW_A_FLAGS]);
+	if (attrs[CE_GW_A_TYPE] != NULL)
+		route->type = nla_get_u8(attrs[CE_GW_A_TYPE]);
+	if (attrs[CE_GW_A_HNDL] != NULL)
+		route->handled = nla_get_u32(attrs[CE_GW_A_HNDL]);
+	if (attrs[CE_GW_A_DROP] != NULL)
+		route->dropped = nla_get_u32(attrs[CE_GW_A_DROP]);
+}
+
+/**
+ * @fn int nl_cb_list_entry(struct nl_msg *msg, void *arg)
+ * @brief will be called for every multipart message and passes the route
+ *        to the callback of ce_gw_list_foreach().
+ * @param msg Netlink Message
+ * @raram arg a struct list_arg
+ * @retval NL_OK
+ * @retval NL_SKIP if the callback stopped the listing or the dump was
+ *         interrupted. The rest of the dump is still read, so that it does
+ *         not remain in the socket.
+ * @ingroup cb
+ * @see defined as callback in ce_gw_list_foreach()
+ */
+int nl_cb_list_entry(struct nl_msg *msg, void *arg)
+{
+	int err;
+	struct list_arg *list = arg;
+	struct ce_gw_route route;
+	uint64_t t = 0;
+
+	struct nlmsghdr *msghdr = nlmsg_hdr(msg);
+
+	if (list->err != 0 || list->intr)
+		return NL_SKIP;
+
+	TIMING_STAMP(t);
 
 	struct nlattr *attrs[CE_GW_A_MAX+1];
 	err = genlmsg_parse(msghdr, USER_HDR_SIZE, attrs,
 	                    CE_GW_A_MAX, ce_gw_genl_policy);
-	if (err < 0)
+	if (err < 0) {
 		fprintf(stderr, "ERROR Kernel Message Parsing Failed\n");
+		return NL_SKIP;
+	}
+
+	route_parse(attrs, &route, list->ctx);
+
+	/* passed to cb before the dump was restarted */
+	if (route.id <= list->skip)
+		return NL_SKIP;
+	if (route.id <= list->last_id)
+		list->sorted = 0;
+	list->last_id = route.id;
+
+	/* the kernel may have ignored the filter of the request */
+	if (!ce_gw_route_match(list->filter, &route))
+		return NL_SKIP;
+
+	list->err = list->cb(&route, list->arg);
+	TIMING_PHASE(TIMING_C_LIST, TIMING_P_CALLBACK, t);
+	if (list->err != 0)
+		return NL_SKIP;
 
-	char *a_msg_src_data = (char *)nla_data(attrs[CE_GW_A_SRC]);
-	char *a_msg_dst_data = (char *)nla_data(attrs[CE_GW_A_DST]);
-	uint32_t *a_msg_id_data = (uint32_t *)nla_data(attrs[CE_GW_A_ID]);
-	uint32_t *a_msg_flags_data = (uint32_t *)nla_data(attrs[CE_GW_A_FLAGS]);
-	uint8_t *a_msg_type_data = (uint8_t *)nla_data(attrs[CE_GW_A_TYPE]);
-	uint32_t *a_msg_hndl_data = (uint32_t *)nla_data(attrs[CE_GW_A_HNDL]);
-	uint32_t *a_msg_drop_data = (uint32_t *)nla_data(attrs[CE_GW_A_DROP]);
-
-	char *type_str;
-	type_str = enum2str(*a_msg_type_data, type_array, 6, TYPE_MAX);
-	char *flags_str;
-	/* 256 should be big enough */
-	flags_str = flags2str(*a_msg_flags_data, flags_array, 256);
-
-	printf(" %-8d %-6s %-6s %-6s %-8d %-8d %s\n", *a_msg_id_data,
-	       a_msg_src_data, a_msg_dst_data, type_str, *a_msg_hndl_data,
-	       *a_msg_drop_data, flags_str);
-
-	free(type_str);
-	free(flags_str);
 	return NL_OK;
 }
 
@@ -374,191 +1262,1793 @@ int nl_cb_list_entry(struct nl_msg *msg, void *arg)
  * @raram arg a file
  * @retval NL_STOP
  * @ingroup cb
- * @see defined as callback in ce_gw_list()
+ * @see defined as callback in ce_gw_list_foreach()
  */
 int nl_cb_list_finish(struct nl_msg *msg, void *arg)
 {
 	return NL_STOP;
 }
 
-int ce_gw_list(uint32_t id)
+/**
+ * @fn int nl_cb_list_in(struct nl_msg *msg, void *arg)
+ * @brief Counts every received message of a dump in the ce_gw_dump_stats.
+ * @param msg Netlink Message
+ * @raram arg a struct list_arg
+ * @retval NL_OK
+ * @ingroup cb
+ * @see defined as callback in ce_gw_lister_alloc()
+ */
+static int nl_cb_list_in(struct nl_msg *msg, void *arg)
+{
+	struct list_arg *list = arg;
+
+	list->stats->messages++;
+	list->stats->bytes += nlmsg_hdr(msg)->nlmsg_len;
+
+	return NL_OK;
+}
+
+/**
+ * @fn int nl_cb_list_intr(struct nl_msg *msg, void *arg)
+ * @brief will be called for every message with NLM_F_DUMP_INTR, i.e. the
+ *        routes changed while they were dumped. The routes from here on are
+ *        skipped by nl_cb_list_entry() and ce_gw_lister_run() resumes the
+ *        dump behind the last passed route.
+ * @param msg Netlink Message
+ * @raram arg a struct list_arg
+ * @retval NL_OK so that the NLMSG_DONE still ends the dump
+ * @ingroup cb
+ * @see defined as callback in ce_gw_lister_alloc()
+ */
+static int nl_cb_list_intr(struct nl_msg *msg, void *arg)
+{
+	struct list_arg *list = arg;
+
+	list->intr = 1;
+
+	return NL_OK;
+}
+
+/**
+ * @struct ce_gw_lister
+ * @brief A prepared CE_GW_C_LIST request. See ce_gw_lister_alloc().
+ */
+struct ce_gw_lister {
+	struct cegw_ctx *ctx;	/**< context of the request */
+	struct nl_msg *msg;	/**< the request, sent again by every run */
+	struct nl_cb *cb;	/**< callbacks of the answer */
+	struct list_arg list;	/**< argument of nl_cb_list_entry() */
+	struct ce_gw_route_filter filter; /**< see ce_gw_lister_filter() */
+};
+
+struct ce_gw_lister *ce_gw_lister_alloc(struct cegw_ctx *ctx, uint32_t id)
 {
 	int err;
-	struct nl_msg *msg;
+	uint64_t t = 0;
+	struct ce_gw_lister *lister = calloc(1, sizeof(*lister));
+	if (lister == NULL) {
+		fprintf(stderr, "list: Allocation failed.\n");
+		return NULL;
+	}
+	lister->ctx = ctx;
+	lister->list.stats = &ctx->dump;
+	lister->list.ctx = ctx;
 
 	/* create */
-	msg = nlmsg_alloc();
-	if(msg == NULL) {
-		fprintf(stderr,"echo: Message allocation failed.\n");
-		return -1;
+	TIMING_BEGIN(TIMING_C_LIST, t);
+	lister->msg = nlmsg_alloc();
+	if(lister->msg == NULL) {
+		fprintf(stderr,"list: Message allocation failed.\n");
+		free(lister);
+		TIMING_END(TIMING_C_LIST, 0, -ENOMEM);
+		return NULL;
 	}
+	TIMING_PHASE(TIMING_C_LIST, TIMING_P_ALLOC, t);
+	struct nl_msg *msg = lister->msg;
 
+	/* no NLM_F_DUMP: the module answers CE_GW_C_LIST from its doit
+	 * handler, which unicasts every route, see ce_gw_lister_run() */
 	void *user_hdr;
 	user_hdr = genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ,
-	                       genl_family_get_id(genl_fam), USER_HDR_SIZE,
+	                       ctx->family, USER_HDR_SIZE,
 	                       NO_FLAG, CE_GW_C_LIST, IFACE_VERSION);
 	if (user_hdr == NULL)
-		fprintf(stderr, "echo: Message Haeder creation failed.\n");
+		fprintf(stderr, "list: Message Haeder creation failed.\n");
 
 	NLA_PUT_U32(msg, CE_GW_A_ID, id);
+	TIMING_PHASE(TIMING_C_LIST, TIMING_P_ENCODE, t);
 
 	/* vaildate */
 	struct nlmsghdr *msghdr = nlmsg_hdr(msg);
 	err = genlmsg_validate(msghdr, 0, CE_GW_A_MAX, ce_gw_genl_policy);
 	if (err != 0) {
-		fprintf(stderr, "echo: Validation of Message Failed: %i\n",
+		fprintf(stderr, "list: Validation of Message Failed: %i\n",
 		        err);
-		return -1;
+		ce_gw_lister_free(lister);
+		TIMING_END(TIMING_C_LIST, 0, err);
+		return NULL;
 	}
-
-	/* send */
-	nl_socket_disable_auto_ack(nl_sk);
-	nl_send_auto(nl_sk, msg);
+	TIMING_PHASE(TIMING_C_LIST, TIMING_P_VALIDATE, t);
 
 	/* create callback system */
-	struct nl_cb *cb = nl_cb_alloc(NL_CB_DEFAULT);
-	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, nl_cb_list_entry, NULL);
-	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, nl_cb_list_finish, NULL);
-	nl_cb_err(cb, NL_CB_CUSTOM, nl_cb_general_errno, NULL);
+	lister->cb = transport_cb_alloc(ctx->transport, NL_CB_DEFAULT);
+	if (lister->cb == NULL) {
+		ce_gw_lister_free(lister);
+		return NULL;
+	}
+	nl_cb_set(lister->cb, NL_CB_VALID, NL_CB_CUSTOM, nl_cb_list_entry,
+	          &lister->list);
+	nl_cb_set(lister->cb, NL_CB_FINISH, NL_CB_CUSTOM, nl_cb_list_finish,
+	          NULL);
+	nl_cb_set(lister->cb, NL_CB_MSG_IN, NL_CB_CUSTOM, nl_cb_list_in,
+	          &lister->list);
+	nl_cb_set(lister->cb, NL_CB_DUMP_INTR, NL_CB_CUSTOM, nl_cb_list_intr,
+	          &lister->list);
+	nl_cb_err(lister->cb, NL_CB_CUSTOM, nl_cb_general_errno, ctx);
+
+	return lister;
+
+nla_put_failure:
+	fprintf(stderr, "Attribute Modification failed: %d\n",-EMSGSIZE);
+	ce_gw_lister_free(lister);
+	TIMING_END(TIMING_C_LIST, 0, -EMSGSIZE);
+	return NULL;
+}
+
+int ce_gw_route_match(const struct ce_gw_route_filter *filter,
+                      const struct ce_gw_route *route)
+{
+	if (filter == NULL)
+		return 1;
+
+	if ((filter->fields & CE_GW_FILTER_SRC) &&
+	    strcmp(filter->src, route->src) != 0)
+		return 0;
+	if ((filter->fields & CE_GW_FILTER_DST) &&
+	    strcmp(filter->dst, route->dst) != 0)
+		return 0;
+	if ((filter->fields & CE_GW_FILTER_TYPE) &&
+	    filter->type != route->type)
+		return 0;
+	if ((filter->fields & CE_GW_FILTER_FLAGS) &&
+	    (route->flags & filter->flags) != filter->flags)
+		return 0;
+
+	return 1;
+}
+
+int ce_gw_lister_filter(struct ce_gw_lister *lister,
+                        const struct ce_gw_route_filter *filter)
+{
+	struct nl_msg *msg = lister->msg;
+
+	if (filter == NULL || filter->fields == 0)
+		return 0;
+
+	if (filter->fields & CE_GW_FILTER_SRC)
+		NLA_PUT_STRING(msg, CE_GW_A_SRC, filter->src);
+	if (filter->fields & CE_GW_FILTER_DST)
+		NLA_PUT_STRING(msg, CE_GW_A_DST, filter->dst);
+	if (filter->fields & CE_GW_FILTER_TYPE)
+		NLA_PUT_U8(msg, CE_GW_A_TYPE, filter->type);
+	if (filter->fields & CE_GW_FILTER_FLAGS)
+		NLA_PUT_U32(msg, CE_GW_A_FLAGS, filter->flags);
+
+	lister->filter = *filter;
+	lister->list.filter = &lister->filter;
+	return 0;
+
+nla_put_failure:
+	fprintf(stderr, "Attribute Modification failed: %d\n", -EMSGSIZE);
+	return -NLE_NOMEM;
+}
+
+int ce_gw_lister_run(struct ce_gw_lister *lister, ce_gw_route_cb route_cb,
+                     void *arg)
+{
+	struct cegw_ctx *ctx = lister->ctx;
+	struct list_arg *list = &lister->list;
+	int err;
+	uint64_t t = 0;
+
+	list->cb = route_cb;
+	list->arg = arg;
+	list->err = 0;
+	list->sorted = 1;
+	list->last_id = 0;
+	list->skip = 0;
+
+	/* continues the record of ce_gw_lister_alloc() in the first run */
+	TIMING_BEGIN(TIMING_C_LIST, t);
+
+	for (int retries = 0; ; ) {
+		list->intr = 0;
+		ctx->dump.dumps++;
+
+		/* new sequence number (and family ID) for every run */
+		fam_msg_update(ctx, lister->msg);
+		TIMING_PHASE(TIMING_C_LIST, TIMING_P_ENCODE, t);
+
+		/* send and receive */
+		err = ce_gw_send_recv(ctx, lister->msg, lister->cb);
+
+		/* the routes are unicasts of the doit handler, not a dump
+		 * the kernel continues: an overrun (ENOBUFS, which libnl
+		 * reports as NLE_NOMEM) loses some of them for good. The
+		 * routes behind it are skipped like after NLM_F_DUMP_INTR
+		 * and the rest of the answer is read, so that it does not
+		 * remain in the socket. Give up if nothing arrives anymore */
+		for (int i = 0; err == -NLE_NOMEM && i < CE_GW_DUMP_RETRIES;
+		     ++i) {
+			uint64_t messages = ctx->dump.messages;
+
+			ctx->dump.overruns++;
+			list->intr = 1;
+			err = ce_gw_recv(ctx, lister->msg, lister->cb);
+			if (ctx->dump.messages != messages)
+				i = -1;
+		}
+		if (err == -NLE_NOMEM)
+			fprintf(stderr, "list: Receive buffer overran %d times "
+			        "in a row, the routes are incomplete\n",
+			        CE_GW_DUMP_RETRIES);
+
+		if (err < 0 || !list->intr || list->err != 0)
+			break;
+
+		/* resume behind the last route passed to route_cb, which
+		 * works only if the kernel lists sorted by ID. Only restarts
+		 * in a row without a new route count as retries */
+		if (list->last_id > list->skip)
+			retries = 0;
+		if (!list->sorted || retries++ == CE_GW_DUMP_RETRIES) {
+			fprintf(stderr, "list: Dump was interrupted %d times "
+			        "in a row, the routes are incomplete\n",
+			        retries);
+			err = -NLE_DUMP_INTR;
+			break;
+		}
 
+		ctx->dump.restarts++;
+		list->skip = list->last_id;
+	}
+
+	TIMING_END(TIMING_C_LIST, nlmsg_hdr(lister->msg)->nlmsg_seq,
+	           err < 0 ? err : list->err);
+	if (err < 0)
+		return err;
+
+	return list->err;
+}
+
+void ce_gw_lister_free(struct ce_gw_lister *lister)
+{
+	if (lister == NULL)
+		return;
+
+	if (lister->cb != NULL)
+		nl_cb_put(lister->cb);
+	nlmsg_free(lister->msg);
+	free(lister);
+}
+
+int ce_gw_list_foreach(struct cegw_ctx *ctx, uint32_t id,
+                       ce_gw_route_cb route_cb, void *arg)
+{
+	int err;
+	struct ce_gw_lister *lister = ce_gw_lister_alloc(ctx, id);
+	if (lister == NULL)
+		return -1;
+
+	err = ce_gw_lister_run(lister, route_cb, arg);
+	ce_gw_lister_free(lister);
+
+	return err;
+}
+
+void ce_gw_route_print_header(void)
+{
 	printf(" ID       SRC    DST    TYPE   HANDLED  DROPPED  FLAGS\n");
+}
 
-	nl_recvmsgs(nl_sk, cb);
+int ce_gw_route_print(const struct ce_gw_route *route, void *arg)
+{
+	const char *type_str;
+	type_str = enum2str(route->type, type_array, TYPE_MAX);
+	char flags_str[256]; /* 256 should be big enough */
+	flags2str(route->flags, flags_array, flags_str, sizeof(flags_str));
 
-	nl_cb_put(cb);
-	nlmsg_free(msg);
+	printf(" %-8u %-6s %-6s %-6s %-8u %-8u %s\n", route->id,
+	       route->src, route->dst, type_str ? type_str : "?",
+	       route->handled, route->dropped, flags_str);
 
 	return 0;
+}
 
-nla_put_failure:
-	fprintf(stderr, "Attribute Modification failed: %d\n",-EMSGSIZE);
-	nlmsg_free(msg);
-	return -1;
+/**
+ * @struct routes_arg
+ * @brief Argument of routes_store(). See ce_gw_list_routes().
+ */
+struct routes_arg {
+	struct ce_gw_route *routes;	/**< caller supplied array */
+	size_t max;			/**< size of routes */
+	size_t count;			/**< number of routes listed */
+};
+
+/**
+ * @fn int routes_store(const struct ce_gw_route *route, void *arg)
+ * @brief stores route in the array of ce_gw_list_routes() if there is space.
+ * @retval 0
+ * @ingroup cb
+ */
+static int routes_store(const struct ce_gw_route *route, void *arg)
+{
+	struct routes_arg *r = arg;
+
+	if (r->count < r->max)
+		r->routes[r->count] = *route;
+	r->count++;
+
+	return 0;
+}
+
+int ce_gw_list_routes(struct cegw_ctx *ctx, uint32_t id,
+                      struct ce_gw_route *routes, size_t max, size_t *count)
+{
+	struct routes_arg r = { routes, max, 0 };
+	int err;
+
+	err = ce_gw_list_foreach(ctx, id, routes_store, &r);
+	*count = r.count;
+
+	return err;
+}
+
+int ce_gw_route_table_store(const struct ce_gw_route *route, void *arg)
+{
+	struct ce_gw_route_table *table = arg;
+
+	if (table->len == table->size) {
+		size_t size = table->size ? table->size * 2 : 64;
+		struct ce_gw_route *routes = realloc(table->routes,
+		                                     size * sizeof(*routes));
+		if (routes == NULL)
+			return -ENOMEM;
+
+		table->routes = routes;
+		table->size = size;
+	}
+
+	table->routes[table->len++] = *route;
+	return 0;
+}
+
+int ce_gw_list_table(struct cegw_ctx *ctx, uint32_t id,
+                     struct ce_gw_route_table *table)
+{
+	table->len = 0;
+
+	return ce_gw_list_foreach(ctx, id, ce_gw_route_table_store,
+	                          table);
+}
+
+void ce_gw_route_table_free(struct ce_gw_route_table *table)
+{
+	free(table->routes);
+	table->routes = NULL;
+	table->len = 0;
+	table->size = 0;
+}
+
+int ce_gw_list(struct cegw_ctx *ctx, uint32_t id,
+               const struct ce_gw_route_filter *filter, unsigned int format)
+{
+	struct format_stream fs;
+	struct ce_gw_lister *lister;
+	int err;
+
+	lister = ce_gw_lister_alloc(ctx, id);
+	if (lister == NULL)
+		return -1;
+
+	err = ce_gw_lister_filter(lister, filter);
+	if (err != 0) {
+		ce_gw_lister_free(lister);
+		return err;
+	}
+
+	/* stdout may have buffered output, which must come first */
+	fflush(stdout);
+
+	if (format_stream_begin(&fs, STDOUT_FILENO, format) != 0) {
+		ce_gw_lister_free(lister);
+		return -ENOMEM;
+	}
+
+	/* the routes are written as the dump arrives, only the buffer of fs
+	 * is kept in memory */
+	err = ce_gw_lister_run(lister, format_stream_route, &fs);
+	if (format_stream_end(&fs) != 0 && err == 0)
+		err = -EIO;
+
+	ce_gw_lister_free(lister);
+	return err;
 }
 
+/**
+ * @struct echo_arg
+ * @brief Argument of nl_cb_echo_answer(). See ce_gw_echo_reply().
+ */
+struct echo_arg {
+	char *reply;	/**< buffer for the answer */
+	size_t size;	/**< size of reply */
+};
+
 /**
  * @fn int nl_cb_echo_answer(struct nl_msg *msg, void *arg)
  * @brief Callback witch receive the message sen bach by kernel
  * @param msg Netlink Message
- * @raram arg a file
+ * @raram arg a struct echo_arg, the message is copied into it.
  * @retval NL_OK
  * @ingroup cb
- * @see defined as callback in ce_gw_echo()
+ * @see defined as callback in ce_gw_echo_reply()
  */
 int nl_cb_echo_answer(struct nl_msg *msg, void *arg)
 {
+	struct echo_arg *echo = arg;
 	struct nlmsghdr *msghdr = nlmsg_hdr(msg);
 	struct genlmsghdr *gemsghdr =  nlmsg_data(msghdr);
+	uint64_t t = 0;
 
+	TIMING_STAMP(t);
 	struct nlattr *a_msg = genlmsg_attrdata(gemsghdr, 0);
-	char * a_msg_data = (char *) nla_data(a_msg);
-	printf("kernel says: %s\n", a_msg_data);
+	nla_strlcpy(echo->reply, a_msg, echo->size);
+	TIMING_PHASE(TIMING_C_ECHO, TIMING_P_CALLBACK, t);
 
 	return NL_OK;
 }
 
-int ce_gw_echo(char *message)
+/**
+ * @fn struct nl_msg *ce_gw_echo_msg(struct cegw_ctx *ctx, char *message)
+ * @brief Create and validate a CE_GW_C_ECHO message. See
+ *        ce_gw_echo_reply() for the parameters.
+ * @retval NULL on failure
+ * @ingroup net
+ * @returns The request buffer of ctx (see ctx_msg()). Valid until the next
+ *          request of ctx.
+ */
+static struct nl_msg *ce_gw_echo_msg(struct cegw_ctx *ctx, char *message)
 {
 	int rc; /* return codes */
 	struct nl_msg *msg;
+	uint64_t t = 0;
 
 	/* create */
-	msg = nlmsg_alloc();
-	if(msg == NULL) {
-		fprintf(stderr,"echo: Message allocation failed.\n");
-		return -1;
-	}
+	TIMING_BEGIN(TIMING_C_ECHO, t);
+	msg = ctx_msg(ctx);
+	TIMING_PHASE(TIMING_C_ECHO, TIMING_P_ALLOC, t);
 
 	void *user_hdr;
 	user_hdr = genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ,
-	                       genl_family_get_id(genl_fam), USER_HDR_SIZE,
+	                       ctx->family, USER_HDR_SIZE,
 	                       NO_FLAG, CE_GW_C_ECHO, IFACE_VERSION);
 	if (user_hdr == NULL)
 		fprintf(stderr, "echo: Message Haeder creation failed.\n");
 
 	NLA_PUT_STRING(msg, CE_GW_A_DATA, message);
+	TIMING_PHASE(TIMING_C_ECHO, TIMING_P_ENCODE, t);
 
 	/* vaildate */
 	struct nlmsghdr *msghdr = nlmsg_hdr(msg);
 	if ((rc = genlmsg_validate(msghdr,0,CE_GW_A_MAX, ce_gw_genl_policy)) != 0) {
 		fprintf(stderr, "echo: Validation of Message Failed: %i\n", rc);
-		return -1;
+		TIMING_END(TIMING_C_ECHO, 0, rc);
+		return NULL;
 	}
+	TIMING_PHASE(TIMING_C_ECHO, TIMING_P_VALIDATE, t);
 
-	/* send */
-	nl_socket_disable_auto_ack(nl_sk);
-	nl_send_auto(nl_sk, msg);
-
-	/* create callback system */
-	struct nl_cb *cb = nl_cb_alloc(NL_CB_DEBUG);
-	nl_cb_set(cb, NL_CB_MSG_IN, NL_CB_CUSTOM , nl_cb_echo_answer, NULL);
-	nl_recvmsgs(nl_sk, cb);
-	nl_cb_put(cb);
-
-
-	nlmsg_free(msg);
-
-	return 0;
+	return msg;
 
 nla_put_failure:
 	fprintf(stderr, "Attribute Modification failed: %d\n",-EMSGSIZE);
+	TIMING_END(TIMING_C_ECHO, 0, -EMSGSIZE);
+	return NULL;
+}
+
+int ce_gw_echo_reply(struct cegw_ctx *ctx, char *message, char *reply,
+                     size_t size)
+{
+	int rc; /* return codes */
+	struct nl_msg *msg;
+	struct echo_arg echo = { reply, size };
+
+	msg = ce_gw_echo_msg(ctx, message);
+	if (msg == NULL)
+		return -1;
+
+	/* create callback system */
+	reply[0] = '\0';
+	struct nl_cb *cb = transport_cb_alloc(ctx->transport, NL_CB_DEFAULT);
+	nl_cb_set(cb, NL_CB_MSG_IN, NL_CB_CUSTOM , nl_cb_echo_answer, &echo);
+
+	/* send and receive */
+	rc = ce_gw_send_recv(ctx, msg, cb);
+	TIMING_END(TIMING_C_ECHO, nlmsg_hdr(msg)->nlmsg_seq, rc < 0 ? rc : 0);
+	nl_cb_put(cb);
+
+	return rc < 0 ? -1 : 0;
+}
+
+int ce_gw_echo(struct cegw_ctx *ctx, char *message)
+{
+	char reply[ECHO_MAX];
+	int err;
+
+	err = ce_gw_echo_reply(ctx, message, reply, sizeof(reply));
+	if (err == 0)
+		printf("kernel says: %s\n", reply);
+
+	return err;
+}
+
+/** Longest blocking receive of ce_gw_ping() in ms, so stop and lost echoes
+ * are noticed */
+#define PING_TICK_MS 100
+
+/**
+ * @struct ping_slot
+ * @brief An outstanding echo of ce_gw_ping().
+ */
+struct ping_slot {
+	uint32_t seq;		/**< sequence number of the echo */
+	uint32_t nl_seq;	/**< netlink sequence number of the request */
+	uint64_t sent;		/**< send time in ns */
+	int used;		/**< 1 while waiting for the answer */
+};
+
+/**
+ * @struct ping_state
+ * @brief State of a running ce_gw_ping(). Passed to the ping callbacks.
+ */
+struct ping_state {
+	struct ping_slot *slots;	/**< ring with window entries */
+	unsigned int window;		/**< size of slots */
+	unsigned int pending;		/**< number of outstanding echoes */
+	ce_gw_ping_cb cb;		/**< called for every answer */
+	void *arg;			/**< passed to cb */
+};
+
+/**
+ * @fn void ping_done(struct ping_state *st, struct ping_slot *slot, int err,
+ *                    uint64_t rtt)
+ * @brief Frees the slot of an answered or lost echo and reports it.
+ */
+static void ping_done(struct ping_state *st, struct ping_slot *slot, int err,
+                      uint64_t rtt)
+{
+	slot->used = 0;
+	st->pending--;
+	st->cb(slot->seq, err, rtt, st->arg);
+}
+
+/**
+ * @fn int nl_cb_ping_reply(struct nl_msg *msg, void *arg)
+ * @brief Called for every echo reply, matches it by the sequence number in
+ *        its CE_GW_A_DATA and takes the round trip time from the send time
+ *        in it.
+ * @param msg Netlink Message
+ * @param arg the struct ping_state of the ping
+ * @retval NL_OK
+ * @ingroup cb
+ * @see defined as callback in ce_gw_ping()
+ */
+static int nl_cb_ping_reply(struct nl_msg *msg, void *arg)
+{
+	struct ping_state *st = arg;
+	struct nlmsghdr *hdr = nlmsg_hdr(msg);
+	struct nlattr *attrs[CE_GW_A_MAX + 1];
+	unsigned long long sent;
+	unsigned int seq;
+	uint64_t now = timing_now();
+
+	if (!genlmsg_valid_hdr(hdr, USER_HDR_SIZE) ||
+	    genlmsg_hdr(hdr)->cmd != CE_GW_C_ECHO ||
+	    genlmsg_parse(hdr, USER_HDR_SIZE, attrs, CE_GW_A_MAX,
+	                  ce_gw_genl_policy) < 0 ||
+	    attrs[CE_GW_A_DATA] == NULL ||
+	    sscanf(nla_data(attrs[CE_GW_A_DATA]), "%u %llu", &seq, &sent) != 2)
+		return NL_SKIP;
+
+	struct ping_slot *slot = &st->slots[seq % st->window];
+	if (!slot->used || slot->seq != seq || slot->sent != sent)
+		return NL_SKIP; /* late answer of a lost echo */
+
+	ping_done(st, slot, 0, now - sent);
+	return NL_OK;
+}
+
+/**
+ * @fn int nl_cb_ping_errno(struct sockaddr_nl *nla,
+ *                    struct nlmsgerr *nlerr, void *arg)
+ * @brief Called for every error returned for an echo.
+ * @param nla Socket address informations
+ * @param nlerr error Message
+ * @param arg the struct ping_state of the ping
+ * @retval NL_SKIP
+ * @ingroup cb
+ * @see defined as callback in ce_gw_ping()
+ */
+static int nl_cb_ping_errno(struct sockaddr_nl *nla,
+                            struct nlmsgerr *nlerr, void *arg)
+{
+	struct ping_state *st = arg;
+
+	for (unsigned int i = 0; i < st->window; ++i) {
+		struct ping_slot *slot = &st->slots[i];
+
+		if (slot->used && slot->nl_seq == nlerr->msg.nlmsg_seq) {
+			ping_done(st, slot, nlerr->error ? nlerr->error
+			          : -EPROTO, 0);
+			break;
+		}
+	}
+
+	return NL_SKIP;
+}
+
+/**
+ * @fn int ping_send(struct cegw_ctx *ctx, struct nl_msg *msg,
+ *                   struct ping_slot *slot, uint32_t seq, size_t size)
+ * @brief Builds and sends the echo seq with size bytes of data and fills
+ *        its slot.
+ * @retval >=0 on success
+ * @retval <0 libnl error code on failure
+ */
+static int ping_send(struct cegw_ctx *ctx, struct nl_msg *msg,
+                     struct ping_slot *slot, uint32_t seq, size_t size)
+{
+	char data[CE_GW_PING_MAX];
+	int err;
+
+	nlmsg_hdr(msg)->nlmsg_len = NLMSG_HDRLEN;
+	if (genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, ctx->family,
+	                USER_HDR_SIZE, NO_FLAG, CE_GW_C_ECHO,
+	                IFACE_VERSION) == NULL)
+		return -NLE_MSGSIZE;
+
+	slot->seq = seq;
+	slot->sent = timing_now();
+	int len = snprintf(data, size, "%u %llu ", seq,
+	                   (unsigned long long) slot->sent);
+	memset(data + len, '.', size - 1 - len);
+	data[size - 1] = '\0';
+
+	err = nla_put(msg, CE_GW_A_DATA, size, data);
+	if (err < 0)
+		return err;
+
+	err = ce_gw_send(ctx, msg);
+	if (err < 0)
+		return err;
+
+	slot->nl_seq = nlmsg_hdr(msg)->nlmsg_seq;
+	slot->used = 1;
+	return err;
+}
+
+int ce_gw_ping(struct cegw_ctx *ctx, const struct ce_gw_ping_opts *opts,
+               ce_gw_ping_cb cb, void *arg)
+{
+	struct ping_state st = { NULL, 0, 0, cb, arg };
+	struct timeval tick = { 0, PING_TICK_MS * 1000 };
+	struct timeval block = { 0, 0 };
+	struct nl_msg *msg = NULL;
+	struct nl_cb *nlcb = NULL;
+	uint64_t timeout = opts->timeout * 1e9;
+	uint64_t interval = opts->interval * 1e9;
+	uint64_t next = timing_now();
+	uint32_t sent = 0;
+	int fd = nl_socket_get_fd(ctx->sk);
+	int err = 0;
+
+	if (opts->size < CE_GW_PING_MIN || opts->size > CE_GW_PING_MAX)
+		return -NLE_INVAL;
+
+	st.window = opts->window ? opts->window : 1;
+	st.slots = calloc(st.window, sizeof(*st.slots));
+	msg = nlmsg_alloc_size(NLMSG_HDRLEN + GENL_HDRLEN + USER_HDR_SIZE +
+	                       nla_total_size(opts->size));
+	nlcb = transport_cb_alloc(ctx->transport, NL_CB_DEFAULT);
+	if (st.slots == NULL || msg == NULL || nlcb == NULL) {
+		err = -NLE_NOMEM;
+		goto out;
+	}
+	nl_cb_set(nlcb, NL_CB_VALID, NL_CB_CUSTOM, nl_cb_ping_reply, &st);
+	nl_cb_set(nlcb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, nl_cb_batch_seq, NULL);
+	nl_cb_err(nlcb, NL_CB_CUSTOM, nl_cb_ping_errno, &st);
+
+	/* the reply or the error, no ACK. A receive returns after a tick
+	 * at the latest */
+	nl_socket_disable_auto_ack(ctx->sk);
+	if (fd >= 0)
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tick, sizeof(tick));
+
+	while (opts->stop == NULL || !*opts->stop) {
+		uint64_t now = timing_now();
+		int more = opts->count == 0 || sent < opts->count;
+
+		if (!more && st.pending == 0)
+			break;
+
+		/* send the next echo when it is due and the window has room */
+		if (more && st.pending < st.window && now >= next) {
+			struct ping_slot *slot = &st.slots[(sent + 1) %
+			                                   st.window];
+			if (slot->used)
+				ping_done(&st, slot, -ETIMEDOUT, 0);
+
+			err = ping_send(ctx, msg, slot, sent + 1, opts->size);
+			if (err < 0)
+				goto out;
+
+			sent++;
+			st.pending++;
+			next = interval ? next + interval : now;
+			continue;
+		}
+
+		/* the echoes without an answer in time are lost */
+		for (unsigned int i = 0; i < st.window; ++i) {
+			struct ping_slot *slot = &st.slots[i];
+			if (slot->used && now - slot->sent >= timeout)
+				ping_done(&st, slot, -ETIMEDOUT, 0);
+		}
+
+		if (st.pending > 0) {
+			err = nl_recvmsgs(ctx->sk, nlcb);
+			if (err == -NLE_AGAIN)
+				err = 0;
+			if (err < 0)
+				goto out;
+		} else if (more && next > now) {
+			uint64_t wait = next - now;
+			struct timespec ts = { wait / 1000000000,
+			                       wait % 1000000000 };
+			nanosleep(&ts, NULL);
+		}
+	}
+
+	err = 0;
+
+out:
+	if (fd >= 0)
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &block, sizeof(block));
+	if (err < 0)
+		fprintf(stderr, "ping: Sending or receiving failed: %s\n",
+		        nl_geterror(err));
+	nl_cb_put(nlcb);
 	nlmsg_free(msg);
-	return -1;
+	free(st.slots);
+
+	return err < 0 ? err : (int) sent;
+}
+
+/** Initial size of the request table of the async API, a power of 2 */
+#define ASYNC_SLOTS 64
+
+/**
+ * @struct async_req
+ * @brief An outstanding add, del or echo of the async API.
+ */
+struct async_req {
+	uint32_t handle;	/**< returned by the submit, 0 if unused */
+	uint32_t seq;		/**< sequence number of the sent message */
+	uint8_t cmd;		/**< CE_GW_C_ADD, CE_GW_C_DEL or CE_GW_C_ECHO */
+	ce_gw_async_cb cb;	/**< called on completion */
+	void *arg;		/**< passed to cb */
+	int lost;		/**< 1 if its answer may be lost by an overrun */
+};
+
+/**
+ * @struct async_list
+ * @brief A list of the async API. A socket runs only one dump at a time,
+ *        so the lists wait in a queue until the ones before are done.
+ */
+struct async_list {
+	struct ce_gw_lister *lister;	/**< the request and its list_arg */
+	uint32_t handle;		/**< returned by the submit */
+	uint32_t seq;			/**< sequence number of the running dump */
+	int running;			/**< 1 once the request is sent */
+	int restarts;			/**< resumed dumps in a row without a
+					 * new route */
+	ce_gw_async_cb cb;		/**< called on completion */
+	void *arg;			/**< passed to cb and the route callback */
+	struct async_list *next;	/**< next in the queue */
+};
+
+/**
+ * @struct async_state
+ * @brief The async API of a context, allocated by ctx_async().
+ */
+struct async_state {
+	struct async_req *reqs;		/**< table indexed by seq & mask */
+	uint32_t mask;			/**< size of reqs - 1 */
+	unsigned int pending;		/**< outstanding adds, dels and echoes */
+	struct async_list *list;	/**< the running list, then the queue */
+	struct async_list *list_tail;	/**< last list of the queue */
+	unsigned int lists;		/**< number of lists in the queue */
+	uint32_t handle;		/**< last returned handle */
+	int completed;			/**< completions of this process call */
+	struct nl_cb *cb;		/**< callbacks of all answers */
+};
+
+/**
+ * @fn int async_insert(struct async_state *st, const struct async_req *req)
+ * @brief Stores req in the table of st. The table is doubled until the
+ *        sequence numbers of all outstanding requests fit without
+ *        collision.
+ * @retval 0 on success
+ * @retval -ENOMEM if the table could not be grown
+ */
+static int async_insert(struct async_state *st, const struct async_req *req)
+{
+	uint32_t size = st->mask + 1;
+	struct async_req *reqs;
+
+	if (!st->reqs[req->seq & st->mask].handle) {
+		st->reqs[req->seq & st->mask] = *req;
+		return 0;
+	}
+
+grow:
+	size *= 2;
+	if (size == 0)
+		return -ENOMEM;
+	reqs = calloc(size, sizeof(*reqs));
+	if (reqs == NULL)
+		return -ENOMEM;
+
+	reqs[req->seq & (size - 1)] = *req;
+	for (uint32_t i = 0; i <= st->mask; ++i) {
+		struct async_req *r = &st->reqs[i];
+		struct async_req *slot = &reqs[r->seq & (size - 1)];
+
+		if (!r->handle)
+			continue;
+		if (slot->handle) {
+			free(reqs);
+			goto grow;
+		}
+		*slot = *r;
+	}
+
+	free(st->reqs);
+	st->reqs = reqs;
+	st->mask = size - 1;
+	return 0;
+}
+
+/**
+ * @fn struct async_req *async_find(struct async_state *st, uint32_t seq)
+ * @brief Returns the outstanding request with sequence number seq or NULL.
+ */
+static struct async_req *async_find(struct async_state *st, uint32_t seq)
+{
+	struct async_req *req = &st->reqs[seq & st->mask];
+
+	return req->handle && req->seq == seq ? req : NULL;
+}
+
+/**
+ * @fn void async_done(struct async_state *st, struct async_req *req,
+ *                     int err, const char *echo)
+ * @brief Frees the slot of a completed request and reports it. The slot is
+ *        free before the callback, which may submit the next request.
+ */
+static void async_done(struct async_state *st, struct async_req *req,
+                       int err, const char *echo)
+{
+	struct async_req done = *req;
+
+	req->handle = 0;
+	st->pending--;
+	st->completed++;
+	done.cb(done.handle, err, echo, done.arg);
+}
+
+/**
+ * @fn uint32_t async_handle(struct async_state *st)
+ * @brief Returns the next request handle, never 0.
+ */
+static uint32_t async_handle(struct async_state *st)
+{
+	if (++st->handle == 0)
+		++st->handle;
+
+	return st->handle;
+}
+
+/**
+ * @fn int async_list_send(struct cegw_ctx *ctx, struct async_list *list)
+ * @brief Sends the request of list with a new sequence number.
+ * @retval >=0 on success
+ * @retval <0 libnl error code on failure
+ */
+static int async_list_send(struct cegw_ctx *ctx, struct async_list *list)
+{
+	struct nl_msg *msg = list->lister->msg;
+	int err;
+
+	list->lister->list.intr = 0;
+	ctx->dump.dumps++;
+	fam_msg_update(ctx, msg);
+
+	/* the answer ends with NLMSG_DONE, no ACK */
+	nl_socket_disable_auto_ack(ctx->sk);
+	err = ce_gw_send(ctx, msg);
+	if (err >= 0) {
+		list->seq = nlmsg_hdr(msg)->nlmsg_seq;
+		list->running = 1;
+	}
+
+	return err;
+}
+
+/**
+ * @fn void async_list_done(struct cegw_ctx *ctx, struct async_state *st,
+ *                          int err)
+ * @brief Reports the running list and sends the next of the queue. A list
+ *        which cannot be sent is reported with -EIO.
+ */
+static void async_list_done(struct cegw_ctx *ctx, struct async_state *st,
+                            int err)
+{
+	struct async_list *list = st->list;
+
+	st->list = list->next;
+	if (st->list == NULL)
+		st->list_tail = NULL;
+	st->lists--;
+	st->completed++;
+
+	TIMING_END(TIMING_C_LIST, list->seq, err);
+	list->cb(list->handle, err, NULL, list->arg);
+	ce_gw_lister_free(list->lister);
+	free(list);
+
+	/* the callback may have queued another list */
+	if (st->list != NULL && !st->list->running &&
+	    async_list_send(ctx, st->list) < 0)
+		async_list_done(ctx, st, -EIO);
+}
+
+/**
+ * @fn void async_list_resume(struct cegw_ctx *ctx, struct async_state *st,
+ *                            int err)
+ * @brief Sends the running list again behind the last passed route, like
+ *        ce_gw_lister_run(). The rest of the old answer is ignored, it has
+ *        another sequence number. Reports the list with err if the routes
+ *        are not sorted or CE_GW_DUMP_RETRIES resumes in a row brought no
+ *        new route.
+ */
+static void async_list_resume(struct cegw_ctx *ctx, struct async_state *st,
+                              int err)
+{
+	struct async_list *list = st->list;
+	struct list_arg *la = &list->lister->list;
+
+	if (la->last_id > la->skip)
+		list->restarts = 0;
+	if (!la->sorted || list->restarts++ == CE_GW_DUMP_RETRIES) {
+		fprintf(stderr, "list: Dump was interrupted %d times in a row, "
+		        "the routes are incomplete\n", list->restarts);
+		async_list_done(ctx, st, err);
+		return;
+	}
+
+	ctx->dump.restarts++;
+	la->skip = la->last_id;
+	if (async_list_send(ctx, list) < 0)
+		async_list_done(ctx, st, -EIO);
+}
+
+/**
+ * @fn void async_overrun(struct cegw_ctx *ctx, struct async_state *st)
+ * @brief Handles an overrun (ENOBUFS) of the socket, which may have lost
+ *        any answer: the outstanding adds, dels and echoes complete with
+ *        -ENOBUFS, as they cannot be sent again safely, and the running
+ *        list is resumed.
+ */
+static void async_overrun(struct cegw_ctx *ctx, struct async_state *st)
+{
+	ctx->dump.overruns++;
+
+	/* not the requests the callbacks submit */
+	for (uint32_t i = 0; i <= st->mask; ++i)
+		st->reqs[i].lost = st->reqs[i].handle != 0;
+
+	uint32_t i = 0;
+	while (i <= st->mask) {
+		struct async_req *reqs = st->reqs;
+
+		if (reqs[i].handle && reqs[i].lost) {
+			async_done(st, &reqs[i], -ENOBUFS, NULL);
+
+			/* the callback grew the table, search it again */
+			if (st->reqs != reqs) {
+				i = 0;
+				continue;
+			}
+		}
+		i++;
+	}
+
+	if (st->list != NULL && st->list->running)
+		async_list_resume(ctx, st, -ENOBUFS);
+}
+
+/**
+ * @fn struct async_list *async_list_find(struct async_state *st,
+ *                                        uint32_t seq)
+ * @brief Returns the running list if its sequence number is seq or NULL.
+ */
+static struct async_list *async_list_find(struct async_state *st,
+                                          uint32_t seq)
+{
+	struct async_list *list = st->list;
+
+	return list != NULL && list->running && list->seq == seq ? list : NULL;
+}
+
+/**
+ * @fn int nl_cb_async_valid(struct nl_msg *msg, void *arg)
+ * @brief Called for every route of a list and every echo reply of the async
+ *        API. The routes are passed on with nl_cb_list_entry(), an echo
+ *        completes with its CE_GW_A_DATA.
+ * @param msg Netlink Message
+ * @param arg the struct cegw_ctx
+ * @retval NL_OK
+ * @ingroup cb
+ * @see defined as callback in ctx_async()
+ */
+static int nl_cb_async_valid(struct nl_msg *msg, void *arg)
+{
+	struct cegw_ctx *ctx = arg;
+	struct async_state *st = ctx->async;
+	struct nlmsghdr *hdr = nlmsg_hdr(msg);
+	struct async_list *list = async_list_find(st, hdr->nlmsg_seq);
+	struct nlattr *attrs[CE_GW_A_MAX + 1];
+
+	if (list != NULL) {
+		nl_cb_list_in(msg, &list->lister->list);
+		nl_cb_list_entry(msg, &list->lister->list);
+		return NL_OK;
+	}
+
+	struct async_req *req = async_find(st, hdr->nlmsg_seq);
+	if (req == NULL || req->cmd != CE_GW_C_ECHO)
+		return NL_OK;
+
+	if (genlmsg_parse(hdr, USER_HDR_SIZE, attrs, CE_GW_A_MAX,
+	                  ce_gw_genl_policy) < 0 ||
+	    attrs[CE_GW_A_DATA] == NULL)
+		async_done(st, req, -EPROTO, NULL);
+	else
+		async_done(st, req, 0, nla_data(attrs[CE_GW_A_DATA]));
+
+	return NL_OK;
+}
+
+/**
+ * @fn int nl_cb_async_ack(struct nl_msg *msg, void *arg)
+ * @brief Called for every ACK, completes the add or del of the async API.
+ * @param msg Netlink Message
+ * @param arg the struct cegw_ctx
+ * @retval NL_OK
+ * @ingroup cb
+ * @see defined as callback in ctx_async()
+ */
+static int nl_cb_async_ack(struct nl_msg *msg, void *arg)
+{
+	struct cegw_ctx *ctx = arg;
+	struct async_req *req = async_find(ctx->async,
+	                                   nlmsg_hdr(msg)->nlmsg_seq);
+
+	if (req != NULL && req->cmd != CE_GW_C_ECHO)
+		async_done(ctx->async, req, 0, NULL);
+
+	return NL_OK;
+}
+
+/**
+ * @fn int nl_cb_async_errno(struct sockaddr_nl *nla,
+ *                    struct nlmsgerr *nlerr, void *arg)
+ * @brief Called for every error, completes the request of the async API it
+ *        belongs to.
+ * @param nla Socket address informations
+ * @param nlerr error Message
+ * @param arg the struct cegw_ctx
+ * @retval NL_SKIP
+ * @ingroup cb
+ * @see defined as callback in ctx_async()
+ */
+static int nl_cb_async_errno(struct sockaddr_nl *nla,
+                             struct nlmsgerr *nlerr, void *arg)
+{
+	struct cegw_ctx *ctx = arg;
+	struct async_state *st = ctx->async;
+	uint32_t seq = nlerr->msg.nlmsg_seq;
+	int err = nlerr->error ? nlerr->error : -EPROTO;
+
+	if (async_list_find(st, seq) != NULL) {
+		async_list_done(ctx, st, err);
+	} else {
+		struct async_req *req = async_find(st, seq);
+
+		/* maybe an interface index of a device which is gone, the
+		 * next adds use names, see ctx_ifcache() */
+		if (req != NULL && req->cmd == CE_GW_C_ADD && err == -ENODEV)
+			ifcache_free(&ctx->ifc);
+		if (req != NULL)
+			async_done(st, req, err, NULL);
+	}
+
+	return NL_SKIP;
+}
+
+/**
+ * @fn int nl_cb_async_finish(struct nl_msg *msg, void *arg)
+ * @brief Called at the end of a dump. Completes the list, or resumes it
+ *        behind the last passed route if it was interrupted, like
+ *        ce_gw_lister_run().
+ * @param msg Netlink Message
+ * @param arg the struct cegw_ctx
+ * @retval NL_OK so that the rest of the buffer is processed
+ * @ingroup cb
+ * @see defined as callback in ctx_async()
+ */
+static int nl_cb_async_finish(struct nl_msg *msg, void *arg)
+{
+	struct cegw_ctx *ctx = arg;
+	struct async_state *st = ctx->async;
+	struct async_list *list = async_list_find(st,
+	                                          nlmsg_hdr(msg)->nlmsg_seq);
+
+	if (list == NULL)
+		return NL_OK;
+
+	struct list_arg *la = &list->lister->list;
+	if (!la->intr || la->err != 0)
+		async_list_done(ctx, st, la->err);
+	else
+		async_list_resume(ctx, st, -EINTR);
+
+	return NL_OK;
+}
+
+/**
+ * @fn int nl_cb_async_intr(struct nl_msg *msg, void *arg)
+ * @brief Called for every message with NLM_F_DUMP_INTR, marks the running
+ *        list like nl_cb_list_intr().
+ * @param msg Netlink Message
+ * @param arg the struct cegw_ctx
+ * @retval NL_OK
+ * @ingroup cb
+ * @see defined as callback in ctx_async()
+ */
+static int nl_cb_async_intr(struct nl_msg *msg, void *arg)
+{
+	struct cegw_ctx *ctx = arg;
+	struct async_list *list = async_list_find(ctx->async,
+	                                          nlmsg_hdr(msg)->nlmsg_seq);
+
+	if (list != NULL)
+		list->lister->list.intr = 1;
+
+	return NL_OK;
+}
+
+/**
+ * @fn struct async_state *ctx_async(struct cegw_ctx *ctx)
+ * @brief Returns the async API of ctx, set up on the first call: the table,
+ *        the callbacks, the interface cache and a non-blocking socket.
+ * @retval NULL if the allocation failed
+ * @ingroup net
+ */
+static struct async_state *ctx_async(struct cegw_ctx *ctx)
+{
+	struct async_state *st = ctx->async;
+
+	if (st != NULL)
+		return st;
+
+	st = calloc(1, sizeof(*st));
+	if (st == NULL)
+		return NULL;
+	st->mask = ASYNC_SLOTS - 1;
+	st->reqs = calloc(ASYNC_SLOTS, sizeof(*st->reqs));
+	st->cb = transport_cb_alloc(ctx->transport, NL_CB_DEFAULT);
+	if (st->reqs == NULL || st->cb == NULL) {
+		fprintf(stderr, "async: Allocation failed.\n");
+		if (st->cb != NULL)
+			nl_cb_put(st->cb);
+		free(st->reqs);
+		free(st);
+		return NULL;
+	}
+
+	nl_cb_set(st->cb, NL_CB_VALID, NL_CB_CUSTOM, nl_cb_async_valid, ctx);
+	nl_cb_set(st->cb, NL_CB_ACK, NL_CB_CUSTOM, nl_cb_async_ack, ctx);
+	nl_cb_set(st->cb, NL_CB_FINISH, NL_CB_CUSTOM, nl_cb_async_finish, ctx);
+	nl_cb_set(st->cb, NL_CB_DUMP_INTR, NL_CB_CUSTOM, nl_cb_async_intr,
+	          ctx);
+	nl_cb_set(st->cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, nl_cb_batch_seq, NULL);
+	nl_cb_err(st->cb, NL_CB_CUSTOM, nl_cb_async_errno, ctx);
+
+	/* the last blocking link dump, see ctx_ifcache() */
+	ctx_ifcache(ctx);
+
+	/* the mock has no file descriptor and never blocks */
+	if (nl_socket_get_fd(ctx->sk) >= 0)
+		nl_socket_set_nonblocking(ctx->sk);
+
+	ctx->async = st;
+	return st;
+}
+
+/**
+ * @fn void async_free(struct async_state *st)
+ * @brief Frees the async API of a context. Outstanding requests are
+ *        dropped without calling their callbacks.
+ */
+static void async_free(struct async_state *st)
+{
+	if (st == NULL)
+		return;
+
+	while (st->list != NULL) {
+		struct async_list *list = st->list;
+
+		st->list = list->next;
+		ce_gw_lister_free(list->lister);
+		free(list);
+	}
+	nl_cb_put(st->cb);
+	free(st->reqs);
+	free(st);
+}
+
+/**
+ * @fn int async_submit(struct cegw_ctx *ctx, struct nl_msg *msg,
+ *                      enum timing_cmd tcmd, ce_gw_async_cb cb, void *arg,
+ *                      uint32_t *handle)
+ * @brief Sends a built add, del or echo msg and stores it as outstanding.
+ *        An echo is answered by its reply, the others by the ACK.
+ * @retval 0 on success
+ * @retval <0 libnl error code on failure
+ */
+static int async_submit(struct cegw_ctx *ctx, struct nl_msg *msg,
+                        enum timing_cmd tcmd, ce_gw_async_cb cb, void *arg,
+                        uint32_t *handle)
+{
+	struct async_state *st = ctx->async;
+	struct async_req req;
+	int err;
+
+	if (msg == NULL) {
+		/* ce_gw_echo_msg() ends its record itself */
+		if (tcmd != TIMING_C_ECHO)
+			TIMING_END(tcmd, 0, -EINVAL);
+		return -NLE_INVAL;
+	}
+
+	req.cmd = genlmsg_hdr(nlmsg_hdr(msg))->cmd;
+	req.cb = cb;
+	req.arg = arg;
+	req.lost = 0;
+
+	if (req.cmd == CE_GW_C_ECHO)
+		nl_socket_disable_auto_ack(ctx->sk);
+	else
+		nl_socket_enable_auto_ack(ctx->sk);
+
+	/* the slot is taken before sending, so that no answer comes
+	 * without one. It is read by ce_gw_async_process() */
+	req.seq = nl_socket_use_seq(ctx->sk);
+	nlmsg_hdr(msg)->nlmsg_seq = req.seq;
+	req.handle = async_handle(st);
+	if (async_insert(st, &req) != 0) {
+		fprintf(stderr, "async: Allocation failed.\n");
+		TIMING_END(tcmd, req.seq, -ENOMEM);
+		return -NLE_NOMEM;
+	}
+
+	err = ce_gw_send(ctx, msg);
+	TIMING_END(tcmd, req.seq, err < 0 ? err : 0);
+	if (err < 0) {
+		async_find(st, req.seq)->handle = 0;
+		return err;
+	}
+	st->pending++;
+
+	if (handle != NULL)
+		*handle = req.handle;
+	return 0;
+}
+
+int ce_gw_async_fd(struct cegw_ctx *ctx)
+{
+	if (ctx_async(ctx) == NULL)
+		return -NLE_NOMEM;
+
+	return nl_socket_get_fd(ctx->sk);
+}
+
+int ce_gw_async_add(struct cegw_ctx *ctx, char *dst_name, char *src_name,
+                    uint8_t type, uint32_t flags, ce_gw_async_cb cb,
+                    void *arg, uint32_t *handle)
+{
+	if (ctx_async(ctx) == NULL)
+		return -NLE_NOMEM;
+
+	return async_submit(ctx, ce_gw_add_msg(ctx, dst_name, src_name, type,
+	                                       flags),
+	                    TIMING_C_ADD, cb, arg, handle);
+}
+
+int ce_gw_async_del(struct cegw_ctx *ctx, uint32_t id, char *dev_name,
+                    ce_gw_async_cb cb, void *arg, uint32_t *handle)
+{
+	if (id != 0 && dev_name != NULL)
+		return -NLE_INVAL;
+	if (ctx_async(ctx) == NULL)
+		return -NLE_NOMEM;
+
+	return async_submit(ctx, ce_gw_del_msg(ctx, id, dev_name),
+	                    TIMING_C_DEL, cb, arg, handle);
+}
+
+int ce_gw_async_echo(struct cegw_ctx *ctx, char *message, ce_gw_async_cb cb,
+                     void *arg, uint32_t *handle)
+{
+	if (ctx_async(ctx) == NULL)
+		return -NLE_NOMEM;
+
+	return async_submit(ctx, ce_gw_echo_msg(ctx, message), TIMING_C_ECHO,
+	                    cb, arg, handle);
+}
+
+int ce_gw_async_list(struct cegw_ctx *ctx, uint32_t id,
+                     const struct ce_gw_route_filter *filter,
+                     ce_gw_route_cb route_cb, ce_gw_async_cb cb, void *arg,
+                     uint32_t *handle)
+{
+	struct async_state *st = ctx_async(ctx);
+	struct async_list *list;
+	struct list_arg *la;
+	int err;
+
+	if (st == NULL)
+		return -NLE_NOMEM;
+
+	list = calloc(1, sizeof(*list));
+	if (list == NULL)
+		return -NLE_NOMEM;
+
+	list->lister = ce_gw_lister_alloc(ctx, id);
+	if (list->lister == NULL) {
+		free(list);
+		return -NLE_NOMEM;
+	}
+	err = ce_gw_lister_filter(list->lister, filter);
+	if (err < 0) {
+		ce_gw_lister_free(list->lister);
+		free(list);
+		return err;
+	}
+
+	la = &list->lister->list;
+	la->cb = route_cb;
+	la->arg = arg;
+	la->sorted = 1;
+	list->cb = cb;
+	list->arg = arg;
+	list->handle = async_handle(st);
+
+	/* behind the running list, see async_list_done() */
+	if (st->list == NULL) {
+		err = async_list_send(ctx, list);
+		if (err < 0) {
+			TIMING_END(TIMING_C_LIST, 0, err);
+			ce_gw_lister_free(list->lister);
+			free(list);
+			return err;
+		}
+		st->list = list;
+	} else {
+		st->list_tail->next = list;
+	}
+	st->list_tail = list;
+	st->lists++;
+
+	if (handle != NULL)
+		*handle = list->handle;
+	return 0;
+}
+
+int ce_gw_async_process(struct cegw_ctx *ctx)
+{
+	struct async_state *st = ctx->async;
+	int err;
+
+	if (st == NULL)
+		return 0;
+
+	st->completed = 0;
+	for (;;) {
+		err = nl_recvmsgs_report(ctx->sk, st->cb);
+
+		/* answers were lost (ENOBUFS, which libnl reports as
+		 * NLE_NOMEM), read on behind them */
+		if (err == -NLE_NOMEM) {
+			async_overrun(ctx, st);
+		} else if (err == -NLE_AGAIN) {
+			break;
+		} else if (err < 0) {
+			fprintf(stderr, "async: Receiving failed: %s\n",
+			        nl_geterror(err));
+			return err;
+		}
+	}
+
+	return st->completed;
 }
 
+unsigned int ce_gw_async_pending(const struct cegw_ctx *ctx)
+{
+	const struct async_state *st = ctx->async;
+
+	return st != NULL ? st->pending + st->lists : 0;
+}
 
-int nl_sk_fam_init(void)
+/**
+ * @struct event_arg
+ * @brief Argument of nl_cb_event(). See ce_gw_monitor().
+ */
+struct event_arg {
+	ce_gw_event_cb cb;	/**< called for every event */
+	void *arg;		/**< passed to cb */
+	int err;		/**< != 0 if cb stopped monitoring */
+};
+
+/**
+ * @fn int nl_cb_event(struct nl_msg *msg, void *arg)
+ * @brief will be called for every message of the multicast group and
+ *        passes CE_GW_C_EVENT messages to the callback of ce_gw_monitor().
+ * @param msg Netlink Message
+ * @raram arg a struct event_arg
+ * @retval NL_OK
+ * @retval NL_STOP if the callback stopped monitoring
+ * @ingroup cb
+ * @see defined as callback in ce_gw_monitor()
+ */
+int nl_cb_event(struct nl_msg *msg, void *arg)
+{
+	struct event_arg *ev_arg = arg;
+	struct nlmsghdr *msghdr = nlmsg_hdr(msg);
+	struct nlattr *attrs[CE_GW_A_MAX+1];
+	struct ce_gw_event event;
+
+	if (!genlmsg_valid_hdr(msghdr, USER_HDR_SIZE) ||
+	    genlmsg_hdr(msghdr)->cmd != CE_GW_C_EVENT)
+		return NL_SKIP;
+
+	if (genlmsg_parse(msghdr, USER_HDR_SIZE, attrs, CE_GW_A_MAX,
+	                  ce_gw_genl_policy) < 0) {
+		fprintf(stderr, "ERROR Kernel Message Parsing Failed\n");
+		return NL_SKIP;
+	}
+
+	route_parse(attrs, &event.route, NULL);
+	event.event = attrs[CE_GW_A_EVENT] ? nla_get_u8(attrs[CE_GW_A_EVENT])
+	              : CE_GW_E_UNSPEC;
+	event.time = attrs[CE_GW_A_TIME] ? nla_get_u64(attrs[CE_GW_A_TIME])
+	             : 0;
+
+	ev_arg->err = ev_arg->cb(&event, ev_arg->arg);
+	if (ev_arg->err != 0)
+		return NL_STOP;
+
+	return NL_OK;
+}
+
+/**
+ * @fn int monitor_connect(struct nl_sock *sk)
+ * @brief Connects sk and joins the event group, either of CE_GW or of
+ *        NETLINK_USERSOCK if CE_GW_EVENT_USERSOCK_ENV is set.
+ * @retval 0 on success
+ * @retval <0 libnl error code on failure
+ * @ingroup net
+ */
+static int monitor_connect(struct nl_sock *sk)
+{
+	int err, group;
+	const char *usersock = getenv(CE_GW_EVENT_USERSOCK_ENV);
+
+	if (usersock != NULL) {
+		group = atoi(usersock);
+		if (group <= 0)
+			return -NLE_INVAL;
+
+		err = nl_connect(sk, NETLINK_USERSOCK);
+	} else {
+		err = genl_connect(sk);
+		if (err == 0) {
+			group = genl_ctrl_resolve_grp(sk, GE_FAMILY_NAME,
+			                              CE_GW_MCGRP_EVENTS);
+			if (group < 0)
+				err = group;
+		}
+	}
+
+	if (err == 0)
+		err = nl_socket_add_membership(sk, group);
+
+	return err;
+}
+
+int ce_gw_monitor(ce_gw_event_cb event_cb, void *arg)
 {
 	int err;
+	struct event_arg ev_arg = { event_cb, arg, 0 };
+	struct nl_sock *sk;
+
+	sk = nl_socket_alloc();
+	if (sk == NULL) {
+		fprintf(stderr, "monitor: Socket allocation failed.\n");
+		return -1;
+	}
+
+	err = monitor_connect(sk);
+	if (err != 0) {
+		fprintf(stderr, "monitor: Can not join the group %s of %s: "
+		        "%s\n", CE_GW_MCGRP_EVENTS, GE_FAMILY_NAME,
+		        nl_geterror(err));
+		nl_socket_free(sk);
+		return -1;
+	}
+
+	/* events are not answers, they have no sequence number */
+	nl_socket_disable_seq_check(sk);
+	nl_socket_modify_cb(sk, NL_CB_VALID, NL_CB_CUSTOM, nl_cb_event,
+	                    &ev_arg);
+	nl_socket_set_nonblocking(sk);
+
+	struct pollfd pfd = { .fd = nl_socket_get_fd(sk), .events = POLLIN };
+
+	while (ev_arg.err == 0) {
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		/* read everything which arrived, then print it at once */
+		do {
+			err = nl_recvmsgs_default(sk);
+		} while (err >= 0 && ev_arg.err == 0);
+		fflush(stdout);
+
+		if (err == -NLE_AGAIN) {
+			err = 0;
+		} else if (err < 0 && ev_arg.err == 0) {
+			/* e.g. ENOBUFS, events were lost. Go on. */
+			fprintf(stderr, "monitor: %s\n", nl_geterror(err));
+			err = 0;
+		}
+	}
+
+	nl_close(sk);
+	nl_socket_free(sk);
+
+	return ev_arg.err != 0 ? ev_arg.err : err;
+}
+
+int ce_gw_event_print(const struct ce_gw_event *event, void *arg)
+{
+	const struct ce_gw_route *route = &event->route;
+	struct timespec ts;
+	struct tm tm;
+	char time_str[32];
+	char flags_str[256];
+	const char *name, *type_str;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	localtime_r(&ts.tv_sec, &tm);
+	strftime(time_str, sizeof(time_str), "%F %T", &tm);
+
+	name = enum2str(event->event, event_array, CE_GW_E_MAX);
+	type_str = enum2str(route->type, type_array, TYPE_MAX);
+	flags2str(route->flags, flags_array, flags_str, sizeof(flags_str));
+
+	printf("[%s.%03ld] %-9s ", time_str, ts.tv_nsec / 1000000,
+	       name ? name : "?");
+
+	switch (event->event) {
+	case CE_GW_E_ROUTE_ADD:
+	case CE_GW_E_ROUTE_DEL:
+		printf("id %u %s -> %s %s %s\n", route->id, route->src,
+		       route->dst, type_str ? type_str : "?", flags_str);
+		break;
+	case CE_GW_E_DEV_ADD:
+	case CE_GW_E_DEV_DEL:
+		printf("dev %s %s %s\n", route->dst,
+		       type_str ? type_str : "?", flags_str);
+		break;
+	case CE_GW_E_DROP:
+		printf("id %u %s -> %s handled %u dropped %u\n", route->id,
+		       route->src, route->dst, route->handled,
+		       route->dropped);
+		break;
+	default:
+		printf("id %u\n", route->id);
+		break;
+	}
+
+	return 0;
+}
+
+struct nl_msg *ce_gw_event_msg(const struct ce_gw_event *event,
+                               int family_id)
+{
+	const struct ce_gw_route *route = &event->route;
+	struct nl_msg *msg;
+
+	msg = nlmsg_alloc();
+	if (msg == NULL)
+		return NULL;
+
+	if (genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, family_id,
+	                USER_HDR_SIZE, NO_FLAG, CE_GW_C_EVENT,
+	                IFACE_VERSION) == NULL)
+		goto nla_put_failure;
+
+	NLA_PUT_U8(msg, CE_GW_A_EVENT, event->event);
+	if (event->time != 0)
+		NLA_PUT_U64(msg, CE_GW_A_TIME, event->time);
+	if (route->id != 0)
+		NLA_PUT_U32(msg, CE_GW_A_ID, route->id);
+	if (route->src[0] != '\0')
+		NLA_PUT_STRING(msg, CE_GW_A_SRC, route->src);
+	if (route->dst[0] != '\0')
+		NLA_PUT_STRING(msg, CE_GW_A_DST, route->dst);
+	NLA_PUT_U8(msg, CE_GW_A_TYPE, route->type);
+	NLA_PUT_U32(msg, CE_GW_A_FLAGS, route->flags);
+	if (event->event == CE_GW_E_DROP) {
+		NLA_PUT_U32(msg, CE_GW_A_HNDL, route->handled);
+		NLA_PUT_U32(msg, CE_GW_A_DROP, route->dropped);
+	}
+
+	return msg;
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return NULL;
+}
+
+
+struct cegw_ctx *cegw_ctx_alloc(void)
+{
+	int err;
+	struct cegw_ctx *ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		fprintf(stderr, "Context allocation failed.\n");
+		return NULL;
+	}
+
+	/* the kernel or the mock, see transport.h */
+	ctx->transport = transport_select(NULL);
+	if (ctx->transport == NULL) {
+		fprintf(stderr, "Unknown transport in %s\n", TRANSPORT_ENV);
+		free(ctx);
+		return NULL;
+	}
 
 	/* create gneric netlink socket */
-	nl_sk = nl_socket_alloc();
-	if ( nl_sk == NULL ) {
+	ctx->sk = nl_socket_alloc();
+	ctx->msg = nlmsg_alloc();
+	if (ctx->sk == NULL || ctx->msg == NULL) {
 		fprintf (stderr, "Socket allocation failed.\n");
-		return -1;
+		goto failure;
 	}
 
-	err = genl_connect(nl_sk);
+	err = ctx->transport->open(ctx->sk);
 	if (err != 0) {
 		fprintf (stderr, "Connetion to socket failed: %d\n", err);
-		return err;
+		goto failure;
+	}
+
+	/* a dump must neither overrun the socket nor be truncated by a too
+	 * small buffer of nl_recv(). The mock has no file descriptor */
+	int fd = nl_socket_get_fd(ctx->sk);
+	if (fd >= 0) {
+		const char *rcvbuf = getenv(CE_GW_RCVBUF_ENV);
+		int size = rcvbuf ? atoi(rcvbuf) : CE_GW_RCVBUF;
+		socklen_t len = sizeof(ctx->dump.rcvbuf);
+
+		/* SO_RCVBUF is capped at net.core.rmem_max, SO_RCVBUFFORCE
+		 * is not but needs CAP_NET_ADMIN */
+		if (nl_socket_set_buffer_size(ctx->sk, size, 0) != 0)
+			fprintf(stderr, "Receive buffer of %d bytes could not "
+			        "be set, large dumps may overrun\n", size);
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size,
+		           sizeof(size));
+		getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &ctx->dump.rcvbuf,
+		           &len);
 	}
+	nl_socket_set_msg_buf_size(ctx->sk, CE_GW_MSG_BUFSIZE);
 
-	err = nl_socket_modify_err_cb(nl_sk, NL_CB_CUSTOM,
-	                              nl_cb_general_errno, NULL);
+	err = nl_socket_modify_err_cb(ctx->sk, NL_CB_CUSTOM,
+	                              nl_cb_general_errno, ctx);
+	if (err == 0)
+		err = nl_socket_modify_cb(ctx->sk, NL_CB_SEQ_CHECK,
+		                          NL_CB_CUSTOM, nl_cb_seq_check, ctx);
 	if (err != 0) {
 		fprintf (stderr, "Error Callback modification failed: %d\n",
 		         err);
 	}
 
-	/* create generic netlink family */
-	genl_fam = genl_family_alloc();
-	if (genl_fam == NULL) {
-		fprintf (stderr, "Family allocation failed.\n");
-		return -1;
+	/* the ID of the last run saves the round trip to the controller. If
+	 * it is outdated anyway, the requests call fam_retry() */
+	int id, version;
+	if (!ctx->transport->cache_family ||
+	    famcache_read(&id, &version) != 0) {
+		err = fam_resolve(ctx, &id, &version);
+		if (err < 0) {
+			fprintf(stderr,
+			        "Could not resolve Netlink Family ID from kernel. "
+			        "Is the module loaded?: %d\n", err);
+			ctx->transport->close(ctx->sk);
+			goto failure;
+		}
+
+		if (ctx->transport->cache_family)
+			famcache_write(id, version);
 	}
 
-	genl_family_set_name(genl_fam, GE_FAMILY_NAME);
-	genl_family_set_version(genl_fam, GE_FAMILY_VERSION);
-	genl_family_set_maxattr(genl_fam, CE_GW_A_MAX);
-	genl_family_set_hdrsize(genl_fam, USER_HDR_SIZE);
+	ctx->family = id;
+	ctx->version = version;
 
-	genl_family_set_id(genl_fam,
-	                   (err = genl_ctrl_resolve(nl_sk, GE_FAMILY_NAME)));
-	if (err < 0) {
-		fprintf(stderr,
-		        "Could not resolve Netlink Family ID from kernel. "
-		        "Is the module loaded?: %d\n", err);
-		return err;
-	}
+	return ctx;
 
-	return 0;
+failure:
+	nlmsg_free(ctx->msg);
+	nl_socket_free(ctx->sk);
+	free(ctx);
+	return NULL;
+}
+
+void cegw_ctx_free(struct cegw_ctx *ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	ctx->transport->close(ctx->sk);
+	nlmsg_free(ctx->msg);
+	nl_socket_free(ctx->sk);
+	ifcache_free(&ctx->ifc);
+	async_free(ctx->async);
+	free(ctx);
 }
 
+const char *cegw_ctx_transport(const struct cegw_ctx *ctx)
+{
+	return ctx->transport->name;
+}
 
-void nl_sk_fam_exit(void)
+const struct ce_gw_dump_stats *cegw_ctx_dump_stats(
+                                            const struct cegw_ctx *ctx)
 {
-	nl_close(nl_sk);
-	genl_family_put(genl_fam);
-	nl_socket_free(nl_sk);
+	return &ctx->dump;
 }
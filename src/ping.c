@@ -0,0 +1,247 @@
+/**
+ * @file ping.c
+ * @brief Control Area Network - Ethernet - Gateway - Ping (Utility)
+ * @details Option parsing and output of "cegwctl ping".
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "netlink.h"
+#include "hist.h"
+#include "ping.h"
+
+/** set by SIGINT, ends the ping */
+static volatile sig_atomic_t ping_stop;
+
+/**
+ * @fn void ping_sigint(int sig)
+ * @brief Handler of SIGINT.
+ */
+static void ping_sigint(int sig)
+{
+	ping_stop = 1;
+}
+
+/**
+ * @struct ping_result
+ * @brief Counters of ping_main(), the argument of ping_reply().
+ */
+struct ping_result {
+	struct hist rtt;	/**< round trip times in ns */
+	unsigned int errors;	/**< echoes answered with an error */
+	unsigned int lost;	/**< echoes without an answer */
+	size_t size;		/**< data bytes of an echo */
+	int quiet;		/**< 1 in flood mode */
+};
+
+/**
+ * @fn void ping_reply(uint32_t seq, int err, uint64_t rtt, void *arg)
+ * @brief Records and prints one answered or lost echo.
+ */
+static void ping_reply(uint32_t seq, int err, uint64_t rtt, void *arg)
+{
+	struct ping_result *r = arg;
+
+	if (err == 0) {
+		hist_record(&r->rtt, rtt);
+		if (!r->quiet)
+			printf("%zu bytes from ce_gw: seq=%" PRIu32
+			       " time=%.3f ms\n", r->size, seq, rtt / 1e6);
+		return;
+	}
+
+	if (err == -ETIMEDOUT)
+		r->lost++;
+	else
+		r->errors++;
+	if (!r->quiet)
+		printf("From ce_gw: seq=%" PRIu32 " %s\n", seq,
+		       err == -ETIMEDOUT ? "Timeout" : strerror(-err));
+}
+
+/**
+ * @fn int ping_number(const char *prog, const char *name, const char *str,
+ *                     double min, double max, double *value)
+ * @brief Parses the option name and checks its range.
+ * @retval 0 on success
+ * @retval -EINVAL after printing an error
+ */
+static int ping_number(const char *prog, const char *name, const char *str,
+                       double min, double max, double *value)
+{
+	char *end;
+
+	*value = strtod(str, &end);
+	if (end == str || *end != '\0' || *value < min || *value > max) {
+		fprintf(stderr, "%s: Error: %s must be between %g and %g\n",
+		        prog, name, min, max);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int ping_main(int argc, char *argv[])
+{
+	struct ce_gw_ping_opts opts = {
+		0, 1.0, PING_SIZE + 1, 1, PING_TIMEOUT, &ping_stop
+	};
+	struct ping_result r = { .quiet = 0 };
+	unsigned int window = PING_FLOOD_WINDOW;
+	const char *prog = "cegwctl ping";
+	double num;
+	int c;
+
+	static struct option long_options[] = {
+		{"count",    required_argument, 0, 'c'},
+		{"interval", required_argument, 0, 'i'},
+		{"size",     required_argument, 0, 's'},
+		{"timeout",  required_argument, 0, 'W'},
+		{"window",   required_argument, 0, 'w'},
+		{"flood",    no_argument,       0, 'f'},
+		{0, 0, 0, 0},
+	};
+
+	optind = 1;
+	while ((c = getopt_long(argc, argv, "c:i:s:W:w:f", long_options,
+	                        NULL)) != -1) {
+		switch (c) {
+		case 'c':
+			if (ping_number(prog, "count", optarg, 1, UINT32_MAX,
+			                &num) != 0)
+				return EXIT_FAILURE;
+			opts.count = num;
+			break;
+
+		case 'i':
+			if (ping_number(prog, "interval", optarg, 0, 3600,
+			                &num) != 0)
+				return EXIT_FAILURE;
+			opts.interval = num;
+			break;
+
+		case 's':
+			/* the data is a string, its \0 counts */
+			if (ping_number(prog, "size", optarg,
+			                CE_GW_PING_MIN - 1, CE_GW_PING_MAX - 1,
+			                &num) != 0)
+				return EXIT_FAILURE;
+			opts.size = num + 1;
+			break;
+
+		case 'W':
+			if (ping_number(prog, "timeout", optarg, 0.001, 3600,
+			                &num) != 0)
+				return EXIT_FAILURE;
+			opts.timeout = num;
+			break;
+
+		case 'w':
+			if (ping_number(prog, "window", optarg, 1, UINT16_MAX,
+			                &num) != 0)
+				return EXIT_FAILURE;
+			window = num;
+			break;
+
+		case 'f':
+			r.quiet = 1;
+			break;
+
+		default:
+			/* getopt_long already printed an error message. */
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind < argc) {
+		fprintf(stderr, "%s: Error: unexpected argument %s\n", prog,
+		        argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	/* flood: as fast as the window allows */
+	if (r.quiet) {
+		opts.interval = 0;
+		opts.window = window;
+	}
+	r.size = opts.size - 1;
+	hist_init(&r.rtt);
+
+	struct cegw_ctx *ctx = cegw_ctx_alloc();
+	if (ctx == NULL) {
+		fprintf(stderr, "Error during initialisation of Socket or "
+		        "Netlink Family\n");
+		return EXIT_FAILURE;
+	}
+
+	struct sigaction sa, old;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = ping_sigint;
+	sigaction(SIGINT, &sa, &old);
+
+	printf("PING ce_gw (%s): %zu data bytes\n", cegw_ctx_transport(ctx),
+	       r.size);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	int sent = ce_gw_ping(ctx, &opts, ping_reply, &r);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	sigaction(SIGINT, &old, NULL);
+	cegw_ctx_free(ctx);
+	if (sent < 0)
+		return EXIT_FAILURE;
+
+	double sec = end.tv_sec - start.tv_sec +
+	             (end.tv_nsec - start.tv_nsec) / 1e9;
+	uint64_t received = r.rtt.n;
+	unsigned int missing = sent - received;
+
+	printf("\n--- ce_gw ping statistics ---\n");
+	printf("%d transmitted, %" PRIu64 " received, %u errors, "
+	       "%.1f%% loss, time %.0f ms\n", sent, received, r.errors,
+	       sent ? 100.0 * missing / sent : 0.0, sec * 1e3);
+	if (received > 0) {
+		printf("rtt min/avg/max/mdev = %.3f/%.3f/%.3f/%.3f ms\n",
+		       r.rtt.min / 1e6, hist_mean(&r.rtt) / 1e6,
+		       r.rtt.max / 1e6, hist_stddev(&r.rtt) / 1e6);
+		printf("rtt p50/p90/p99/p99.9 = %.3f/%.3f/%.3f/%.3f ms\n",
+		       hist_percentile(&r.rtt, 50) / 1e6,
+		       hist_percentile(&r.rtt, 90) / 1e6,
+		       hist_percentile(&r.rtt, 99) / 1e6,
+		       hist_percentile(&r.rtt, 99.9) / 1e6);
+	}
+	if (r.quiet && sec > 0)
+		printf("rate %.0f echoes/s, window %u\n", received / sec,
+		       opts.window);
+
+	return sent > 0 && missing == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,411 @@
+/**
+ * @file snapshot.c
+ * @brief Control Area Network - Ethernet - Gateway - Snapshot (Utility)
+ * @details Saves the devices and routes to a checksummed binary file and
+ *          replays it with pipelined adds.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <net/if_arp.h>
+#include "netlink.h"
+#include "format.h"
+#include "snapshot.h"
+#include "timing.h"
+
+_Static_assert(sizeof(struct ce_gw_snap_header) == 32,
+               "layout of struct ce_gw_snap_header changed");
+_Static_assert(sizeof(struct ce_gw_snap_record) == 8 + 2 * IFNAMSIZ,
+               "layout of struct ce_gw_snap_record changed");
+
+static uint32_t crc_table[256]; /**< CRC-32 of every byte, see crc_init() */
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT; /**< for crc_init() */
+
+/**
+ * @fn void crc_init(void)
+ * @brief Fills crc_table for the reflected polynomial 0xEDB88320.
+ * @ingroup files
+ */
+static void crc_init(void)
+{
+	for (uint32_t i = 0; i < 256; ++i) {
+		uint32_t c = i;
+
+		for (int k = 0; k < 8; ++k)
+			c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+		crc_table[i] = c;
+	}
+}
+
+/**
+ * @fn uint32_t crc32_update(uint32_t crc, const void *buf, size_t len)
+ * @brief Continues the CRC-32 crc (0 at the start) over buf.
+ * @ingroup files
+ */
+static uint32_t crc32_update(uint32_t crc, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+
+	pthread_once(&crc_once, crc_init);
+
+	crc = ~crc;
+	while (len--)
+		crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+/**
+ * @fn uint32_t snap_crc(const struct ce_gw_snap_header *hdr,
+ *                       const void *records, size_t len)
+ * @brief CRC-32 of hdr with crc 0 and len bytes of records.
+ * @ingroup files
+ */
+static uint32_t snap_crc(const struct ce_gw_snap_header *hdr,
+                         const void *records, size_t len)
+{
+	struct ce_gw_snap_header h = *hdr;
+
+	h.crc = 0;
+	return crc32_update(crc32_update(0, &h, sizeof(h)), records, len);
+}
+
+/**
+ * @fn int is_can(const char *name)
+ * @brief Tells if the network device name is a CAN device.
+ * @retval 1 if /sys/class/net/NAME/type is ARPHRD_CAN
+ * @retval 0 otherwise, also if the device does not exist
+ * @ingroup files
+ */
+static int is_can(const char *name)
+{
+	char path[64];
+	int type = -1;
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/type", name);
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+		return 0;
+	if (fscanf(file, "%d", &type) != 1)
+		type = -1;
+	fclose(file);
+
+	return type == ARPHRD_CAN;
+}
+
+/**
+ * @struct snap_name
+ * @brief A device name used by a route, sorted by snap_name_cmp().
+ */
+struct snap_name {
+	const char *name;	/**< src or dst of the route */
+	size_t route;		/**< index of the route */
+};
+
+/**
+ * @fn int snap_name_cmp(const void *a, const void *b)
+ * @brief qsort() order of struct snap_name: by name, then by route, so the
+ *        first entry of a name is its first route.
+ */
+static int snap_name_cmp(const void *a, const void *b)
+{
+	const struct snap_name *x = a, *y = b;
+	int c = strcmp(x->name, y->name);
+
+	if (c != 0)
+		return c;
+	return x->route < y->route ? -1 : x->route > y->route;
+}
+
+/**
+ * @fn void snap_record(struct ce_gw_snap_record *rec, const char *src,
+ *                      const char *dst, uint8_t type, uint32_t flags)
+ * @brief Fills rec, the names \0 padded.
+ */
+static void snap_record(struct ce_gw_snap_record *rec, const char *src,
+                        const char *dst, uint8_t type, uint32_t flags)
+{
+	memset(rec, 0, sizeof(*rec));
+	rec->flags = flags;
+	rec->type = type;
+	strncpy(rec->src, src, IFNAMSIZ - 1);
+	strncpy(rec->dst, dst, IFNAMSIZ - 1);
+}
+
+/**
+ * @fn int write_all(int fd, const void *buf, size_t len)
+ * @brief write() of all len bytes.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len > 0) {
+		ssize_t n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int snapshot_save(struct cegw_ctx *ctx, const char *path)
+{
+	struct ce_gw_route_table cur = { NULL, 0, 0 };
+	struct ce_gw_snap_record *recs = NULL;
+	struct snap_name *names = NULL;
+	struct ce_gw_snap_header hdr;
+	char tmp[4096];
+	size_t n_devs = 0;
+	int fd = -1;
+	int err;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int) sizeof(tmp))
+		return -ENAMETOOLONG;
+
+	err = ce_gw_list_table(ctx, 0, &cur);
+	if (err != 0) {
+		fprintf(stderr, "save: Can not get the current routes: %d\n",
+		        err);
+		goto out;
+	}
+
+	/* at most two devices per route, then the routes */
+	names = malloc((2 * cur.len + 1) * sizeof(*names));
+	recs = malloc((3 * cur.len + 1) * sizeof(*recs));
+	if (names == NULL || recs == NULL) {
+		fprintf(stderr, "save: Out of memory\n");
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (size_t i = 0; i < cur.len; ++i) {
+		names[2 * i].name = cur.routes[i].src;
+		names[2 * i].route = i;
+		names[2 * i + 1].name = cur.routes[i].dst;
+		names[2 * i + 1].route = i;
+	}
+	qsort(names, 2 * cur.len, sizeof(*names), snap_name_cmp);
+
+	for (size_t i = 0; i < 2 * cur.len; ++i) {
+		if (i > 0 && strcmp(names[i].name, names[i - 1].name) == 0)
+			continue;
+		if (is_can(names[i].name))
+			continue;
+
+		const struct ce_gw_route *r = &cur.routes[names[i].route];
+		snap_record(&recs[n_devs++], "", names[i].name, r->type,
+		            r->flags);
+	}
+
+	for (size_t i = 0; i < cur.len; ++i) {
+		const struct ce_gw_route *r = &cur.routes[i];
+		snap_record(&recs[n_devs + i], r->src, r->dst, r->type,
+		            r->flags);
+	}
+
+	size_t len = (n_devs + cur.len) * sizeof(*recs);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CE_GW_SNAP_MAGIC, sizeof(hdr.magic));
+	hdr.version = CE_GW_SNAP_VERSION;
+	hdr.header_size = sizeof(hdr);
+	hdr.byte_order = CE_GW_BIN_BYTE_ORDER;
+	hdr.record_size = sizeof(*recs);
+	hdr.n_devs = n_devs;
+	hdr.n_routes = cur.len;
+	hdr.crc = snap_crc(&hdr, recs, len);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		err = -errno;
+		fprintf(stderr, "save: Can not open %s: %s\n", tmp,
+		        strerror(errno));
+		goto out;
+	}
+
+	err = write_all(fd, &hdr, sizeof(hdr));
+	if (err == 0)
+		err = write_all(fd, recs, len);
+	if (err == 0 && fsync(fd) != 0)
+		err = -errno;
+	if (close(fd) != 0 && err == 0)
+		err = -errno;
+	if (err == 0 && rename(tmp, path) != 0)
+		err = -errno;
+	if (err != 0) {
+		fprintf(stderr, "save: Can not write %s: %s\n", path,
+		        strerror(-err));
+		unlink(tmp);
+		goto out;
+	}
+
+	printf("save: %zu devs, %zu routes\n", n_devs, cur.len);
+
+out:
+	ce_gw_route_table_free(&cur);
+	free(names);
+	free(recs);
+	return err;
+}
+
+/**
+ * @fn const char *snap_check(const struct ce_gw_snap_header *hdr,
+ *                            size_t size)
+ * @brief Checks the header of a snapshot of size bytes and its CRC.
+ * @returns NULL if the snapshot is valid, else the reason.
+ */
+static const char *snap_check(const struct ce_gw_snap_header *hdr,
+                              size_t size)
+{
+	if (size < sizeof(*hdr) ||
+	    memcmp(hdr->magic, CE_GW_SNAP_MAGIC, sizeof(hdr->magic)) != 0)
+		return "Not a snapshot";
+	if (hdr->byte_order != CE_GW_BIN_BYTE_ORDER)
+		return "Written on a host with another byte order";
+	if (hdr->version != CE_GW_SNAP_VERSION)
+		return "Unsupported version";
+	if (hdr->header_size < sizeof(*hdr) || hdr->header_size > size ||
+	    hdr->record_size < sizeof(struct ce_gw_snap_record))
+		return "Malformed header";
+
+	uint64_t len = ((uint64_t) hdr->n_devs + hdr->n_routes) *
+	               hdr->record_size;
+	if (len != size - hdr->header_size)
+		return "Truncated";
+	if (snap_crc(hdr, (const char *) hdr + hdr->header_size, len) !=
+	    hdr->crc)
+		return "Checksum mismatch";
+
+	return NULL;
+}
+
+int snapshot_restore(struct cegw_ctx *ctx, const char *path,
+                     unsigned int window)
+{
+	const struct ce_gw_snap_header *hdr;
+	struct ce_gw_op *ops = NULL;
+	struct stat st;
+	void *map = MAP_FAILED;
+	const char *reason;
+	size_t n = 0;
+	int failed = 0;
+	int err = 0;
+
+	uint64_t start = timing_now();
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		err = -errno;
+		fprintf(stderr, "restore: Can not open %s: %s\n", path,
+		        strerror(errno));
+		goto out;
+	}
+
+	if (st.st_size > 0)
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		err = st.st_size > 0 ? -errno : -EINVAL;
+		fprintf(stderr, "restore: Can not map %s: %s\n", path,
+		        strerror(-err));
+		goto out;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	hdr = map;
+	reason = snap_check(hdr, st.st_size);
+	if (reason != NULL) {
+		fprintf(stderr, "restore: %s: %s\n", path, reason);
+		err = -EINVAL;
+		goto out;
+	}
+
+	n = (size_t) hdr->n_devs + hdr->n_routes;
+	ops = calloc(n + 1, sizeof(*ops));
+	if (ops == NULL) {
+		fprintf(stderr, "restore: Out of memory\n");
+		err = -ENOMEM;
+		goto out;
+	}
+
+	const char *rec = (const char *) map + hdr->header_size;
+	for (size_t i = 0; i < n; ++i, rec += hdr->record_size) {
+		const struct ce_gw_snap_record *r = (const void *) rec;
+
+		ops[i].cmd = CE_GW_C_ADD;
+		ops[i].type = r->type;
+		ops[i].flags = r->flags;
+		ops[i].line = i + 1;
+		memcpy(ops[i].src, r->src, IFNAMSIZ - 1);
+		memcpy(ops[i].dst, r->dst, IFNAMSIZ - 1);
+	}
+
+	err = ce_gw_batch(ctx, ops, n, window);
+
+	for (size_t i = 0; i < n; ++i) {
+		const struct ce_gw_op *op = &ops[i];
+		int dev = op->src[0] == '\0';
+
+		if (op->err == 0 || (dev && op->err == -EEXIST))
+			continue;
+
+		if (dev)
+			fprintf(stderr, "restore: add dev %s failed: %s\n",
+			        op->dst, strerror(-op->err));
+		else
+			fprintf(stderr, "restore: add route %s %s failed: "
+			        "%s\n", op->src, op->dst, strerror(-op->err));
+		failed++;
+	}
+
+	double sec = (timing_now() - start) / 1e9;
+	printf("restore: %u devs, %u routes in %.2f ms (%.0f ops/s)\n",
+	       hdr->n_devs, hdr->n_routes, sec * 1e3, sec > 0 ? n / sec : 0);
+
+	if (err == 0)
+		err = failed;
+
+out:
+	if (map != MAP_FAILED)
+		munmap(map, st.st_size);
+	if (fd >= 0)
+		close(fd);
+	free(ops);
+	return err;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file timing.c
+ * @brief Control Area Network - Ethernet - Gateway - Timing (Utility)
+ * @details Aggregates the time of the phases of the netlink requests per
+ *          command and writes the optional trace file of --timing.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "timing.h"
+
+/**
+ * @struct timing_stat
+ * @brief The aggregated time of one phase of one command.
+ */
+struct timing_stat {
+	uint64_t count;	/**< number of times the phase occurred */
+	uint64_t total;	/**< total time in ns */
+	uint64_t min;	/**< shortest time in ns */
+	uint64_t max;	/**< longest time in ns */
+};
+
+/**
+ * @struct timing_record
+ * @brief The phases of the request in progress of one command.
+ */
+struct timing_record {
+	int open;				/**< 1 while in progress */
+	uint64_t start;				/**< time of timing_begin() */
+	uint64_t phases[__TIMING_P_MAX];	/**< time per phase in ns */
+};
+
+/** Names of enum timing_cmd */
+static const char *cmd_names[__TIMING_C_MAX] = {
+	"echo", "add", "del", "list", "family", "batch"
+};
+
+/** Names of enum timing_phase */
+static const char *phase_names[__TIMING_P_MAX] = {
+	"alloc", "encode", "validate", "send", "wait", "recv", "callback"
+};
+
+int timing_enabled;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; /**< of stats and
+                                                          * trace */
+static struct timing_stat stats[__TIMING_C_MAX][__TIMING_P_MAX];
+/** the requests in progress, every thread has its own requests */
+static __thread struct timing_record records[__TIMING_C_MAX];
+static FILE *trace; /**< the trace file or NULL */
+
+uint64_t timing_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @fn void timing_exit(void)
+ * @brief Prints the summary to stderr and closes the trace file. Registered
+ *        with atexit() by timing_init().
+ */
+static void timing_exit(void)
+{
+	timing_summary(stderr);
+
+	if (trace != NULL) {
+		fclose(trace);
+		trace = NULL;
+	}
+}
+
+int timing_init(const char *trace_path)
+{
+	if (trace_path != NULL) {
+		trace = fopen(trace_path, "w");
+		if (trace == NULL)
+			return -errno;
+
+		fprintf(trace, "cmd,seq,start_ns");
+		for (int p = 0; p < __TIMING_P_MAX; ++p)
+			fprintf(trace, ",%s_ns", phase_names[p]);
+		fprintf(trace, ",err\n");
+	}
+
+	for (int c = 0; c < __TIMING_C_MAX; ++c) {
+		for (int p = 0; p < __TIMING_P_MAX; ++p)
+			stats[c][p].min = UINT64_MAX;
+	}
+
+	timing_enabled = 1;
+	atexit(timing_exit);
+
+	return 0;
+}
+
+void timing_begin(enum timing_cmd cmd)
+{
+	struct timing_record *rec = &records[cmd];
+
+	if (rec->open)
+		return;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->open = 1;
+	rec->start = timing_now();
+}
+
+void timing_phase(enum timing_cmd cmd, enum timing_phase phase,
+                  uint64_t *stamp)
+{
+	struct timing_stat *stat = &stats[cmd][phase];
+	uint64_t now = timing_now();
+	uint64_t t = now - *stamp;
+
+	pthread_mutex_lock(&lock);
+	stat->count++;
+	stat->total += t;
+	if (t < stat->min)
+		stat->min = t;
+	if (t > stat->max)
+		stat->max = t;
+	pthread_mutex_unlock(&lock);
+
+	if (records[cmd].open)
+		records[cmd].phases[phase] += t;
+
+	*stamp = now;
+}
+
+void timing_end(enum timing_cmd cmd, uint32_t seq, int err)
+{
+	struct timing_record *rec = &records[cmd];
+
+	if (!rec->open)
+		return;
+	rec->open = 0;
+
+	if (trace == NULL)
+		return;
+
+	pthread_mutex_lock(&lock);
+	fprintf(trace, "%s,%u,%llu", cmd_names[cmd], seq,
+	        (unsigned long long) rec->start);
+	for (int p = 0; p < __TIMING_P_MAX; ++p)
+		fprintf(trace, ",%llu", (unsigned long long) rec->phases[p]);
+	fprintf(trace, ",%d\n", err);
+	pthread_mutex_unlock(&lock);
+}
+
+void timing_summary(FILE *file)
+{
+	pthread_mutex_lock(&lock);
+	fprintf(file, "timing: %-7s %-9s %9s %11s %10s %10s %10s\n", "CMD",
+	        "PHASE", "COUNT", "TOTAL ms", "MIN us", "MEAN us", "MAX us");
+
+	for (int c = 0; c < __TIMING_C_MAX; ++c) {
+		for (int p = 0; p < __TIMING_P_MAX; ++p) {
+			const struct timing_stat *s = &stats[c][p];
+
+			if (s->count == 0)
+				continue;
+
+			fprintf(file, "        %-7s %-9s %9llu %11.3f %10.1f "
+			        "%10.1f %10.1f\n", cmd_names[c],
+			        phase_names[p], (unsigned long long) s->count,
+			        s->total / 1e6, s->min / 1e3,
+			        s->total / 1e3 / s->count, s->max / 1e3);
+		}
+	}
+	pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file transport.c
+ * @brief Control Area Network - Ethernet - Gateway - Transport (Utility)
+ * @details Selection of the transport and the generic netlink transport.
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netlink/genl/genl.h>
+#include "transport.h"
+#include "ifcache.h"
+
+/**
+ * @fn int netlink_open(struct nl_sock *sk)
+ * @brief connects sk to the generic netlink bus of the kernel.
+ * @ingroup net
+ */
+static int netlink_open(struct nl_sock *sk)
+{
+	return genl_connect(sk);
+}
+
+const struct ce_gw_transport netlink_transport = {
+	.name = "netlink",
+	.cache_family = 1,
+	.open = netlink_open,
+	.close = nl_close,
+	.setup_cb = NULL,
+	.links = ifcache_rtnl_load,
+};
+
+/** all transports for transport_select() */
+static const struct ce_gw_transport *transports[] = {
+	&netlink_transport,
+	&mock_transport,
+	NULL,
+};
+
+const struct ce_gw_transport *transport_select(const char *name)
+{
+	if (name == NULL)
+		name = getenv(TRANSPORT_ENV);
+	if (name == NULL || name[0] == '\0')
+		name = netlink_transport.name;
+
+	for (int i = 0; transports[i] != NULL; ++i) {
+		if (strcmp(name, transports[i]->name) == 0)
+			return transports[i];
+	}
+
+	return NULL;
+}
+
+struct nl_cb *transport_cb_alloc(const struct ce_gw_transport *t,
+                                 enum nl_cb_kind kind)
+{
+	struct nl_cb *cb = nl_cb_alloc(kind);
+
+	if (cb != NULL && t->setup_cb != NULL)
+		t->setup_cb(cb);
+
+	return cb;
+}
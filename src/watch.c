@@ -0,0 +1,508 @@
+/**
+ * @file watch.c
+ * @brief Control Area Network - Ethernet - Gateway - Route Statistics
+ * (Utility)
+ * @details Samples the counters of the routes periodically and prints their
+ *          rates (cegwctl route --watch and --delta).
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "watch.h"
+#include "format.h"
+
+#define STAT_TABLE_MIN 64 /**< initial size of a struct stat_table */
+
+/**
+ * @struct watch_arg
+ * @brief Argument of watch_sample(). The routes of the new sample are stored
+ *        in cur, the previous sample is looked up in prev.
+ */
+struct watch_arg {
+	struct stat_table prev;	/**< previous sample */
+	struct stat_table cur;	/**< current sample */
+	double elapsed;		/**< seconds since the previous sample */
+};
+
+/**
+ * @fn size_t stat_hash(uint32_t id, size_t size)
+ * @brief Fibonacci hash of a route id for a table of size (power of 2).
+ */
+static inline size_t stat_hash(uint32_t id, size_t size)
+{
+	return (size_t) ((id * 2654435769u) & (size - 1));
+}
+
+/**
+ * @fn struct route_stat *stat_slot(struct stat_table *table, uint32_t id)
+ * @brief Returns the entry of id or the empty slot where it belongs.
+ */
+static struct route_stat *stat_slot(struct stat_table *table, uint32_t id)
+{
+	size_t i = stat_hash(id, table->size);
+
+	while (table->stats[i].route.id != 0 &&
+	       table->stats[i].route.id != id)
+		i = (i + 1) & (table->size - 1);
+
+	return &table->stats[i];
+}
+
+/**
+ * @fn int stat_table_init(struct stat_table *table, size_t size)
+ * @brief Allocates an empty table with size slots (a power of 2).
+ * @retval 0 on success
+ * @retval -ENOMEM on failure
+ */
+static int stat_table_init(struct stat_table *table, size_t size)
+{
+	table->stats = calloc(size, sizeof(*table->stats));
+	if (table->stats == NULL)
+		return -ENOMEM;
+
+	table->len = 0;
+	table->size = size;
+	return 0;
+}
+
+/**
+ * @fn void stat_table_clear(struct stat_table *table)
+ * @brief Removes all entries, the memory is kept.
+ */
+static void stat_table_clear(struct stat_table *table)
+{
+	memset(table->stats, 0, table->size * sizeof(*table->stats));
+	table->len = 0;
+}
+
+/**
+ * @fn int stat_table_grow(struct stat_table *table)
+ * @brief Doubles the size of table if it is more than half full.
+ * @retval 0 on success
+ * @retval -ENOMEM on failure
+ */
+static int stat_table_grow(struct stat_table *table)
+{
+	struct stat_table bigger;
+
+	if (table->len * 2 < table->size)
+		return 0;
+
+	if (stat_table_init(&bigger, table->size * 2) != 0)
+		return -ENOMEM;
+
+	for (size_t i = 0; i < table->size; ++i) {
+		if (table->stats[i].route.id != 0)
+			*stat_slot(&bigger, table->stats[i].route.id) =
+				table->stats[i];
+	}
+
+	bigger.len = table->len;
+	free(table->stats);
+	*table = bigger;
+	return 0;
+}
+
+/**
+ * @fn int same_route(const struct ce_gw_route *a,
+ *                    const struct ce_gw_route *b)
+ * @brief Checks if a and b are the same route and not a new route which got
+ *        the id of a deleted one.
+ */
+static int same_route(const struct ce_gw_route *a, const struct ce_gw_route *b)
+{
+	return a->type == b->type && a->flags == b->flags &&
+	       strncmp(a->src, b->src, IFNAMSIZ) == 0 &&
+	       strncmp(a->dst, b->dst, IFNAMSIZ) == 0;
+}
+
+/**
+ * @fn int watch_sample(const struct ce_gw_route *route, void *arg)
+ * @brief Stores a route of the new sample and computes its rates from the
+ *        previous sample.
+ * @details The difference of the 32 bit counters is computed modulo 2^32,
+ *          so a single wrap between two samples is counted correctly. A
+ *          route which was not in the previous sample, or whose id now
+ *          belongs to a route with other devices, type or flags, starts
+ *          with its current counters and rate 0.
+ * @retval 0 on success
+ * @retval -ENOMEM if the table could not grow. Stops the listing.
+ * @ingroup cb
+ */
+static int watch_sample(const struct ce_gw_route *route, void *arg)
+{
+	struct watch_arg *w = arg;
+	struct route_stat *prev, *stat;
+
+	/* id 0 marks an empty slot, the kernel starts counting at 1 */
+	if (route->id == 0)
+		return 0;
+
+	if (stat_table_grow(&w->cur) != 0)
+		return -ENOMEM;
+
+	stat = stat_slot(&w->cur, route->id);
+	if (stat->route.id == 0)
+		w->cur.len++;
+
+	prev = stat_slot(&w->prev, route->id);
+	if (prev->route.id == 0 || !same_route(&prev->route, route)) {
+		stat->handled = route->handled;
+		stat->dropped = route->dropped;
+		stat->handled_rate = 0;
+		stat->dropped_rate = 0;
+	} else {
+		uint32_t handled = route->handled - prev->route.handled;
+		uint32_t dropped = route->dropped - prev->route.dropped;
+
+		stat->handled = prev->handled + handled;
+		stat->dropped = prev->dropped + dropped;
+		stat->handled_rate = w->elapsed > 0 ? handled / w->elapsed : 0;
+		stat->dropped_rate = w->elapsed > 0 ? dropped / w->elapsed : 0;
+	}
+
+	stat->route = *route;
+	return 0;
+}
+
+/**
+ * @fn int stat_cmp(const void *a, const void *b)
+ * @brief qsort() compare function: highest frames/s first, then by id.
+ */
+static int stat_cmp(const void *a, const void *b)
+{
+	const struct route_stat *x = *(const struct route_stat * const *) a;
+	const struct route_stat *y = *(const struct route_stat * const *) b;
+
+	if (x->handled_rate != y->handled_rate)
+		return x->handled_rate < y->handled_rate ? 1 : -1;
+	if (x->dropped_rate != y->dropped_rate)
+		return x->dropped_rate < y->dropped_rate ? 1 : -1;
+
+	return x->route.id < y->route.id ? -1 : x->route.id > y->route.id;
+}
+
+/**
+ * @fn size_t screen_rows(void)
+ * @brief Returns the number of rows of the terminal or 0 if stdout is no
+ *        terminal.
+ */
+static size_t screen_rows(void)
+{
+	struct winsize ws;
+
+	if (!isatty(STDOUT_FILENO) ||
+	    ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0)
+		return 0;
+
+	return ws.ws_row;
+}
+
+/**
+ * @fn size_t watch_sort(struct stat_table *table, struct route_stat **sorted)
+ * @brief Stores pointers to the routes of table in sorted, highest load
+ *        first.
+ * @param sorted Array of at least table->len pointers.
+ * @returns The number of routes.
+ */
+static size_t watch_sort(struct stat_table *table, struct route_stat **sorted)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < table->size; ++i) {
+		if (table->stats[i].route.id != 0)
+			sorted[n++] = &table->stats[i];
+	}
+	qsort(sorted, n, sizeof(*sorted), stat_cmp);
+
+	return n;
+}
+
+/**
+ * @fn double drop_ratio(const struct route_stat *stat)
+ * @brief drops / (frames + drops) of the last interval in percent.
+ */
+static inline double drop_ratio(const struct route_stat *stat)
+{
+	double total = stat->handled_rate + stat->dropped_rate;
+
+	return total > 0 ? 100 * stat->dropped_rate / total : 0;
+}
+
+/**
+ * @fn int watch_print(struct route_stat **sorted, size_t n, double interval,
+ *                     int clear)
+ * @brief Prints the sorted routes as table with one write().
+ * @param clear If set, the screen is cleared first and only as many routes
+ *              are printed as fit on the terminal.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int watch_print(struct route_stat **sorted, size_t n, double interval,
+                       int clear)
+{
+	struct outbuf out;
+	char line[ROW_MAX];
+	uint64_t handled_sum = 0, dropped_sum = 0;
+	double handled_rate = 0, dropped_rate = 0;
+	size_t rows = n;
+	int len, err;
+
+	for (size_t i = 0; i < n; ++i) {
+		handled_sum += sorted[i]->handled;
+		dropped_sum += sorted[i]->dropped;
+		handled_rate += sorted[i]->handled_rate;
+		dropped_rate += sorted[i]->dropped_rate;
+	}
+
+	if (outbuf_init(&out, STDOUT_FILENO, OUTBUF_SIZE) != 0)
+		return -ENOMEM;
+
+	if (clear) {
+		size_t screen = screen_rows();
+		outbuf_put(&out, "\033[H\033[2J", 7);
+		if (screen > 4 && rows > screen - 4)
+			rows = screen - 4;
+	}
+
+	len = snprintf(line, sizeof(line),
+	               "routes: %zu  interval: %.2f s  frames/s: %.0f  "
+	               "drops/s: %.0f\n\n"
+	               " ID       SRC    DST    TYPE   FRAMES/S   DROPS/S    "
+	               "DROP%%   HANDLED      DROPPED\n",
+	               n, interval, handled_rate, dropped_rate);
+	outbuf_put(&out, line, len);
+
+	for (size_t i = 0; i < rows; ++i) {
+		const struct route_stat *stat = sorted[i];
+		const struct ce_gw_route *r = &stat->route;
+		size_t type_len;
+
+		len = snprintf(line, sizeof(line),
+		               " %-8u %-6s %-6s %-6s %-10.0f %-10.0f "
+		               "%-7.2f %-12llu %llu\n",
+		               r->id, r->src, r->dst,
+		               format_type(r->type, &type_len),
+		               stat->handled_rate, stat->dropped_rate,
+		               drop_ratio(stat),
+		               (unsigned long long) stat->handled,
+		               (unsigned long long) stat->dropped);
+		outbuf_put(&out, line, len);
+	}
+
+	if (!clear) {
+		len = snprintf(line, sizeof(line), " %-60s%-12llu %llu\n",
+		               "total", (unsigned long long) handled_sum,
+		               (unsigned long long) dropped_sum);
+		outbuf_put(&out, line, len);
+	}
+
+	fflush(stdout);
+	err = outbuf_flush(&out);
+	outbuf_free(&out);
+	return err;
+}
+
+/**
+ * @fn int watch_records(struct route_stat **sorted, size_t n,
+ *                       unsigned int format, int header)
+ * @brief Prints the sorted routes as JSON lines (one object per route and
+ *        sample) or CSV lines, each with the time of the sample.
+ * @param header If set, the CSV column names are printed first.
+ * @retval 0 on success
+ * @retval <0 -errno on failure
+ */
+static int watch_records(struct route_stat **sorted, size_t n,
+                         unsigned int format, int header)
+{
+	static const char csv_header[] = "time,id,src,dst,type,frames_per_s,"
+		"drops_per_s,drop_percent,handled,dropped\n";
+	struct outbuf out;
+	struct timespec ts;
+	char line[ROW_MAX];
+	char src[6 * IFNAMSIZ + 2], dst[6 * IFNAMSIZ + 2];
+	int len, err;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	double now = ts.tv_sec + ts.tv_nsec / 1e9;
+
+	if (outbuf_init(&out, STDOUT_FILENO, OUTBUF_SIZE) != 0)
+		return -ENOMEM;
+
+	if (header && (format & FORMAT_MASK) == FORMAT_CSV)
+		outbuf_put(&out, csv_header, sizeof(csv_header) - 1);
+
+	for (size_t i = 0; i < n; ++i) {
+		const struct route_stat *stat = sorted[i];
+		const struct ce_gw_route *r = &stat->route;
+		size_t type_len;
+		const char *type_str = format_type(r->type, &type_len);
+
+		if ((format & FORMAT_MASK) == FORMAT_JSON) {
+			src[fmt_json_str(src, r->src,
+			                 strnlen(r->src, IFNAMSIZ - 1))] = '\0';
+			dst[fmt_json_str(dst, r->dst,
+			                 strnlen(r->dst, IFNAMSIZ - 1))] = '\0';
+			len = snprintf(line, sizeof(line),
+			               "{\"time\":%.3f,\"id\":%u,\"src\":%s,"
+			               "\"dst\":%s,\"type\":\"%s\","
+			               "\"frames_per_s\":%.1f,"
+			               "\"drops_per_s\":%.1f,"
+			               "\"drop_percent\":%.3f,"
+			               "\"handled\":%llu,\"dropped\":%llu}\n",
+			               now, r->id, src, dst, type_str,
+			               stat->handled_rate, stat->dropped_rate,
+			               drop_ratio(stat),
+			               (unsigned long long) stat->handled,
+			               (unsigned long long) stat->dropped);
+		} else {
+			*fmt_csv_str(src, r->src,
+			             strnlen(r->src, IFNAMSIZ - 1)) = '\0';
+			*fmt_csv_str(dst, r->dst,
+			             strnlen(r->dst, IFNAMSIZ - 1)) = '\0';
+			len = snprintf(line, sizeof(line),
+			               "%.3f,%u,%s,%s,%s,%.1f,%.1f,%.3f,"
+			               "%llu,%llu\n",
+			               now, r->id, src, dst, type_str,
+			               stat->handled_rate, stat->dropped_rate,
+			               drop_ratio(stat),
+			               (unsigned long long) stat->handled,
+			               (unsigned long long) stat->dropped);
+		}
+		outbuf_put(&out, line, len);
+	}
+
+	fflush(stdout);
+	err = outbuf_flush(&out);
+	outbuf_free(&out);
+	return err;
+}
+
+/**
+ * @fn double timespec_sec(const struct timespec *ts)
+ * @brief converts ts to seconds.
+ */
+static inline double timespec_sec(const struct timespec *ts)
+{
+	return ts->tv_sec + ts->tv_nsec / 1e9;
+}
+
+int ce_gw_watch(struct cegw_ctx *ctx, uint32_t id,
+                const struct ce_gw_route_filter *filter, double interval,
+                int once, unsigned int format)
+{
+	struct watch_arg w;
+	struct ce_gw_lister *lister;
+	struct route_stat **sorted = NULL;
+	size_t sorted_size = 0, samples = 0;
+	struct timespec next, last, now;
+	int err;
+
+	if (interval <= 0 || (format & FORMAT_MASK) == FORMAT_BIN)
+		return -EINVAL;
+
+	lister = ce_gw_lister_alloc(ctx, id);
+	if (lister == NULL)
+		return -1;
+
+	err = ce_gw_lister_filter(lister, filter);
+	if (err != 0) {
+		ce_gw_lister_free(lister);
+		return err;
+	}
+
+	if (stat_table_init(&w.prev, STAT_TABLE_MIN) != 0 ||
+	    stat_table_init(&w.cur, STAT_TABLE_MIN) != 0) {
+		ce_gw_lister_free(lister);
+		free(w.prev.stats);
+		return -ENOMEM;
+	}
+
+	/* the first sample has no previous one, it only fills the table */
+	w.elapsed = 0;
+	clock_gettime(CLOCK_MONOTONIC, &last);
+	err = ce_gw_lister_run(lister, watch_sample, &w);
+	next = last;
+
+	for (int first = 1; err == 0; first = 0) {
+		/* swap, the current sample becomes the previous one */
+		struct stat_table tmp = w.prev;
+		w.prev = w.cur;
+		w.cur = tmp;
+		stat_table_clear(&w.cur);
+
+		if (!first && once)
+			break;
+
+		/* sleep until an absolute time, so the samples do not drift */
+		next.tv_sec += (time_t) interval;
+		next.tv_nsec += (long) ((interval - (time_t) interval) * 1e9);
+		if (next.tv_nsec >= 1000000000L) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+		                       NULL) == EINTR)
+			;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		w.elapsed = timespec_sec(&now) - timespec_sec(&last);
+		last = now;
+
+		err = ce_gw_lister_run(lister, watch_sample, &w);
+		if (err != 0)
+			break;
+
+		if (sorted_size < w.cur.len) {
+			free(sorted);
+			sorted_size = w.cur.size;
+			sorted = malloc(sorted_size * sizeof(*sorted));
+			if (sorted == NULL) {
+				err = -ENOMEM;
+				break;
+			}
+		}
+
+		size_t n = watch_sort(&w.cur, sorted);
+		if ((format & FORMAT_MASK) == FORMAT_TEXT)
+			err = watch_print(sorted, n, w.elapsed, !once);
+		else
+			err = watch_records(sorted, n, format,
+			                    samples++ == 0 &&
+			                    !(format & FORMAT_NO_HEADER));
+	}
+
+	free(sorted);
+	free(w.prev.stats);
+	free(w.cur.stats);
+	ce_gw_lister_free(lister);
+
+	return err;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file event_standin.c
+ * @brief Control Area Network - Ethernet - Gateway - Event Stand-in
+ * (Utility)
+ * @details Emits CE_GW_C_EVENT messages like the kernel module, but to a
+ *          NETLINK_USERSOCK multicast group, which needs neither the module
+ *          nor root. So "cegwctl monitor" can be tried without the module:
+ *
+ *              CEGW_EVENT_USERSOCK=5 cegwctl monitor &
+ *              event_standin 5 3
+ *
+ *          Every cycle emits dev-add, route-add, drop, route-del and dev-del.
+ *          Build with "make tools".
+ * @author Fabian Raab (fabian.raab@tum.de)
+ * @date May, 2013
+ * @copyright GNU Public License v3 or higher
+ */
+
+/*****************************************************************************
+ * (C) Copyright 2013 Fabian Raab, Stefan Smarzly
+ *
+ * This file is part of CAN-Eth-GW.
+ *
+ * CAN-Eth-GW is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CAN-Eth-GW is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CAN-Eth-GW.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <linux/genetlink.h>
+#include "netlink.h"
+#include "timing.h"
+
+/**
+ * @fn int emit(struct nl_sock *sk, uint8_t type, uint32_t id,
+ *              const char *src, const char *dst)
+ * @brief sends one event to the group of sk.
+ * @retval 0 on success
+ * @retval <0 libnl error code on failure
+ */
+static int emit(struct nl_sock *sk, uint8_t type, uint32_t id,
+                const char *src, const char *dst)
+{
+	struct ce_gw_event event;
+	struct nl_msg *msg;
+	int err;
+
+	memset(&event, 0, sizeof(event));
+	event.event = type;
+	event.time = timing_now();
+	event.route.id = id;
+	event.route.type = TYPE_NET;
+	event.route.handled = 100000 * id;
+	event.route.dropped = 1000 * id;
+	strncpy(event.route.src, src, IFNAMSIZ - 1);
+	strncpy(event.route.dst, dst, IFNAMSIZ - 1);
+
+	/* no family ID without the module, any genl ID will do */
+	msg = ce_gw_event_msg(&event, GENL_MIN_ID);
+	if (msg == NULL)
+		return -NLE_NOMEM;
+
+	err = nl_send_auto(sk, msg);
+	nlmsg_free(msg);
+
+	/* the kernel also unicasts to port 0, which has no NETLINK_USERSOCK
+	 * socket. The multicast was delivered anyway */
+	if (err < 0 && errno == ECONNREFUSED)
+		err = 0;
+
+	return err < 0 ? err : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct nl_sock *sk;
+	int err = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s GROUP [CYCLES] [INTERVAL_MS]\n",
+		        argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int group = atoi(argv[1]);
+	int cycles = argc > 2 ? atoi(argv[2]) : 1;
+	int interval = argc > 3 ? atoi(argv[3]) : 100;
+
+	if (group <= 0 || group > 32) {
+		fprintf(stderr, "%s: GROUP must be between 1 and 32\n",
+		        argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	sk = nl_socket_alloc();
+	if (sk == NULL || nl_connect(sk, NETLINK_USERSOCK) != 0) {
+		fprintf(stderr, "%s: Connection to socket failed\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	nl_socket_set_peer_groups(sk, 1u << (group - 1));
+	nl_socket_disable_auto_ack(sk);
+
+	for (int i = 1; i <= cycles && err == 0; ++i) {
+		char dev[IFNAMSIZ];
+		snprintf(dev, sizeof(dev), "cegw%d", i);
+
+		err = emit(sk, CE_GW_E_DEV_ADD, 0, "", dev);
+		if (err == 0)
+			err = emit(sk, CE_GW_E_ROUTE_ADD, i, "can0", dev);
+		if (err == 0)
+			err = emit(sk, CE_GW_E_DROP, i, "can0", dev);
+		if (err == 0)
+			err = emit(sk, CE_GW_E_ROUTE_DEL, i, "can0", dev);
+		if (err == 0)
+			err = emit(sk, CE_GW_E_DEV_DEL, 0, "", dev);
+
+		usleep(interval * 1000);
+	}
+
+	if (err != 0)
+		fprintf(stderr, "%s: Sending failed: %s\n", argv[0],
+		        nl_geterror(err));
+
+	nl_close(sk);
+	nl_socket_free(sk);
+	return err == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}